@@ -10,6 +10,10 @@ INSTALL_FOLDER="$TMP_FOLDER/install"
 # Unset these to skip the corresponding steps
 TEST_STEP=1
 INSTALL_STEP=1
+# Set this (-b|--benchmark) to run the benchmarks after the tests
+unset BENCHMARK_STEP
+# Set this (-s|--soak) to run the memory soak tests after the tests
+unset SOAK_STEP
 unset HELP PYTHON_VERS
 PYTHON_VERS_DEFAULT="system fink 2.6 3.1"
 
@@ -20,6 +24,12 @@ while test $# -gt 0; do
     -h|--help)
       HELP=1
       ;;
+    -b|--benchmark)
+      BENCHMARK_STEP=1
+      ;;
+    -s|--soak)
+      SOAK_STEP=1
+      ;;
     *)
       PYTHON_VERS="$PYTHON_VERS $OPTION"
       ;;
@@ -32,9 +42,9 @@ if test -n "$HELP"; then
   cat << EOF
 Usage:
   $MYNAME -h|--help
-  $MYNAME
-  $MYNAME ver1 [ver2 ...]
-  PYTHON_VERS="ver1 [ver2 ...]" $MYNAME
+  $MYNAME [-b|--benchmark] [-s|--soak]
+  $MYNAME [-b|--benchmark] [-s|--soak] ver1 [ver2 ...]
+  PYTHON_VERS="ver1 [ver2 ...]" $MYNAME [-b|--benchmark] [-s|--soak]
 
 $MYNAME is a helper script that runs one cycle consisting of a build,
 test and install step per specified Python version.
@@ -50,6 +60,14 @@ $MYNAME writes the result of all the cycles it runs to a log file for
 later inspection. The log file is removed if it exists when $MYNAME
 is started.
 
+With -b|--benchmark, $MYNAME also runs the benchmarks after the unit tests
+and writes their results as JSON to $MYNAME.benchmark-<version>.json.
+The files of two runs can be diffed to spot performance regressions.
+
+With -s|--soak, $MYNAME also runs the memory soak tests after the unit tests
+and writes their measurements as JSON to $MYNAME.soak-<version>.json. The
+step fails if a measurement exceeds the baseline in src/packages/soak.
+
 Note about how Python versions are interpreted:
 - system: The system's version of Python. The binary is expected to be present
   in /usr/bin/python.
@@ -179,6 +197,32 @@ for PYTHON_VER in $PYTHON_VERS; do
     fi
   fi
 
+  if test -n "$BENCHMARK_STEP" -a -n "$TEST_STEP"; then
+    printf "  Running benchmarks... "
+    BENCHMARK_FILE="$MYNAME.benchmark-$PYTHON_VER.json"
+    PYTHONPATH="$TMP_FOLDER" "$PYTHON_BIN" setup.py benchmark "--output=$BENCHMARK_FILE" >>"$LOGFILE" 2>&1
+    if test $? -eq 0; then
+      echo "success (results in $BENCHMARK_FILE)"
+    else
+      echo "failed"
+      AT_LEAST_ONE_STEP_FAILED=1
+      continue
+    fi
+  fi
+
+  if test -n "$SOAK_STEP" -a -n "$TEST_STEP"; then
+    printf "  Running memory soak tests... "
+    SOAK_FILE="$MYNAME.soak-$PYTHON_VER.json"
+    PYTHONPATH="$TMP_FOLDER" "$PYTHON_BIN" setup.py soak "--output=$SOAK_FILE" >>"$LOGFILE" 2>&1
+    if test $? -eq 0; then
+      echo "success (results in $SOAK_FILE)"
+    else
+      echo "failed"
+      AT_LEAST_ONE_STEP_FAILED=1
+      continue
+    fi
+  fi
+
   if test -n "$INSTALL_STEP"; then
     printf "  Testing installation... "
     "$PYTHON_BIN" setup.py install "--home=$INSTALL_FOLDER" >>"$LOGFILE" 2>&1
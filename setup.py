@@ -71,7 +71,21 @@ aprmd5 = Extension("aprmd5",
                    sources = ["src/extension/aprmd5.c",
                               "src/extension/aprmd5_md5type.c",
                               "src/extension/aprmd5_wrappers.c",
-                              "src/extension/aprmd5_helpers.c"],
+                              "src/extension/aprmd5_helpers.c",
+                              "src/extension/aprmd5_threadpool.c",
+                              "src/extension/aprmd5_md5block.c",
+                              "src/extension/aprmd5_backend.c",
+                              "src/extension/aprmd5_multibuf.c",
+                              "src/extension/aprmd5_apr1.c",
+                              "src/extension/aprmd5_passwd.c",
+                              "src/extension/aprmd5_fileio.c",
+                              "src/extension/aprmd5_checkpoint.c",
+                              "src/extension/aprmd5_dedup.c",
+                              "src/extension/aprmd5_async.c",
+                              "src/extension/aprmd5_cache.c",
+                              "src/extension/aprmd5_htpasswd.c",
+                              "src/extension/aprmd5_stats.c",
+                              "src/extension/aprmd5_capsule.c"],
                    define_macros = [("APRMD5_HEADER_FILENAME",
                                      aprmd5_header_filename)],
                    libraries = [aprmd5_library_filename],
@@ -82,7 +96,7 @@ aprmd5 = Extension("aprmd5",
 
 
 # Extend search path for packages and modules. This is required for finding the
-# "tests" package and its modules.
+# "tests", "benchmarks" and "soak" packages and their modules.
 PACKAGES_BASEDIR = "src/packages"
 sys.path.append(PACKAGES_BASEDIR)
 
@@ -137,12 +151,115 @@ class test(Command):
             sys.exit(1)
 
 
+class benchmark(Command):
+    """Implements a distutils command to run the benchmarks.
+
+    To run the command, a user must type something like this:
+      ./setup.py benchmark                          # run all benchmarks
+      ./setup.py benchmark --output=results.json    # also write JSON results
+      ./setup.py benchmark --max-size=16777216      # skip the huge buffers
+
+    The JSON results of two runs (e.g. before and after an upgrade of
+    libaprutil or the compiler) can be compared with any diff tool.
+    """
+
+    description = "run benchmarks"
+
+    user_options = [("output=", "o", "write the results as JSON to this file"),
+                    ("max-size=", "m", "largest buffer size in bytes for md5.update() [default: 1073741824]"),
+                    ("duration=", "d", "minimum duration in seconds of one measurement [default: 0.2]"),
+                    ("repeat=", "r", "number of measurements per operation; the best is reported [default: 3]")]
+
+    def __init__(self, dist):
+        self.command_name = "benchmark"
+        Command.__init__(self, dist)
+
+    def initialize_options(self):
+        self.output = None
+        self.max_size = 1 << 30
+        self.duration = 0.2
+        self.repeat = 3
+
+    def finalize_options(self):
+        self.max_size = int(self.max_size)
+        self.duration = float(self.duration)
+        self.repeat = int(self.repeat)
+        if self.repeat < 1:
+            raise ValueError("repeat must be at least 1")
+
+    def run(self):
+        import benchmarks
+        runner = benchmarks.Runner(duration = self.duration,
+                                   repeat = self.repeat,
+                                   maxSize = self.max_size)
+        benchmarks.runAll(runner, self.output)
+
+
+class soak(Command):
+    """Implements a distutils command to run the memory soak tests.
+
+    To run the command, a user must type something like this:
+      ./setup.py soak                             # compare with the baseline
+      ./setup.py soak --duration=60               # soak each scenario longer
+      ./setup.py soak --write-baseline            # accept the measurements
+
+    The command fails if a scenario leaves more memory behind per call, or
+    grows the RSS more, than the baseline allows. Write a new baseline only
+    after a change that is expected to use more memory.
+    """
+
+    description = "run memory soak tests and compare them with a baseline"
+
+    user_options = [("output=", "o", "write the measurements as JSON to this file"),
+                    ("baseline=", "b", "JSON file with the limits [default: src/packages/soak/baseline.json]"),
+                    ("write-baseline", "w", "write the measurements as the new baseline instead of comparing"),
+                    ("duration=", "d", "duration in seconds of the RSS loop of one scenario [default: 5]"),
+                    ("min-calls=", "m", "minimum number of calls per loop [default: 1000]")]
+
+    def __init__(self, dist):
+        self.command_name = "soak"
+        Command.__init__(self, dist)
+
+    def initialize_options(self):
+        self.output = None
+        self.baseline = None
+        self.write_baseline = 0
+        self.duration = 5.0
+        self.min_calls = 1000
+
+    def finalize_options(self):
+        self.duration = float(self.duration)
+        self.min_calls = int(self.min_calls)
+        if self.min_calls < 1:
+            raise ValueError("min-calls must be at least 1")
+
+    def run(self):
+        import json
+        import soak
+        baselinePath = self.baseline or soak.BASELINE_PATH
+        runner = soak.Runner(duration = self.duration, minCalls = self.min_calls)
+        report = soak.runAll(runner, self.output)
+        if self.write_baseline:
+            with open(baselinePath, "w") as baselineFile:
+                json.dump(soak.makeBaseline(report["results"]), baselineFile, indent = 2, sort_keys = True)
+                baselineFile.write("\n")
+            return
+        regressions = soak.compare(report["results"], soak.loadBaseline(baselinePath))
+        for regression in regressions:
+            print("REGRESSION: " + regression)
+        if regressions:
+            sys.exit(1)
+
+
 setup(
       # List extension modules
       ext_modules= [aprmd5],
-      # Add a command named "test". The name string in the dict is also used by
-      # "python setup.py --help-commands", but not by "python setup.py test -h"
-      cmdclass = { "test" : test },
+      # The public header of the C API that other extensions can import
+      headers = ["src/extension/aprmd5_capi.h"],
+      # Add commands named "test", "benchmark" and "soak". The name string in the dict
+      # is also used by "python setup.py --help-commands", but not by
+      # "python setup.py test -h"
+      cmdclass = { "test" : test, "benchmark" : benchmark, "soak" : soak },
       # Meta-data
       name="python-aprmd5",
       version="0.2.1",
@@ -27,6 +27,159 @@
 #include "aprmd5.h"
 #include "aprmd5_wrappers.h"
 #include "aprmd5_md5type.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_multibuf.h"
+#include "aprmd5_async.h"
+#include "aprmd5_cache.h"
+#include "aprmd5_htpasswd.h"
+#include "aprmd5_stats.h"
+#include "aprmd5_state.h"
+#include "aprmd5_capsule.h"
+
+// System includes
+#include <pthread.h>
+
+
+// ---------------------------------------------------------------------------
+// The state of the module. Where there is no per-interpreter module state,
+// this is the one and only state.
+// ---------------------------------------------------------------------------
+#if ! APRMD5_HAVE_MODULE_STATE
+
+aprmd5_module_state aprmd5_global_state;
+
+#endif  // #if ! APRMD5_HAVE_MODULE_STATE
+
+
+// ---------------------------------------------------------------------------
+// Initialization that is done once per process, no matter how many
+// interpreters import the module
+// ---------------------------------------------------------------------------
+static pthread_once_t aprmd5_process_once = PTHREAD_ONCE_INIT;
+
+static void
+aprmd5_process_init(void)
+{
+  // Select the CPU-specific kernels, then the backend, whose calibration
+  // uses the kernels
+  aprmd5_md5block_init();
+  aprmd5_multibuf_init();
+  aprmd5_backend_init();
+}
+
+
+// ---------------------------------------------------------------------------
+// Adds a type to the module. Returns 0 on success, or -1 with a Python
+// exception set.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_module_add_type(PyObject* module, const char* name, PyObject* type)
+{
+  Py_INCREF(type);
+  if (PyModule_AddObject(module, (char*)name, type) < 0)
+  {
+    Py_DECREF(type);
+    return -1;
+  }
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Populates a newly created module object and its state. This is the
+// Py_mod_exec slot of multi-phase initialization; otherwise the module's
+// initialization function calls it. Returns 0 on success, or -1 with a
+// Python exception set.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_module_exec(PyObject* module)
+{
+  aprmd5_module_state* state = aprmd5_state_from_module(module);
+  pthread_once(&aprmd5_process_once, aprmd5_process_init);
+  // Prepare the runtime statistics
+  if (aprmd5_stats_init() < 0)
+    return -1;
+  // Create the types
+  state->md5Type = aprmd5_md5_type_create(module);
+  if (NULL == state->md5Type)
+    return -1;
+  state->cacheType = aprmd5_cache_type_create(module);
+  if (NULL == state->cacheType)
+    return -1;
+  state->htpasswdType = aprmd5_htpasswd_type_create(module);
+  if (NULL == state->htpasswdType)
+    return -1;
+  // Prepare the machinery behind the awaitable functions
+  if (aprmd5_async_init(module) < 0)
+    return -1;
+  // Make the types available
+  if (aprmd5_module_add_type(module, aprmd5_md5_type_name, state->md5Type) < 0
+      || aprmd5_module_add_type(module, aprmd5_cache_type_name, state->cacheType) < 0
+      || aprmd5_module_add_type(module, aprmd5_htpasswd_type_name, state->htpasswdType) < 0)
+    return -1;
+  // Export the C API for other native extensions
+  if (aprmd5_capsule_add(module) < 0)
+    return -1;
+  // Tell the user which backend md5 and the apr1 functions use, and which
+  // kernels the builtin backend and md5_many() use
+  if (PyModule_AddStringConstant(module, "backend", (char*)aprmd5_backend_selected->name) < 0
+      || PyModule_AddStringConstant(module, "md5block_kernel", (char*)aprmd5_md5block_selected_name) < 0
+      || PyModule_AddStringConstant(module, "multibuf_kernel", (char*)aprmd5_multibuf_selected_kernel->name) < 0)
+    return -1;
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Garbage collection support and cleanup of the module state
+// ---------------------------------------------------------------------------
+#if APRMD5_HAVE_MODULE_STATE
+
+static int
+aprmd5_module_traverse(PyObject* module, visitproc visit, void* arg)
+{
+  aprmd5_module_state* state = aprmd5_state_from_module(module);
+  if (NULL == state)
+    return 0;
+  Py_VISIT(state->md5Type);
+  Py_VISIT(state->cacheType);
+  Py_VISIT(state->htpasswdType);
+  Py_VISIT(state->asyncPortType);
+  Py_VISIT(state->asyncPorts);
+  Py_VISIT(state->asyncGetRunningLoop);
+  return 0;
+}
+
+static int
+aprmd5_module_clear(PyObject* module)
+{
+  aprmd5_module_state* state = aprmd5_state_from_module(module);
+  if (NULL == state)
+    return 0;
+  Py_CLEAR(state->md5Type);
+  Py_CLEAR(state->cacheType);
+  Py_CLEAR(state->htpasswdType);
+  Py_CLEAR(state->asyncPortType);
+  Py_CLEAR(state->asyncPorts);
+  Py_CLEAR(state->asyncGetRunningLoop);
+  return 0;
+}
+
+static void
+aprmd5_module_free(void* module)
+{
+  aprmd5_module_clear((PyObject*)module);
+  aprmd5_module_state* state = aprmd5_state_from_module((PyObject*)module);
+  if (NULL == state)
+    return;
+  // md5 objects keep their type alive, and the type keeps the module alive,
+  // so by now no md5 object can be left that might be put on the freelist
+  while (state->md5FreelistCount > 0)
+    PyObject_Free(state->md5Freelist[--state->md5FreelistCount]);
+}
+
+#endif  // #if APRMD5_HAVE_MODULE_STATE
 
 
 // ---------------------------------------------------------------------------
@@ -35,6 +188,39 @@
 // ---------------------------------------------------------------------------
 #if PY_MAJOR_VERSION >= 3
 
+#if APRMD5_HAVE_MODULE_STATE
+
+static PyModuleDef_Slot aprmd5_module_slots[] =
+{
+  {Py_mod_exec, (void*)aprmd5_module_exec},
+#if PY_VERSION_HEX >= 0x030C0000
+  // Nothing is shared between interpreters except for native threads and
+  // native memory, which have their own locks
+  {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000
+  // Objects whose state was protected by the GIL lock themselves in the
+  // free-threaded build
+  {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+  {0, NULL}
+};
+
+static struct PyModuleDef aprmd5_module =
+{
+  PyModuleDef_HEAD_INIT,
+  "aprmd5",     // name of module
+  NULL,         // module documentation, may be NULL
+  sizeof(aprmd5_module_state),  // size of per-interpreter state of the module
+  aprmd5_methods,
+  aprmd5_module_slots,
+  aprmd5_module_traverse,
+  aprmd5_module_clear,
+  aprmd5_module_free
+};
+
+#else   // #if APRMD5_HAVE_MODULE_STATE
+
 static struct PyModuleDef aprmd5_module =
 {
   PyModuleDef_HEAD_INIT,
@@ -45,6 +231,8 @@ static struct PyModuleDef aprmd5_module =
   aprmd5_methods
 };
 
+#endif  // #if APRMD5_HAVE_MODULE_STATE
+
 #endif  // #if PY_MAJOR_VERSION >= 3
 
 
@@ -53,6 +241,10 @@ static struct PyModuleDef aprmd5_module =
 // named PyInit_name, where name is the name of the module, and should be the
 // only non-static item defined in the module file. The function is called when
 // the Python program imports the module for the first time.
+//
+// With multi-phase initialization, the function only returns the module
+// definition; Python then creates the module object and calls
+// aprmd5_module_exec(), once for every interpreter that imports the module.
 // ---------------------------------------------------------------------------
 PyMODINIT_FUNC
 
@@ -60,18 +252,19 @@ PyMODINIT_FUNC
 
 PyInit_aprmd5(void)
 {
-  // Initialize the type
-  if (PyType_Ready(&aprmd5_md5_type) < 0)
-    return NULL;
-  // Create the module
+#if APRMD5_HAVE_MODULE_STATE
+  return PyModuleDef_Init(&aprmd5_module);
+#else   // #if APRMD5_HAVE_MODULE_STATE
   PyObject* module = PyModule_Create(&aprmd5_module);
   if (NULL == module)
     return NULL;
-  // Make the md5 type available
-  Py_INCREF(&aprmd5_md5_type);
-  PyModule_AddObject(module, aprmd5_md5_type_name, (PyObject*)&aprmd5_md5_type);
-
+  if (aprmd5_module_exec(module) < 0)
+  {
+    Py_DECREF(module);
+    return NULL;
+  }
   return module;
+#endif  // #if APRMD5_HAVE_MODULE_STATE
 }
 
 
@@ -79,16 +272,10 @@ PyInit_aprmd5(void)
 
 initaprmd5(void)
 {
-  // Initialize the md5 type
-  if (PyType_Ready(&aprmd5_md5_type) < 0)
-    return;
-  // Create the module
   PyObject* module = Py_InitModule("aprmd5", aprmd5_methods);
   if (NULL == module)
     return;
-  // Make the md5 type available
-  Py_INCREF(&aprmd5_md5_type);
-  PyModule_AddObject(module, "md5", (PyObject*)&aprmd5_md5_type);
+  aprmd5_module_exec(module);
 }
 
 
@@ -44,6 +44,57 @@
 // where the macro is defined is setup.py.
 #include APRMD5_HEADER_FILENAME
 
+// METH_FASTCALL is part of the stable calling conventions since Python 3.7.
+// Functions that are called very often use it where it is available, which
+// saves creating an argument tuple on every call.
+#if PY_VERSION_HEX >= 0x03070000
+#define APRMD5_HAVE_FASTCALL 1
+#define APRMD5_METH_FASTCALL METH_FASTCALL
+#define APRMD5_FASTCALL_PARAMETERS PyObject* const* args, Py_ssize_t nargs
+#else
+#define APRMD5_HAVE_FASTCALL 0
+#define APRMD5_METH_FASTCALL METH_VARARGS
+#define APRMD5_FASTCALL_PARAMETERS PyObject* args
+#endif
+
+// Since Python 3.9 the module uses multi-phase initialization: each
+// interpreter that imports the module gets its own module object, with its
+// own types and its own state (see aprmd5_state.h). Older versions keep the
+// state in a global variable and do not support subinterpreters.
+#if PY_VERSION_HEX >= 0x03090000
+#define APRMD5_HAVE_MODULE_STATE 1
+#else
+#define APRMD5_HAVE_MODULE_STATE 0
+#endif
+
+// Under Python 3 the types are heap types. Since Python 3.8 the instances of
+// a heap type own a reference to the type, which tp_dealloc must release.
+#if PY_VERSION_HEX >= 0x03080000
+#define APRMD5_TYPE_DECREF(type) Py_DECREF(type)
+#else
+#define APRMD5_TYPE_DECREF(type)
+#endif
+
+// Static types cannot be modified from Python code. The heap types that
+// replace them under Python 3 are made immutable as well, where supported.
+#if PY_VERSION_HEX >= 0x030A0000
+#define APRMD5_TPFLAGS_DEFAULT (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE)
+#else
+#define APRMD5_TPFLAGS_DEFAULT Py_TPFLAGS_DEFAULT
+#endif
+
+// The free-threaded build of Python (3.13+) has no GIL that serializes access
+// to the state of an object. Code that relies on the GIL for this wraps the
+// access in these macros, which lock the object in the free-threaded build
+// and do nothing otherwise. The section must not be left with return or goto.
+#if defined(Py_GIL_DISABLED)
+#define APRMD5_BEGIN_CRITICAL_SECTION(obj) Py_BEGIN_CRITICAL_SECTION(obj)
+#define APRMD5_END_CRITICAL_SECTION()      Py_END_CRITICAL_SECTION()
+#else
+#define APRMD5_BEGIN_CRITICAL_SECTION(obj) {
+#define APRMD5_END_CRITICAL_SECTION()      }
+#endif
+
 // The digest size as defined by libaprutil
 #define APRMD5_MD5_DIGESTSIZE   APR_MD5_DIGESTSIZE
 
@@ -51,5 +102,26 @@
 // Python's hashlib (see <pythonroot>/Modules/md5module.c)
 #define APRMD5_MD5_BLOCKSIZE    64
 
+// Input buffers of at least this many bytes are hashed with the GIL released.
+// For smaller buffers, releasing and re-acquiring the GIL costs more than the
+// hashing itself. Python's hashlib uses the same threshold (see
+// HASHLIB_GIL_MINSIZE in <pythonroot>/Modules/hashlib.h)
+#define APRMD5_GIL_MINSIZE      2048
+
+// The maximum number of bytes that we pass to a single MD5 update call.
+// Larger input buffers are fed in chunks of this size. The value must fit into
+// apr_size_t on all platforms, and it is a multiple of the block size so that
+// chunking does not cause needless buffering.
+#define APRMD5_MD5_MAXCHUNKSIZE ((apr_size_t)0x40000000)   // 1 GiB
+
+// The maximum size of an apr1 hash generated by apr_md5_encode(), including
+// the terminating null byte. apr_md5_encode() uses at most 8 characters of the
+// salt.
+#define APRMD5_APR1_HASHSIZE    (6 + 8 + 1 + 22 + 1)  // 6 = $apr1$
+                                                      // 8 = salt
+                                                      // 1 = $ (terminating the salt)
+                                                      // 22 = hash
+                                                      // 1 = terminating null byte
+
 
 #endif // #ifndef APRMD5_H
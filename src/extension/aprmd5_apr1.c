@@ -0,0 +1,718 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the module's own version of the apr1 algorithm, i.e.
+// of the algorithm behind apr_md5_encode(). The results are identical to
+// those of libaprutil.
+//
+// The expensive part of apr1 is a loop of 1000 rounds, each of which hashes a
+// short message that depends on the result of the previous round. The rounds
+// of one password are therefore strictly serial, but the rounds of different
+// passwords are independent. The multi-lane engine in this file runs the loop
+// for several passwords at once, one password per lane of the multi-buffer
+// MD5 kernel (see aprmd5_multibuf.c).
+//
+// The single-password engine is used where only one password is at hand,
+// e.g. by password_validate(). It exploits that there are only eight
+// different kinds of round messages, which differ only in the 16 bytes of the
+// previous digest: The eight messages are built and padded once, and the
+// blocks that precede the digest are compressed once. Each round then copies
+// the digest into place and compresses the remaining blocks directly.
+//
+// The single-password engine also generates the hashes of the md5crypt
+// scheme ("$1$"), which is the same algorithm with a different prefix.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_multibuf.h"
+#include "aprmd5_apr1.h"
+#include "aprmd5_backend.h"
+
+// System includes
+#include <errno.h>
+#include <fcntl.h>    // for open()
+#include <stdlib.h>   // for malloc(), free()
+#include <string.h>   // for memcpy(), memset(), strlen(), strncmp()
+#include <unistd.h>   // for read(), close()
+
+// getrandom() draws from the kernel's random pool without a file descriptor
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/random.h>)
+#include <sys/random.h>
+#define APRMD5_APR1_HAVE_GETRANDOM 1
+#endif
+#endif
+#ifndef APRMD5_APR1_HAVE_GETRANDOM
+#define APRMD5_APR1_HAVE_GETRANDOM 0
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+
+// The number of rounds of the apr1 loop
+#define APRMD5_APR1_ROUNDS 1000
+
+// Round messages up to this size (two blocks) are built in a buffer on the
+// stack. This covers passwords of up to 47 characters.
+#define APRMD5_APR1_STACKMESSAGESIZE (2 * APRMD5_MD5_BLOCKSIZE)
+
+// The number of random bytes that aprmd5_apr1_generate_salts() draws from
+// the kernel in one go, i.e. the random bytes for 512 salts
+#define APRMD5_APR1_RANDOMBATCHSIZE 4096
+
+// The alphabet of the crypt-style base64 encoding
+static const char aprmd5_apr1_itoa64[] =
+  "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+
+// ---------------------------------------------------------------------------
+// The per-lane bookkeeping of the multi-lane engine
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  aprmd5_apr1_job* job;
+  const char* salt;             // points into job->salt, without prefix
+  apr_size_t saltLen;
+  apr_size_t passwordLen;
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];   // result of the last round
+  unsigned char* message;       // holds the padded message of one round
+  unsigned char stackMessage[APRMD5_APR1_STACKMESSAGESIZE];
+  apr_size_t blockCount;        // number of blocks in message
+} aprmd5_apr1_lane;
+
+
+// ---------------------------------------------------------------------------
+// Determines the salt the same way as apr_md5_encode() does: The prefix id
+// (e.g. "$apr1$") is skipped, and the salt ends at the first '$', or after 8
+// characters, whichever comes first.
+// ---------------------------------------------------------------------------
+static const char*
+aprmd5_apr1_refine_salt(const char* salt, const char* id, apr_size_t idLen, apr_size_t* saltLen)
+{
+  if (0 == strncmp(salt, id, idLen))
+    salt += idLen;
+  apr_size_t len = 0;
+  while (len < 8 && '\0' != salt[len] && '$' != salt[len])
+    ++len;
+  *saltLen = len;
+  return salt;
+}
+
+
+// ---------------------------------------------------------------------------
+// Computes the digest that the apr1 loop starts with. This is cheap compared
+// to the loop, so it is done one password at a time.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_apr1_initial_digest(const char* password, apr_size_t passwordLen,
+                           const char* salt, apr_size_t saltLen,
+                           const char* id, apr_size_t idLen,
+                           unsigned char digest[APRMD5_MD5_DIGESTSIZE])
+{
+  const unsigned char* pw = (const unsigned char*)password;
+  apr_md5_ctx_t context;
+  apr_md5_ctx_t alternateContext;
+
+  aprmd5_md5block_ctx_init(&context);
+  aprmd5_md5block_ctx_update(&context, pw, passwordLen);
+  aprmd5_md5block_ctx_update(&context, (const unsigned char*)id, idLen);
+  aprmd5_md5block_ctx_update(&context, (const unsigned char*)salt, saltLen);
+
+  aprmd5_md5block_ctx_init(&alternateContext);
+  aprmd5_md5block_ctx_update(&alternateContext, pw, passwordLen);
+  aprmd5_md5block_ctx_update(&alternateContext, (const unsigned char*)salt, saltLen);
+  aprmd5_md5block_ctx_update(&alternateContext, pw, passwordLen);
+  aprmd5_md5block_ctx_final(digest, &alternateContext);
+
+  apr_size_t remaining;
+  for (remaining = passwordLen; remaining > 0; )
+  {
+    apr_size_t len = remaining > APRMD5_MD5_DIGESTSIZE ? APRMD5_MD5_DIGESTSIZE : remaining;
+    aprmd5_md5block_ctx_update(&context, digest, len);
+    remaining -= len;
+  }
+
+  // Yes, this really uses the zeroed digest, not the digest that was just
+  // computed. This is a quirk of the original algorithm.
+  memset(digest, 0, APRMD5_MD5_DIGESTSIZE);
+  apr_size_t bits;
+  for (bits = passwordLen; bits != 0; bits >>= 1)
+  {
+    if (bits & 1)
+      aprmd5_md5block_ctx_update(&context, digest, 1);
+    else
+      aprmd5_md5block_ctx_update(&context, pw, 1);
+  }
+
+  aprmd5_md5block_ctx_final(digest, &context);
+}
+
+
+// ---------------------------------------------------------------------------
+// Builds the padded message of one round of the apr1 loop. Returns the number
+// of blocks.
+// ---------------------------------------------------------------------------
+static apr_size_t
+aprmd5_apr1_round_message(unsigned char* message, int round,
+                          const unsigned char digest[APRMD5_MD5_DIGESTSIZE],
+                          const char* password, apr_size_t passwordLen,
+                          const char* salt, apr_size_t saltLen)
+{
+  unsigned char* p = message;
+  if (round & 1)
+  {
+    memcpy(p, password, passwordLen);
+    p += passwordLen;
+  }
+  else
+  {
+    memcpy(p, digest, APRMD5_MD5_DIGESTSIZE);
+    p += APRMD5_MD5_DIGESTSIZE;
+  }
+  if (round % 3)
+  {
+    memcpy(p, salt, saltLen);
+    p += saltLen;
+  }
+  if (round % 7)
+  {
+    memcpy(p, password, passwordLen);
+    p += passwordLen;
+  }
+  if (round & 1)
+  {
+    memcpy(p, digest, APRMD5_MD5_DIGESTSIZE);
+    p += APRMD5_MD5_DIGESTSIZE;
+  }
+  else
+  {
+    memcpy(p, password, passwordLen);
+    p += passwordLen;
+  }
+  return aprmd5_md5block_pad_in_place(message, (apr_size_t)(p - message));
+}
+
+
+// ---------------------------------------------------------------------------
+// Writes the final hash string "$apr1$salt$encrypted-password", or the
+// equivalent with another prefix id.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_apr1_to64(char* s, unsigned long v, int n)
+{
+  while (--n >= 0)
+  {
+    *s++ = aprmd5_apr1_itoa64[v & 0x3f];
+    v >>= 6;
+  }
+}
+
+static void
+aprmd5_apr1_format(char* result, const char* salt, apr_size_t saltLen,
+                   const char* id, apr_size_t idLen,
+                   const unsigned char digest[APRMD5_MD5_DIGESTSIZE])
+{
+  const unsigned char* f = digest;
+  char* p = result;
+  memcpy(p, id, idLen);
+  p += idLen;
+  memcpy(p, salt, saltLen);
+  p += saltLen;
+  *p++ = '$';
+  aprmd5_apr1_to64(p, ((unsigned long)f[0] << 16) | ((unsigned long)f[6] << 8) | f[12], 4);
+  p += 4;
+  aprmd5_apr1_to64(p, ((unsigned long)f[1] << 16) | ((unsigned long)f[7] << 8) | f[13], 4);
+  p += 4;
+  aprmd5_apr1_to64(p, ((unsigned long)f[2] << 16) | ((unsigned long)f[8] << 8) | f[14], 4);
+  p += 4;
+  aprmd5_apr1_to64(p, ((unsigned long)f[3] << 16) | ((unsigned long)f[9] << 8) | f[15], 4);
+  p += 4;
+  aprmd5_apr1_to64(p, ((unsigned long)f[4] << 16) | ((unsigned long)f[10] << 8) | f[5], 4);
+  p += 4;
+  aprmd5_apr1_to64(p, f[11], 2);
+  p += 2;
+  *p = '\0';
+}
+
+
+// ---------------------------------------------------------------------------
+// Runs the apr1 loop for up to one lane group of passwords
+// ---------------------------------------------------------------------------
+static void
+aprmd5_apr1_run_lanes(const aprmd5_multibuf_kernel* kernel, aprmd5_apr1_lane* lanes, int laneCount)
+{
+  int kernelLanes = kernel->lanes;
+  apr_uint32_t state[4 * APRMD5_MULTIBUF_MAXLANES];
+  const unsigned char* blocks[APRMD5_MULTIBUF_MAXLANES];
+  int laneIndex;
+  int round;
+
+  for (round = 0; round < APRMD5_APR1_ROUNDS; ++round)
+  {
+    apr_size_t maxBlockCount = 0;
+    for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+    {
+      aprmd5_apr1_lane* lane = &lanes[laneIndex];
+      lane->blockCount = aprmd5_apr1_round_message(lane->message, round, lane->digest,
+                                                   lane->job->password, lane->passwordLen,
+                                                   lane->salt, lane->saltLen);
+      if (lane->blockCount > maxBlockCount)
+        maxBlockCount = lane->blockCount;
+      state[0 * kernelLanes + laneIndex] = APRMD5_MD5_INIT_A;
+      state[1 * kernelLanes + laneIndex] = APRMD5_MD5_INIT_B;
+      state[2 * kernelLanes + laneIndex] = APRMD5_MD5_INIT_C;
+      state[3 * kernelLanes + laneIndex] = APRMD5_MD5_INIT_D;
+    }
+    for (; laneIndex < kernelLanes; ++laneIndex)
+      blocks[laneIndex] = NULL;
+
+    // Lanes whose message is shorter than the longest message sit idle for
+    // the remaining blocks
+    apr_size_t blockIndex;
+    for (blockIndex = 0; blockIndex < maxBlockCount; ++blockIndex)
+    {
+      for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+      {
+        aprmd5_apr1_lane* lane = &lanes[laneIndex];
+        blocks[laneIndex] = (blockIndex < lane->blockCount)
+                          ? lane->message + blockIndex * APRMD5_MD5_BLOCKSIZE
+                          : NULL;
+      }
+      kernel->func(state, blocks);
+    }
+
+    for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+    {
+      apr_uint32_t laneState[4];
+      int word;
+      for (word = 0; word < 4; ++word)
+        laneState[word] = state[word * kernelLanes + laneIndex];
+      aprmd5_md5block_state_to_digest(laneState, lanes[laneIndex].digest);
+    }
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// Generates the apr1 hashes of a number of password/salt pairs. The result
+// for each pair is the same as what apr_md5_encode() generates.
+//
+// Parameters:
+// - kernel: The multi-buffer kernel to use, usually
+//   aprmd5_multibuf_selected_kernel
+// - jobs: The password/salt pairs to encode; the hash of each pair is written
+//   to the location specified by the job
+// - jobCount: The number of jobs
+//
+// Return value:
+// - 0 on success
+// - -1 if memory for an extraordinarily long password could not be
+//   allocated; the results are undefined in this case
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_apr1_encode_many(const aprmd5_multibuf_kernel* kernel, aprmd5_apr1_job* jobs, Py_ssize_t jobCount)
+{
+  aprmd5_apr1_lane lanes[APRMD5_MULTIBUF_MAXLANES];
+  int result = 0;
+  Py_ssize_t groupBegin;
+
+  for (groupBegin = 0; groupBegin < jobCount; groupBegin += kernel->lanes)
+  {
+    int laneCount = kernel->lanes;
+    if (groupBegin + laneCount > jobCount)
+      laneCount = (int)(jobCount - groupBegin);
+
+    int laneIndex;
+    int allocatedCount = 0;
+    for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+    {
+      aprmd5_apr1_lane* lane = &lanes[laneIndex];
+      lane->job = &jobs[groupBegin + laneIndex];
+      lane->salt = aprmd5_apr1_refine_salt(lane->job->salt, APRMD5_APR1_ID, APRMD5_APR1_IDLEN, &lane->saltLen);
+      lane->passwordLen = strlen(lane->job->password);
+
+      // The longest round message is digest + salt + 2 * password
+      apr_size_t maxMessageLen = APRMD5_MD5_DIGESTSIZE + lane->saltLen + 2 * lane->passwordLen;
+      apr_size_t messageSize = ((maxMessageLen + 8) / APRMD5_MD5_BLOCKSIZE + 1) * APRMD5_MD5_BLOCKSIZE;
+      if (messageSize <= APRMD5_APR1_STACKMESSAGESIZE)
+      {
+        lane->message = lane->stackMessage;
+      }
+      else
+      {
+        lane->message = (unsigned char*)malloc(messageSize);
+        if (NULL == lane->message)
+        {
+          result = -1;
+          break;
+        }
+      }
+      ++allocatedCount;
+
+      aprmd5_apr1_initial_digest(lane->job->password, lane->passwordLen,
+                                 lane->salt, lane->saltLen,
+                                 APRMD5_APR1_ID, APRMD5_APR1_IDLEN, lane->digest);
+    }
+
+    if (0 == result)
+    {
+      aprmd5_apr1_run_lanes(kernel, lanes, laneCount);
+      for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+      {
+        aprmd5_apr1_lane* lane = &lanes[laneIndex];
+        aprmd5_apr1_format(lane->job->result, lane->salt, lane->saltLen,
+                           APRMD5_APR1_ID, APRMD5_APR1_IDLEN, lane->digest);
+      }
+    }
+
+    for (laneIndex = 0; laneIndex < allocatedCount; ++laneIndex)
+    {
+      if (lanes[laneIndex].message != lanes[laneIndex].stackMessage)
+        free(lanes[laneIndex].message);
+    }
+    if (0 != result)
+      break;
+  }
+
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// The round messages of the single-password engine. The kind of message of a
+// round is (round & 1) | ((round % 3 != 0) << 1) | ((round % 7 != 0) << 2).
+// ---------------------------------------------------------------------------
+#define APRMD5_APR1_VARIANTS 8
+
+typedef struct
+{
+  unsigned char* message;       // the padded message; the digest is filled in
+                                // by each round
+  apr_size_t digestOffset;      // where the digest goes in the message
+  apr_size_t firstBlock;        // the block that contains the digest; the
+                                // blocks before it are already compressed
+  apr_size_t blockCount;        // the number of blocks in message
+  apr_uint32_t midstate[4];     // the state after compressing the blocks
+                                // before firstBlock
+} aprmd5_apr1_variant;
+
+
+// ---------------------------------------------------------------------------
+// The single-password engine, for the prefix id "$apr1$" or "$1$"
+// ---------------------------------------------------------------------------
+static int
+aprmd5_apr1_encode_single(const char* password, const char* salt,
+                          const char* id, apr_size_t idLen, char* result)
+{
+  aprmd5_md5block_func compress = aprmd5_md5block_selected;
+  aprmd5_apr1_variant variants[APRMD5_APR1_VARIANTS];
+  unsigned char stackMessages[APRMD5_APR1_VARIANTS * APRMD5_APR1_STACKMESSAGESIZE];
+  unsigned char* messages = stackMessages;
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  apr_size_t saltLen;
+  salt = aprmd5_apr1_refine_salt(salt, id, idLen, &saltLen);
+  apr_size_t passwordLen = strlen(password);
+
+  // The longest round message is digest + salt + 2 * password
+  apr_size_t maxMessageLen = APRMD5_MD5_DIGESTSIZE + saltLen + 2 * passwordLen;
+  apr_size_t messageSize = ((maxMessageLen + 8) / APRMD5_MD5_BLOCKSIZE + 1) * APRMD5_MD5_BLOCKSIZE;
+  if (messageSize > APRMD5_APR1_STACKMESSAGESIZE)
+  {
+    messages = (unsigned char*)malloc(APRMD5_APR1_VARIANTS * messageSize);
+    if (NULL == messages)
+      return -1;
+  }
+
+  int variantIndex;
+  for (variantIndex = 0; variantIndex < APRMD5_APR1_VARIANTS; ++variantIndex)
+  {
+    aprmd5_apr1_variant* variant = &variants[variantIndex];
+    variant->message = messages + variantIndex * messageSize;
+    unsigned char* p = variant->message;
+    int odd = variantIndex & 1;
+    if (odd)
+    {
+      memcpy(p, password, passwordLen);
+      p += passwordLen;
+    }
+    else
+    {
+      variant->digestOffset = 0;
+      p += APRMD5_MD5_DIGESTSIZE;
+    }
+    if (variantIndex & 2)
+    {
+      memcpy(p, salt, saltLen);
+      p += saltLen;
+    }
+    if (variantIndex & 4)
+    {
+      memcpy(p, password, passwordLen);
+      p += passwordLen;
+    }
+    if (odd)
+    {
+      variant->digestOffset = (apr_size_t)(p - variant->message);
+      p += APRMD5_MD5_DIGESTSIZE;
+    }
+    else
+    {
+      memcpy(p, password, passwordLen);
+      p += passwordLen;
+    }
+    variant->blockCount = aprmd5_md5block_pad_in_place(variant->message, (apr_size_t)(p - variant->message));
+    variant->firstBlock = variant->digestOffset / APRMD5_MD5_BLOCKSIZE;
+    variant->midstate[0] = APRMD5_MD5_INIT_A;
+    variant->midstate[1] = APRMD5_MD5_INIT_B;
+    variant->midstate[2] = APRMD5_MD5_INIT_C;
+    variant->midstate[3] = APRMD5_MD5_INIT_D;
+    if (variant->firstBlock > 0)
+      compress(variant->midstate, variant->message, variant->firstBlock);
+  }
+
+  aprmd5_apr1_initial_digest(password, passwordLen, salt, saltLen, id, idLen, digest);
+  int round;
+  for (round = 0; round < APRMD5_APR1_ROUNDS; ++round)
+  {
+    aprmd5_apr1_variant* variant = &variants[(round & 1) | ((round % 3 != 0) << 1) | ((round % 7 != 0) << 2)];
+    apr_uint32_t state[4];
+    memcpy(variant->message + variant->digestOffset, digest, APRMD5_MD5_DIGESTSIZE);
+    memcpy(state, variant->midstate, sizeof(state));
+    compress(state,
+             variant->message + variant->firstBlock * APRMD5_MD5_BLOCKSIZE,
+             variant->blockCount - variant->firstBlock);
+    aprmd5_md5block_state_to_digest(state, digest);
+  }
+  aprmd5_apr1_format(result, salt, saltLen, id, idLen, digest);
+
+  // The messages contain the password
+  memset(messages, 0, APRMD5_APR1_VARIANTS * messageSize);
+  if (messages != stackMessages)
+    free(messages);
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Generates the apr1 hash of a single password/salt pair. The result is the
+// same as what apr_md5_encode() generates.
+//
+// Parameters:
+// - password: The password; null-terminated
+// - salt: The salt; null-terminated, interpreted like apr_md5_encode() does
+// - result: Receives the hash, at most APRMD5_APR1_HASHSIZE bytes including
+//   the terminating null byte
+//
+// Return value:
+// - 0 on success
+// - -1 if memory for an extraordinarily long password could not be
+//   allocated
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_apr1_encode(const char* password, const char* salt, char* result)
+{
+  return aprmd5_apr1_encode_single(password, salt, APRMD5_APR1_ID, APRMD5_APR1_IDLEN, result);
+}
+
+
+// ---------------------------------------------------------------------------
+// Generates the md5crypt hash ("$1$salt$encrypted-password") of a single
+// password/salt pair. The result is the same as what crypt() generates for a
+// salt with the prefix "$1$".
+//
+// Parameters and return value: Like aprmd5_apr1_encode(), except that a
+// "$1$" prefix of the salt is skipped
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_apr1_md5crypt_encode(const char* password, const char* salt, char* result)
+{
+  return aprmd5_apr1_encode_single(password, salt, APRMD5_MD5CRYPT_ID, APRMD5_MD5CRYPT_IDLEN, result);
+}
+
+
+// ---------------------------------------------------------------------------
+// Fills a buffer with random bytes from the kernel. Returns 0 on success, or
+// an errno value.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_apr1_random(unsigned char* buffer, size_t len)
+{
+#if APRMD5_APR1_HAVE_GETRANDOM
+  while (len > 0)
+  {
+    ssize_t bytesRead = getrandom(buffer, len, 0);
+    if (bytesRead < 0)
+    {
+      if (EINTR == errno)
+        continue;
+      // Kernels before 3.17 lack the system call; fall back to the device
+      if (ENOSYS == errno)
+        break;
+      return errno;
+    }
+    buffer += bytesRead;
+    len -= (size_t)bytesRead;
+  }
+  if (0 == len)
+    return 0;
+#endif  // #if APRMD5_APR1_HAVE_GETRANDOM
+
+  int fd;
+  do
+  {
+    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  }
+  while (fd < 0 && EINTR == errno);
+  if (fd < 0)
+    return errno;
+  int result = 0;
+  while (len > 0)
+  {
+    ssize_t bytesRead = read(fd, buffer, len);
+    if (bytesRead < 0 && EINTR == errno)
+      continue;
+    if (bytesRead <= 0)
+    {
+      result = bytesRead < 0 ? errno : EIO;
+      break;
+    }
+    buffer += bytesRead;
+    len -= (size_t)bytesRead;
+  }
+  close(fd);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Generates random salts for apr1 hashes, the way the htpasswd command line
+// utility does: APRMD5_APR1_SALTLEN characters of the crypt-style base64
+// alphabet. The random bytes are drawn from the kernel in large batches.
+//
+// Parameters:
+// - salts: Receives the salts, APRMD5_APR1_SALTLEN + 1 bytes per salt; each
+//   salt is null-terminated
+// - count: The number of salts to generate
+//
+// Return value:
+// - 0 on success
+// - An errno value if no random bytes could be drawn
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_apr1_generate_salts(char* salts, Py_ssize_t count)
+{
+  unsigned char randomBytes[APRMD5_APR1_RANDOMBATCHSIZE];
+  Py_ssize_t saltsPerBatch = APRMD5_APR1_RANDOMBATCHSIZE / APRMD5_APR1_SALTLEN;
+  while (count > 0)
+  {
+    Py_ssize_t batchCount = count < saltsPerBatch ? count : saltsPerBatch;
+    int result = aprmd5_apr1_random(randomBytes, (size_t)(batchCount * APRMD5_APR1_SALTLEN));
+    if (0 != result)
+      return result;
+    const unsigned char* randomByte = randomBytes;
+    Py_ssize_t index;
+    for (index = 0; index < batchCount; ++index)
+    {
+      int charIndex;
+      // The alphabet has 64 characters, so the low 6 bits of a random byte
+      // select each character with the same probability
+      for (charIndex = 0; charIndex < APRMD5_APR1_SALTLEN; ++charIndex)
+        *salts++ = aprmd5_apr1_itoa64[*randomByte++ & 0x3f];
+      *salts++ = '\0';
+    }
+    count -= batchCount;
+  }
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Compares two hashes in constant time, i.e. in a time that depends on the
+// length of hash1, but not on the position of the first difference. This
+// keeps an attacker from learning the correct hash character by character.
+//
+// Return value:
+// - 1 if the hashes are equal, otherwise 0
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_apr1_equal(const char* hash1, const char* hash2)
+{
+  apr_size_t len1 = strlen(hash1);
+  apr_size_t len2 = strlen(hash2);
+  // Reading beyond the end of hash2 is avoided by comparing against the
+  // terminating null byte, which always differs
+  volatile unsigned char difference = (len1 != len2);
+  apr_size_t index;
+  for (index = 0; index < len1; ++index)
+    difference |= (unsigned char)hash1[index] ^ (unsigned char)hash2[index < len2 ? index : len2];
+  return 0 == difference;
+}
+
+
+// ---------------------------------------------------------------------------
+// Validates a password against an apr1 hash, like apr_password_validate()
+// does. The hash is re-generated by the selected backend (see
+// aprmd5_backend.c), which for the builtin backend means the single-password
+// engine, and the result is compared in constant time. Hashes of other
+// schemes are validated by aprmd5_passwd_validate().
+//
+// Return value:
+// - APR_SUCCESS if the password matches the hash
+// - Another status code if it does not
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+apr_status_t aprmd5_apr1_password_validate(const char* password, const char* hash)
+{
+  // +1 to the result size for the same reason as in aprmd5_md5_encode()
+  char result[APRMD5_APR1_HASHSIZE + 1];
+  apr_status_t status = aprmd5_backend_selected->apr1_encode(password, hash, result, sizeof(result));
+  if (APR_SUCCESS != status)
+    return apr_password_validate(password, hash);
+  status = aprmd5_apr1_equal(result, hash) ? APR_SUCCESS : APR_EMISMATCH;
+  memset(result, 0, sizeof(result));
+  return status;
+}
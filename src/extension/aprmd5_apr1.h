@@ -0,0 +1,85 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the module's own implementation of the apr1 algorithm,
+// i.e. of the algorithm behind apr_md5_encode().
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_APR1_H
+#define APRMD5_APR1_H
+
+// Project includes
+#include "aprmd5_multibuf.h"
+
+// The prefix of all apr1 hashes
+#define APRMD5_APR1_ID          "$apr1$"
+#define APRMD5_APR1_IDLEN       6
+
+// The number of characters of the salts that aprmd5_apr1_generate_salts()
+// generates; the maximum that apr1 uses
+#define APRMD5_APR1_SALTLEN     8
+
+// The prefix of all md5crypt hashes, i.e. of the scheme that apr1 is derived
+// from
+#define APRMD5_MD5CRYPT_ID      "$1$"
+#define APRMD5_MD5CRYPT_IDLEN   3
+
+// A password/salt pair that is encoded by aprmd5_apr1_encode_many()
+typedef struct
+{
+  const char* password;   // null-terminated
+  const char* salt;       // null-terminated; interpreted like apr_md5_encode()
+                          // does, i.e. an "$apr1$" prefix is skipped and at
+                          // most 8 characters up to the next '$' are used
+  char* result;           // receives the hash, at most APRMD5_APR1_HASHSIZE
+                          // bytes including the terminating null byte
+} aprmd5_apr1_job;
+
+extern int
+aprmd5_apr1_encode_many(const aprmd5_multibuf_kernel* kernel,
+                        aprmd5_apr1_job* jobs,
+                        Py_ssize_t jobCount);
+
+extern int
+aprmd5_apr1_encode(const char* password,
+                   const char* salt,
+                   char* result);
+
+extern int
+aprmd5_apr1_md5crypt_encode(const char* password,
+                            const char* salt,
+                            char* result);
+
+extern int
+aprmd5_apr1_equal(const char* hash1,
+                  const char* hash2);
+
+extern int
+aprmd5_apr1_generate_salts(char* salts,
+                           Py_ssize_t count);
+
+extern apr_status_t
+aprmd5_apr1_password_validate(const char* password,
+                              const char* hash);
+
+
+#endif // #ifndef APRMD5_APR1_H
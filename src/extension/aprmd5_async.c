@@ -0,0 +1,787 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the machinery behind the module's awaitable functions.
+//
+// An awaitable function packs its work into a job and submits the job to a
+// persistent pool of native worker threads. In return it gets an
+// asyncio.Future, created by the running event loop, which it returns to the
+// caller.
+//
+// When a worker has run a job, it hands the job to the completion port of the
+// event loop that the job was submitted from. The port is a small object that
+// owns an eventfd (a pipe on platforms without eventfd), which is registered
+// with the event loop via loop.add_reader(). Writing to the eventfd wakes the
+// loop, which then calls the port's _drain() method; _drain() completes the
+// jobs and resolves their futures on the loop's own thread. Python code never
+// runs on a worker thread, and the loop only wakes up once for a whole burst
+// of completed jobs.
+//
+// There is one port per event loop; the ports are kept in a
+// weakref.WeakKeyDictionary so that a port goes away together with its loop.
+//
+// Worker threads generate apr1 hashes of several queued jobs at once on the
+// multi-buffer MD5 kernel, so a loop that validates many passwords
+// concurrently gets the same throughput as password_validate_many().
+//
+// The awaitable functions require asyncio and are therefore only available
+// with Python 3.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_async.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_passwd.h"
+#include "aprmd5_threadpool.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_state.h"
+
+#if PY_MAJOR_VERSION >= 3
+
+// System includes
+#include <errno.h>
+#include <fcntl.h>      // for fcntl()
+#include <pthread.h>
+#include <stdint.h>     // for uint64_t
+#include <string.h>     // for memcpy(), strlen(), strncmp()
+#include <unistd.h>     // for pipe(), read(), write(), close()
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#define APRMD5_ASYNC_EVENTFD 1
+#endif
+
+
+// ---------------------------------------------------------------------------
+// The completion port of one event loop
+// ---------------------------------------------------------------------------
+struct aprmd5_async_port
+{
+  PyObject_HEAD
+  int readFd;                   // registered with the event loop
+  int writeFd;                  // same as readFd if eventfd is used
+  pthread_mutex_t mutex;        // protects the list of completed jobs
+  aprmd5_async_job* head;
+  aprmd5_async_job* tail;
+};
+
+// The worker pool. The threads are started on first use and run until the
+// process exits.
+static pthread_mutex_t aprmd5_async_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t aprmd5_async_queue_cond = PTHREAD_COND_INITIALIZER;
+static aprmd5_async_job* aprmd5_async_queue_head = NULL;
+static aprmd5_async_job* aprmd5_async_queue_tail = NULL;
+static int aprmd5_async_worker_count = 0;
+static int aprmd5_async_atfork_registered = 0;
+// Serializes the start of the workers; the module may be used by several
+// interpreters, or without a GIL
+static pthread_mutex_t aprmd5_async_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The Python objects used here are in the module state, so that each
+// interpreter has its own. They are created by aprmd5_async_init().
+
+
+// ---------------------------------------------------------------------------
+// Wakes up the event loop of a port. Invoked without the GIL.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_async_port_signal(aprmd5_async_port* port)
+{
+#if defined(APRMD5_ASYNC_EVENTFD)
+  uint64_t value = 1;
+  const void* data = &value;
+  size_t len = sizeof(value);
+#else
+  const char value = 1;
+  const void* data = &value;
+  size_t len = sizeof(value);
+#endif
+  // If the write fails because the eventfd counter or the pipe is full, the
+  // loop has a wakeup pending anyway
+  while (write(port->writeFd, data, len) < 0 && EINTR == errno)
+    ;
+}
+
+// ---------------------------------------------------------------------------
+// Hands a job that has been run to the completion port of its event loop.
+// Invoked without the GIL.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_async_port_post(aprmd5_async_job* job)
+{
+  aprmd5_async_port* port = job->port;
+  job->next = NULL;
+  pthread_mutex_lock(&port->mutex);
+  int wasEmpty = (NULL == port->head);
+  if (wasEmpty)
+    port->head = job;
+  else
+    port->tail->next = job;
+  port->tail = job;
+  pthread_mutex_unlock(&port->mutex);
+
+  // The port only needs to be signalled when the first job arrives; the loop
+  // picks up all jobs that have arrived in the meantime in one go
+  if (wasEmpty)
+    aprmd5_async_port_signal(port);
+}
+
+
+// ---------------------------------------------------------------------------
+// Discards a job. Must be called with the GIL held.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_async_job_free(aprmd5_async_job* job)
+{
+  if (NULL != job->release)
+    job->release(job);
+  Py_XDECREF(job->future);
+  Py_XDECREF((PyObject*)job->port);
+  PyMem_Free(job);
+}
+
+// ---------------------------------------------------------------------------
+// Resolves the future of a job that has been run. Must be called with the GIL
+// held.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_async_job_complete(aprmd5_async_job* job)
+{
+  // Nobody waits for the result of a cancelled future
+  PyObject* cancelled = PyObject_CallMethod(job->future, "cancelled", NULL);
+  if (NULL == cancelled)
+  {
+    PyErr_WriteUnraisable(job->future);
+    return;
+  }
+  int isCancelled = PyObject_IsTrue(cancelled);
+  Py_DECREF(cancelled);
+  if (isCancelled)
+    return;
+
+  PyObject* outcome = NULL;
+  PyObject* result = job->complete(job);
+  if (NULL != result)
+  {
+    outcome = PyObject_CallMethod(job->future, "set_result", "O", result);
+    Py_DECREF(result);
+  }
+  else
+  {
+    PyObject* type;
+    PyObject* value;
+    PyObject* traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+    if (NULL != traceback)
+      PyException_SetTraceback(value, traceback);
+    outcome = PyObject_CallMethod(job->future, "set_exception", "O", value);
+    Py_XDECREF(type);
+    Py_XDECREF(value);
+    Py_XDECREF(traceback);
+  }
+  if (NULL == outcome)
+    PyErr_WriteUnraisable(job->future);
+  Py_XDECREF(outcome);
+}
+
+// ---------------------------------------------------------------------------
+// The reader callback of a port that the event loop invokes when the port's
+// file descriptor becomes readable. Completes all jobs that have arrived at
+// the port.
+// ---------------------------------------------------------------------------
+static PyObject*
+aprmd5_async_port_drain(aprmd5_async_port* self, PyObject* args)
+{
+  // Consume the wakeup before taking the jobs; a job that arrives after this
+  // point signals the port again
+#if defined(APRMD5_ASYNC_EVENTFD)
+  uint64_t value;
+  while (read(self->readFd, &value, sizeof(value)) < 0 && EINTR == errno)
+    ;
+#else
+  char buffer[64];
+  for (;;)
+  {
+    ssize_t bytesRead = read(self->readFd, buffer, sizeof(buffer));
+    if (bytesRead <= 0 && ! (bytesRead < 0 && EINTR == errno))
+      break;
+  }
+#endif
+
+  pthread_mutex_lock(&self->mutex);
+  aprmd5_async_job* job = self->head;
+  self->head = NULL;
+  self->tail = NULL;
+  pthread_mutex_unlock(&self->mutex);
+
+  while (NULL != job)
+  {
+    aprmd5_async_job* next = job->next;
+    aprmd5_async_job_complete(job);
+    aprmd5_async_job_free(job);
+    job = next;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static void
+aprmd5_async_port_dealloc(aprmd5_async_port* self)
+{
+  // Jobs in flight hold a reference to their port, so no jobs can be left
+  if (self->readFd >= 0)
+    close(self->readFd);
+  if (self->writeFd >= 0 && self->writeFd != self->readFd)
+    close(self->writeFd);
+  pthread_mutex_destroy(&self->mutex);
+  PyTypeObject* type = Py_TYPE(self);
+  type->tp_free((PyObject*)self);
+  Py_DECREF(type);
+}
+
+static PyMethodDef aprmd5_async_port_methods[] =
+{
+  {
+    "_drain", (PyCFunction)aprmd5_async_port_drain, METH_NOARGS,
+    "Complete the jobs that have arrived at the port. Invoked by the event loop."
+  },
+  {NULL}  // Sentinel
+};
+
+static PyType_Slot aprmd5_async_port_slots[] =
+{
+  {Py_tp_dealloc, (void*)aprmd5_async_port_dealloc},
+  {Py_tp_methods, aprmd5_async_port_methods},
+  {Py_tp_doc, "The completion port that connects an event loop to the worker threads"},
+  {0, NULL}
+};
+
+static PyType_Spec aprmd5_async_port_spec =
+{
+  "aprmd5._CompletionPort",
+  sizeof(aprmd5_async_port),
+  0,
+  Py_TPFLAGS_DEFAULT,
+  aprmd5_async_port_slots
+};
+
+// ---------------------------------------------------------------------------
+// Returns a new reference to the running event loop, or NULL with a Python
+// exception set (RuntimeError if no event loop is running). asyncio is
+// imported on first use, so that importing aprmd5 does not pay for it.
+// ---------------------------------------------------------------------------
+static PyObject*
+aprmd5_async_running_loop(aprmd5_module_state* state)
+{
+  PyObject* getRunningLoop = state->asyncGetRunningLoop;
+  if (NULL == getRunningLoop)
+  {
+    PyObject* asyncio = PyImport_ImportModule("asyncio");
+    if (NULL == asyncio)
+      return NULL;
+    getRunningLoop = PyObject_GetAttrString(asyncio, "get_running_loop");
+    Py_DECREF(asyncio);
+    if (NULL == getRunningLoop)
+      return NULL;
+    // Another thread may have done the same in the meantime; the ports
+    // dictionary serves as the lock in the free-threaded build
+    APRMD5_BEGIN_CRITICAL_SECTION(state->asyncPorts);
+    if (NULL == state->asyncGetRunningLoop)
+    {
+      Py_INCREF(getRunningLoop);
+      state->asyncGetRunningLoop = getRunningLoop;
+    }
+    APRMD5_END_CRITICAL_SECTION();
+  }
+  else
+  {
+    Py_INCREF(getRunningLoop);
+  }
+  PyObject* loop = PyObject_CallObject(getRunningLoop, NULL);
+  Py_DECREF(getRunningLoop);
+  return loop;
+}
+
+// ---------------------------------------------------------------------------
+// Creates the file descriptors of a port. Returns 0 on success, or -1 with
+// errno set.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_async_port_open(aprmd5_async_port* port)
+{
+#if defined(APRMD5_ASYNC_EVENTFD)
+  port->readFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  port->writeFd = port->readFd;
+  return port->readFd < 0 ? -1 : 0;
+#else
+  int fds[2];
+  if (0 != pipe(fds))
+    return -1;
+  port->readFd = fds[0];
+  port->writeFd = fds[1];
+  int index;
+  for (index = 0; index < 2; ++index)
+  {
+    fcntl(fds[index], F_SETFL, fcntl(fds[index], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[index], F_SETFD, fcntl(fds[index], F_GETFD) | FD_CLOEXEC);
+  }
+  return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Returns the completion port of the running event loop, creating the port
+// if necessary. Returns a new reference, or NULL with a Python exception set
+// (e.g. RuntimeError if no event loop is running).
+// ---------------------------------------------------------------------------
+static aprmd5_async_port*
+aprmd5_async_port_for_running_loop(aprmd5_module_state* state, PyObject** loopOut)
+{
+  PyObject* loop = aprmd5_async_running_loop(state);
+  if (NULL == loop)
+    return NULL;
+
+  PyObject* port = PyObject_GetItem(state->asyncPorts, loop);
+  if (NULL != port)
+  {
+    *loopOut = loop;
+    return (aprmd5_async_port*)port;
+  }
+  if (! PyErr_ExceptionMatches(PyExc_KeyError))
+    goto fail;
+  PyErr_Clear();
+
+  aprmd5_async_port* newPort = PyObject_New(aprmd5_async_port, (PyTypeObject*)state->asyncPortType);
+  if (NULL == newPort)
+    goto fail;
+  port = (PyObject*)newPort;
+  newPort->writeFd = -1;
+  newPort->head = NULL;
+  newPort->tail = NULL;
+  pthread_mutex_init(&newPort->mutex, NULL);
+  if (aprmd5_async_port_open(newPort) < 0)
+  {
+    newPort->readFd = -1;
+    PyErr_SetFromErrno(PyExc_OSError);
+    goto fail;
+  }
+
+  PyObject* drain = PyObject_GetAttrString(port, "_drain");
+  if (NULL == drain)
+    goto fail;
+  PyObject* handle = PyObject_CallMethod(loop, "add_reader", "iO", newPort->readFd, drain);
+  Py_DECREF(drain);
+  if (NULL == handle)
+    goto fail;
+  Py_DECREF(handle);
+  if (PyObject_SetItem(state->asyncPorts, loop, port) < 0)
+  {
+    PyObject* removed = PyObject_CallMethod(loop, "remove_reader", "i", newPort->readFd);
+    Py_XDECREF(removed);
+    goto fail;
+  }
+
+  *loopOut = loop;
+  return newPort;
+
+fail:
+  Py_XDECREF(port);
+  Py_DECREF(loop);
+  return NULL;
+}
+
+
+// ---------------------------------------------------------------------------
+// The worker threads
+// ---------------------------------------------------------------------------
+
+// Runs a number of jobs that the worker took from the queue. If the jobs have
+// apr1 hashes, these are generated together.
+static void
+aprmd5_async_run_jobs(aprmd5_async_job** jobs, int jobCount)
+{
+  int index;
+  if (NULL != jobs[0]->apr1)
+  {
+    aprmd5_apr1_job apr1Jobs[APRMD5_MULTIBUF_MAXLANES];
+    for (index = 0; index < jobCount; ++index)
+      apr1Jobs[index] = *jobs[index]->apr1;
+    int failed = aprmd5_apr1_encode_many(aprmd5_multibuf_selected_kernel, apr1Jobs, jobCount);
+    for (index = 0; index < jobCount; ++index)
+      jobs[index]->apr1Failed = (0 != failed);
+  }
+
+  for (index = 0; index < jobCount; ++index)
+  {
+    if (NULL != jobs[index]->run)
+      jobs[index]->run(jobs[index]);
+    aprmd5_async_port_post(jobs[index]);
+  }
+}
+
+static void*
+aprmd5_async_worker_main(void* argument)
+{
+  for (;;)
+  {
+    aprmd5_async_job* jobs[APRMD5_MULTIBUF_MAXLANES];
+    int jobCount = 0;
+
+    pthread_mutex_lock(&aprmd5_async_queue_mutex);
+    while (NULL == aprmd5_async_queue_head)
+      pthread_cond_wait(&aprmd5_async_queue_cond, &aprmd5_async_queue_mutex);
+    // Take the first job, plus as many apr1 jobs behind it as the
+    // multi-buffer kernel has lanes
+    int lanes = (NULL != aprmd5_async_queue_head->apr1) ? aprmd5_multibuf_selected_kernel->lanes : 1;
+    do
+    {
+      aprmd5_async_job* job = aprmd5_async_queue_head;
+      aprmd5_async_queue_head = job->next;
+      jobs[jobCount++] = job;
+    }
+    while (jobCount < lanes
+           && NULL != aprmd5_async_queue_head
+           && NULL != aprmd5_async_queue_head->apr1);
+    if (NULL == aprmd5_async_queue_head)
+      aprmd5_async_queue_tail = NULL;
+    else
+      pthread_cond_signal(&aprmd5_async_queue_cond);
+    pthread_mutex_unlock(&aprmd5_async_queue_mutex);
+
+    aprmd5_async_run_jobs(jobs, jobCount);
+  }
+  return NULL;
+}
+
+// In the child process of a fork() only the forking thread survives. The
+// child starts with a fresh pool; queued jobs belong to the parent.
+static void
+aprmd5_async_atfork_child(void)
+{
+  pthread_mutex_init(&aprmd5_async_start_mutex, NULL);
+  pthread_mutex_init(&aprmd5_async_queue_mutex, NULL);
+  pthread_cond_init(&aprmd5_async_queue_cond, NULL);
+  aprmd5_async_queue_head = NULL;
+  aprmd5_async_queue_tail = NULL;
+  aprmd5_async_worker_count = 0;
+}
+
+// Starts the worker threads, if they have not been started yet. Returns 0 on
+// success, or -1 with a Python exception set.
+static int
+aprmd5_async_start_workers(void)
+{
+  int result = 0;
+  pthread_mutex_lock(&aprmd5_async_start_mutex);
+  if (aprmd5_async_worker_count > 0)
+    goto done;
+  result = -1;
+  if (! aprmd5_async_atfork_registered)
+  {
+    if (0 != pthread_atfork(NULL, NULL, aprmd5_async_atfork_child))
+    {
+      PyErr_SetString(PyExc_RuntimeError, "pthread_atfork() returned status code != 0");
+      goto done;
+    }
+    aprmd5_async_atfork_registered = 1;
+  }
+
+  int threadCount = aprmd5_threadpool_default_thread_count();
+  int index;
+  for (index = 0; index < threadCount; ++index)
+  {
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, aprmd5_async_worker_main, NULL))
+      break;
+    pthread_detach(thread);
+    ++aprmd5_async_worker_count;
+  }
+  if (0 == aprmd5_async_worker_count)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "pthread_create() returned status code != 0");
+    goto done;
+  }
+  result = 0;
+
+done:
+  pthread_mutex_unlock(&aprmd5_async_start_mutex);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Submits a job to the worker threads.
+//
+// Parameters:
+// - state: The state of the module that the caller belongs to
+// - job: The job to run, allocated with PyMem_Malloc(). The members run,
+//   complete, release and apr1 must be set. The function takes ownership of
+//   the job, even if it fails.
+//
+// Return value:
+// - A new reference to the asyncio.Future that is resolved with the result
+//   of the job, or NULL with a Python exception set
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_async_submit(aprmd5_module_state* state, aprmd5_async_job* job)
+{
+  job->next = NULL;
+  job->apr1Failed = 0;
+  job->future = NULL;
+  job->port = NULL;
+
+  PyObject* loop = NULL;
+  job->port = aprmd5_async_port_for_running_loop(state, &loop);
+  if (NULL == job->port)
+    goto fail;
+  job->future = PyObject_CallMethod(loop, "create_future", NULL);
+  Py_DECREF(loop);
+  if (NULL == job->future || aprmd5_async_start_workers() < 0)
+    goto fail;
+
+  PyObject* future = job->future;
+  Py_INCREF(future);
+  pthread_mutex_lock(&aprmd5_async_queue_mutex);
+  if (NULL == aprmd5_async_queue_tail)
+    aprmd5_async_queue_head = job;
+  else
+    aprmd5_async_queue_tail->next = job;
+  aprmd5_async_queue_tail = job;
+  pthread_cond_signal(&aprmd5_async_queue_cond);
+  pthread_mutex_unlock(&aprmd5_async_queue_mutex);
+  return future;
+
+fail:
+  aprmd5_async_job_free(job);
+  return NULL;
+}
+
+
+// ---------------------------------------------------------------------------
+// Returns a new reference to an asyncio.Future of the running event loop that
+// is already resolved with the specified result. Awaitable functions use this
+// for work that is too small to be worth a trip to a worker thread. Returns
+// NULL with a Python exception set on failure.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_async_resolved(aprmd5_module_state* state, PyObject* result)
+{
+  PyObject* loop = aprmd5_async_running_loop(state);
+  if (NULL == loop)
+    return NULL;
+  PyObject* future = PyObject_CallMethod(loop, "create_future", NULL);
+  Py_DECREF(loop);
+  if (NULL == future)
+    return NULL;
+  PyObject* outcome = PyObject_CallMethod(future, "set_result", "O", result);
+  if (NULL == outcome)
+    Py_CLEAR(future);
+  Py_XDECREF(outcome);
+  return future;
+}
+
+
+// ---------------------------------------------------------------------------
+// Creates the Python objects needed by the awaitable functions and stores
+// them in the state of a module. Returns 0 on success, or -1 with a Python
+// exception set.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_async_init(PyObject* module)
+{
+  aprmd5_module_state* state = aprmd5_state_from_module(module);
+  state->asyncPortType = aprmd5_helper_type_from_spec(module, &aprmd5_async_port_spec);
+  if (NULL == state->asyncPortType)
+    return -1;
+
+  PyObject* weakref = PyImport_ImportModule("weakref");
+  if (NULL == weakref)
+    return -1;
+  state->asyncPorts = PyObject_CallMethod(weakref, "WeakKeyDictionary", NULL);
+  Py_DECREF(weakref);
+  if (NULL == state->asyncPorts)
+    return -1;
+
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// The password jobs behind md5_encode_async() and password_validate_async()
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  aprmd5_async_job base;
+  aprmd5_apr1_job apr1Job;
+  int validate;                 // 0 = md5_encode(), 1 = password_validate()
+  const char* password;
+  const char* second;           // the salt or the hash
+  char result[APRMD5_APR1_HASHSIZE];
+  apr_status_t status;
+  char strings[1];              // password and second, null-terminated
+} aprmd5_async_password_job;
+
+static void
+aprmd5_async_password_run(aprmd5_async_job* job)
+{
+  aprmd5_async_password_job* passwordJob = (aprmd5_async_password_job*)job;
+  if (NULL == job->apr1)
+  {
+    passwordJob->status = aprmd5_passwd_validate(passwordJob->password, passwordJob->second);
+  }
+  else if (job->apr1Failed)
+  {
+    // +1 to the result size for the same reason as in aprmd5_md5_encode()
+    if (passwordJob->validate)
+      passwordJob->status = aprmd5_passwd_validate(passwordJob->password, passwordJob->second);
+    else
+      passwordJob->status = aprmd5_backend_selected->apr1_encode(passwordJob->password, passwordJob->second,
+                                                                 passwordJob->result, APRMD5_APR1_HASHSIZE + 1);
+  }
+  else if (passwordJob->validate)
+  {
+    // Compare in constant time; otherwise like apr_password_validate()
+    passwordJob->status = aprmd5_apr1_equal(passwordJob->result, passwordJob->second) ? APR_SUCCESS : APR_EMISMATCH;
+  }
+  else
+  {
+    passwordJob->status = APR_SUCCESS;
+  }
+}
+
+static PyObject*
+aprmd5_async_password_complete(aprmd5_async_job* job)
+{
+  aprmd5_async_password_job* passwordJob = (aprmd5_async_password_job*)job;
+  if (passwordJob->validate)
+    return PyBool_FromLong(APR_SUCCESS == passwordJob->status);
+  if (APR_SUCCESS != passwordJob->status)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "apr_md5_encode() returned status code != 0");
+    return NULL;
+  }
+  return Py_BuildValue("s", passwordJob->result);
+}
+
+static PyObject*
+aprmd5_async_password_submit(PyObject* module, const char* password, const char* second, int validate)
+{
+  size_t passwordLen = strlen(password);
+  size_t secondLen = strlen(second);
+  aprmd5_async_password_job* job = (aprmd5_async_password_job*)PyMem_Malloc(
+    sizeof(aprmd5_async_password_job) + passwordLen + secondLen + 1);
+  if (NULL == job)
+    return PyErr_NoMemory();
+
+  memcpy(job->strings, password, passwordLen + 1);
+  memcpy(job->strings + passwordLen + 1, second, secondLen + 1);
+  job->password = job->strings;
+  job->second = job->strings + passwordLen + 1;
+  job->validate = validate;
+  job->status = APR_SUCCESS;
+  job->apr1Job.password = job->password;
+  job->apr1Job.salt = job->second;
+  job->apr1Job.result = job->result;
+
+  job->base.run = aprmd5_async_password_run;
+  job->base.complete = aprmd5_async_password_complete;
+  job->base.release = NULL;
+  // Hashes that are not apr1 hashes are validated one at a time by
+  // aprmd5_passwd_validate()
+  if (validate && 0 != strncmp(second, APRMD5_APR1_ID, APRMD5_APR1_IDLEN))
+    job->base.apr1 = NULL;
+  else
+    job->base.apr1 = &job->apr1Job;
+  return aprmd5_async_submit(aprmd5_state_from_module(module), &job->base);
+}
+
+
+// ---------------------------------------------------------------------------
+// This is the awaitable version of md5_encode(). From within Python, this
+// function will be available as
+//
+//   aprmd5.md5_encode_async()
+//
+// The password is encoded on a native worker thread, so the event loop is not
+// blocked. The function must be called while an asyncio event loop is running
+// in the current thread.
+//
+// Parameters of the Python function:
+// - Same as md5_encode()
+//
+// Return value of the Python function:
+// - An asyncio.Future whose result is the same string that md5_encode()
+//   returns
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_encode_async(PyObject* self, PyObject* args)
+{
+  const char* password = NULL;
+  const char* salt = NULL;
+  if (! PyArg_ParseTuple(args, "ss:md5_encode_async", &password, &salt))
+    return NULL;
+  return aprmd5_async_password_submit(self, password, salt, 0);
+}
+
+
+// ---------------------------------------------------------------------------
+// This is the awaitable version of password_validate(). From within Python,
+// this function will be available as
+//
+//   aprmd5.password_validate_async()
+//
+// The password is validated on a native worker thread, so the event loop is
+// not blocked. The function must be called while an asyncio event loop is
+// running in the current thread.
+//
+// Parameters of the Python function:
+// - Same as password_validate()
+//
+// Return value of the Python function:
+// - An asyncio.Future whose result is the same boolean value that
+//   password_validate() returns
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_password_validate_async(PyObject* self, PyObject* args)
+{
+  const char* password = NULL;
+  const char* hash = NULL;
+  if (! PyArg_ParseTuple(args, "ss:password_validate_async", &password, &hash))
+    return NULL;
+  return aprmd5_async_password_submit(self, password, hash, 1);
+}
+
+#else   // #if PY_MAJOR_VERSION >= 3
+
+int aprmd5_async_init(PyObject* module)
+{
+  return 0;
+}
+
+#endif  // #if PY_MAJOR_VERSION >= 3
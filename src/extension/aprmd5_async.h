@@ -0,0 +1,83 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the machinery behind the module's awaitable functions.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_ASYNC_H
+#define APRMD5_ASYNC_H
+
+// Project includes
+#include "aprmd5_apr1.h"
+#include "aprmd5_state.h"
+
+typedef struct aprmd5_async_job aprmd5_async_job;
+typedef struct aprmd5_async_port aprmd5_async_port;
+
+// Invoked on a worker thread with the GIL released; performs the actual work
+// of a job. Must not touch any Python objects.
+typedef void (*aprmd5_async_run_func)(aprmd5_async_job* job);
+
+// Invoked on the event loop's thread with the GIL held after the job has been
+// run. Returns the result of the job, or NULL with a Python exception set.
+typedef PyObject* (*aprmd5_async_complete_func)(aprmd5_async_job* job);
+
+// Invoked with the GIL held when the job is discarded; releases the
+// resources held by the job, but not the job memory itself.
+typedef void (*aprmd5_async_release_func)(aprmd5_async_job* job);
+
+// The common header of all jobs. A concrete job embeds this as its first
+// member, and is allocated with PyMem_Malloc().
+struct aprmd5_async_job
+{
+  aprmd5_async_job* next;
+  aprmd5_async_run_func run;              // may be NULL
+  aprmd5_async_complete_func complete;
+  aprmd5_async_release_func release;      // may be NULL
+  // If not NULL, the worker generates this apr1 hash before it invokes run.
+  // Worker threads generate the hashes of several such jobs together on the
+  // multi-buffer kernel.
+  aprmd5_apr1_job* apr1;
+  int apr1Failed;                         // 1 if the apr1 hash could not be
+                                          // generated for lack of memory
+  // Owned by the machinery
+  PyObject* future;
+  aprmd5_async_port* port;
+};
+
+extern int
+aprmd5_async_init(PyObject* module);
+
+extern PyObject*
+aprmd5_async_submit(aprmd5_module_state* state, aprmd5_async_job* job);
+
+extern PyObject*
+aprmd5_async_resolved(aprmd5_module_state* state, PyObject* result);
+
+extern PyObject*
+aprmd5_md5_encode_async(PyObject* self, PyObject* args);
+
+extern PyObject*
+aprmd5_password_validate_async(PyObject* self, PyObject* args);
+
+
+#endif // #ifndef APRMD5_ASYNC_H
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the MD5 backends. The md5 type, the one-shot digest
+// functions, md5_file(), md5_encode() and the C API delegate to the selected
+// backend. There are three backends:
+// - "builtin": The module's own streaming functions on top of the compression
+//   function that aprmd5_md5block_init() selected, and the module's own apr1
+//   engine
+// - "openssl": The same, but with the assembly-optimized compression function
+//   of OpenSSL's libcrypto. libcrypto is loaded at runtime, so the module does
+//   not depend on it; the backend is simply not available on hosts that lack
+//   it.
+// - "apr": The MD5 routines of libaprutil
+//
+// The engines that work on the block level (md5_many(), the batch functions,
+// the cache and the duplicate finder) are not affected by the backend,
+// because neither libaprutil nor OpenSSL offer a multi-lane MD5.
+//
+// All backends keep the MD5 context in the format of apr_md5_ctx_t and
+// produce identical results, so the choice is a matter of speed only. The
+// backend is selected when the module is initialized by hashing a small buffer
+// with each available backend; the fastest backend wins, unless it is less
+// than 10% faster than the builtin backend. The environment variable
+// APRMD5_BACKEND can be set to the name of a backend to force it. A backend
+// that is not available is never selected.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_apr1.h"
+
+// System includes
+#include <dlfcn.h>    // for dlopen(), dlsym()
+#include <stdlib.h>   // for getenv()
+#include <string.h>   // for memcmp(), strcmp(), strlen()
+#include <time.h>     // for clock_gettime()
+
+
+// The size of the buffer that is hashed to calibrate the backends, and the
+// number of times that each backend hashes it. The best time counts.
+#define APRMD5_BACKEND_CALIBRATIONSIZE    (16 * 1024)
+#define APRMD5_BACKEND_CALIBRATIONREPEAT  3
+
+
+// ---------------------------------------------------------------------------
+// The builtin backend
+// ---------------------------------------------------------------------------
+
+// Generates an apr1 hash with the module's own single-password apr1 engine.
+// The result is copied the same way as apr_md5_encode() copies it, i.e. at
+// most resultSize - 2 characters plus the terminating null byte are written.
+static apr_status_t
+aprmd5_backend_builtin_apr1_encode(const char* password, const char* salt, char* result, apr_size_t resultSize)
+{
+  char hash[APRMD5_APR1_HASHSIZE];
+  if (0 != aprmd5_apr1_encode(password, salt, hash))
+    return APR_ENOMEM;
+  if (resultSize < 2)
+    return APR_SUCCESS;
+  apr_size_t hashLen = strlen(hash);
+  if (hashLen > resultSize - 2)
+    hashLen = resultSize - 2;
+  memcpy(result, hash, hashLen);
+  result[hashLen] = '\0';
+  return APR_SUCCESS;
+}
+
+
+// ---------------------------------------------------------------------------
+// The openssl backend
+// ---------------------------------------------------------------------------
+
+// The layout of MD5_CTX in <openssl/md5.h>. OpenSSL's headers are not
+// included because libcrypto is only loaded at runtime.
+typedef struct
+{
+  unsigned int A, B, C, D;
+  unsigned int Nl, Nh;
+  unsigned int data[16];
+  unsigned int num;
+} aprmd5_backend_openssl_ctx;
+
+// MD5_Transform() compresses a single block with the same function that
+// OpenSSL's own MD5 uses
+typedef void (*aprmd5_backend_openssl_transform_func)(aprmd5_backend_openssl_ctx* context,
+                                                      const unsigned char* block);
+
+static aprmd5_backend_openssl_transform_func aprmd5_backend_openssl_transform = NULL;
+
+static void
+aprmd5_backend_openssl_block(apr_uint32_t state[4], const unsigned char* blocks, apr_size_t blockCount)
+{
+  aprmd5_backend_openssl_ctx context;
+  context.A = state[0];
+  context.B = state[1];
+  context.C = state[2];
+  context.D = state[3];
+  for (; blockCount > 0; --blockCount, blocks += APRMD5_MD5_BLOCKSIZE)
+    aprmd5_backend_openssl_transform(&context, blocks);
+  state[0] = context.A;
+  state[1] = context.B;
+  state[2] = context.C;
+  state[3] = context.D;
+}
+
+// Loads libcrypto and checks that its compression function computes the same
+// as ours. A libcrypto whose MD5_CTX has a different layout fails the check.
+static int
+aprmd5_backend_openssl_load(void)
+{
+  static const char* libraryNames[] =
+  {
+#if defined(__APPLE__)
+    // Never the unversioned system library, which aborts the process
+    "libcrypto.3.dylib",
+    "libcrypto.1.1.dylib",
+#else
+    "libcrypto.so.3",
+    "libcrypto.so.1.1",
+    "libcrypto.so",
+#endif
+    NULL
+  };
+  const char** libraryName;
+  void* library = NULL;
+  for (libraryName = libraryNames; NULL == library && NULL != *libraryName; ++libraryName)
+    library = dlopen(*libraryName, RTLD_NOW | RTLD_LOCAL);
+  if (NULL == library)
+    return 0;
+  // The library stays loaded until the process ends
+  aprmd5_backend_openssl_transform = (aprmd5_backend_openssl_transform_func)dlsym(library, "MD5_Transform");
+  if (NULL == aprmd5_backend_openssl_transform)
+    return 0;
+
+  unsigned char blocks[2 * APRMD5_MD5_BLOCKSIZE];
+  unsigned int index;
+  for (index = 0; index < sizeof(blocks); ++index)
+    blocks[index] = (unsigned char)(index * 7 + 1);
+  apr_uint32_t expected[4] = { APRMD5_MD5_INIT_A, APRMD5_MD5_INIT_B, APRMD5_MD5_INIT_C, APRMD5_MD5_INIT_D };
+  apr_uint32_t actual[4] = { APRMD5_MD5_INIT_A, APRMD5_MD5_INIT_B, APRMD5_MD5_INIT_C, APRMD5_MD5_INIT_D };
+  aprmd5_md5block_portable(expected, blocks, 2);
+  aprmd5_backend_openssl_block(actual, blocks, 2);
+  if (0 != memcmp(expected, actual, sizeof(expected)))
+  {
+    aprmd5_backend_openssl_transform = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+static void
+aprmd5_backend_openssl_update(apr_md5_ctx_t* context, const unsigned char* input, apr_size_t inputLen)
+{
+  aprmd5_md5block_ctx_update_using(aprmd5_backend_openssl_block, context, input, inputLen);
+}
+
+static void
+aprmd5_backend_openssl_final(unsigned char digest[APRMD5_MD5_DIGESTSIZE], apr_md5_ctx_t* context)
+{
+  aprmd5_md5block_ctx_final_using(aprmd5_backend_openssl_block, digest, context);
+}
+
+
+// ---------------------------------------------------------------------------
+// The apr backend
+// ---------------------------------------------------------------------------
+
+static void
+aprmd5_backend_apr_update(apr_md5_ctx_t* context, const unsigned char* input, apr_size_t inputLen)
+{
+  apr_md5_update(context, input, inputLen);
+}
+
+static void
+aprmd5_backend_apr_final(unsigned char digest[APRMD5_MD5_DIGESTSIZE], apr_md5_ctx_t* context)
+{
+  apr_md5_final(digest, context);
+}
+
+
+// ---------------------------------------------------------------------------
+// The table of backends. The first backend is always available and is used
+// when no other backend is faster.
+// ---------------------------------------------------------------------------
+static const aprmd5_backend aprmd5_backends[] =
+{
+  { "builtin", NULL,
+    aprmd5_md5block_ctx_update, aprmd5_md5block_ctx_final, aprmd5_backend_builtin_apr1_encode },
+  { "openssl", aprmd5_backend_openssl_load,
+    aprmd5_backend_openssl_update, aprmd5_backend_openssl_final, aprmd5_backend_builtin_apr1_encode },
+  { "apr",     NULL,
+    aprmd5_backend_apr_update, aprmd5_backend_apr_final, apr_md5_encode },
+  { NULL,      NULL, NULL, NULL, NULL }   // Sentinel
+};
+
+// The backend that is used by the md5 type and the apr1 functions
+const aprmd5_backend* aprmd5_backend_selected = &aprmd5_backends[0];
+
+
+// ---------------------------------------------------------------------------
+// Returns the time in ns that a backend needs to hash the calibration buffer
+// ---------------------------------------------------------------------------
+static apr_int64_t
+aprmd5_backend_measure(const aprmd5_backend* backend)
+{
+  static unsigned char input[APRMD5_BACKEND_CALIBRATIONSIZE];
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  apr_md5_ctx_t context;
+  apr_int64_t best = -1;
+  int repeat;
+  for (repeat = 0; repeat < APRMD5_BACKEND_CALIBRATIONREPEAT; ++repeat)
+  {
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    aprmd5_md5block_ctx_init(&context);
+    backend->update(&context, input, sizeof(input));
+    backend->final(digest, &context);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    apr_int64_t elapsed = (apr_int64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+
+// ---------------------------------------------------------------------------
+// Selects the backend. This must be called once when the module is
+// initialized, after aprmd5_md5block_init().
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_backend_init(void)
+{
+  const char* forcedName = getenv("APRMD5_BACKEND");
+  const aprmd5_backend* backend;
+  if (NULL != forcedName && '\0' != forcedName[0])
+  {
+    // Fall back to the first backend if the forced backend is unknown or not
+    // available
+    aprmd5_backend_selected = &aprmd5_backends[0];
+    for (backend = aprmd5_backends; NULL != backend->name; ++backend)
+    {
+      if (0 != strcmp(forcedName, backend->name))
+        continue;
+      if (NULL == backend->load || backend->load())
+        aprmd5_backend_selected = backend;
+      break;
+    }
+    return;
+  }
+
+  aprmd5_backend_selected = &aprmd5_backends[0];
+  apr_int64_t builtinTime = aprmd5_backend_measure(aprmd5_backend_selected);
+  apr_int64_t bestTime = builtinTime;
+  for (backend = aprmd5_backends + 1; NULL != backend->name; ++backend)
+  {
+    if (NULL != backend->load && ! backend->load())
+      continue;
+    apr_int64_t time = aprmd5_backend_measure(backend);
+    if (time < bestTime && time * 10 < builtinTime * 9)
+    {
+      aprmd5_backend_selected = backend;
+      bestTime = time;
+    }
+  }
+}
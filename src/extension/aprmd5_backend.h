@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the MD5 backends, i.e. the implementations of MD5 and
+// apr1 that the md5 type and the apr1 functions delegate to.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_BACKEND_H
+#define APRMD5_BACKEND_H
+
+// Project includes
+#include "aprmd5_md5block.h"
+
+// A backend. All backends keep the MD5 context in the format of
+// apr_md5_ctx_t, so that a context can be copied, exported and restored no
+// matter which backend is selected. Contexts are initialized with
+// aprmd5_md5block_ctx_init().
+typedef struct
+{
+  const char* name;   // e.g. "openssl"
+  // Prepares the backend; returns 0 if the backend cannot be used on this
+  // host, otherwise non-zero. NULL if the backend is always available.
+  int (*load)(void);
+  // The equivalents of apr_md5_update(), apr_md5_final() and
+  // apr_md5_encode()
+  void (*update)(apr_md5_ctx_t* context, const unsigned char* input, apr_size_t inputLen);
+  void (*final)(unsigned char digest[APRMD5_MD5_DIGESTSIZE], apr_md5_ctx_t* context);
+  apr_status_t (*apr1_encode)(const char* password, const char* salt, char* result, apr_size_t resultSize);
+} aprmd5_backend;
+
+extern const aprmd5_backend* aprmd5_backend_selected;
+
+extern void
+aprmd5_backend_init(void);
+
+
+#endif // #ifndef APRMD5_BACKEND_H
@@ -0,0 +1,748 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the ValidationCache type exposed to Python.
+//
+// A ValidationCache remembers (password, hash) pairs that have been
+// successfully validated, so that validating the same pair again does not
+// repeat the expensive hash computation.
+//
+// The cache never stores a password. It stores the HMAC-MD5 of the pair,
+// keyed with a random secret that is generated when the cache is created and
+// never leaves the process. An attacker who can read the cache's memory
+// learns nothing that would help them guess a password offline, because the
+// key is needed to test a guess.
+//
+// Failed validations are not cached. Otherwise, the cache would make guessing
+// passwords cheap.
+//
+// The entries are spread across a number of stripes, each of which is a
+// small hash table with its own lock, its own LRU list and its own share of
+// the capacity. The shares add up to max_entries exactly; a cache with fewer
+// than 16 entries has fewer stripes, so that no stripe is empty. Threads that validate different pairs therefore rarely wait
+// for each other. Lookups are done with the GIL released.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_cache.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_passwd.h"
+#include "aprmd5_md5block.h"
+
+// Defines PyMemberDef and PyMethodDef. Weird - why is this not in Python.h?
+// See http://bugs.python.org/issue2897.
+#include <structmember.h>
+
+// System includes
+#include <limits.h>   // for INT_MAX
+#include <pthread.h>
+#include <string.h>   // for memcmp(), memcpy(), memset(), strlen()
+#include <time.h>     // for clock_gettime()
+
+
+// The maximum number of stripes; must be a power of 2
+#define APRMD5_CACHE_STRIPECOUNT 16
+
+// Marks the end of a list of entries
+#define APRMD5_CACHE_NOENTRY (-1)
+
+// The expiration time of entries in a cache without a TTL
+#define APRMD5_CACHE_NEVER ((apr_int64_t)0x7fffffffffffffffLL)
+
+// The size of the HMAC key; the same as the MD5 block size, which is the
+// largest key size that HMAC-MD5 can use without hashing the key first
+#define APRMD5_CACHE_KEYSIZE APRMD5_MD5_BLOCKSIZE
+
+
+// ---------------------------------------------------------------------------
+// Various strings that are exposed to Python and visible to the user
+// ---------------------------------------------------------------------------
+
+const char* aprmd5_cache_type_name = "ValidationCache";
+static char* aprmd5_cache_init_kwlist[] = {"max_entries", "ttl", NULL};
+
+
+// ---------------------------------------------------------------------------
+// Definition of the C type that is used to create ValidationCache objects
+// ---------------------------------------------------------------------------
+
+// A cached pair. Entries are linked by index rather than by pointer.
+typedef struct
+{
+  unsigned char key[APRMD5_MD5_DIGESTSIZE];   // HMAC-MD5 of the pair
+  apr_int64_t expires;                        // monotonic time in ns
+  int bucketNext;                             // next entry in the bucket
+  int lruPrev;                                // more recently used entry
+  int lruNext;                                // less recently used entry
+} aprmd5_cache_entry;
+
+typedef struct
+{
+  pthread_mutex_t mutex;        // protects everything else in the stripe
+  aprmd5_cache_entry* entries;
+  int capacity;                 // the number of entries
+  int count;                    // the number of entries in use
+  int* buckets;                 // the first entry of each bucket
+  apr_uint32_t bucketMask;      // the number of buckets - 1
+  int lruHead;                  // the most recently used entry
+  int lruTail;                  // the least recently used entry
+  int freeList;                 // unused entries, linked by bucketNext
+  apr_uint64_t hits;
+  apr_uint64_t misses;
+  apr_uint64_t evictions;
+  apr_uint64_t expirations;
+} aprmd5_cache_stripe;
+
+typedef struct {
+  // Adds reference count and a pointer to the actual type object
+  PyObject_HEAD
+  // Type-specific fields go here
+  Py_ssize_t maxEntries;
+  apr_int64_t ttl;              // in ns, or APRMD5_CACHE_NEVER
+  apr_md5_ctx_t innerContext;   // HMAC state after the inner key block
+  apr_md5_ctx_t outerContext;   // HMAC state after the outer key block
+  aprmd5_cache_stripe* stripes; // NULL until the object has been initialized
+  int stripeCount;              // a power of 2, at most APRMD5_CACHE_STRIPECOUNT
+} aprmd5_cache_object;
+
+
+// ---------------------------------------------------------------------------
+// Helper functions. None of them touch Python objects; they can be called
+// while the GIL is released.
+// ---------------------------------------------------------------------------
+
+// Returns the current time of the monotonic clock in ns.
+static apr_int64_t
+aprmd5_cache_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (apr_int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Computes the key under which a (password, hash) pair is cached: the
+// HMAC-MD5 of the hash, a null byte and the password. The null byte keeps
+// the boundary between hash and password unambiguous.
+static void
+aprmd5_cache_compute_key(const aprmd5_cache_object* self, const char* password, const char* hash,
+                         unsigned char key[APRMD5_MD5_DIGESTSIZE])
+{
+  apr_md5_ctx_t context = self->innerContext;
+  aprmd5_md5block_ctx_update(&context, (const unsigned char*)hash, strlen(hash) + 1);
+  aprmd5_md5block_ctx_update(&context, (const unsigned char*)password, strlen(password));
+  unsigned char innerDigest[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_md5block_ctx_final(innerDigest, &context);
+
+  context = self->outerContext;
+  aprmd5_md5block_ctx_update(&context, innerDigest, APRMD5_MD5_DIGESTSIZE);
+  aprmd5_md5block_ctx_final(key, &context);
+}
+
+// Selects the stripe of a key. The key is an HMAC, so its bytes are
+// uniformly distributed; the stripe and the bucket use different bytes.
+static aprmd5_cache_stripe*
+aprmd5_cache_stripe_for_key(const aprmd5_cache_object* self, const unsigned char* key)
+{
+  return &self->stripes[key[0] & (self->stripeCount - 1)];
+}
+
+static apr_uint32_t
+aprmd5_cache_bucket_for_key(const aprmd5_cache_stripe* stripe, const unsigned char* key)
+{
+  apr_uint32_t value = ((apr_uint32_t)key[4] << 24) | ((apr_uint32_t)key[5] << 16)
+                     | ((apr_uint32_t)key[6] << 8) | key[7];
+  return value & stripe->bucketMask;
+}
+
+static void
+aprmd5_cache_lru_unlink(aprmd5_cache_stripe* stripe, int index)
+{
+  aprmd5_cache_entry* entry = &stripe->entries[index];
+  if (APRMD5_CACHE_NOENTRY == entry->lruPrev)
+    stripe->lruHead = entry->lruNext;
+  else
+    stripe->entries[entry->lruPrev].lruNext = entry->lruNext;
+  if (APRMD5_CACHE_NOENTRY == entry->lruNext)
+    stripe->lruTail = entry->lruPrev;
+  else
+    stripe->entries[entry->lruNext].lruPrev = entry->lruPrev;
+}
+
+static void
+aprmd5_cache_lru_push_front(aprmd5_cache_stripe* stripe, int index)
+{
+  aprmd5_cache_entry* entry = &stripe->entries[index];
+  entry->lruPrev = APRMD5_CACHE_NOENTRY;
+  entry->lruNext = stripe->lruHead;
+  if (APRMD5_CACHE_NOENTRY == stripe->lruHead)
+    stripe->lruTail = index;
+  else
+    stripe->entries[stripe->lruHead].lruPrev = index;
+  stripe->lruHead = index;
+}
+
+// Returns the index of the entry with the specified key, or
+// APRMD5_CACHE_NOENTRY. If link is not NULL, it receives the location that
+// points to the entry, so that the entry can be removed from its bucket.
+static int
+aprmd5_cache_find(aprmd5_cache_stripe* stripe, const unsigned char* key, int** link)
+{
+  int* location = &stripe->buckets[aprmd5_cache_bucket_for_key(stripe, key)];
+  while (APRMD5_CACHE_NOENTRY != *location)
+  {
+    if (0 == memcmp(stripe->entries[*location].key, key, APRMD5_MD5_DIGESTSIZE))
+      break;
+    location = &stripe->entries[*location].bucketNext;
+  }
+  if (NULL != link)
+    *link = location;
+  return *location;
+}
+
+// Removes an entry and puts it on the free list.
+static void
+aprmd5_cache_remove(aprmd5_cache_stripe* stripe, int index)
+{
+  int* link;
+  aprmd5_cache_find(stripe, stripe->entries[index].key, &link);
+  *link = stripe->entries[index].bucketNext;
+  aprmd5_cache_lru_unlink(stripe, index);
+  stripe->entries[index].bucketNext = stripe->freeList;
+  stripe->freeList = index;
+  --stripe->count;
+}
+
+// Returns 1 if the stripe contains an unexpired entry with the specified key,
+// otherwise 0. Updates the stripe's counters.
+static int
+aprmd5_cache_lookup(aprmd5_cache_stripe* stripe, const unsigned char* key, apr_int64_t now)
+{
+  int hit = 0;
+  pthread_mutex_lock(&stripe->mutex);
+  int index = aprmd5_cache_find(stripe, key, NULL);
+  if (APRMD5_CACHE_NOENTRY != index)
+  {
+    if (stripe->entries[index].expires > now)
+    {
+      aprmd5_cache_lru_unlink(stripe, index);
+      aprmd5_cache_lru_push_front(stripe, index);
+      hit = 1;
+    }
+    else
+    {
+      aprmd5_cache_remove(stripe, index);
+      ++stripe->expirations;
+    }
+  }
+  if (hit)
+    ++stripe->hits;
+  else
+    ++stripe->misses;
+  pthread_mutex_unlock(&stripe->mutex);
+  return hit;
+}
+
+// Adds an entry with the specified key to the stripe, evicting the least
+// recently used entry if the stripe is full. If the stripe already contains
+// an entry with the key (another thread has just added it), the existing
+// entry is refreshed.
+static void
+aprmd5_cache_insert(aprmd5_cache_stripe* stripe, const unsigned char* key, apr_int64_t expires)
+{
+  pthread_mutex_lock(&stripe->mutex);
+  int index = aprmd5_cache_find(stripe, key, NULL);
+  if (APRMD5_CACHE_NOENTRY != index)
+  {
+    aprmd5_cache_lru_unlink(stripe, index);
+  }
+  else
+  {
+    if (APRMD5_CACHE_NOENTRY == stripe->freeList)
+    {
+      aprmd5_cache_remove(stripe, stripe->lruTail);
+      ++stripe->evictions;
+    }
+    index = stripe->freeList;
+    aprmd5_cache_entry* entry = &stripe->entries[index];
+    stripe->freeList = entry->bucketNext;
+    memcpy(entry->key, key, APRMD5_MD5_DIGESTSIZE);
+    int* bucket = &stripe->buckets[aprmd5_cache_bucket_for_key(stripe, key)];
+    entry->bucketNext = *bucket;
+    *bucket = index;
+    ++stripe->count;
+  }
+  stripe->entries[index].expires = expires;
+  aprmd5_cache_lru_push_front(stripe, index);
+  pthread_mutex_unlock(&stripe->mutex);
+}
+
+// Removes all entries from the stripe. The stripe's mutex must be held.
+static void
+aprmd5_cache_stripe_reset(aprmd5_cache_stripe* stripe)
+{
+  int index;
+  for (index = 0; index <= (int)stripe->bucketMask; ++index)
+    stripe->buckets[index] = APRMD5_CACHE_NOENTRY;
+  for (index = 0; index < stripe->capacity; ++index)
+    stripe->entries[index].bucketNext = (index + 1 < stripe->capacity) ? index + 1 : APRMD5_CACHE_NOENTRY;
+  stripe->freeList = 0;
+  stripe->lruHead = APRMD5_CACHE_NOENTRY;
+  stripe->lruTail = APRMD5_CACHE_NOENTRY;
+  stripe->count = 0;
+}
+
+// Frees the stripes of a cache.
+static void
+aprmd5_cache_free_stripes(aprmd5_cache_object* self)
+{
+  if (NULL == self->stripes)
+    return;
+  int index;
+  for (index = 0; index < self->stripeCount; ++index)
+  {
+    aprmd5_cache_stripe* stripe = &self->stripes[index];
+    pthread_mutex_destroy(&stripe->mutex);
+    PyMem_Free(stripe->entries);
+    PyMem_Free(stripe->buckets);
+  }
+  PyMem_Free(self->stripes);
+  self->stripes = NULL;
+}
+
+
+// ---------------------------------------------------------------------------
+// Allocation/initialization/deallocation of ValidationCache objects
+// ---------------------------------------------------------------------------
+
+static PyObject*
+aprmd5_cache_object_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+  aprmd5_cache_object* self = (aprmd5_cache_object*)type->tp_alloc(type, 0);
+  if (NULL == self)
+    return NULL;
+  self->stripes = NULL;
+  return (PyObject*)self;
+}
+
+// Generates the random HMAC key and precomputes the inner and outer HMAC
+// contexts. Returns 0 on success, or -1 with a Python exception set.
+static int
+aprmd5_cache_object_init_key(aprmd5_cache_object* self)
+{
+  PyObject* os = PyImport_ImportModule("os");
+  if (NULL == os)
+    return -1;
+  PyObject* randomBytes = PyObject_CallMethod(os, "urandom", "i", APRMD5_CACHE_KEYSIZE);
+  Py_DECREF(os);
+  if (NULL == randomBytes)
+    return -1;
+  if (! PyBytes_Check(randomBytes) || APRMD5_CACHE_KEYSIZE != PyBytes_GET_SIZE(randomBytes))
+  {
+    Py_DECREF(randomBytes);
+    PyErr_SetString(PyExc_RuntimeError, "os.urandom() returned an unexpected result");
+    return -1;
+  }
+
+  unsigned char innerPad[APRMD5_CACHE_KEYSIZE];
+  unsigned char outerPad[APRMD5_CACHE_KEYSIZE];
+  const unsigned char* key = (const unsigned char*)PyBytes_AS_STRING(randomBytes);
+  int index;
+  for (index = 0; index < APRMD5_CACHE_KEYSIZE; ++index)
+  {
+    innerPad[index] = key[index] ^ 0x36;
+    outerPad[index] = key[index] ^ 0x5c;
+  }
+  Py_DECREF(randomBytes);
+
+  aprmd5_md5block_ctx_init(&self->innerContext);
+  aprmd5_md5block_ctx_update(&self->innerContext, innerPad, APRMD5_CACHE_KEYSIZE);
+  aprmd5_md5block_ctx_init(&self->outerContext);
+  aprmd5_md5block_ctx_update(&self->outerContext, outerPad, APRMD5_CACHE_KEYSIZE);
+  memset(innerPad, 0, sizeof(innerPad));
+  memset(outerPad, 0, sizeof(outerPad));
+  return 0;
+}
+
+static int
+aprmd5_cache_object_init(aprmd5_cache_object* self, PyObject* args, PyObject* kwds)
+{
+  Py_ssize_t maxEntries = 10000;
+  PyObject* ttlObject = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "|nO:ValidationCache", aprmd5_cache_init_kwlist,
+                                    &maxEntries, &ttlObject))
+    return -1;
+  if (maxEntries < 1 || maxEntries > (Py_ssize_t)(INT_MAX / 2) * APRMD5_CACHE_STRIPECOUNT)
+  {
+    PyErr_SetString(PyExc_ValueError, "max_entries is out of range");
+    return -1;
+  }
+
+  // The default TTL is 5 minutes; None means that entries never expire
+  apr_int64_t ttl = (apr_int64_t)300 * 1000000000;
+  if (NULL != ttlObject && Py_None == ttlObject)
+  {
+    ttl = APRMD5_CACHE_NEVER;
+  }
+  else if (NULL != ttlObject)
+  {
+    double seconds = PyFloat_AsDouble(ttlObject);
+    if (-1.0 == seconds && PyErr_Occurred())
+      return -1;
+    if (! (seconds > 0.0) || seconds > 1e9)
+    {
+      PyErr_SetString(PyExc_ValueError, "ttl must be a positive number of seconds, or None");
+      return -1;
+    }
+    ttl = (apr_int64_t)(seconds * 1e9);
+  }
+
+  // Other threads may be using the stripes with the GIL released, so they
+  // cannot be replaced
+  if (NULL != self->stripes)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "ValidationCache object is already initialized");
+    return -1;
+  }
+  if (aprmd5_cache_object_init_key(self) < 0)
+    return -1;
+
+  // Small caches get fewer stripes, so that every stripe has an entry
+  int stripeCount = APRMD5_CACHE_STRIPECOUNT;
+  while (stripeCount > maxEntries)
+    stripeCount /= 2;
+  self->stripes = PyMem_New(aprmd5_cache_stripe, stripeCount);
+  if (NULL == self->stripes)
+  {
+    PyErr_NoMemory();
+    return -1;
+  }
+  memset(self->stripes, 0, stripeCount * sizeof(aprmd5_cache_stripe));
+  self->stripeCount = stripeCount;
+  self->maxEntries = maxEntries;
+  self->ttl = ttl;
+
+  // The capacity is split exactly: each stripe gets an equal share, and the
+  // first stripes get one more entry each for the remainder
+  int index;
+  for (index = 0; index < stripeCount; ++index)
+  {
+    aprmd5_cache_stripe* stripe = &self->stripes[index];
+    int capacity = (int)(maxEntries / stripeCount) + (index < (int)(maxEntries % stripeCount) ? 1 : 0);
+    int bucketCount = 1;
+    while (bucketCount < capacity)
+      bucketCount *= 2;
+    pthread_mutex_init(&stripe->mutex, NULL);
+    stripe->capacity = capacity;
+    stripe->bucketMask = (apr_uint32_t)bucketCount - 1;
+    stripe->entries = PyMem_New(aprmd5_cache_entry, capacity);
+    stripe->buckets = PyMem_New(int, bucketCount);
+    if (NULL == stripe->entries || NULL == stripe->buckets)
+    {
+      aprmd5_cache_free_stripes(self);
+      PyErr_NoMemory();
+      return -1;
+    }
+    aprmd5_cache_stripe_reset(stripe);
+  }
+  return 0;
+}
+
+static void
+aprmd5_cache_object_dealloc(aprmd5_cache_object* self)
+{
+  aprmd5_cache_free_stripes(self);
+  memset(&self->innerContext, 0, sizeof(self->innerContext));
+  memset(&self->outerContext, 0, sizeof(self->outerContext));
+#if PY_MAJOR_VERSION >= 3
+  PyTypeObject* type = Py_TYPE(self);
+#else   // #if PY_MAJOR_VERSION >= 3
+  PyTypeObject* type = self->ob_type;
+#endif  // #if PY_MAJOR_VERSION >= 3
+  type->tp_free((PyObject*)self);
+  APRMD5_TYPE_DECREF(type);
+}
+
+// Sets a Python exception if the object has not been initialized. Returns 0
+// if the object is usable, otherwise -1.
+static int
+aprmd5_cache_object_check(aprmd5_cache_object* self)
+{
+  if (NULL != self->stripes)
+    return 0;
+  PyErr_SetString(PyExc_RuntimeError, "ValidationCache object has not been initialized");
+  return -1;
+}
+
+
+// ---------------------------------------------------------------------------
+// Implementation of ValidationCache methods
+// ---------------------------------------------------------------------------
+
+static PyObject*
+aprmd5_cache_object_validate(aprmd5_cache_object* self, PyObject* args)
+{
+  const char* password = NULL;
+  const char* hash = NULL;
+  if (! PyArg_ParseTuple(args, "ss:validate", &password, &hash))
+    return NULL;
+  if (aprmd5_cache_object_check(self) < 0)
+    return NULL;
+
+  apr_status_t status;
+  Py_BEGIN_ALLOW_THREADS
+  unsigned char key[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_cache_compute_key(self, password, hash, key);
+  aprmd5_cache_stripe* stripe = aprmd5_cache_stripe_for_key(self, key);
+  apr_int64_t now = aprmd5_cache_now();
+  if (aprmd5_cache_lookup(stripe, key, now))
+  {
+    status = APR_SUCCESS;
+  }
+  else
+  {
+    status = aprmd5_passwd_validate(password, hash);
+    if (APR_SUCCESS == status)
+    {
+      apr_int64_t expires = APRMD5_CACHE_NEVER;
+      if (APRMD5_CACHE_NEVER != self->ttl)
+        expires = now + self->ttl;
+      aprmd5_cache_insert(stripe, key, expires);
+    }
+  }
+  memset(key, 0, sizeof(key));
+  Py_END_ALLOW_THREADS
+
+  return PyBool_FromLong(APR_SUCCESS == status);
+}
+
+static PyObject*
+aprmd5_cache_object_clear(aprmd5_cache_object* self, PyObject* args)
+{
+  if (aprmd5_cache_object_check(self) < 0)
+    return NULL;
+  int index;
+  for (index = 0; index < self->stripeCount; ++index)
+  {
+    aprmd5_cache_stripe* stripe = &self->stripes[index];
+    pthread_mutex_lock(&stripe->mutex);
+    aprmd5_cache_stripe_reset(stripe);
+    pthread_mutex_unlock(&stripe->mutex);
+  }
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject*
+aprmd5_cache_object_stats(aprmd5_cache_object* self, PyObject* args)
+{
+  if (aprmd5_cache_object_check(self) < 0)
+    return NULL;
+  apr_uint64_t hits = 0;
+  apr_uint64_t misses = 0;
+  apr_uint64_t evictions = 0;
+  apr_uint64_t expirations = 0;
+  Py_ssize_t entries = 0;
+  int index;
+  for (index = 0; index < self->stripeCount; ++index)
+  {
+    aprmd5_cache_stripe* stripe = &self->stripes[index];
+    pthread_mutex_lock(&stripe->mutex);
+    hits += stripe->hits;
+    misses += stripe->misses;
+    evictions += stripe->evictions;
+    expirations += stripe->expirations;
+    entries += stripe->count;
+    pthread_mutex_unlock(&stripe->mutex);
+  }
+  return Py_BuildValue("{s:K,s:K,s:K,s:K,s:n,s:n}",
+                       "hits", (unsigned long long)hits,
+                       "misses", (unsigned long long)misses,
+                       "evictions", (unsigned long long)evictions,
+                       "expirations", (unsigned long long)expirations,
+                       "entries", entries,
+                       "max_entries", self->maxEntries);
+}
+
+
+// ---------------------------------------------------------------------------
+// Implementation of ValidationCache attribute getters/setters
+// ---------------------------------------------------------------------------
+
+static PyObject *
+aprmd5_cache_object_get_max_entries(aprmd5_cache_object* self, void* closure)
+{
+  if (aprmd5_cache_object_check(self) < 0)
+    return NULL;
+  return PyLong_FromSsize_t(self->maxEntries);
+}
+
+static PyObject *
+aprmd5_cache_object_get_ttl(aprmd5_cache_object* self, void* closure)
+{
+  if (aprmd5_cache_object_check(self) < 0)
+    return NULL;
+  if (APRMD5_CACHE_NEVER == self->ttl)
+  {
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  return PyFloat_FromDouble((double)self->ttl / 1e9);
+}
+
+
+// ---------------------------------------------------------------------------
+// Attributes and methods of ValidationCache
+// ---------------------------------------------------------------------------
+
+static PyMemberDef aprmd5_cache_object_members[] =
+{
+  {NULL}  // Sentinel
+};
+
+static PyGetSetDef aprmd5_cache_object_getseters[] =
+{
+  {
+    "max_entries",
+    (getter)aprmd5_cache_object_get_max_entries, NULL,
+    "The maximum number of validated pairs that the cache holds.",
+    NULL
+  },
+  {
+    "ttl",
+    (getter)aprmd5_cache_object_get_ttl, NULL,
+    "The number of seconds for which a validated pair is remembered, or None if pairs never expire.",
+    NULL
+  },
+  {NULL}  /* Sentinel */
+};
+
+static PyMethodDef aprmd5_cache_object_methods[] =
+{
+  {
+    "validate", (PyCFunction)aprmd5_cache_object_validate, METH_VARARGS,
+    "Validate a password like password_validate() does. If the (password, hash) pair has been validated successfully within the last ttl seconds, the result is taken from the cache. Successful validations are added to the cache; failed validations are never cached. The GIL is released during the lookup and during validation."
+  },
+  {
+    "clear", (PyCFunction)aprmd5_cache_object_clear, METH_NOARGS,
+    "Remove all entries from the cache. The counters are not reset."
+  },
+  {
+    "stats", (PyCFunction)aprmd5_cache_object_stats, METH_NOARGS,
+    "Return a dictionary with the counters hits, misses, evictions and expirations, the current number of entries, and max_entries."
+  },
+  {NULL}  // Sentinel
+};
+
+// ---------------------------------------------------------------------------
+// Definition of the Python type
+// ---------------------------------------------------------------------------
+
+#if PY_MAJOR_VERSION >= 3
+
+static PyType_Slot aprmd5_cache_type_slots[] =
+{
+  {Py_tp_dealloc, (void*)aprmd5_cache_object_dealloc},
+  {Py_tp_doc, "Instances of this class cache successful password validations"},
+  {Py_tp_methods, aprmd5_cache_object_methods},
+  {Py_tp_members, aprmd5_cache_object_members},
+  {Py_tp_getset, aprmd5_cache_object_getseters},
+  {Py_tp_init, (void*)aprmd5_cache_object_init},
+  {Py_tp_new, (void*)aprmd5_cache_object_new},
+  {0, NULL}
+};
+
+static PyType_Spec aprmd5_cache_type_spec =
+{
+  "aprmd5.ValidationCache",
+  sizeof(aprmd5_cache_object),
+  0,
+  APRMD5_TPFLAGS_DEFAULT,
+  aprmd5_cache_type_slots
+};
+
+#else   // #if PY_MAJOR_VERSION >= 3
+
+static PyTypeObject aprmd5_cache_type =
+{
+  PyObject_HEAD_INIT(NULL)
+  0,                             // ob_size
+  "aprmd5.ValidationCache",      // tp_name
+  sizeof(aprmd5_cache_object),   // tp_basicsize
+  0,                             // tp_itemsize
+  (destructor)
+    aprmd5_cache_object_dealloc, // tp_dealloc
+  0,                             // tp_print
+  0,                             // tp_getattr
+  0,                             // tp_setattr
+  0,                             // tp_compare
+  0,                             // tp_repr
+  0,                             // tp_as_number
+  0,                             // tp_as_sequence
+  0,                             // tp_as_mapping
+  0,                             // tp_hash
+  0,                             // tp_call
+  0,                             // tp_str
+  0,                             // tp_getattro
+  0,                             // tp_setattro
+  0,                             // tp_as_buffer
+  Py_TPFLAGS_DEFAULT,            // tp_flags; Py_TPFLAGS_DEFAULT enables all
+                                 // members defined by the version of Python
+                                 // that this is compiled for
+  "Instances of this class cache successful password validations", // tp_doc
+  0,                             // tp_traverse
+  0,                             // tp_clear
+  0,                             // tp_richcompare
+  0,                             // tp_weaklistoffset
+  0,                             // tp_iter
+  0,                             // tp_iternext
+  aprmd5_cache_object_methods,   // tp_methods
+  aprmd5_cache_object_members,   // tp_members
+  aprmd5_cache_object_getseters, // tp_getset
+  0,                             // tp_base
+  0,                             // tp_dict
+  0,                             // tp_descr_get
+  0,                             // tp_descr_set
+  0,                             // tp_dictoffset
+  (initproc)
+    aprmd5_cache_object_init,    // tp_init
+  0,                             // tp_alloc
+  aprmd5_cache_object_new,       // tp_new
+};
+
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+
+// Creates the type of a module. Returns a new reference, or NULL with a Python
+// exception set.
+PyObject*
+aprmd5_cache_type_create(PyObject* module)
+{
+#if PY_MAJOR_VERSION >= 3
+  return aprmd5_helper_type_from_spec(module, &aprmd5_cache_type_spec);
+#else   // #if PY_MAJOR_VERSION >= 3
+  if (PyType_Ready(&aprmd5_cache_type) < 0)
+    return NULL;
+  Py_INCREF(&aprmd5_cache_type);
+  return (PyObject*)&aprmd5_cache_type;
+#endif  // #if PY_MAJOR_VERSION >= 3
+}
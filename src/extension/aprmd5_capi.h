@@ -0,0 +1,146 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the C API of the aprmd5 module. It is the only header
+// that is installed, so that other native extensions can hash without going
+// through the Python layer.
+//
+// Usage: Include Python.h, then this file. Call aprmd5_capi_import() once,
+// e.g. in the initialization function of the extension, and keep the
+// returned pointer; it stays valid while the aprmd5 module is loaded.
+//
+//   const aprmd5_capi* api = aprmd5_capi_import();
+//   if (NULL == api)
+//     return NULL;   // ImportError is set
+//   unsigned char digest[APRMD5_CAPI_DIGESTSIZE];
+//   api->md5(digest, data, dataLen);
+//
+// None of the functions touches Python objects, so all of them may be called
+// with the GIL released, and concurrently from several threads. Calls through
+// the C API are not counted in the statistics of aprmd5.stats().
+//
+// Versioning: The function table only ever grows at its end. An extension that
+// is compiled against version N works with every aprmd5 module that provides
+// version N or later; aprmd5_capi_import() checks this.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_CAPI_H
+#define APRMD5_CAPI_H
+
+// System includes
+#include <stddef.h>   // for size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// The name of the capsule, i.e. the attribute _C_API of the module aprmd5
+#define APRMD5_CAPI_NAME          "aprmd5._C_API"
+
+// The version of the function table that this header declares
+#define APRMD5_CAPI_VERSION       1
+
+// The size of an MD5 digest in bytes
+#define APRMD5_CAPI_DIGESTSIZE    16
+
+// The size of the buffer that receives an apr1 hash, including the terminating
+// null byte
+#define APRMD5_CAPI_APR1_HASHSIZE 38
+
+// The state of an incremental MD5 computation. The content is private; the
+// size is large enough for the context of every version of the module. A
+// context may be copied with memcpy() to fork a computation.
+typedef union
+{
+  unsigned char opaque[128];
+  void* alignPointer;
+  unsigned long long alignInteger;
+} aprmd5_capi_md5_context;
+
+typedef struct
+{
+  // The version of the table, APRMD5_CAPI_VERSION or later
+  int version;
+
+  // Incremental MD5, like the methods of aprmd5.md5. md5_final() leaves the
+  // context in an undefined state; call md5_init() to reuse it.
+  void (*md5_init)(aprmd5_capi_md5_context* context);
+  void (*md5_update)(aprmd5_capi_md5_context* context, const void* input, size_t inputLen);
+  void (*md5_final)(unsigned char digest[APRMD5_CAPI_DIGESTSIZE], aprmd5_capi_md5_context* context);
+
+  // The MD5 digest of a single buffer, like aprmd5.md5_digest()
+  void (*md5)(unsigned char digest[APRMD5_CAPI_DIGESTSIZE], const void* input, size_t inputLen);
+
+  // Like aprmd5.md5_encode(). Writes the null-terminated hash to result.
+  // Returns 0 on success, or -1 if the hash could not be generated.
+  int (*apr1_encode)(const char* password, const char* salt, char result[APRMD5_CAPI_APR1_HASHSIZE]);
+
+  // Like aprmd5.password_validate(). Returns 1 if the password matches the
+  // hash, otherwise 0.
+  int (*password_validate)(const char* password, const char* hash);
+
+  // Like aprmd5.md5_many(): the digests of count buffers, written to digests
+  // (APRMD5_CAPI_DIGESTSIZE bytes per buffer) in input order. threadCount is
+  // the maximum number of native threads to use; 0 means one per CPU core.
+  // Returns 0 on success, or -1 if memory could not be allocated.
+  int (*md5_many)(const void* const* inputs, const size_t* inputLens, size_t count,
+                  unsigned char* digests, int threadCount);
+
+  // Like aprmd5.md5_encode_many(): writes the hash of each pair to results
+  // (APRMD5_CAPI_APR1_HASHSIZE bytes per pair) in input order. Returns 0 on
+  // success, or -1 if memory could not be allocated or a hash could not be
+  // generated.
+  int (*apr1_encode_many)(const char* const* passwords, const char* const* salts, size_t count,
+                          char* results, int threadCount);
+
+  // Like aprmd5.password_validate_many(): sets valid[i] to 1 if password i
+  // matches hash i, otherwise to 0. Returns 0 on success, or -1 if memory
+  // could not be allocated.
+  int (*password_validate_many)(const char* const* passwords, const char* const* hashes, size_t count,
+                                unsigned char* valid, int threadCount);
+} aprmd5_capi;
+
+
+// Imports the aprmd5 module and returns its function table. Returns NULL with
+// a Python exception set if the module cannot be imported, or if it provides
+// an older version of the table than this header declares. Must be called
+// with the GIL held.
+static inline const aprmd5_capi*
+aprmd5_capi_import(void)
+{
+  const aprmd5_capi* api = (const aprmd5_capi*)PyCapsule_Import(APRMD5_CAPI_NAME, 0);
+  if (NULL != api && api->version < APRMD5_CAPI_VERSION)
+  {
+    PyErr_Format(PyExc_ImportError, "aprmd5 provides C API version %d, but version %d is required",
+                 api->version, APRMD5_CAPI_VERSION);
+    return NULL;
+  }
+  return api;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef APRMD5_CAPI_H
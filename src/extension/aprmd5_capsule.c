@@ -0,0 +1,210 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the C API that other native extensions import through
+// the capsule aprmd5._C_API. The functions are thin adapters around the
+// engines that the Python functions use; they neither take nor return Python
+// objects, and they never need the GIL.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_capi.h"
+#include "aprmd5_capsule.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_apr1.h"
+#include "aprmd5_passwd.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_multibuf.h"
+#include "aprmd5_wrappers.h"
+
+// System includes
+#include <stdlib.h>   // for calloc(), free()
+#include <string.h>   // for memcpy(), strlen()
+
+
+// The public context must be able to hold the internal one. The array size is
+// negative, and compilation fails, if it cannot.
+typedef char aprmd5_capsule_context_fits[(sizeof(apr_md5_ctx_t) <= sizeof(aprmd5_capi_md5_context)) ? 1 : -1];
+
+
+// ---------------------------------------------------------------------------
+// Single operations
+// ---------------------------------------------------------------------------
+
+static void
+aprmd5_capsule_md5_init(aprmd5_capi_md5_context* context)
+{
+  aprmd5_md5block_ctx_init((apr_md5_ctx_t*)context);
+}
+
+static void
+aprmd5_capsule_md5_update(aprmd5_capi_md5_context* context, const void* input, size_t inputLen)
+{
+  // Split the input like aprmd5_helper_md5_update() does, but without the
+  // detour through Py_ssize_t
+  const unsigned char* chunk = (const unsigned char*)input;
+  while (inputLen > 0)
+  {
+    apr_size_t chunkLen = APRMD5_MD5_MAXCHUNKSIZE;
+    if ((size_t)chunkLen > inputLen)
+      chunkLen = (apr_size_t)inputLen;
+    aprmd5_backend_selected->update((apr_md5_ctx_t*)context, chunk, chunkLen);
+    chunk += chunkLen;
+    inputLen -= (size_t)chunkLen;
+  }
+}
+
+static void
+aprmd5_capsule_md5_final(unsigned char digest[APRMD5_CAPI_DIGESTSIZE], aprmd5_capi_md5_context* context)
+{
+  aprmd5_backend_selected->final(digest, (apr_md5_ctx_t*)context);
+}
+
+static void
+aprmd5_capsule_md5(unsigned char digest[APRMD5_CAPI_DIGESTSIZE], const void* input, size_t inputLen)
+{
+  aprmd5_capi_md5_context context;
+  aprmd5_capsule_md5_init(&context);
+  aprmd5_capsule_md5_update(&context, input, inputLen);
+  aprmd5_capsule_md5_final(digest, &context);
+}
+
+static int
+aprmd5_capsule_apr1_encode(const char* password, const char* salt, char result[APRMD5_CAPI_APR1_HASHSIZE])
+{
+  // apr_md5_encode() wants one byte more than it writes (see
+  // aprmd5_md5_encode()), which the caller's buffer might not have
+  char buffer[APRMD5_APR1_HASHSIZE + 1];
+  if (APR_SUCCESS != aprmd5_backend_selected->apr1_encode(password, salt, buffer, sizeof(buffer)))
+    return -1;
+  memcpy(result, buffer, strlen(buffer) + 1);
+  return 0;
+}
+
+static int
+aprmd5_capsule_password_validate(const char* password, const char* hash)
+{
+  return APR_SUCCESS == aprmd5_passwd_validate(password, hash);
+}
+
+
+// ---------------------------------------------------------------------------
+// Batch operations. Memory is allocated with calloc() because the GIL may not
+// be held.
+// ---------------------------------------------------------------------------
+
+static int
+aprmd5_capsule_md5_many(const void* const* inputs, const size_t* inputLens, size_t count,
+                        unsigned char* digests, int threadCount)
+{
+  aprmd5_multibuf_job* jobs = (aprmd5_multibuf_job*)calloc(count + 1, sizeof(aprmd5_multibuf_job));
+  if (NULL == jobs)
+    return -1;
+  size_t index;
+  for (index = 0; index < count; ++index)
+  {
+    jobs[index].data = (const unsigned char*)inputs[index];
+    jobs[index].len = (Py_ssize_t)inputLens[index];
+    jobs[index].digest = digests + index * APRMD5_CAPI_DIGESTSIZE;
+  }
+  aprmd5_multibuf_md5_parallel(threadCount, jobs, (Py_ssize_t)count);
+  free(jobs);
+  return 0;
+}
+
+static int
+aprmd5_capsule_apr1_encode_many(const char* const* passwords, const char* const* salts, size_t count,
+                                char* results, int threadCount)
+{
+  apr_status_t* statuses = (apr_status_t*)calloc(count + 1, sizeof(apr_status_t));
+  if (NULL == statuses)
+    return -1;
+  aprmd5_md5_encode_batch(threadCount, (const char**)passwords, (const char**)salts,
+                          (Py_ssize_t)count, results, statuses);
+  int result = 0;
+  size_t index;
+  for (index = 0; index < count; ++index)
+  {
+    if (APR_SUCCESS != statuses[index])
+      result = -1;
+  }
+  free(statuses);
+  return result;
+}
+
+static int
+aprmd5_capsule_password_validate_many(const char* const* passwords, const char* const* hashes, size_t count,
+                                      unsigned char* valid, int threadCount)
+{
+  apr_status_t* statuses = (apr_status_t*)calloc(count + 1, sizeof(apr_status_t));
+  if (NULL == statuses)
+    return -1;
+  aprmd5_password_validate_batch(threadCount, (const char**)passwords, (const char**)hashes,
+                                 (Py_ssize_t)count, statuses);
+  size_t index;
+  for (index = 0; index < count; ++index)
+    valid[index] = (APR_SUCCESS == statuses[index]);
+  free(statuses);
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// The function table and the capsule
+// ---------------------------------------------------------------------------
+
+static const aprmd5_capi aprmd5_capsule_table =
+{
+  APRMD5_CAPI_VERSION,
+  aprmd5_capsule_md5_init,
+  aprmd5_capsule_md5_update,
+  aprmd5_capsule_md5_final,
+  aprmd5_capsule_md5,
+  aprmd5_capsule_apr1_encode,
+  aprmd5_capsule_password_validate,
+  aprmd5_capsule_md5_many,
+  aprmd5_capsule_apr1_encode_many,
+  aprmd5_capsule_password_validate_many,
+};
+
+
+// ---------------------------------------------------------------------------
+// Adds the capsule with the function table to a module as attribute _C_API.
+// Returns 0 on success, or -1 with a Python exception set.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int
+aprmd5_capsule_add(PyObject* module)
+{
+  PyObject* capsule = PyCapsule_New((void*)&aprmd5_capsule_table, APRMD5_CAPI_NAME, NULL);
+  if (NULL == capsule)
+    return -1;
+  if (PyModule_AddObject(module, "_C_API", capsule) < 0)
+  {
+    Py_DECREF(capsule);
+    return -1;
+  }
+  return 0;
+}
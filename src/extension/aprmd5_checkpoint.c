@@ -0,0 +1,520 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the incremental hashing of append-only files.
+//
+// md5_rehash() keeps a small index file next to the hashed file. The index
+// stores the MD5 context after every interval bytes of the file, i.e. a
+// checkpoint, in the format of md5.export_state(). Because the interval is a
+// multiple of the block size, the contexts never hold pending input. A later
+// call resumes from the last checkpoint that is still valid and only hashes
+// the bytes after it, so re-hashing a log that grew by a few MiB costs a few
+// MiB of I/O, no matter how large the log is.
+//
+// A checkpoint is valid if the file still reaches the checkpoint, and if the
+// MD5 digest of the bytes just before the checkpoint, which the index also
+// stores, still matches the file. This detects a file that was truncated or
+// replaced, but not a change further before the checkpoint; the function is
+// meant for files that are only ever appended to.
+//
+// The index has this layout; all integers are little endian:
+//   4 bytes   magic "AMDX"
+//   1 byte    format version
+//   3 bytes   reserved, 0
+//   8 bytes   the interval in bytes
+//   8 bytes   the number of checkpoints n
+//   n times:
+//     29 bytes  the exported MD5 context at offset (i + 1) * interval
+//     16 bytes  the MD5 digest of the probe bytes before that offset
+//   16 bytes  the MD5 digest of everything above
+//
+// An index that is missing, damaged or written for a different interval is
+// silently rebuilt. The new index is written to a temporary file with a unique
+// name next to it that is then renamed, so a crash never leaves a
+// half-written index behind.
+//
+// All I/O and hashing is done with the GIL released.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_checkpoint.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_fileio.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_md5type.h"
+
+// System includes
+#include <errno.h>
+#include <stdlib.h>   // for malloc(), realloc(), free()
+#include <string.h>   // for memcmp(), memcpy()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for pread(), write(), close()
+
+#define APRMD5_CHECKPOINT_MAGIC "AMDX"
+#define APRMD5_CHECKPOINT_VERSION 1
+#define APRMD5_CHECKPOINT_HEADERSIZE (4 + 1 + 3 + 8 + 8)
+#define APRMD5_CHECKPOINT_ENTRYSIZE (APRMD5_MD5_STATEHEADERSIZE + APRMD5_MD5_DIGESTSIZE)
+#define APRMD5_CHECKPOINT_TRAILERSIZE APRMD5_MD5_DIGESTSIZE
+
+// The default distance between two checkpoints
+#define APRMD5_CHECKPOINT_DEFAULTINTERVAL ((apr_int64_t)64 * 1024 * 1024)
+
+// The number of bytes before a checkpoint that are hashed to verify that the
+// file has not changed. Smaller intervals use the whole interval.
+#define APRMD5_CHECKPOINT_PROBESIZE 4096
+
+
+// ---------------------------------------------------------------------------
+// The checkpoints of a file, as they are held in memory
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  apr_int64_t interval;
+  apr_int64_t count;
+  apr_int64_t capacity;
+  unsigned char* entries;   // APRMD5_CHECKPOINT_ENTRYSIZE bytes per checkpoint
+  int dirty;                // non-zero if the index file must be written
+} aprmd5_checkpoint_index;
+
+
+// ---------------------------------------------------------------------------
+// Helpers for the index format
+// ---------------------------------------------------------------------------
+
+static void
+aprmd5_checkpoint_put_uint64(unsigned char* output, apr_uint64_t value)
+{
+  aprmd5_helper_put_uint32(output, (apr_uint32_t)value);
+  aprmd5_helper_put_uint32(output + 4, (apr_uint32_t)(value >> 32));
+}
+
+static apr_uint64_t
+aprmd5_checkpoint_get_uint64(const unsigned char* input)
+{
+  return (apr_uint64_t)aprmd5_helper_get_uint32(input)
+    | ((apr_uint64_t)aprmd5_helper_get_uint32(input + 4) << 32);
+}
+
+static void
+aprmd5_checkpoint_md5(unsigned char digest[APRMD5_MD5_DIGESTSIZE], const unsigned char* input, Py_ssize_t inputLen)
+{
+  apr_md5_ctx_t context;
+  aprmd5_md5block_ctx_init(&context);
+  aprmd5_helper_md5_update(&context, input, inputLen);
+  aprmd5_backend_selected->final(digest, &context);
+}
+
+// Reads exactly length bytes at offset. Returns 0 on success, EIO if the
+// file ends early, or another errno value.
+static int
+aprmd5_checkpoint_read(int fd, unsigned char* buffer, apr_int64_t length, off_t offset)
+{
+  while (length > 0)
+  {
+    ssize_t bytesRead = pread(fd, buffer, (size_t)length, offset);
+    if (bytesRead < 0)
+    {
+      if (EINTR == errno)
+        continue;
+      return errno;
+    }
+    if (0 == bytesRead)
+      return EIO;
+    buffer += bytesRead;
+    offset += (off_t)bytesRead;
+    length -= bytesRead;
+  }
+  return 0;
+}
+
+static int
+aprmd5_checkpoint_write(int fd, const unsigned char* buffer, apr_int64_t length)
+{
+  while (length > 0)
+  {
+    ssize_t bytesWritten = write(fd, buffer, (size_t)length);
+    if (bytesWritten < 0)
+    {
+      if (EINTR == errno)
+        continue;
+      return errno;
+    }
+    buffer += bytesWritten;
+    length -= bytesWritten;
+  }
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Loads the checkpoints from an index file. requestedInterval is the interval
+// that the caller asked for, or 0 to use the interval of the index.
+//
+// Returns 0 on success, or an errno value if the index exists but cannot be
+// read. An index that does not exist or that is damaged leaves no
+// checkpoints, and marks the index as dirty.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_checkpoint_load(const char* indexPath, apr_int64_t requestedInterval, aprmd5_checkpoint_index* index)
+{
+  index->interval = requestedInterval > 0 ? requestedInterval : APRMD5_CHECKPOINT_DEFAULTINTERVAL;
+  index->count = 0;
+  index->capacity = 0;
+  index->entries = NULL;
+  index->dirty = 1;
+
+  int fd = aprmd5_fileio_open(indexPath);
+  if (fd < 0)
+    return ENOENT == errno ? 0 : errno;
+
+  int result = 0;
+  unsigned char* content = NULL;
+  struct stat status;
+  if (0 != fstat(fd, &status))
+  {
+    result = errno;
+    goto done;
+  }
+  // The size of the file already tells whether the header can be right
+  apr_int64_t contentLen = (apr_int64_t)status.st_size;
+  apr_int64_t entriesLen = contentLen - APRMD5_CHECKPOINT_HEADERSIZE - APRMD5_CHECKPOINT_TRAILERSIZE;
+  if (entriesLen < 0 || 0 != entriesLen % APRMD5_CHECKPOINT_ENTRYSIZE || (apr_uint64_t)contentLen > PY_SSIZE_T_MAX)
+    goto done;
+  content = (unsigned char*)malloc((size_t)contentLen);
+  if (NULL == content)
+  {
+    result = ENOMEM;
+    goto done;
+  }
+  result = aprmd5_checkpoint_read(fd, content, contentLen, 0);
+  if (EIO == result)
+  {
+    // The index shrank while we read it
+    result = 0;
+    goto done;
+  }
+  if (0 != result)
+    goto done;
+
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_checkpoint_md5(digest, content, (Py_ssize_t)(contentLen - APRMD5_CHECKPOINT_TRAILERSIZE));
+  if (0 != memcmp(digest, content + contentLen - APRMD5_CHECKPOINT_TRAILERSIZE, APRMD5_MD5_DIGESTSIZE)
+      || 0 != memcmp(content, APRMD5_CHECKPOINT_MAGIC, 4)
+      || APRMD5_CHECKPOINT_VERSION != content[4])
+    goto done;
+  apr_uint64_t interval = aprmd5_checkpoint_get_uint64(content + 8);
+  apr_uint64_t count = aprmd5_checkpoint_get_uint64(content + 16);
+  if (0 == interval || 0 != interval % APRMD5_MD5_BLOCKSIZE || interval > (apr_uint64_t)PY_SSIZE_T_MAX
+      || count != (apr_uint64_t)(entriesLen / APRMD5_CHECKPOINT_ENTRYSIZE))
+    goto done;
+  if (requestedInterval > 0 && (apr_uint64_t)requestedInterval != interval)
+    goto done;
+
+  // Keep the buffer and move the entries to its start
+  memmove(content, content + APRMD5_CHECKPOINT_HEADERSIZE, (size_t)entriesLen);
+  index->interval = (apr_int64_t)interval;
+  index->count = (apr_int64_t)count;
+  index->capacity = (apr_int64_t)count;
+  index->entries = content;
+  index->dirty = 0;
+  content = NULL;
+
+done:
+  free(content);
+  close(fd);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Writes the checkpoints to an index file. Returns 0 on success, or an errno
+// value.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_checkpoint_save(const char* indexPath, const aprmd5_checkpoint_index* index)
+{
+  apr_int64_t entriesLen = index->count * APRMD5_CHECKPOINT_ENTRYSIZE;
+  apr_int64_t contentLen = APRMD5_CHECKPOINT_HEADERSIZE + entriesLen + APRMD5_CHECKPOINT_TRAILERSIZE;
+  unsigned char* content = (unsigned char*)malloc((size_t)contentLen);
+  char* tmpPath = NULL;
+  int result = 0;
+  if (NULL == content)
+  {
+    result = ENOMEM;
+    goto done;
+  }
+  memcpy(content, APRMD5_CHECKPOINT_MAGIC, 4);
+  content[4] = APRMD5_CHECKPOINT_VERSION;
+  content[5] = content[6] = content[7] = 0;
+  aprmd5_checkpoint_put_uint64(content + 8, (apr_uint64_t)index->interval);
+  aprmd5_checkpoint_put_uint64(content + 16, (apr_uint64_t)index->count);
+  if (entriesLen > 0)
+    memcpy(content + APRMD5_CHECKPOINT_HEADERSIZE, index->entries, (size_t)entriesLen);
+  aprmd5_checkpoint_md5(content + contentLen - APRMD5_CHECKPOINT_TRAILERSIZE, content,
+                        (Py_ssize_t)(contentLen - APRMD5_CHECKPOINT_TRAILERSIZE));
+
+  int fd = aprmd5_helper_tmpfile_create(indexPath, &tmpPath);
+  if (fd < 0)
+  {
+    result = errno;
+    goto done;
+  }
+  result = aprmd5_checkpoint_write(fd, content, contentLen);
+  if (0 != result)
+    aprmd5_helper_tmpfile_discard(fd, tmpPath);
+  else
+    result = aprmd5_helper_tmpfile_commit(fd, tmpPath, indexPath);
+
+done:
+  free(content);
+  free(tmpPath);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Computes the probe digest of the checkpoint at offset. Returns 0 on
+// success, EIO if the file does not reach offset, or another errno value.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_checkpoint_probe(int fd, apr_int64_t offset, apr_int64_t interval, unsigned char digest[APRMD5_MD5_DIGESTSIZE])
+{
+  apr_int64_t probeLen = interval < APRMD5_CHECKPOINT_PROBESIZE ? interval : APRMD5_CHECKPOINT_PROBESIZE;
+  apr_md5_ctx_t context;
+  apr_int64_t bytesHashed = 0;
+  aprmd5_md5block_ctx_init(&context);
+  int result = aprmd5_fileio_md5_update(&context, fd, (off_t)(offset - probeLen), probeLen, &bytesHashed);
+  aprmd5_backend_selected->final(digest, &context);
+  if (0 == result && bytesHashed != probeLen)
+    result = EIO;
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Hashes a file, resuming from the last valid checkpoint of the index, and
+// adds a checkpoint for each interval that is hashed completely.
+//
+// Returns 0 on success, or an errno value. If the error concerns the index,
+// *indexFailed is set to 1.
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_checkpoint_rehash(const char* path, const char* indexPath, apr_int64_t requestedInterval,
+                         unsigned char digest[APRMD5_MD5_DIGESTSIZE], int* indexFailed)
+{
+  aprmd5_checkpoint_index index;
+  int result = aprmd5_checkpoint_load(indexPath, requestedInterval, &index);
+  if (0 != result)
+  {
+    *indexFailed = 1;
+    return result;
+  }
+  int fd = aprmd5_fileio_open(path);
+  if (fd < 0)
+  {
+    result = errno;
+    goto done;
+  }
+  struct stat status;
+  if (0 != fstat(fd, &status))
+  {
+    result = errno;
+    goto done;
+  }
+  apr_int64_t fileSize = (apr_int64_t)status.st_size;
+
+  // Find the last checkpoint that is still valid. Its context must have
+  // hashed exactly the bytes up to the checkpoint; anything else means that
+  // the index does not belong to this file.
+  apr_md5_ctx_t context;
+  aprmd5_md5block_ctx_init(&context);
+  apr_int64_t validCount = index.count;
+  for (; validCount > 0; --validCount)
+  {
+    const unsigned char* entry = index.entries + (validCount - 1) * APRMD5_CHECKPOINT_ENTRYSIZE;
+    apr_int64_t offset = validCount * index.interval;
+    if (offset > fileSize)
+      continue;
+    apr_md5_ctx_t checkpoint;
+    if (APRMD5_MD5_STATE_OK != aprmd5_md5_state_import(&checkpoint, entry, APRMD5_MD5_STATEHEADERSIZE))
+      continue;
+    apr_uint64_t bitCount = (apr_uint64_t)checkpoint.count[0] | ((apr_uint64_t)checkpoint.count[1] << 32);
+    if (bitCount != (apr_uint64_t)offset * 8)
+      continue;
+    unsigned char probe[APRMD5_MD5_DIGESTSIZE];
+    result = aprmd5_checkpoint_probe(fd, offset, index.interval, probe);
+    if (EIO == result)
+    {
+      result = 0;
+      continue;
+    }
+    if (0 != result)
+      goto done;
+    if (0 == memcmp(probe, entry + APRMD5_MD5_STATEHEADERSIZE, APRMD5_MD5_DIGESTSIZE))
+    {
+      context = checkpoint;
+      break;
+    }
+  }
+  if (validCount != index.count)
+  {
+    index.count = validCount;
+    index.dirty = 1;
+  }
+
+  // Hash the rest of the file one interval at a time
+  apr_int64_t position = validCount * index.interval;
+  for (;;)
+  {
+    apr_int64_t bytesHashed = 0;
+    result = aprmd5_fileio_md5_update(&context, fd, (off_t)position, index.interval, &bytesHashed);
+    if (0 != result)
+      goto done;
+    position += bytesHashed;
+    if (bytesHashed < index.interval)
+      break;
+
+    if (index.count == index.capacity)
+    {
+      apr_int64_t capacity = index.capacity > 0 ? 2 * index.capacity : 16;
+      unsigned char* entries = (unsigned char*)realloc(index.entries, (size_t)(capacity * APRMD5_CHECKPOINT_ENTRYSIZE));
+      if (NULL == entries)
+      {
+        result = ENOMEM;
+        goto done;
+      }
+      index.entries = entries;
+      index.capacity = capacity;
+    }
+    unsigned char* entry = index.entries + index.count * APRMD5_CHECKPOINT_ENTRYSIZE;
+    aprmd5_md5_state_export(&context, entry);
+    result = aprmd5_checkpoint_probe(fd, position, index.interval, entry + APRMD5_MD5_STATEHEADERSIZE);
+    if (0 != result)
+      goto done;
+    ++index.count;
+    index.dirty = 1;
+  }
+  aprmd5_backend_selected->final(digest, &context);
+
+  if (index.dirty)
+  {
+    result = aprmd5_checkpoint_save(indexPath, &index);
+    if (0 != result)
+      *indexFailed = 1;
+  }
+
+done:
+  if (fd >= 0)
+    close(fd);
+  free(index.entries);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// This function hashes a file that is only ever appended to, resuming from
+// the checkpoints of an earlier call. From within Python, this function will
+// be available as
+//
+//   aprmd5.md5_rehash()
+//
+// The file is read and hashed with the GIL released.
+//
+// Parameters of the Python function:
+// - path: The path of the file to hash; a string, a bytes object or an
+//   os.PathLike object
+// - index: The path of the index file that holds the checkpoints. The index
+//   is created if it does not exist, and updated if checkpoints were added
+//   or dropped.
+// - interval: optional keyword argument that specifies the distance between
+//   two checkpoints in bytes; must be a positive multiple of 64. The default
+//   (None) is to use the interval of an existing index, or 64 MiB for a new
+//   index. An index with a different interval is rebuilt.
+//
+// Return value of the Python function:
+// - A bytes object that contains the MD5 digest of the file content, the
+//   same as md5_file(path)
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_rehash(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"path", "index", "interval", NULL};
+  PyObject* intervalObject = Py_None;
+#if PY_MAJOR_VERSION >= 3
+  PyObject* pathObject = NULL;
+  PyObject* indexPathObject = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|$O:md5_rehash", kwlist,
+                                    PyUnicode_FSConverter, &pathObject,
+                                    PyUnicode_FSConverter, &indexPathObject, &intervalObject))
+    return NULL;
+  const char* path = PyBytes_AS_STRING(pathObject);
+  const char* indexPath = PyBytes_AS_STRING(indexPathObject);
+#else   // #if PY_MAJOR_VERSION >= 3
+  const char* path = NULL;
+  const char* indexPath = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "ss|O:md5_rehash", kwlist,
+                                    &path, &indexPath, &intervalObject))
+    return NULL;
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+  PyObject* result = NULL;
+  apr_int64_t interval = 0;
+  if (Py_None != intervalObject)
+  {
+    Py_ssize_t value = PyNumber_AsSsize_t(intervalObject, PyExc_OverflowError);
+    if (-1 == value && PyErr_Occurred())
+      goto done;
+    if (value <= 0 || 0 != value % APRMD5_MD5_BLOCKSIZE)
+    {
+      PyErr_Format(PyExc_ValueError, "interval must be a positive multiple of %d", APRMD5_MD5_BLOCKSIZE);
+      goto done;
+    }
+    interval = value;
+  }
+
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  int indexFailed = 0;
+  int error;
+  Py_BEGIN_ALLOW_THREADS
+  error = aprmd5_checkpoint_rehash(path, indexPath, interval, digest, &indexFailed);
+  Py_END_ALLOW_THREADS
+
+  if (0 != error)
+  {
+    errno = error;
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, indexFailed ? indexPath : path);
+    goto done;
+  }
+  result = PyBytes_FromStringAndSize((const char*)digest, APRMD5_MD5_DIGESTSIZE);
+
+done:
+#if PY_MAJOR_VERSION >= 3
+  Py_DECREF(pathObject);
+  Py_DECREF(indexPathObject);
+#endif  // #if PY_MAJOR_VERSION >= 3
+  return result;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the incremental hashing of append-only files.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_CHECKPOINT_H
+#define APRMD5_CHECKPOINT_H
+
+
+extern PyObject*
+aprmd5_md5_rehash(PyObject* self, PyObject* args, PyObject* kwds);
+
+
+#endif // #ifndef APRMD5_CHECKPOINT_H
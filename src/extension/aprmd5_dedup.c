@@ -0,0 +1,605 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the native duplicate file finder.
+//
+// The finder works in stages, each of which narrows down the set of
+// candidates that the next, more expensive stage has to look at:
+//
+// 1. Walk the directory trees and record path, device, inode and size of all
+//    regular files. Symbolic links are not followed.
+// 2. Collapse entries that refer to the same file (same device and inode),
+//    i.e. hard links, and files that were reached through overlapping roots.
+//    Only the first path that the walk found is kept.
+// 3. Group the files by size. A file with a unique size has no duplicate.
+// 4. Hash the head and the tail of each remaining file and group the files by
+//    size and partial digest. Small files are hashed completely in this stage
+//    and are done.
+// 5. Hash the remaining files completely and group them by size and digest.
+//
+// Stages 4 and 5 run on the native thread pool. All stages run with the GIL
+// released; Python objects are only touched to parse the arguments and to
+// build the result.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_dedup.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_fileio.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_threadpool.h"
+
+// System includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>      // for open(), fstatat()
+#include <stdlib.h>     // for malloc(), realloc(), free(), qsort()
+#include <string.h>     // for memcmp(), memcpy(), strcmp(), strlen()
+#include <sys/stat.h>
+#include <unistd.h>     // for close()
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+
+// The number of bytes at the head and at the tail of a file that are hashed
+// to prefilter the candidates. Files up to twice this size are hashed
+// completely by the prefilter.
+#define APRMD5_DEDUP_PARTIALSIZE 4096
+
+// Hashing a file costs at least one open() and one read(), so a few files per
+// range are enough to make handing out the ranges cheap
+#define APRMD5_DEDUP_GRAINSIZE 8
+
+
+// ---------------------------------------------------------------------------
+// A regular file found by the directory walk
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  size_t pathOffset;            // offset of the path in aprmd5_dedup_tree.paths
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  int error;                    // errno value if the file could not be hashed
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+} aprmd5_dedup_file;
+
+// ---------------------------------------------------------------------------
+// The result of the directory walk, and the state shared by all stages
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  aprmd5_dedup_file* files;
+  Py_ssize_t fileCount;
+  Py_ssize_t fileCapacity;
+  char* paths;                  // all paths, null-terminated, back to back
+  size_t pathsLen;
+  size_t pathsCapacity;
+  off_t minSize;                // smaller files are ignored
+  aprmd5_dedup_file** candidates;
+  int completeHash;             // 0 = partial hash stage, 1 = full hash stage
+} aprmd5_dedup_tree;
+
+
+// ---------------------------------------------------------------------------
+// Grows a buffer so that it can hold at least minCapacity elements. Returns
+// 0 on success, or -1 if memory could not be allocated.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_dedup_grow(void** buffer, size_t* capacity, size_t minCapacity, size_t elementSize)
+{
+  if (minCapacity <= *capacity)
+    return 0;
+  size_t newCapacity = *capacity ? *capacity : 64;
+  while (newCapacity < minCapacity)
+    newCapacity *= 2;
+  void* newBuffer = realloc(*buffer, newCapacity * elementSize);
+  if (NULL == newBuffer)
+    return -1;
+  *buffer = newBuffer;
+  *capacity = newCapacity;
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Records a regular file. Returns 0 on success, or an errno value.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_dedup_add_file(aprmd5_dedup_tree* tree, const char* path, size_t pathLen, const struct stat* st)
+{
+  if (st->st_size < tree->minSize)
+    return 0;
+
+  size_t fileCapacity = (size_t)tree->fileCapacity;
+  if (aprmd5_dedup_grow((void**)&tree->files, &fileCapacity, (size_t)tree->fileCount + 1, sizeof(aprmd5_dedup_file)) < 0
+      || aprmd5_dedup_grow((void**)&tree->paths, &tree->pathsCapacity, tree->pathsLen + pathLen + 1, 1) < 0)
+  {
+    tree->fileCapacity = (Py_ssize_t)fileCapacity;
+    return ENOMEM;
+  }
+  tree->fileCapacity = (Py_ssize_t)fileCapacity;
+
+  aprmd5_dedup_file* file = &tree->files[tree->fileCount++];
+  file->pathOffset = tree->pathsLen;
+  file->dev = st->st_dev;
+  file->ino = st->st_ino;
+  file->size = st->st_size;
+  file->error = 0;
+  memcpy(tree->paths + tree->pathsLen, path, pathLen + 1);
+  tree->pathsLen += pathLen + 1;
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// Walks the directory whose path is in *path, recursively. *path is a buffer
+// that is extended with the names of the directory entries; on return it
+// again contains the directory path. Directories that cannot be read are
+// skipped. Returns 0 on success, or an errno value if memory could not be
+// allocated.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_dedup_walk_directory(aprmd5_dedup_tree* tree, char** path, size_t* pathCapacity, size_t pathLen)
+{
+  DIR* dir = opendir(*path);
+  if (NULL == dir)
+    return 0;
+
+  int result = 0;
+  struct dirent* entry;
+  while (0 == result && NULL != (entry = readdir(dir)))
+  {
+    const char* name = entry->d_name;
+    if (0 == strcmp(name, ".") || 0 == strcmp(name, ".."))
+      continue;
+
+    size_t nameLen = strlen(name);
+    size_t entryPathLen = pathLen + nameLen + 1;
+    if (aprmd5_dedup_grow((void**)path, pathCapacity, entryPathLen + 1, 1) < 0)
+    {
+      result = ENOMEM;
+      break;
+    }
+    if (pathLen > 0 && '/' == (*path)[pathLen - 1])
+      --entryPathLen;
+    else
+      (*path)[pathLen] = '/';
+    memcpy(*path + entryPathLen - nameLen, name, nameLen + 1);
+
+    struct stat st;
+    if (0 != fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW))
+      continue;
+    if (S_ISDIR(st.st_mode))
+      result = aprmd5_dedup_walk_directory(tree, path, pathCapacity, entryPathLen);
+    else if (S_ISREG(st.st_mode))
+      result = aprmd5_dedup_add_file(tree, *path, entryPathLen, &st);
+  }
+
+  closedir(dir);
+  (*path)[pathLen] = '\0';
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Walks one of the trees that the user specified. The root itself may also be
+// a regular file. Returns 0 on success, or an errno value if the root does not
+// exist or if memory could not be allocated.
+// ---------------------------------------------------------------------------
+static int
+aprmd5_dedup_walk(aprmd5_dedup_tree* tree, const char* root)
+{
+  struct stat st;
+  if (0 != stat(root, &st))
+    return errno;
+
+  size_t rootLen = strlen(root);
+  if (S_ISREG(st.st_mode))
+    return aprmd5_dedup_add_file(tree, root, rootLen, &st);
+  if (! S_ISDIR(st.st_mode))
+    return 0;
+
+  size_t pathCapacity = 0;
+  char* path = NULL;
+  if (aprmd5_dedup_grow((void**)&path, &pathCapacity, rootLen + 1, 1) < 0)
+    return ENOMEM;
+  memcpy(path, root, rootLen + 1);
+  int result = aprmd5_dedup_walk_directory(tree, &path, &pathCapacity, rootLen);
+  free(path);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Comparison functions for qsort(). All of them order by walk order last, so
+// that the order of the result does not depend on qsort()'s implementation.
+// ---------------------------------------------------------------------------
+#define APRMD5_DEDUP_COMPARE(a, b) if ((a) != (b)) return (a) < (b) ? -1 : 1
+
+static int
+aprmd5_dedup_compare_inode(const void* left, const void* right)
+{
+  const aprmd5_dedup_file* l = *(const aprmd5_dedup_file* const*)left;
+  const aprmd5_dedup_file* r = *(const aprmd5_dedup_file* const*)right;
+  APRMD5_DEDUP_COMPARE(l->dev, r->dev);
+  APRMD5_DEDUP_COMPARE(l->ino, r->ino);
+  APRMD5_DEDUP_COMPARE(l->pathOffset, r->pathOffset);
+  return 0;
+}
+
+static int
+aprmd5_dedup_compare_size(const void* left, const void* right)
+{
+  const aprmd5_dedup_file* l = *(const aprmd5_dedup_file* const*)left;
+  const aprmd5_dedup_file* r = *(const aprmd5_dedup_file* const*)right;
+  // Largest files first: they waste the most space
+  APRMD5_DEDUP_COMPARE(r->size, l->size);
+  APRMD5_DEDUP_COMPARE(l->pathOffset, r->pathOffset);
+  return 0;
+}
+
+static int
+aprmd5_dedup_compare_digest(const void* left, const void* right)
+{
+  const aprmd5_dedup_file* l = *(const aprmd5_dedup_file* const*)left;
+  const aprmd5_dedup_file* r = *(const aprmd5_dedup_file* const*)right;
+  APRMD5_DEDUP_COMPARE(r->size, l->size);
+  int result = memcmp(l->digest, r->digest, APRMD5_MD5_DIGESTSIZE);
+  if (0 != result)
+    return result;
+  APRMD5_DEDUP_COMPARE(l->pathOffset, r->pathOffset);
+  return 0;
+}
+
+static int
+aprmd5_dedup_same_content(const aprmd5_dedup_file* l, const aprmd5_dedup_file* r)
+{
+  return l->size == r->size && 0 == memcmp(l->digest, r->digest, APRMD5_MD5_DIGESTSIZE);
+}
+
+
+// ---------------------------------------------------------------------------
+// Hashes a range of the candidates. This is the work function for the thread
+// pool. Depending on the stage, each file is hashed completely, or only its
+// head and tail.
+// ---------------------------------------------------------------------------
+static void
+aprmd5_dedup_hash_range(void* context, Py_ssize_t begin, Py_ssize_t end)
+{
+  aprmd5_dedup_tree* tree = (aprmd5_dedup_tree*)context;
+  Py_ssize_t index;
+  for (index = begin; index < end; ++index)
+  {
+    aprmd5_dedup_file* file = tree->candidates[index];
+    int fd = open(tree->paths + file->pathOffset, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      file->error = errno;
+      continue;
+    }
+
+    apr_md5_ctx_t md5Context;
+    aprmd5_md5block_ctx_init(&md5Context);
+    apr_int64_t expectedLen = file->size;
+    apr_int64_t hashedLen = 0;
+    if (tree->completeHash || file->size <= 2 * APRMD5_DEDUP_PARTIALSIZE)
+    {
+      file->error = aprmd5_fileio_md5_update(&md5Context, fd, 0, file->size, &hashedLen);
+    }
+    else
+    {
+      apr_int64_t tailLen = 0;
+      file->error = aprmd5_fileio_md5_update(&md5Context, fd, 0, APRMD5_DEDUP_PARTIALSIZE, &hashedLen);
+      if (0 == file->error)
+        file->error = aprmd5_fileio_md5_update(&md5Context, fd, file->size - APRMD5_DEDUP_PARTIALSIZE,
+                                               APRMD5_DEDUP_PARTIALSIZE, &tailLen);
+      hashedLen += tailLen;
+      expectedLen = 2 * APRMD5_DEDUP_PARTIALSIZE;
+    }
+    close(fd);
+    aprmd5_backend_selected->final(file->digest, &md5Context);
+
+    // The file was truncated after the walk; its content does not match the
+    // size by which it was grouped
+    if (0 == file->error && hashedLen != expectedLen)
+      file->error = EIO;
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// Keeps only those candidates that have at least one other candidate with the
+// same content according to aprmd5_dedup_same_content(). The candidates must
+// be sorted so that such candidates are adjacent. Candidates that could not
+// be hashed are dropped. Returns the new number of candidates.
+// ---------------------------------------------------------------------------
+static Py_ssize_t
+aprmd5_dedup_keep_groups(aprmd5_dedup_file** candidates, Py_ssize_t count, int compareDigests)
+{
+  Py_ssize_t keptCount = 0;
+  Py_ssize_t groupBegin = 0;
+  while (groupBegin < count)
+  {
+    Py_ssize_t groupEnd = groupBegin + 1;
+    while (groupEnd < count
+           && (compareDigests ? aprmd5_dedup_same_content(candidates[groupBegin], candidates[groupEnd])
+                              : candidates[groupBegin]->size == candidates[groupEnd]->size))
+      ++groupEnd;
+
+    Py_ssize_t validCount = 0;
+    Py_ssize_t index;
+    for (index = groupBegin; index < groupEnd; ++index)
+    {
+      if (0 == candidates[index]->error)
+        ++validCount;
+    }
+    if (validCount >= 2)
+    {
+      for (index = groupBegin; index < groupEnd; ++index)
+      {
+        if (0 == candidates[index]->error)
+          candidates[keptCount++] = candidates[index];
+      }
+    }
+    groupBegin = groupEnd;
+  }
+  return keptCount;
+}
+
+
+// ---------------------------------------------------------------------------
+// Runs stages 2 to 5 on the files found by the walk. On return,
+// tree->candidates contains the duplicate files, sorted so that the files of
+// a group are adjacent. Returns the number of files in tree->candidates, or
+// -1 if memory could not be allocated.
+// ---------------------------------------------------------------------------
+static Py_ssize_t
+aprmd5_dedup_find(aprmd5_dedup_tree* tree, int threadCount)
+{
+  Py_ssize_t count = tree->fileCount;
+  aprmd5_dedup_file** candidates = (aprmd5_dedup_file**)malloc((size_t)(count + 1) * sizeof(aprmd5_dedup_file*));
+  if (NULL == candidates)
+    return -1;
+  tree->candidates = candidates;
+  Py_ssize_t index;
+  for (index = 0; index < count; ++index)
+    candidates[index] = &tree->files[index];
+
+  // Stage 2: Collapse entries that refer to the same file
+  qsort(candidates, (size_t)count, sizeof(aprmd5_dedup_file*), aprmd5_dedup_compare_inode);
+  Py_ssize_t uniqueCount = 0;
+  for (index = 0; index < count; ++index)
+  {
+    if (uniqueCount > 0
+        && candidates[uniqueCount - 1]->dev == candidates[index]->dev
+        && candidates[uniqueCount - 1]->ino == candidates[index]->ino)
+      continue;
+    candidates[uniqueCount++] = candidates[index];
+  }
+  count = uniqueCount;
+
+  // Stage 3: Group by size
+  qsort(candidates, (size_t)count, sizeof(aprmd5_dedup_file*), aprmd5_dedup_compare_size);
+  count = aprmd5_dedup_keep_groups(candidates, count, 0);
+
+  // Stage 4: Group by size and partial digest
+  tree->completeHash = 0;
+  aprmd5_threadpool_run(threadCount, count, APRMD5_DEDUP_GRAINSIZE, aprmd5_dedup_hash_range, tree);
+  qsort(candidates, (size_t)count, sizeof(aprmd5_dedup_file*), aprmd5_dedup_compare_digest);
+  count = aprmd5_dedup_keep_groups(candidates, count, 1);
+
+  // Stage 5: Group by size and full digest. The small files, which already
+  // have their full digest, are moved to the end; they sort after the large
+  // files anyway.
+  Py_ssize_t largeCount = 0;
+  while (largeCount < count && candidates[largeCount]->size > 2 * APRMD5_DEDUP_PARTIALSIZE)
+    ++largeCount;
+  tree->completeHash = 1;
+  aprmd5_threadpool_run(threadCount, largeCount, APRMD5_DEDUP_GRAINSIZE, aprmd5_dedup_hash_range, tree);
+  qsort(candidates, (size_t)largeCount, sizeof(aprmd5_dedup_file*), aprmd5_dedup_compare_digest);
+  Py_ssize_t keptLargeCount = aprmd5_dedup_keep_groups(candidates, largeCount, 1);
+  memmove(candidates + keptLargeCount, candidates + largeCount,
+          (size_t)(count - largeCount) * sizeof(aprmd5_dedup_file*));
+  return keptLargeCount + (count - largeCount);
+}
+
+
+// ---------------------------------------------------------------------------
+// Converts a path to a Python string object the same way os.listdir() does.
+// ---------------------------------------------------------------------------
+static PyObject*
+aprmd5_dedup_path_to_object(const char* path)
+{
+#if PY_MAJOR_VERSION >= 3
+  return PyUnicode_DecodeFSDefault(path);
+#else   // #if PY_MAJOR_VERSION >= 3
+  return PyString_FromString(path);
+#endif  // #if PY_MAJOR_VERSION >= 3
+}
+
+
+// ---------------------------------------------------------------------------
+// Builds the list of groups that aprmd5_find_duplicates() returns.
+// ---------------------------------------------------------------------------
+static PyObject*
+aprmd5_dedup_build_result(aprmd5_dedup_tree* tree, Py_ssize_t count)
+{
+  PyObject* resultList = PyList_New(0);
+  Py_ssize_t groupBegin = 0;
+  while (NULL != resultList && groupBegin < count)
+  {
+    Py_ssize_t groupEnd = groupBegin + 1;
+    while (groupEnd < count && aprmd5_dedup_same_content(tree->candidates[groupBegin], tree->candidates[groupEnd]))
+      ++groupEnd;
+
+    PyObject* group = PyList_New(groupEnd - groupBegin);
+    Py_ssize_t index;
+    for (index = groupBegin; NULL != group && index < groupEnd; ++index)
+    {
+      PyObject* path = aprmd5_dedup_path_to_object(tree->paths + tree->candidates[index]->pathOffset);
+      if (NULL == path)
+        Py_CLEAR(group);
+      else
+        PyList_SET_ITEM(group, index - groupBegin, path);
+    }
+    if (NULL == group || PyList_Append(resultList, group) < 0)
+      Py_CLEAR(resultList);
+    Py_XDECREF(group);
+    groupBegin = groupEnd;
+  }
+  return resultList;
+}
+
+
+// ---------------------------------------------------------------------------
+// This function finds files with identical content. From within Python, this
+// function will be available as
+//
+//   aprmd5.find_duplicates()
+//
+// The directory trees are walked and the files are hashed with the GIL
+// released. Files are hashed on a pool of native threads. Only files that
+// have the same size as another file are hashed, and only if their heads and
+// tails are also identical are they hashed completely.
+//
+// Parameters of the Python function:
+// - roots: an iterable of paths (strings, bytes objects or os.PathLike
+//   objects) of the directories to search; a path may also refer to a single
+//   file
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core
+// - min_size: optional keyword argument; files smaller than this many bytes
+//   are ignored. The default is 1, i.e. empty files are ignored.
+//
+// Return value of the Python function:
+// - A list of groups, each of which is a list of the paths of files with
+//   identical content. Groups with larger files come first; the paths in a
+//   group are in the order in which the directory walk found them. Hard links
+//   to the same file are reported only once, with the path that was found
+//   first. Symbolic links are not followed, and files or directories that
+//   cannot be read are skipped.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_find_duplicates(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"roots", "threads", "min_size", NULL};
+  PyObject* iterable;
+  int threadCount = 0;
+  Py_ssize_t minSize = 1;
+#if PY_MAJOR_VERSION >= 3
+  const char* format = "O|$in:find_duplicates";
+#else   // #if PY_MAJOR_VERSION >= 3
+  const char* format = "O|in:find_duplicates";
+#endif  // #if PY_MAJOR_VERSION >= 3
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, format, kwlist, &iterable, &threadCount, &minSize))
+    return NULL;
+  if (threadCount < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+    return NULL;
+  }
+  if (minSize < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "min_size must not be negative");
+    return NULL;
+  }
+
+  PyObject* items = PySequence_Tuple(iterable);
+  if (NULL == items)
+    return NULL;
+  Py_ssize_t rootCount = PyTuple_GET_SIZE(items);
+
+  // The path objects are immutable, so their buffers can be accessed while
+  // the GIL is released
+  PyObject* resultList = NULL;
+  PyObject* rootObjects = PyTuple_New(rootCount);
+  const char** roots = PyMem_New(const char*, rootCount + 1);
+  aprmd5_dedup_tree tree;
+  memset(&tree, 0, sizeof(tree));
+  tree.minSize = (off_t)minSize;
+  if (NULL == rootObjects || NULL == roots)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+  Py_ssize_t index;
+  for (index = 0; index < rootCount; ++index)
+  {
+    PyObject* rootObject = NULL;
+#if PY_MAJOR_VERSION >= 3
+    if (! PyUnicode_FSConverter(PyTuple_GET_ITEM(items, index), &rootObject))
+      goto done;
+    roots[index] = PyBytes_AS_STRING(rootObject);
+#else   // #if PY_MAJOR_VERSION >= 3
+    rootObject = PyTuple_GET_ITEM(items, index);
+    roots[index] = PyString_AsString(rootObject);
+    if (NULL == roots[index])
+      goto done;
+    Py_INCREF(rootObject);
+#endif  // #if PY_MAJOR_VERSION >= 3
+    PyTuple_SET_ITEM(rootObjects, index, rootObject);
+  }
+
+  int error = 0;
+  Py_ssize_t failedRoot = -1;
+  Py_ssize_t duplicateCount = 0;
+  Py_BEGIN_ALLOW_THREADS
+  for (index = 0; 0 == error && index < rootCount; ++index)
+  {
+    error = aprmd5_dedup_walk(&tree, roots[index]);
+    if (0 != error)
+      failedRoot = index;
+  }
+  if (0 == error)
+  {
+    duplicateCount = aprmd5_dedup_find(&tree, threadCount);
+    if (duplicateCount < 0)
+      error = ENOMEM;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (ENOMEM == error)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+  if (0 != error)
+  {
+    errno = error;
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, roots[failedRoot]);
+    goto done;
+  }
+  resultList = aprmd5_dedup_build_result(&tree, duplicateCount);
+
+done:
+  free(tree.candidates);
+  free(tree.files);
+  free(tree.paths);
+  PyMem_Free(roots);
+  Py_XDECREF(rootObjects);
+  Py_DECREF(items);
+  return resultList;
+}
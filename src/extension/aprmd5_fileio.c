@@ -0,0 +1,495 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the functions that hash the content of files.
+//
+// Files are read with large pread() calls into a page-aligned buffer, and the
+// kernel is told via posix_fadvise() that the file is read sequentially, so
+// that it reads ahead aggressively. Memory-mapping the file would save one
+// copy per buffer, but that copy is cheap compared to hashing the data, and a
+// mapped file that is truncated by another process while we hash it would
+// kill the interpreter with SIGBUS. pread() also works for many files that
+// cannot be mapped, such as most files in /proc. Pipes cannot be read with
+// pread(); they are read sequentially with read() instead, which is only
+// possible from their start.
+//
+// None of the functions in this file touch Python objects while I/O is in
+// progress, so all I/O and hashing is done with the GIL released.
+//
+// md5_parts() splits a file or a buffer into parts of a fixed size and hashes
+// the parts in parallel on the native thread pool. Only regular files can be
+// split, because the parts are found by the size of the file. All threads read the file
+// through the same file descriptor; pread() does not use the file offset, so
+// they do not get in each other's way.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_fileio.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_threadpool.h"
+
+// System includes
+#include <errno.h>
+#include <fcntl.h>    // for open(), posix_fadvise()
+#include <stdio.h>    // for snprintf()
+#include <stdlib.h>   // for posix_memalign(), free()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for pread(), read(), close()
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+
+// The size of the buffer that file content is read into. The buffer is large
+// enough to make the cost of the system calls negligible, and small enough to
+// stay in the CPU's cache between reading and hashing.
+#define APRMD5_FILEIO_BUFFERSIZE (1024 * 1024)
+
+// The alignment of the buffer; a typical page size
+#define APRMD5_FILEIO_BUFFERALIGNMENT 4096
+
+
+// ---------------------------------------------------------------------------
+// Updates an MD5 context with a range of the content of a file.
+//
+// Parameters:
+// - context: The MD5 context to update
+// - fd: A file descriptor that is open for reading. The file offset of the
+//   descriptor is not changed, unless the descriptor refers to a pipe or a
+//   socket, which is read with read() if offset is 0.
+// - offset: The position in the file where hashing starts
+// - length: The number of bytes to hash, or APRMD5_FILEIO_TO_EOF. Hashing
+//   also stops if the end of the file is reached before length bytes have
+//   been hashed.
+// - bytesHashed: Receives the number of bytes that were hashed. May be NULL.
+//
+// Return value:
+// - 0 on success
+// - An errno value if the file could not be read, or if memory for the
+//   buffer could not be allocated. ESPIPE if the file is a pipe or a socket
+//   and offset is not 0.
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_fileio_md5_update(apr_md5_ctx_t* context, int fd, off_t offset, apr_int64_t length, apr_int64_t* bytesHashed)
+{
+  apr_int64_t totalLen = 0;
+  int sequential = 0;           // 1 if the file must be read with read()
+  void* buffer = NULL;
+  int result = posix_memalign(&buffer, APRMD5_FILEIO_BUFFERALIGNMENT, APRMD5_FILEIO_BUFFERSIZE);
+  if (0 != result)
+    goto done;
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+  // This is only a hint; the result does not matter
+  posix_fadvise(fd, offset, APRMD5_FILEIO_TO_EOF == length ? 0 : (off_t)length, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  while (APRMD5_FILEIO_TO_EOF == length || totalLen < length)
+  {
+    size_t readLen = APRMD5_FILEIO_BUFFERSIZE;
+    if (APRMD5_FILEIO_TO_EOF != length && length - totalLen < (apr_int64_t)readLen)
+      readLen = (size_t)(length - totalLen);
+    ssize_t bytesRead = sequential
+      ? read(fd, buffer, readLen)
+      : pread(fd, buffer, readLen, offset + (off_t)totalLen);
+    if (bytesRead < 0)
+    {
+      if (EINTR == errno)
+        continue;
+      if (ESPIPE == errno && ! sequential && 0 == offset && 0 == totalLen)
+      {
+        sequential = 1;
+        continue;
+      }
+      result = errno;
+      break;
+    }
+    if (0 == bytesRead)
+      break;
+    aprmd5_backend_selected->update(context, (const unsigned char*)buffer, (apr_size_t)bytesRead);
+    totalLen += bytesRead;
+  }
+
+done:
+  free(buffer);
+  if (NULL != bytesHashed)
+    *bytesHashed = totalLen;
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Opens a file for reading. Returns the file descriptor, or -1 with errno set.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_fileio_open(const char* path)
+{
+  int fd;
+  do
+  {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  while (fd < 0 && EINTR == errno);
+  return fd;
+}
+
+
+// ---------------------------------------------------------------------------
+// This function hashes the content of a file. From within Python, this
+// function will be available as
+//
+//   aprmd5.md5_file()
+//
+// The file is read and hashed with the GIL released, so other Python threads
+// keep running while a large file is hashed.
+//
+// Parameters of the Python function:
+// - path: The path of the file to hash; a string, a bytes object or an
+//   os.PathLike object
+// - offset: optional keyword argument that specifies the position in the file
+//   where hashing starts; the default is 0
+// - length: optional keyword argument that specifies the maximum number of
+//   bytes to hash; the default (None) is to hash up to the end of the file
+//
+// Return value of the Python function:
+// - A bytes object that contains the MD5 digest of the file content. The
+//   digest is the same as md5(content).digest().
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_file(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"path", "offset", "length", NULL};
+  Py_ssize_t offset = 0;
+  PyObject* lengthObject = Py_None;
+#if PY_MAJOR_VERSION >= 3
+  PyObject* pathObject = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O&|$nO:md5_file", kwlist,
+                                    PyUnicode_FSConverter, &pathObject, &offset, &lengthObject))
+    return NULL;
+  const char* path = PyBytes_AS_STRING(pathObject);
+#else   // #if PY_MAJOR_VERSION >= 3
+  const char* path = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "s|nO:md5_file", kwlist,
+                                    &path, &offset, &lengthObject))
+    return NULL;
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+  PyObject* result = NULL;
+  apr_int64_t length = APRMD5_FILEIO_TO_EOF;
+  if (Py_None != lengthObject)
+  {
+    Py_ssize_t value = PyNumber_AsSsize_t(lengthObject, PyExc_OverflowError);
+    if (-1 == value && PyErr_Occurred())
+      goto done;
+    if (value < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "length must not be negative");
+      goto done;
+    }
+    length = value;
+  }
+  if (offset < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "offset must not be negative");
+    goto done;
+  }
+
+  apr_md5_ctx_t context;
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  int error = 0;
+  Py_BEGIN_ALLOW_THREADS
+  int fd = aprmd5_fileio_open(path);
+  if (fd < 0)
+  {
+    error = errno;
+  }
+  else
+  {
+    aprmd5_md5block_ctx_init(&context);
+    error = aprmd5_fileio_md5_update(&context, fd, (off_t)offset, length, NULL);
+    close(fd);
+    aprmd5_backend_selected->final(digest, &context);
+  }
+  Py_END_ALLOW_THREADS
+
+  if (0 != error)
+  {
+    errno = error;
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    goto done;
+  }
+  result = PyBytes_FromStringAndSize((const char*)digest, APRMD5_MD5_DIGESTSIZE);
+
+done:
+#if PY_MAJOR_VERSION >= 3
+  Py_DECREF(pathObject);
+#endif  // #if PY_MAJOR_VERSION >= 3
+  return result;
+}
+
+
+#if PY_MAJOR_VERSION >= 3
+
+// ---------------------------------------------------------------------------
+// The work of md5_parts(). Each part is one item for the thread pool; the
+// source is either a file descriptor or a buffer.
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  int fd;                       // -1 if the source is a buffer
+  const unsigned char* buffer;
+  apr_int64_t totalLen;         // the size of the file or the buffer
+  apr_int64_t partSize;
+  unsigned char* digests;       // APRMD5_MD5_DIGESTSIZE bytes per part
+  apr_int64_t* partLens;        // the number of bytes hashed per part
+  int* errors;                  // an errno value per part, or 0
+} aprmd5_fileio_parts;
+
+static void
+aprmd5_fileio_parts_range(void* context, Py_ssize_t begin, Py_ssize_t end)
+{
+  aprmd5_fileio_parts* parts = (aprmd5_fileio_parts*)context;
+  Py_ssize_t index;
+  for (index = begin; index < end; ++index)
+  {
+    apr_int64_t offset = (apr_int64_t)index * parts->partSize;
+    apr_int64_t length = parts->totalLen - offset;
+    if (length > parts->partSize)
+      length = parts->partSize;
+    apr_md5_ctx_t md5Context;
+    aprmd5_md5block_ctx_init(&md5Context);
+    if (parts->fd < 0)
+    {
+      aprmd5_helper_md5_update(&md5Context, parts->buffer + offset, (Py_ssize_t)length);
+      parts->partLens[index] = length;
+      parts->errors[index] = 0;
+    }
+    else
+    {
+      parts->errors[index] = aprmd5_fileio_md5_update(&md5Context, parts->fd, (off_t)offset, length,
+                                                      &parts->partLens[index]);
+    }
+    aprmd5_backend_selected->final(parts->digests + index * APRMD5_MD5_DIGESTSIZE, &md5Context);
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// This function hashes a file or a buffer in parts of a fixed size, the way
+// that S3 computes the ETag of an object that was uploaded in multiple parts.
+// From within Python, this function will be available as
+//
+//   aprmd5.md5_parts()
+//
+// The parts are hashed in parallel on the native thread pool with the GIL
+// released.
+//
+// Parameters of the Python function:
+// - source: Either an object that supports the buffer protocol (e.g. bytes,
+//   bytearray, memoryview or mmap), whose content is hashed; or the path of
+//   a file, as a string or an os.PathLike object. Note that bytes are hashed,
+//   not interpreted as a path.
+// - part_size: The size of each part in bytes; the last part may be shorter
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core
+//
+// Return value of the Python function:
+// - A tuple (digests, etag). digests is a list with the MD5 digest of each
+//   part, as bytes. etag is the string "<md5>-<n>", where <md5> is the
+//   hexadecimal MD5 digest of the concatenated part digests and <n> is the
+//   number of parts. Empty content counts as one empty part.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_parts(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"source", "part_size", "threads", NULL};
+  PyObject* source;
+  Py_ssize_t partSize;
+  int threadCount = 0;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "On|$i:md5_parts", kwlist, &source, &partSize, &threadCount))
+    return NULL;
+  if (partSize <= 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "part_size must be positive");
+    return NULL;
+  }
+  if (threadCount < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+    return NULL;
+  }
+
+  aprmd5_fileio_parts parts;
+  parts.fd = -1;
+  parts.buffer = NULL;
+  parts.partSize = partSize;
+  parts.digests = NULL;
+  parts.partLens = NULL;
+  parts.errors = NULL;
+  Py_buffer input;
+  input.buf = NULL;
+  PyObject* pathObject = NULL;
+  const char* path = NULL;
+  PyObject* result = NULL;
+  int error = 0;
+
+  if (PyObject_CheckBuffer(source))
+  {
+    if (PyObject_GetBuffer(source, &input, PyBUF_SIMPLE) < 0)
+      return NULL;
+    parts.buffer = (const unsigned char*)input.buf;
+    parts.totalLen = input.len;
+  }
+  else
+  {
+    if (! PyUnicode_FSConverter(source, &pathObject))
+      return NULL;
+    path = PyBytes_AS_STRING(pathObject);
+    struct stat fileStat;
+    int sizeMatches = 0;
+    Py_BEGIN_ALLOW_THREADS
+    parts.fd = aprmd5_fileio_open(path);
+    if (parts.fd < 0 || fstat(parts.fd, &fileStat) < 0)
+    {
+      error = errno;
+    }
+    else if (S_ISDIR(fileStat.st_mode))
+    {
+      error = EISDIR;
+    }
+    else if (S_ISREG(fileStat.st_mode))
+    {
+      // Files in /proc and similar file systems are regular files whose size
+      // says nothing about their content (usually 0). Nothing must follow the
+      // end of a file.
+      char probe;
+      ssize_t bytesRead;
+      do
+      {
+        bytesRead = pread(parts.fd, &probe, 1, fileStat.st_size);
+      }
+      while (bytesRead < 0 && EINTR == errno);
+      if (bytesRead < 0)
+        error = errno;
+      else
+        sizeMatches = (0 == bytesRead);
+    }
+    Py_END_ALLOW_THREADS
+    if (0 != error)
+      goto done;
+    // The parts are found by the size of the file. Pipes and special files
+    // report a size of 0 or a size that does not match their content, so
+    // they would silently be hashed as empty.
+    if (! sizeMatches)
+    {
+      PyErr_Format(PyExc_ValueError, "%s is not a regular file, or its size does not match its content", path);
+      goto done;
+    }
+    parts.totalLen = (apr_int64_t)fileStat.st_size;
+  }
+
+  Py_ssize_t partCount = (Py_ssize_t)((parts.totalLen + parts.partSize - 1) / parts.partSize);
+  if (0 == partCount)
+    partCount = 1;
+  parts.digests = PyMem_New(unsigned char, partCount * APRMD5_MD5_DIGESTSIZE);
+  parts.partLens = PyMem_New(apr_int64_t, partCount);
+  parts.errors = PyMem_New(int, partCount);
+  if (NULL == parts.digests || NULL == parts.partLens || NULL == parts.errors)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  aprmd5_threadpool_run(threadCount, partCount, 1, aprmd5_fileio_parts_range, &parts);
+  Py_END_ALLOW_THREADS
+
+  // Every part but the last must have been hashed completely. Anything else
+  // means that the file was truncated while it was hashed.
+  Py_ssize_t index;
+  apr_int64_t hashedLen = 0;
+  for (index = 0; index < partCount && 0 == error; ++index)
+  {
+    error = parts.errors[index];
+    hashedLen += parts.partLens[index];
+  }
+  if (0 != error)
+    goto done;
+  if (hashedLen != parts.totalLen)
+  {
+    PyErr_Format(PyExc_RuntimeError, "%s changed size while it was hashed", path);
+    goto done;
+  }
+
+  PyObject* digestList = PyList_New(partCount);
+  if (NULL == digestList)
+    goto done;
+  for (index = 0; index < partCount; ++index)
+  {
+    PyObject* digest = PyBytes_FromStringAndSize((const char*)parts.digests + index * APRMD5_MD5_DIGESTSIZE,
+                                                 APRMD5_MD5_DIGESTSIZE);
+    if (NULL == digest)
+    {
+      Py_DECREF(digestList);
+      goto done;
+    }
+    PyList_SET_ITEM(digestList, index, digest);
+  }
+
+  // The ETag is the digest of the part digests, and the number of parts
+  apr_md5_ctx_t etagContext;
+  unsigned char etagDigest[APRMD5_MD5_DIGESTSIZE];
+  char etag[2 * APRMD5_MD5_DIGESTSIZE + 32];
+  aprmd5_md5block_ctx_init(&etagContext);
+  aprmd5_helper_md5_update(&etagContext, parts.digests, partCount * APRMD5_MD5_DIGESTSIZE);
+  aprmd5_backend_selected->final(etagDigest, &etagContext);
+  aprmd5_helper_bindigest_to_hexdigest(APRMD5_MD5_DIGESTSIZE, etagDigest, etag);
+  snprintf(etag + 2 * APRMD5_MD5_DIGESTSIZE, sizeof(etag) - 2 * APRMD5_MD5_DIGESTSIZE, "-%zd", partCount);
+  result = Py_BuildValue("(Ns)", digestList, etag);
+
+done:
+  if (0 != error)
+  {
+    errno = error;
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+  }
+  if (parts.fd >= 0)
+    close(parts.fd);
+  if (NULL != input.buf)
+    PyBuffer_Release(&input);
+  Py_XDECREF(pathObject);
+  PyMem_Free(parts.digests);
+  PyMem_Free(parts.partLens);
+  PyMem_Free(parts.errors);
+  return result;
+}
+
+#endif  // #if PY_MAJOR_VERSION >= 3
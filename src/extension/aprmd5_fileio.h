@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the functions that hash the content of files.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_FILEIO_H
+#define APRMD5_FILEIO_H
+
+// System includes
+#include <sys/types.h>   // for off_t
+
+// Passed as length to aprmd5_fileio_md5_update() to hash up to the end of the
+// file
+#define APRMD5_FILEIO_TO_EOF ((apr_int64_t)-1)
+
+extern int
+aprmd5_fileio_open(const char* path);
+
+extern int
+aprmd5_fileio_md5_update(apr_md5_ctx_t* context,
+                         int fd,
+                         off_t offset,
+                         apr_int64_t length,
+                         apr_int64_t* bytesHashed);
+
+extern PyObject*
+aprmd5_md5_file(PyObject* self, PyObject* args, PyObject* kwds);
+
+#if PY_MAJOR_VERSION >= 3
+extern PyObject*
+aprmd5_md5_parts(PyObject* self, PyObject* args, PyObject* kwds);
+#endif
+
+
+#endif // #ifndef APRMD5_FILEIO_H
@@ -24,10 +24,26 @@
 
 
 // Project includes
+#include "aprmd5.h"
 #include "aprmd5_helpers.h"
+#include "aprmd5_backend.h"
+#include "aprmd5_md5block.h"
 
 // System includes
-#include <stdio.h>  // for sprintf()
+#include <errno.h>
+#include <fcntl.h>    // for fcntl(), open()
+#include <stdio.h>    // for rename()
+#include <stdlib.h>   // for mkstemp(), malloc(), free()
+#include <string.h>   // for strlen(), memcpy()
+#include <sys/stat.h> // for stat(), fstat(), fchmod()
+#include <unistd.h>   // for fsync(), close(), unlink()
+
+// Appended to a path to get the template of its temporary files
+#define APRMD5_HELPER_TMPSUFFIX ".XXXXXX"
+
+// Appended to the path of a temporary file to get the path of the file that
+// finds out the permission bits of new files
+#define APRMD5_HELPER_MODESUFFIX ".mode"
 
 
 // ---------------------------------------------------------------------------
@@ -40,7 +56,8 @@
 // - hexDigest: A pre-allocated character array whose content is overwritten by
 //   this function with the hexadecimal MD5 digest. The array is expected to be
 //   of length binDigestSize * 2 (because each byte of the binary digest
-//   will be converted into two hexadecimal digits/characters).
+//   will be converted into two hexadecimal digits/characters). No terminating
+//   null byte is written.
 //
 // Return value:
 // - None
@@ -49,14 +66,448 @@
 // ---------------------------------------------------------------------------
 void aprmd5_helper_bindigest_to_hexdigest(int binDigestSize, const unsigned char* binDigest, char* hexDigest)
 {
-  int i = 0;
-  int j = 0;
-  while (i < binDigestSize)
+  // Each nibble is looked up in a table; this is many times faster than
+  // formatting each byte with sprintf()
+  static const char hexDigits[] = "0123456789abcdef";
+  int i;
+  for (i = 0; i < binDigestSize; ++i)
+  {
+    hexDigest[2 * i] = hexDigits[binDigest[i] >> 4];
+    hexDigest[2 * i + 1] = hexDigits[binDigest[i] & 0x0f];
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// Feeds an input buffer of arbitrary size to an MD5 context.
+//
+// The MD5 streaming functions take the input length as apr_size_t, which on
+// some platforms is smaller than Py_ssize_t. This function therefore splits
+// the input into chunks of at most APRMD5_MD5_MAXCHUNKSIZE bytes and feeds the
+// chunks one after the other.
+//
+// Parameters:
+// - context: The MD5 context to update
+// - input: The input buffer
+// - inputLen: The length of the input buffer in bytes; must not be negative
+//
+// Return value:
+// - APR_SUCCESS if all chunks could be fed to the MD5 algorithm, otherwise the
+//   status code of the first chunk that failed
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+apr_status_t aprmd5_helper_md5_update(apr_md5_ctx_t* context, const void* input, Py_ssize_t inputLen)
+{
+  const unsigned char* chunk = (const unsigned char*)input;
+  while (inputLen > 0)
+  {
+    apr_size_t chunkLen = APRMD5_MD5_MAXCHUNKSIZE;
+    if ((Py_ssize_t)chunkLen > inputLen)
+      chunkLen = (apr_size_t)inputLen;
+    aprmd5_backend_selected->update(context, chunk, chunkLen);
+    chunk += chunkLen;
+    inputLen -= (Py_ssize_t)chunkLen;
+  }
+  return APR_SUCCESS;
+}
+
+
+// ---------------------------------------------------------------------------
+// Stores a 32-bit integer in little endian byte order, no matter what the
+// byte order of the host is. Used by the serialized formats of the module.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_helper_put_uint32(unsigned char* output, apr_uint32_t value)
+{
+  output[0] = (unsigned char)value;
+  output[1] = (unsigned char)(value >> 8);
+  output[2] = (unsigned char)(value >> 16);
+  output[3] = (unsigned char)(value >> 24);
+}
+
+
+// ---------------------------------------------------------------------------
+// Loads a 32-bit integer that was stored by aprmd5_helper_put_uint32().
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+apr_uint32_t aprmd5_helper_get_uint32(const unsigned char* input)
+{
+  return (apr_uint32_t)input[0]
+    | ((apr_uint32_t)input[1] << 8)
+    | ((apr_uint32_t)input[2] << 16)
+    | ((apr_uint32_t)input[3] << 24);
+}
+
+
+// ---------------------------------------------------------------------------
+// Returns the permission bits that a file created with mode 0666 gets next to
+// tmpPath, i.e. 0666 & ~umask. The umask cannot be read without changing it,
+// which would affect files that other threads create at the same time, so a
+// file is created and removed again instead. Its name is derived from the
+// unique name of the temporary file. Returns 0600 if that does not work.
+// ---------------------------------------------------------------------------
+static mode_t aprmd5_helper_creation_mode(const char* tmpPath)
+{
+  mode_t mode = 0600;
+  size_t tmpPathLen = strlen(tmpPath);
+  char* probePath = (char*)malloc(tmpPathLen + sizeof(APRMD5_HELPER_MODESUFFIX));
+  if (NULL == probePath)
+    return mode;
+  memcpy(probePath, tmpPath, tmpPathLen);
+  memcpy(probePath + tmpPathLen, APRMD5_HELPER_MODESUFFIX, sizeof(APRMD5_HELPER_MODESUFFIX));
+  int fd = open(probePath, O_WRONLY | O_CREAT | O_EXCL, 0666);
+  if (fd >= 0)
+  {
+    struct stat status;
+    if (0 == fstat(fd, &status))
+      mode = status.st_mode & 0777;
+    close(fd);
+    unlink(probePath);
+  }
+  free(probePath);
+  return mode;
+}
+
+
+// ---------------------------------------------------------------------------
+// Creates a temporary file that is later renamed to replace a file, so that
+// readers of the file never see it half-written.
+//
+// The temporary file is created next to the file, with a unique name, with
+// O_EXCL and with mode 0600, so that a file or a symbolic link that someone
+// else planted cannot be followed or truncated, and concurrent writers do not
+// get in each other's way. If the file already exists, the temporary file
+// gets its permission bits; otherwise it gets the permission bits of a new
+// file, 0666 & ~umask, like the file that the htpasswd utility creates.
+//
+// Parameters:
+// - path: The path of the file that is to be replaced
+// - tmpPath: Receives the path of the temporary file, allocated with
+//   malloc(). The caller must free() it, also if the function fails.
+//
+// Return value:
+// - A file descriptor that is open for writing, or -1 with errno set
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_helper_tmpfile_create(const char* path, char** tmpPath)
+{
+  size_t pathLen = strlen(path);
+  *tmpPath = (char*)malloc(pathLen + sizeof(APRMD5_HELPER_TMPSUFFIX));
+  if (NULL == *tmpPath)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(*tmpPath, path, pathLen);
+  memcpy(*tmpPath + pathLen, APRMD5_HELPER_TMPSUFFIX, sizeof(APRMD5_HELPER_TMPSUFFIX));
+  int fd = mkstemp(*tmpPath);
+  if (fd < 0)
+    return -1;
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  struct stat status;
+  mode_t mode;
+  if (0 == stat(path, &status))
+  {
+    mode = status.st_mode & 07777;
+  }
+  else if (ENOENT == errno)
+  {
+    mode = aprmd5_helper_creation_mode(*tmpPath);
+  }
+  else
+  {
+    int error = errno;
+    aprmd5_helper_tmpfile_discard(fd, *tmpPath);
+    errno = error;
+    return -1;
+  }
+  if (0 != fchmod(fd, mode))
+  {
+    int error = errno;
+    aprmd5_helper_tmpfile_discard(fd, *tmpPath);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+
+// ---------------------------------------------------------------------------
+// Flushes a temporary file that was created by aprmd5_helper_tmpfile_create()
+// to disk, closes it and renames it to path. If anything fails, the temporary
+// file is removed. The file descriptor is closed in any case.
+//
+// Return value:
+// - 0 on success, otherwise an errno value
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_helper_tmpfile_commit(int fd, const char* tmpPath, const char* path)
+{
+  int result = 0;
+  if (0 != fsync(fd))
+    result = errno;
+  if (0 != close(fd) && 0 == result)
+    result = errno;
+  if (0 == result && 0 != rename(tmpPath, path))
+    result = errno;
+  if (0 != result)
+    unlink(tmpPath);
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Closes and removes a temporary file that was created by
+// aprmd5_helper_tmpfile_create(). errno is preserved.
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_helper_tmpfile_discard(int fd, const char* tmpPath)
+{
+  int error = errno;
+  close(fd);
+  unlink(tmpPath);
+  errno = error;
+}
+
+
+#if APRMD5_HAVE_FASTCALL
+
+// ---------------------------------------------------------------------------
+// Gets the strings from the arguments of a METH_FASTCALL function that takes
+// only positional string arguments. This does the same as PyArg_ParseTuple()
+// with one format unit "s" per argument, without the overhead of parsing a
+// format string.
+//
+// Parameters:
+// - args, nargs: The arguments as passed to the METH_FASTCALL function
+// - functionName: The name of the function; appears in error messages
+// - count: The number of arguments that the function takes
+// - strings: An array of count pointers that this function overwrites with
+//   the null-terminated UTF-8 representations of the arguments. The strings
+//   are owned by the argument objects.
+//
+// Return value:
+// - 0 on success
+// - -1 on failure, in which case a Python exception has been set
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_helper_fastcall_strings(PyObject* const* args, Py_ssize_t nargs, const char* functionName, Py_ssize_t count, const char** strings)
+{
+  if (nargs != count)
+  {
+    PyErr_Format(PyExc_TypeError, "%s() takes exactly %zd arguments (%zd given)", functionName, count, nargs);
+    return -1;
+  }
+  Py_ssize_t index;
+  for (index = 0; index < count; ++index)
+  {
+    if (! PyUnicode_Check(args[index]))
+    {
+      PyErr_Format(PyExc_TypeError, "%s() argument %zd must be str, not %.50s",
+                   functionName, index + 1, Py_TYPE(args[index])->tp_name);
+      return -1;
+    }
+    Py_ssize_t len;
+    strings[index] = PyUnicode_AsUTF8AndSize(args[index], &len);
+    if (NULL == strings[index])
+      return -1;
+    if ((size_t)len != strlen(strings[index]))
+    {
+      PyErr_SetString(PyExc_ValueError, "embedded null character");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+#endif  // #if APRMD5_HAVE_FASTCALL
+
+
+#if PY_MAJOR_VERSION >= 3
+
+// ---------------------------------------------------------------------------
+// Creates one of the module's heap types.
+//
+// Parameters:
+// - module: The module object that the type belongs to. Where the module
+//   has per-interpreter state, the state can be reached from the type with
+//   aprmd5_state_from_type().
+// - spec: The specification of the type
+//
+// Return value:
+// - A new reference to the type, or NULL with a Python exception set
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+PyObject* aprmd5_helper_type_from_spec(PyObject* module, PyType_Spec* spec)
+{
+#if APRMD5_HAVE_MODULE_STATE
+  return PyType_FromModuleAndSpec(module, spec, NULL);
+#else
+  return PyType_FromSpec(spec);
+#endif
+}
+
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+
+// ---------------------------------------------------------------------------
+// Copies the strings of an iterable of pairs into a newly allocated batch of
+// string pairs.
+//
+// Parameters:
+// - iterable: An iterable whose items are pairs, i.e. tuples or lists with
+//   two elements. Other sequences are rejected, because a string such as "ab"
+//   would otherwise be taken apart into a pair of characters. Each element
+//   must be acceptable to PyArg_ParseTuple() format unit "s".
+// - format: The PyArg_ParseTuple() format string that is used to parse each
+//   pair, e.g. "ss:md5_encode_many". The format string appears in error
+//   messages.
+// - pairs: A batch structure that is overwritten by this function. If the
+//   function succeeds, the caller must free the batch with
+//   aprmd5_helper_string_pairs_free().
+//
+// Return value:
+// - 0 on success
+// - -1 on failure, in which case a Python exception has been set and nothing
+//   needs to be freed
+//
+// Note: The strings are copied because the Python objects that they come from
+// might be mutated or destroyed by other threads as soon as the GIL is
+// released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_helper_string_pairs_create(PyObject* iterable, const char* format, aprmd5_helper_string_pairs* pairs)
+{
+  pairs->count = 0;
+  pairs->first = NULL;
+  pairs->second = NULL;
+  pairs->storage = NULL;
+
+  // Take a snapshot of the iterable, so that we don't have to worry about a
+  // list that is changed while we process it
+  PyObject* items = PySequence_Tuple(iterable);
+  if (NULL == items)
+    return -1;
+  Py_ssize_t count = PyTuple_GET_SIZE(items);
+
+  // Strings are first stored as offsets into the storage buffer, because the
+  // storage buffer may be moved while it grows
+  Py_ssize_t* offsets = PyMem_New(Py_ssize_t, 2 * count + 1);
+  Py_ssize_t storageSize = 64 * count + 64;
+  Py_ssize_t storageUsed = 0;
+  char* storage = PyMem_New(char, storageSize);
+  if (NULL == offsets || NULL == storage)
+  {
+    PyErr_NoMemory();
+    goto error;
+  }
+
+  Py_ssize_t index;
+  for (index = 0; index < count; ++index)
+  {
+    PyObject* item = PyTuple_GET_ITEM(items, index);
+    if (! PyTuple_Check(item) && ! PyList_Check(item))
+    {
+      PyErr_Format(PyExc_TypeError, "items must be tuples or lists of two strings, not %.200s",
+                   Py_TYPE(item)->tp_name);
+      goto error;
+    }
+    PyObject* pair = PySequence_Tuple(item);
+    if (NULL == pair)
+      goto error;
+    const char* strings[2];
+    if (! PyArg_ParseTuple(pair, format, &strings[0], &strings[1]))
+    {
+      Py_DECREF(pair);
+      goto error;
+    }
+    int stringIndex;
+    for (stringIndex = 0; stringIndex < 2; ++stringIndex)
+    {
+      Py_ssize_t stringSize = (Py_ssize_t)strlen(strings[stringIndex]) + 1;
+      if (storageUsed + stringSize > storageSize)
+      {
+        while (storageUsed + stringSize > storageSize)
+          storageSize *= 2;
+        char* newStorage = PyMem_Resize(storage, char, storageSize);
+        if (NULL == newStorage)
+        {
+          Py_DECREF(pair);
+          PyErr_NoMemory();
+          goto error;
+        }
+        storage = newStorage;
+      }
+      memcpy(storage + storageUsed, strings[stringIndex], stringSize);
+      offsets[2 * index + stringIndex] = storageUsed;
+      storageUsed += stringSize;
+    }
+    Py_DECREF(pair);
+  }
+  Py_DECREF(items);
+
+  // Now that the storage buffer has reached its final location, the offsets
+  // can be turned into pointers
+  pairs->first = PyMem_New(const char*, 2 * count + 1);
+  if (NULL == pairs->first)
+  {
+    PyMem_Free(offsets);
+    PyMem_Free(storage);
+    PyErr_NoMemory();
+    return -1;
+  }
+  pairs->second = pairs->first + count;
+  for (index = 0; index < count; ++index)
   {
-    // Make sure that each byte results in a two digit hex number (padded by
-    // leading 0, if necessary)
-    sprintf(&(hexDigest[j]), "%02x", binDigest[i]);
-    ++i;
-    j += 2;
+    pairs->first[index] = storage + offsets[2 * index];
+    pairs->second[index] = storage + offsets[2 * index + 1];
   }
+  PyMem_Free(offsets);
+  pairs->count = count;
+  pairs->storage = storage;
+  return 0;
+
+error:
+  Py_DECREF(items);
+  PyMem_Free(offsets);
+  PyMem_Free(storage);
+  return -1;
+}
+
+
+// ---------------------------------------------------------------------------
+// Frees the memory of a batch of string pairs that was created by
+// aprmd5_helper_string_pairs_create().
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_helper_string_pairs_free(aprmd5_helper_string_pairs* pairs)
+{
+  PyMem_Free((void*)pairs->first);
+  PyMem_Free(pairs->storage);
+  pairs->count = 0;
+  pairs->first = NULL;
+  pairs->second = NULL;
+  pairs->storage = NULL;
 }
@@ -26,10 +26,68 @@
 #ifndef APRMD5_HELPERS_H
 #define APRMD5_HELPERS_H
 
+// A batch of string pairs, copied out of Python objects so that the strings
+// can be accessed while the GIL is released
+typedef struct
+{
+  Py_ssize_t count;     // the number of pairs
+  const char** first;   // the first string of each pair, null-terminated
+  const char** second;  // the second string of each pair, null-terminated
+  char* storage;        // holds the characters of all strings
+} aprmd5_helper_string_pairs;
+
 extern void
 aprmd5_helper_bindigest_to_hexdigest(int binDigestSize,
                                      const unsigned char* binDigest,
                                      char* hexDigest);
 
+extern apr_status_t
+aprmd5_helper_md5_update(apr_md5_ctx_t* context,
+                         const void* input,
+                         Py_ssize_t inputLen);
+
+extern void
+aprmd5_helper_put_uint32(unsigned char* output,
+                         apr_uint32_t value);
+
+extern apr_uint32_t
+aprmd5_helper_get_uint32(const unsigned char* input);
+
+extern int
+aprmd5_helper_tmpfile_create(const char* path,
+                             char** tmpPath);
+
+extern int
+aprmd5_helper_tmpfile_commit(int fd,
+                             const char* tmpPath,
+                             const char* path);
+
+extern void
+aprmd5_helper_tmpfile_discard(int fd,
+                              const char* tmpPath);
+
+#if APRMD5_HAVE_FASTCALL
+extern int
+aprmd5_helper_fastcall_strings(PyObject* const* args,
+                               Py_ssize_t nargs,
+                               const char* functionName,
+                               Py_ssize_t count,
+                               const char** strings);
+#endif
+
+#if PY_MAJOR_VERSION >= 3
+extern PyObject*
+aprmd5_helper_type_from_spec(PyObject* module,
+                             PyType_Spec* spec);
+#endif
+
+extern int
+aprmd5_helper_string_pairs_create(PyObject* iterable,
+                                  const char* format,
+                                  aprmd5_helper_string_pairs* pairs);
+
+extern void
+aprmd5_helper_string_pairs_free(aprmd5_helper_string_pairs* pairs);
+
 
 #endif // #ifndef APRMD5_HELPERS_H
@@ -0,0 +1,1121 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the HtpasswdFile type exposed to Python.
+//
+// An HtpasswdFile object holds the content of an htpasswd file in a single
+// buffer, plus an index that maps each user name to the location of its line
+// in the buffer. The index is an open-addressing hash table with linear
+// probing; an entry takes 24 bytes and refers to the buffer by offset, so no
+// Python objects are created per user, and the memory used is the size of the
+// file plus a small multiple of the number of users.
+//
+// The file is watched for changes: before a lookup, the object stat()s the
+// file (at most once per check interval). If the device, inode, size or
+// modification time differ from the loaded file, the object reloads:
+//
+// - If the file is the same inode and has only grown, and all of the
+//   previously loaded content is unchanged, the file has been appended to.
+//   Only the new tail is added to the index. The old content must be
+//   compared in full: the htpasswd utility rewrites the file in place, so a
+//   line that was changed to a hash of the same length does not show in the
+//   size or the inode.
+// - Otherwise the buffer and the index are rebuilt from scratch.
+//
+// The file is read with the GIL held. Reloads are rare and htpasswd files are
+// small, and holding the GIL means that lookups need no lock of their own. In
+// the free-threaded build, lookups and reloads are serialized with a critical
+// section on the object instead.
+// The file is read into memory rather than mapped: a mapped file that is
+// rewritten in place by the htpasswd utility would crash the interpreter
+// with SIGBUS if it is accessed while it is shorter than before.
+//
+// The file format is the one that Apache's mod_authn_file reads: one
+// "user:hash" pair per line, lines that are empty or start with '#' are
+// ignored, and if a user appears more than once the first line wins.
+//
+// write_htpasswd() writes such a file in bulk. The pairs are taken from the
+// iterable in chunks; the salts of a chunk are generated natively, the
+// passwords are encoded on the native thread pool, and the lines are written
+// in input order with one write() per chunk, all with the GIL released. The
+// lines go to a temporary file with a unique name next to the target, which
+// replaces the target only once it is complete.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_htpasswd.h"
+#include "aprmd5_helpers.h"
+#include "aprmd5_passwd.h"
+#include "aprmd5_apr1.h"
+#include "aprmd5_wrappers.h"
+
+// Defines PyMemberDef and PyMethodDef. Weird - why is this not in Python.h?
+// See http://bugs.python.org/issue2897.
+#include <structmember.h>
+
+// System includes
+#include <errno.h>
+#include <fcntl.h>      // for open()
+#include <string.h>     // for memchr(), memcmp(), memcpy(), strlen()
+#include <sys/stat.h>
+#include <time.h>       // for clock_gettime()
+#include <stdlib.h>     // for free()
+#include <unistd.h>     // for pread(), write(), close()
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+// The modification time of a struct stat, with nanoseconds. Darwin names the
+// field differently than POSIX.1-2008.
+#if defined(__APPLE__)
+#define APRMD5_HTPASSWD_MTIME(st) ((st)->st_mtimespec)
+#else
+#define APRMD5_HTPASSWD_MTIME(st) ((st)->st_mtim)
+#endif
+
+
+// The number of users that write_htpasswd() encodes and writes in one go.
+// Each user takes 1000 rounds of MD5, so a chunk keeps all threads busy for
+// a while, and the memory for a chunk stays well below 1 MiB.
+#define APRMD5_HTPASSWD_WRITECHUNKSIZE 4096
+
+// The size of the pieces in which the loaded content is compared with the
+// file before an incremental reload
+#define APRMD5_HTPASSWD_COMPARECHUNKSIZE 4096
+
+// Hashes up to this size are validated from a buffer on the stack
+#define APRMD5_HTPASSWD_STACKHASHSIZE 256
+
+
+// ---------------------------------------------------------------------------
+// Various strings that are exposed to Python and visible to the user
+// ---------------------------------------------------------------------------
+
+const char* aprmd5_htpasswd_type_name = "HtpasswdFile";
+static char* aprmd5_htpasswd_init_kwlist[] = {"path", "check_interval", NULL};
+
+
+// ---------------------------------------------------------------------------
+// Definition of the C type that is used to create HtpasswdFile objects
+// ---------------------------------------------------------------------------
+
+// An index entry. An entry with userLen 0 is empty.
+typedef struct
+{
+  apr_uint64_t offset;          // offset of the user name in the buffer; the
+                                // hash follows the ':' after the user name
+  apr_uint32_t userLen;
+  apr_uint32_t hashLen;
+  apr_uint32_t userHash;        // hash value of the user name
+} aprmd5_htpasswd_entry;
+
+typedef struct {
+  // Adds reference count and a pointer to the actual type object
+  PyObject_HEAD
+  // Type-specific fields go here
+  char* path;                   // NULL until the object has been initialized
+  apr_int64_t checkInterval;    // in ns; -1 = never check automatically
+  apr_int64_t lastCheck;        // monotonic time in ns
+  // The loaded content
+  char* data;
+  size_t size;
+  size_t capacity;
+  size_t parsedSize;            // the content up to here has been indexed
+  struct stat fileStat;         // of the loaded file
+  // The index
+  aprmd5_htpasswd_entry* entries;
+  size_t entryMask;             // the number of entries - 1
+  size_t userCount;
+  // Counters
+  apr_uint64_t fullReloads;
+  apr_uint64_t incrementalReloads;
+} aprmd5_htpasswd_object;
+
+
+// ---------------------------------------------------------------------------
+// Helper functions
+// ---------------------------------------------------------------------------
+
+static apr_int64_t
+aprmd5_htpasswd_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (apr_int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// FNV-1a
+static apr_uint32_t
+aprmd5_htpasswd_hash_user(const char* user, size_t userLen)
+{
+  apr_uint32_t hash = 2166136261u;
+  size_t index;
+  for (index = 0; index < userLen; ++index)
+  {
+    hash ^= (unsigned char)user[index];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Returns the index entry of a user, or NULL if the user is not in the index
+static aprmd5_htpasswd_entry*
+aprmd5_htpasswd_find(aprmd5_htpasswd_object* self, const char* user, size_t userLen)
+{
+  if (NULL == self->entries || 0 == userLen)
+    return NULL;
+  apr_uint32_t userHash = aprmd5_htpasswd_hash_user(user, userLen);
+  size_t slot = userHash & self->entryMask;
+  for (;; slot = (slot + 1) & self->entryMask)
+  {
+    aprmd5_htpasswd_entry* entry = &self->entries[slot];
+    if (0 == entry->userLen)
+      return NULL;
+    if (entry->userHash == userHash && entry->userLen == userLen
+        && 0 == memcmp(self->data + entry->offset, user, userLen))
+      return entry;
+  }
+}
+
+// Adds an entry to a table without checking for duplicates. The table must
+// have at least one empty entry.
+static void
+aprmd5_htpasswd_place(aprmd5_htpasswd_entry* entries, size_t entryMask, const aprmd5_htpasswd_entry* entry)
+{
+  size_t slot = entry->userHash & entryMask;
+  while (0 != entries[slot].userLen)
+    slot = (slot + 1) & entryMask;
+  entries[slot] = *entry;
+}
+
+// Makes room for at least one more user; the load factor is kept at or below
+// 1/2. Returns 0 on success, or -1 if memory could not be allocated.
+static int
+aprmd5_htpasswd_reserve(aprmd5_htpasswd_object* self)
+{
+  size_t entryCount = (NULL == self->entries) ? 0 : self->entryMask + 1;
+  if (2 * (self->userCount + 1) <= entryCount)
+    return 0;
+
+  size_t newEntryCount = entryCount ? 2 * entryCount : 64;
+  aprmd5_htpasswd_entry* newEntries = PyMem_New(aprmd5_htpasswd_entry, newEntryCount);
+  if (NULL == newEntries)
+    return -1;
+  memset(newEntries, 0, newEntryCount * sizeof(aprmd5_htpasswd_entry));
+  size_t slot;
+  for (slot = 0; slot < entryCount; ++slot)
+  {
+    if (0 != self->entries[slot].userLen)
+      aprmd5_htpasswd_place(newEntries, newEntryCount - 1, &self->entries[slot]);
+  }
+  PyMem_Free(self->entries);
+  self->entries = newEntries;
+  self->entryMask = newEntryCount - 1;
+  return 0;
+}
+
+// Indexes the lines of the loaded content, starting at self->parsedSize. A
+// last line without a line break is indexed, but not counted as parsed.
+// Returns 0 on success, or -1 if memory could not be allocated.
+static int
+aprmd5_htpasswd_parse(aprmd5_htpasswd_object* self)
+{
+  size_t lineStart = self->parsedSize;
+  while (lineStart < self->size)
+  {
+    const char* line = self->data + lineStart;
+    size_t remaining = self->size - lineStart;
+    const char* lineBreak = (const char*)memchr(line, '\n', remaining);
+    size_t lineLen = (NULL == lineBreak) ? remaining : (size_t)(lineBreak - line);
+    size_t nextLineStart = lineStart + lineLen + ((NULL == lineBreak) ? 0 : 1);
+
+    size_t contentLen = lineLen;
+    if (contentLen > 0 && '\r' == line[contentLen - 1])
+      --contentLen;
+    const char* colon = (const char*)memchr(line, ':', contentLen);
+    if (contentLen > 0 && '#' != line[0] && NULL != colon && colon != line
+        && (size_t)(colon - line) <= 0xffffffffu && contentLen <= 0xffffffffu)
+    {
+      size_t userLen = (size_t)(colon - line);
+      if (NULL == aprmd5_htpasswd_find(self, line, userLen))
+      {
+        if (aprmd5_htpasswd_reserve(self) < 0)
+          return -1;
+        aprmd5_htpasswd_entry entry;
+        entry.offset = lineStart;
+        entry.userLen = (apr_uint32_t)userLen;
+        entry.hashLen = (apr_uint32_t)(contentLen - userLen - 1);
+        entry.userHash = aprmd5_htpasswd_hash_user(line, userLen);
+        aprmd5_htpasswd_place(self->entries, self->entryMask, &entry);
+        ++self->userCount;
+      }
+    }
+
+    if (NULL != lineBreak)
+      self->parsedSize = nextLineStart;
+    lineStart = nextLineStart;
+  }
+  return 0;
+}
+
+// Reads len bytes at the specified offset of a file. Returns 0 on success, or
+// an errno value; EAGAIN if the file is shorter than expected (it was
+// truncated while it was read).
+static int
+aprmd5_htpasswd_read(int fd, char* buffer, off_t offset, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t bytesRead = pread(fd, buffer, len, offset);
+    if (bytesRead < 0 && EINTR == errno)
+      continue;
+    if (bytesRead < 0)
+      return errno;
+    if (0 == bytesRead)
+      return EAGAIN;
+    buffer += bytesRead;
+    offset += bytesRead;
+    len -= (size_t)bytesRead;
+  }
+  return 0;
+}
+
+// Returns 1 if the file is the same inode as the loaded file, has grown, and
+// still starts with all of the loaded content.
+static int
+aprmd5_htpasswd_is_appended(aprmd5_htpasswd_object* self, int fd, const struct stat* st)
+{
+  if (NULL == self->data
+      || st->st_dev != self->fileStat.st_dev
+      || st->st_ino != self->fileStat.st_ino
+      || st->st_size <= self->fileStat.st_size
+      || (off_t)self->size != self->fileStat.st_size
+      || self->parsedSize != self->size)   // last line had no line break
+    return 0;
+
+  char chunk[APRMD5_HTPASSWD_COMPARECHUNKSIZE];
+  size_t offset;
+  for (offset = 0; offset < self->size; offset += sizeof(chunk))
+  {
+    size_t chunkLen = self->size - offset < sizeof(chunk) ? self->size - offset : sizeof(chunk);
+    if (0 != aprmd5_htpasswd_read(fd, chunk, (off_t)offset, chunkLen)
+        || 0 != memcmp(chunk, self->data + offset, chunkLen))
+      return 0;
+  }
+  return 1;
+}
+
+// Discards the loaded content and the index.
+static void
+aprmd5_htpasswd_clear(aprmd5_htpasswd_object* self)
+{
+  PyMem_Free(self->data);
+  PyMem_Free(self->entries);
+  self->data = NULL;
+  self->size = 0;
+  self->capacity = 0;
+  self->parsedSize = 0;
+  self->entries = NULL;
+  self->entryMask = 0;
+  self->userCount = 0;
+}
+
+// Loads the file, or the part of it that has been appended since it was last
+// loaded. If force is 0, nothing happens if the file looks unchanged. Returns
+// 0 on success, or an errno value. On failure, the previously loaded content
+// stays in use.
+static int
+aprmd5_htpasswd_load(aprmd5_htpasswd_object* self, int force)
+{
+  int fd = open(self->path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return errno;
+
+  int result = 0;
+  struct stat st;
+  if (0 != fstat(fd, &st))
+  {
+    result = errno;
+    goto done;
+  }
+  if (! force && NULL != self->data
+      && st.st_dev == self->fileStat.st_dev
+      && st.st_ino == self->fileStat.st_ino
+      && st.st_size == self->fileStat.st_size
+      && APRMD5_HTPASSWD_MTIME(&st).tv_sec == APRMD5_HTPASSWD_MTIME(&self->fileStat).tv_sec
+      && APRMD5_HTPASSWD_MTIME(&st).tv_nsec == APRMD5_HTPASSWD_MTIME(&self->fileStat).tv_nsec)
+    goto done;
+  if (st.st_size < 0 || (apr_uint64_t)st.st_size >= (apr_uint64_t)PY_SSIZE_T_MAX)
+  {
+    result = EFBIG;
+    goto done;
+  }
+
+  size_t newSize = (size_t)st.st_size;
+  if (aprmd5_htpasswd_is_appended(self, fd, &st))
+  {
+    // Append the tail to the existing buffer and index
+    if (newSize > self->capacity)
+    {
+      size_t newCapacity = self->capacity * 2 > newSize ? self->capacity * 2 : newSize;
+      char* newData = (char*)PyMem_Realloc(self->data, newCapacity);
+      if (NULL == newData)
+      {
+        result = ENOMEM;
+        goto done;
+      }
+      self->data = newData;
+      self->capacity = newCapacity;
+    }
+    result = aprmd5_htpasswd_read(fd, self->data + self->size, (off_t)self->size, newSize - self->size);
+    if (0 != result)
+      goto done;
+    self->size = newSize;
+    if (aprmd5_htpasswd_parse(self) < 0)
+    {
+      // The index is incomplete; make sure that the next check rebuilds it
+      self->fileStat.st_size = -1;
+      result = ENOMEM;
+      goto done;
+    }
+    ++self->incrementalReloads;
+  }
+  else
+  {
+    // Rebuild from scratch. The old content is kept until the new content has
+    // been read successfully.
+    char* newData = (char*)PyMem_Malloc(newSize ? newSize : 1);
+    if (NULL == newData)
+    {
+      result = ENOMEM;
+      goto done;
+    }
+    result = aprmd5_htpasswd_read(fd, newData, 0, newSize);
+    if (0 != result)
+    {
+      PyMem_Free(newData);
+      goto done;
+    }
+    aprmd5_htpasswd_clear(self);
+    self->data = newData;
+    self->size = newSize;
+    self->capacity = newSize;
+    if (aprmd5_htpasswd_parse(self) < 0)
+    {
+      aprmd5_htpasswd_clear(self);
+      result = ENOMEM;
+      goto done;
+    }
+    ++self->fullReloads;
+  }
+  self->fileStat = st;
+
+done:
+  close(fd);
+  return result;
+}
+
+// Sets a Python exception for an errno value returned by
+// aprmd5_htpasswd_load().
+static void
+aprmd5_htpasswd_set_error(aprmd5_htpasswd_object* self, int error)
+{
+  if (ENOMEM == error)
+  {
+    PyErr_NoMemory();
+    return;
+  }
+  errno = error;
+  PyErr_SetFromErrnoWithFilename(PyExc_OSError, self->path);
+}
+
+// Sets a Python exception if the object has not been initialized. Returns 0
+// if the object is usable, otherwise -1.
+static int
+aprmd5_htpasswd_check(aprmd5_htpasswd_object* self)
+{
+  if (NULL != self->path)
+    return 0;
+  PyErr_SetString(PyExc_RuntimeError, "HtpasswdFile object has not been initialized");
+  return -1;
+}
+
+// Reloads the file if the check interval has elapsed and the file has
+// changed. Errors are ignored: while the file is being replaced it may be
+// missing for a moment, and in that case the loaded content is still the
+// best answer.
+static void
+aprmd5_htpasswd_refresh(aprmd5_htpasswd_object* self)
+{
+  if (self->checkInterval < 0)
+    return;
+  apr_int64_t now = aprmd5_htpasswd_now();
+  if (now - self->lastCheck < self->checkInterval)
+    return;
+  self->lastCheck = now;
+  aprmd5_htpasswd_load(self, 0);
+}
+
+
+// ---------------------------------------------------------------------------
+// Allocation/initialization/deallocation of HtpasswdFile objects
+// ---------------------------------------------------------------------------
+
+static PyObject*
+aprmd5_htpasswd_object_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+  aprmd5_htpasswd_object* self = (aprmd5_htpasswd_object*)type->tp_alloc(type, 0);
+  if (NULL == self)
+    return NULL;
+  self->path = NULL;
+  self->data = NULL;
+  self->entries = NULL;
+  aprmd5_htpasswd_clear(self);
+  return (PyObject*)self;
+}
+
+static int
+aprmd5_htpasswd_object_init(aprmd5_htpasswd_object* self, PyObject* args, PyObject* kwds)
+{
+  double checkInterval = 1.0;
+  PyObject* checkIntervalObject = NULL;
+#if PY_MAJOR_VERSION >= 3
+  PyObject* pathObject = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O&|O:HtpasswdFile", aprmd5_htpasswd_init_kwlist,
+                                    PyUnicode_FSConverter, &pathObject, &checkIntervalObject))
+    return -1;
+  const char* path = PyBytes_AS_STRING(pathObject);
+#else   // #if PY_MAJOR_VERSION >= 3
+  const char* path = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "s|O:HtpasswdFile", aprmd5_htpasswd_init_kwlist,
+                                    &path, &checkIntervalObject))
+    return -1;
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+  int result = -1;
+  if (NULL != self->path)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "HtpasswdFile object is already initialized");
+    goto done;
+  }
+  // None means that the file is only reloaded by reload()
+  self->checkInterval = -1;
+  if (NULL != checkIntervalObject && Py_None != checkIntervalObject)
+  {
+    checkInterval = PyFloat_AsDouble(checkIntervalObject);
+    if (-1.0 == checkInterval && PyErr_Occurred())
+      goto done;
+    if (! (checkInterval >= 0.0) || checkInterval > 1e9)
+    {
+      PyErr_SetString(PyExc_ValueError, "check_interval must be a non-negative number of seconds, or None");
+      goto done;
+    }
+  }
+  if (Py_None != checkIntervalObject)
+    self->checkInterval = (apr_int64_t)(checkInterval * 1e9);
+
+  size_t pathLen = strlen(path);
+  self->path = (char*)PyMem_Malloc(pathLen + 1);
+  if (NULL == self->path)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+  memcpy(self->path, path, pathLen + 1);
+
+  int error = aprmd5_htpasswd_load(self, 1);
+  if (0 != error)
+  {
+    aprmd5_htpasswd_set_error(self, error);
+    PyMem_Free(self->path);
+    self->path = NULL;
+    goto done;
+  }
+  self->lastCheck = aprmd5_htpasswd_now();
+  result = 0;
+
+done:
+#if PY_MAJOR_VERSION >= 3
+  Py_DECREF(pathObject);
+#endif  // #if PY_MAJOR_VERSION >= 3
+  return result;
+}
+
+static void
+aprmd5_htpasswd_object_dealloc(aprmd5_htpasswd_object* self)
+{
+  aprmd5_htpasswd_clear(self);
+  PyMem_Free(self->path);
+#if PY_MAJOR_VERSION >= 3
+  PyTypeObject* type = Py_TYPE(self);
+#else   // #if PY_MAJOR_VERSION >= 3
+  PyTypeObject* type = self->ob_type;
+#endif  // #if PY_MAJOR_VERSION >= 3
+  type->tp_free((PyObject*)self);
+  APRMD5_TYPE_DECREF(type);
+}
+
+
+// ---------------------------------------------------------------------------
+// Implementation of HtpasswdFile methods
+// ---------------------------------------------------------------------------
+
+static PyObject*
+aprmd5_htpasswd_object_validate(aprmd5_htpasswd_object* self, PyObject* args)
+{
+  const char* user = NULL;
+  const char* password = NULL;
+  if (! PyArg_ParseTuple(args, "ss:validate", &user, &password))
+    return NULL;
+  if (aprmd5_htpasswd_check(self) < 0)
+    return NULL;
+
+  // The hash is copied because the buffer may be replaced by a reload in
+  // another thread while the GIL is released
+  char stackHash[APRMD5_HTPASSWD_STACKHASHSIZE];
+  char* hash = NULL;
+  int found = 0;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  aprmd5_htpasswd_refresh(self);
+  const aprmd5_htpasswd_entry* entry = aprmd5_htpasswd_find(self, user, strlen(user));
+  if (NULL != entry)
+  {
+    found = 1;
+    hash = stackHash;
+    if (entry->hashLen >= sizeof(stackHash))
+      hash = (char*)PyMem_Malloc(entry->hashLen + 1);
+    if (NULL != hash)
+    {
+      memcpy(hash, self->data + entry->offset + entry->userLen + 1, entry->hashLen);
+      hash[entry->hashLen] = '\0';
+    }
+  }
+  APRMD5_END_CRITICAL_SECTION();
+  if (! found)
+    Py_RETURN_FALSE;
+  if (NULL == hash)
+    return PyErr_NoMemory();
+
+  apr_status_t status;
+  Py_BEGIN_ALLOW_THREADS
+  status = aprmd5_passwd_validate(password, hash);
+  Py_END_ALLOW_THREADS
+
+  if (hash != stackHash)
+    PyMem_Free(hash);
+  return PyBool_FromLong(APR_SUCCESS == status);
+}
+
+static PyObject*
+aprmd5_htpasswd_object_reload(aprmd5_htpasswd_object* self, PyObject* args)
+{
+  if (aprmd5_htpasswd_check(self) < 0)
+    return NULL;
+  int error;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  self->lastCheck = aprmd5_htpasswd_now();
+  error = aprmd5_htpasswd_load(self, 0);
+  APRMD5_END_CRITICAL_SECTION();
+  if (0 != error)
+  {
+    aprmd5_htpasswd_set_error(self, error);
+    return NULL;
+  }
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject*
+aprmd5_htpasswd_object_stats(aprmd5_htpasswd_object* self, PyObject* args)
+{
+  if (aprmd5_htpasswd_check(self) < 0)
+    return NULL;
+  PyObject* result;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  result = Py_BuildValue("{s:n,s:n,s:K,s:K}",
+                         "users", (Py_ssize_t)self->userCount,
+                         "size", (Py_ssize_t)self->size,
+                         "full_reloads", (unsigned long long)self->fullReloads,
+                         "incremental_reloads", (unsigned long long)self->incrementalReloads);
+  APRMD5_END_CRITICAL_SECTION();
+  return result;
+}
+
+static Py_ssize_t
+aprmd5_htpasswd_object_length(aprmd5_htpasswd_object* self)
+{
+  if (aprmd5_htpasswd_check(self) < 0)
+    return -1;
+  Py_ssize_t userCount;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  aprmd5_htpasswd_refresh(self);
+  userCount = (Py_ssize_t)self->userCount;
+  APRMD5_END_CRITICAL_SECTION();
+  return userCount;
+}
+
+static int
+aprmd5_htpasswd_object_contains(aprmd5_htpasswd_object* self, PyObject* userObject)
+{
+  if (aprmd5_htpasswd_check(self) < 0)
+    return -1;
+  const char* user = NULL;
+  if (! PyArg_Parse(userObject, "s", &user))
+    return -1;
+  int found;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  aprmd5_htpasswd_refresh(self);
+  found = (NULL != aprmd5_htpasswd_find(self, user, strlen(user)));
+  APRMD5_END_CRITICAL_SECTION();
+  return found;
+}
+
+
+// ---------------------------------------------------------------------------
+// Implementation of HtpasswdFile attribute getters/setters
+// ---------------------------------------------------------------------------
+
+static PyObject *
+aprmd5_htpasswd_object_get_path(aprmd5_htpasswd_object* self, void* closure)
+{
+  if (aprmd5_htpasswd_check(self) < 0)
+    return NULL;
+#if PY_MAJOR_VERSION >= 3
+  return PyUnicode_DecodeFSDefault(self->path);
+#else
+  return PyString_FromString(self->path);
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+// Attributes and methods of HtpasswdFile
+// ---------------------------------------------------------------------------
+
+static PyMemberDef aprmd5_htpasswd_object_members[] =
+{
+  {NULL}  // Sentinel
+};
+
+static PyGetSetDef aprmd5_htpasswd_object_getseters[] =
+{
+  {
+    "path",
+    (getter)aprmd5_htpasswd_object_get_path, NULL,
+    "The path of the htpasswd file.",
+    NULL
+  },
+  {NULL}  /* Sentinel */
+};
+
+static PyMethodDef aprmd5_htpasswd_object_methods[] =
+{
+  {
+    "validate", (PyCFunction)aprmd5_htpasswd_object_validate, METH_VARARGS,
+    "Validate the password of a user like password_validate() does with the user's hash from the file. Returns False if the user is not in the file. If the file has changed, it is reloaded first (at most once per check_interval)."
+  },
+  {
+    "reload", (PyCFunction)aprmd5_htpasswd_object_reload, METH_NOARGS,
+    "Reload the file now if it has changed. If the file has only been appended to, only the new lines are added to the index. Raises OSError if the file cannot be read; the previously loaded content stays in use in that case."
+  },
+  {
+    "stats", (PyCFunction)aprmd5_htpasswd_object_stats, METH_NOARGS,
+    "Return a dictionary with the number of users, the size of the loaded content, and the number of full and incremental reloads."
+  },
+  {NULL}  // Sentinel
+};
+
+// ---------------------------------------------------------------------------
+// Definition of the Python type
+// ---------------------------------------------------------------------------
+
+#if PY_MAJOR_VERSION >= 3
+
+static PyType_Slot aprmd5_htpasswd_type_slots[] =
+{
+  {Py_tp_dealloc, (void*)aprmd5_htpasswd_object_dealloc},
+  {Py_tp_doc, "Instances of this class validate passwords against an htpasswd file"},
+  {Py_tp_methods, aprmd5_htpasswd_object_methods},
+  {Py_tp_members, aprmd5_htpasswd_object_members},
+  {Py_tp_getset, aprmd5_htpasswd_object_getseters},
+  {Py_tp_init, (void*)aprmd5_htpasswd_object_init},
+  {Py_tp_new, (void*)aprmd5_htpasswd_object_new},
+  {Py_sq_length, (void*)aprmd5_htpasswd_object_length},
+  {Py_sq_contains, (void*)aprmd5_htpasswd_object_contains},
+  {0, NULL}
+};
+
+static PyType_Spec aprmd5_htpasswd_type_spec =
+{
+  "aprmd5.HtpasswdFile",
+  sizeof(aprmd5_htpasswd_object),
+  0,
+  APRMD5_TPFLAGS_DEFAULT,
+  aprmd5_htpasswd_type_slots
+};
+
+#else   // #if PY_MAJOR_VERSION >= 3
+
+static PySequenceMethods aprmd5_htpasswd_object_as_sequence =
+{
+  (lenfunc)aprmd5_htpasswd_object_length,       // sq_length
+  0,                                            // sq_concat
+  0,                                            // sq_repeat
+  0,                                            // sq_item
+  0,                                            // sq_slice (Python 2.x)
+  0,                                            // sq_ass_item
+  0,                                            // sq_ass_slice (Python 2.x)
+  (objobjproc)aprmd5_htpasswd_object_contains,  // sq_contains
+};
+
+static PyTypeObject aprmd5_htpasswd_type =
+{
+  PyObject_HEAD_INIT(NULL)
+  0,                             // ob_size
+  "aprmd5.HtpasswdFile",         // tp_name
+  sizeof(aprmd5_htpasswd_object),// tp_basicsize
+  0,                             // tp_itemsize
+  (destructor)
+    aprmd5_htpasswd_object_dealloc, // tp_dealloc
+  0,                             // tp_print
+  0,                             // tp_getattr
+  0,                             // tp_setattr
+  0,                             // tp_compare
+  0,                             // tp_repr
+  0,                             // tp_as_number
+  &aprmd5_htpasswd_object_as_sequence, // tp_as_sequence
+  0,                             // tp_as_mapping
+  0,                             // tp_hash
+  0,                             // tp_call
+  0,                             // tp_str
+  0,                             // tp_getattro
+  0,                             // tp_setattro
+  0,                             // tp_as_buffer
+  Py_TPFLAGS_DEFAULT,            // tp_flags; Py_TPFLAGS_DEFAULT enables all
+                                 // members defined by the version of Python
+                                 // that this is compiled for
+  "Instances of this class validate passwords against an htpasswd file", // tp_doc
+  0,                             // tp_traverse
+  0,                             // tp_clear
+  0,                             // tp_richcompare
+  0,                             // tp_weaklistoffset
+  0,                             // tp_iter
+  0,                             // tp_iternext
+  aprmd5_htpasswd_object_methods,   // tp_methods
+  aprmd5_htpasswd_object_members,   // tp_members
+  aprmd5_htpasswd_object_getseters, // tp_getset
+  0,                             // tp_base
+  0,                             // tp_dict
+  0,                             // tp_descr_get
+  0,                             // tp_descr_set
+  0,                             // tp_dictoffset
+  (initproc)
+    aprmd5_htpasswd_object_init, // tp_init
+  0,                             // tp_alloc
+  aprmd5_htpasswd_object_new,    // tp_new
+};
+
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+
+// Creates the type of a module. Returns a new reference, or NULL with a Python
+// exception set.
+PyObject*
+aprmd5_htpasswd_type_create(PyObject* module)
+{
+#if PY_MAJOR_VERSION >= 3
+  return aprmd5_helper_type_from_spec(module, &aprmd5_htpasswd_type_spec);
+#else   // #if PY_MAJOR_VERSION >= 3
+  if (PyType_Ready(&aprmd5_htpasswd_type) < 0)
+    return NULL;
+  Py_INCREF(&aprmd5_htpasswd_type);
+  return (PyObject*)&aprmd5_htpasswd_type;
+#endif  // #if PY_MAJOR_VERSION >= 3
+}
+
+
+// ---------------------------------------------------------------------------
+// Bulk writing of htpasswd files
+// ---------------------------------------------------------------------------
+
+// The buffers of write_htpasswd(); they are allocated once and reused for
+// every chunk
+typedef struct
+{
+  aprmd5_helper_string_pairs pairs;   // (user, password) of the current chunk
+  char* salts;                        // APRMD5_APR1_SALTLEN + 1 bytes per user
+  const char** saltPointers;
+  char* results;                      // APRMD5_APR1_HASHSIZE bytes per user
+  apr_status_t* statuses;
+  char* output;                       // the lines of the current chunk
+  Py_ssize_t outputSize;
+} aprmd5_htpasswd_writer;
+
+// Collects the next chunk of pairs from an iterator. Returns the number of
+// pairs, 0 at the end of the iterator, or -1 with a Python exception set.
+static Py_ssize_t
+aprmd5_htpasswd_writer_next(aprmd5_htpasswd_writer* writer, PyObject* iterator)
+{
+  PyObject* chunk = PyList_New(0);
+  if (NULL == chunk)
+    return -1;
+  while (PyList_GET_SIZE(chunk) < APRMD5_HTPASSWD_WRITECHUNKSIZE)
+  {
+    PyObject* item = PyIter_Next(iterator);
+    if (NULL == item)
+      break;
+    int appended = PyList_Append(chunk, item);
+    Py_DECREF(item);
+    if (appended < 0)
+      break;
+  }
+  if (PyErr_Occurred()
+      || aprmd5_helper_string_pairs_create(chunk, "ss:write_htpasswd", &writer->pairs) < 0)
+  {
+    Py_DECREF(chunk);
+    return -1;
+  }
+  Py_DECREF(chunk);
+
+  // The lines of a chunk must not be corrupted by a user name that contains
+  // the field or the line separator
+  Py_ssize_t index;
+  Py_ssize_t outputSize = 0;
+  for (index = 0; index < writer->pairs.count; ++index)
+  {
+    const char* user = writer->pairs.first[index];
+    size_t userLen = strlen(user);
+    if (0 == userLen || userLen != strcspn(user, ":\r\n"))
+    {
+      PyErr_SetString(PyExc_ValueError, "user names must not be empty, and must not contain ':' or line breaks");
+      return -1;
+    }
+    // +1 for ':'; the null byte of the hash becomes the newline
+    outputSize += (Py_ssize_t)userLen + 1 + APRMD5_APR1_HASHSIZE;
+  }
+  if (outputSize > writer->outputSize)
+  {
+    char* output = PyMem_Resize(writer->output, char, outputSize);
+    if (NULL == output)
+    {
+      PyErr_NoMemory();
+      return -1;
+    }
+    writer->output = output;
+    writer->outputSize = outputSize;
+  }
+  return writer->pairs.count;
+}
+
+// Encodes the current chunk and appends its lines to the file. Returns 0 on
+// success, an errno value if the salts could not be generated or the file
+// could not be written, or -1 if a password could not be encoded. Must be
+// called with the GIL released.
+static int
+aprmd5_htpasswd_writer_write(aprmd5_htpasswd_writer* writer, int fd, int threadCount)
+{
+  Py_ssize_t count = writer->pairs.count;
+  int result = aprmd5_apr1_generate_salts(writer->salts, count);
+  if (0 != result)
+    return result;
+  Py_ssize_t index;
+  for (index = 0; index < count; ++index)
+    writer->saltPointers[index] = writer->salts + index * (APRMD5_APR1_SALTLEN + 1);
+  aprmd5_md5_encode_batch(threadCount, writer->pairs.second, writer->saltPointers, count,
+                          writer->results, writer->statuses);
+
+  char* line = writer->output;
+  for (index = 0; index < count; ++index)
+  {
+    if (APR_SUCCESS != writer->statuses[index])
+      return -1;
+    size_t userLen = strlen(writer->pairs.first[index]);
+    const char* hash = writer->results + index * APRMD5_APR1_HASHSIZE;
+    size_t hashLen = strlen(hash);
+    memcpy(line, writer->pairs.first[index], userLen);
+    line += userLen;
+    *line++ = ':';
+    memcpy(line, hash, hashLen);
+    line += hashLen;
+    *line++ = '\n';
+  }
+
+  const char* output = writer->output;
+  size_t outputLen = (size_t)(line - writer->output);
+  while (outputLen > 0)
+  {
+    ssize_t bytesWritten = write(fd, output, outputLen);
+    if (bytesWritten < 0)
+    {
+      if (EINTR == errno)
+        continue;
+      return errno;
+    }
+    output += bytesWritten;
+    outputLen -= (size_t)bytesWritten;
+  }
+  return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// This function writes an htpasswd file with an apr1 hash for each user.
+// From within Python, this function will be available as
+//
+//   aprmd5.write_htpasswd()
+//
+// Each user gets a random salt of 8 characters, like the htpasswd command
+// line utility generates it. Salts are drawn from the kernel's random pool,
+// the passwords are encoded on a pool of native threads, and the lines are
+// written in input order, all with the GIL released. The file is written to
+// a temporary file next to it, which replaces the file when all users have
+// been written; if an error occurs, the file is left unchanged.
+//
+// Parameters of the Python function:
+// - path: The path of the htpasswd file; a string, a bytes object or an
+//   os.PathLike object
+// - pairs: an iterable of (user, password) pairs. The iterable is consumed
+//   in chunks, so it can be a generator that produces millions of pairs.
+//   User names must not be empty, and must not contain ':' or line breaks.
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core
+//
+// Return value of the Python function:
+// - The number of users that were written
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_write_htpasswd(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"path", "pairs", "threads", NULL};
+  PyObject* iterable;
+  int threadCount = 0;
+#if PY_MAJOR_VERSION >= 3
+  PyObject* pathObject = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O&O|$i:write_htpasswd", kwlist,
+                                    PyUnicode_FSConverter, &pathObject, &iterable, &threadCount))
+    return NULL;
+  const char* path = PyBytes_AS_STRING(pathObject);
+#else   // #if PY_MAJOR_VERSION >= 3
+  const char* path = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "sO|i:write_htpasswd", kwlist,
+                                    &path, &iterable, &threadCount))
+    return NULL;
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+  PyObject* result = NULL;
+  PyObject* iterator = NULL;
+  char* tmpPath = NULL;
+  int fd = -1;
+  int error = 0;
+  aprmd5_htpasswd_writer writer;
+  memset(&writer, 0, sizeof(writer));
+  if (threadCount < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+    goto done;
+  }
+  iterator = PyObject_GetIter(iterable);
+  if (NULL == iterator)
+    goto done;
+
+  writer.salts = PyMem_New(char, APRMD5_HTPASSWD_WRITECHUNKSIZE * (APRMD5_APR1_SALTLEN + 1));
+  writer.saltPointers = PyMem_New(const char*, APRMD5_HTPASSWD_WRITECHUNKSIZE);
+  writer.results = PyMem_New(char, APRMD5_HTPASSWD_WRITECHUNKSIZE * APRMD5_APR1_HASHSIZE);
+  writer.statuses = PyMem_New(apr_status_t, APRMD5_HTPASSWD_WRITECHUNKSIZE);
+  if (NULL == writer.salts || NULL == writer.saltPointers
+      || NULL == writer.results || NULL == writer.statuses)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  fd = aprmd5_helper_tmpfile_create(path, &tmpPath);
+  if (fd < 0)
+    error = errno;
+  Py_END_ALLOW_THREADS
+  if (0 != error)
+  {
+    errno = error;
+    if (ENOMEM == error)
+      PyErr_NoMemory();
+    else
+      PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    goto done;
+  }
+
+  Py_ssize_t userCount = 0;
+  for (;;)
+  {
+    Py_ssize_t count = aprmd5_htpasswd_writer_next(&writer, iterator);
+    if (count < 0)
+      goto done;
+    if (0 == count)
+      break;
+    Py_BEGIN_ALLOW_THREADS
+    error = aprmd5_htpasswd_writer_write(&writer, fd, threadCount);
+    Py_END_ALLOW_THREADS
+    aprmd5_helper_string_pairs_free(&writer.pairs);
+    if (error < 0)
+    {
+      PyErr_SetString(PyExc_RuntimeError, "apr_md5_encode() returned status code != 0");
+      goto done;
+    }
+    if (0 != error)
+    {
+      errno = error;
+      PyErr_SetFromErrnoWithFilename(PyExc_OSError, tmpPath);
+      goto done;
+    }
+    userCount += count;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  error = aprmd5_helper_tmpfile_commit(fd, tmpPath, path);
+  fd = -1;
+  Py_END_ALLOW_THREADS
+  if (0 != error)
+  {
+    errno = error;
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    goto done;
+  }
+  result = PyLong_FromSsize_t(userCount);
+
+done:
+  if (fd >= 0)
+    aprmd5_helper_tmpfile_discard(fd, tmpPath);
+  aprmd5_helper_string_pairs_free(&writer.pairs);
+  PyMem_Free(writer.salts);
+  PyMem_Free((void*)writer.saltPointers);
+  PyMem_Free(writer.results);
+  PyMem_Free(writer.statuses);
+  PyMem_Free(writer.output);
+  free(tmpPath);
+  Py_XDECREF(iterator);
+#if PY_MAJOR_VERSION >= 3
+  Py_DECREF(pathObject);
+#endif  // #if PY_MAJOR_VERSION >= 3
+  return result;
+}
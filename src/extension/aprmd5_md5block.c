@@ -0,0 +1,499 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the module's own MD5 compression functions, the
+// streaming functions that the md5 type uses on top of them, plus a few
+// helpers that are shared by the engines that compress blocks directly.
+//
+// The implementation follows RFC 1321. It produces exactly the same results
+// as libaprutil, it just makes the block level accessible and lets us use a
+// compression function that is tuned for the CPU.
+//
+// There are up to three compression functions:
+// - "portable": Plain C that works on every host
+// - "fast": Tuned for little-endian hosts with cheap unaligned loads; only
+//   compiled for x86-64 and AArch64
+// - "bmi": The same as "fast", but compiled to use the BMI1/BMI2 instructions
+//   ANDN and RORX; only compiled for x86-64 and only selected if CPUID reports
+//   both extensions
+// The best function that the CPU supports is selected at module
+// initialization. The environment variable APRMD5_MD5BLOCK_KERNEL can be set
+// to the name of a function to force it, which is useful for verification.
+// A function that the CPU does not support is never selected.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_md5block.h"
+
+// System includes
+#include <stdlib.h>   // for getenv()
+#include <string.h>   // for memcpy(), memset(), strcmp()
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__AARCH64EL__))
+#define APRMD5_MD5BLOCK_FAST 1
+#endif
+#if defined(APRMD5_MD5BLOCK_FAST) && defined(__x86_64__)
+#define APRMD5_MD5BLOCK_BMI 1
+#endif
+
+
+// ---------------------------------------------------------------------------
+// The four auxiliary functions, the rotation and the step operation of
+// RFC 1321. F and G are written in the form that needs one operation less
+// than the form given in the RFC.
+// ---------------------------------------------------------------------------
+#define APRMD5_MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define APRMD5_MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define APRMD5_MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define APRMD5_MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define APRMD5_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define APRMD5_STEP(f, a, b, c, d, x, t, s)       \
+  (a) += f((b), (c), (d)) + (x) + (apr_uint32_t)(t); \
+  (a) = APRMD5_ROTL((a), (s));                     \
+  (a) += (b);
+
+
+// Reads a little-endian 32-bit word, regardless of alignment and of the
+// byte order of the host
+static apr_uint32_t
+aprmd5_md5block_load_le32(const unsigned char* p)
+{
+  return ((apr_uint32_t)p[0])
+       | ((apr_uint32_t)p[1] << 8)
+       | ((apr_uint32_t)p[2] << 16)
+       | ((apr_uint32_t)p[3] << 24);
+}
+
+
+// ---------------------------------------------------------------------------
+// Compresses one or more consecutive 64-byte blocks into an MD5 state.
+//
+// Parameters:
+// - state: The MD5 state (A, B, C, D) that is updated by this function
+// - blocks: The blocks to compress; there are no alignment requirements
+// - blockCount: The number of blocks to compress
+//
+// Return value:
+// - None
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_portable(apr_uint32_t state[4], const unsigned char* blocks, apr_size_t blockCount)
+{
+  apr_uint32_t a = state[0];
+  apr_uint32_t b = state[1];
+  apr_uint32_t c = state[2];
+  apr_uint32_t d = state[3];
+
+  while (blockCount-- > 0)
+  {
+    apr_uint32_t x[16];
+    int i;
+    for (i = 0; i < 16; ++i)
+      x[i] = aprmd5_md5block_load_le32(blocks + 4 * i);
+
+    apr_uint32_t aa = a;
+    apr_uint32_t bb = b;
+    apr_uint32_t cc = c;
+    apr_uint32_t dd = d;
+
+    // Round 1
+    APRMD5_STEP(APRMD5_MD5_F, a, b, c, d, x[ 0], 0xd76aa478,  7);
+    APRMD5_STEP(APRMD5_MD5_F, d, a, b, c, x[ 1], 0xe8c7b756, 12);
+    APRMD5_STEP(APRMD5_MD5_F, c, d, a, b, x[ 2], 0x242070db, 17);
+    APRMD5_STEP(APRMD5_MD5_F, b, c, d, a, x[ 3], 0xc1bdceee, 22);
+    APRMD5_STEP(APRMD5_MD5_F, a, b, c, d, x[ 4], 0xf57c0faf,  7);
+    APRMD5_STEP(APRMD5_MD5_F, d, a, b, c, x[ 5], 0x4787c62a, 12);
+    APRMD5_STEP(APRMD5_MD5_F, c, d, a, b, x[ 6], 0xa8304613, 17);
+    APRMD5_STEP(APRMD5_MD5_F, b, c, d, a, x[ 7], 0xfd469501, 22);
+    APRMD5_STEP(APRMD5_MD5_F, a, b, c, d, x[ 8], 0x698098d8,  7);
+    APRMD5_STEP(APRMD5_MD5_F, d, a, b, c, x[ 9], 0x8b44f7af, 12);
+    APRMD5_STEP(APRMD5_MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17);
+    APRMD5_STEP(APRMD5_MD5_F, b, c, d, a, x[11], 0x895cd7be, 22);
+    APRMD5_STEP(APRMD5_MD5_F, a, b, c, d, x[12], 0x6b901122,  7);
+    APRMD5_STEP(APRMD5_MD5_F, d, a, b, c, x[13], 0xfd987193, 12);
+    APRMD5_STEP(APRMD5_MD5_F, c, d, a, b, x[14], 0xa679438e, 17);
+    APRMD5_STEP(APRMD5_MD5_F, b, c, d, a, x[15], 0x49b40821, 22);
+
+    // Round 2
+    APRMD5_STEP(APRMD5_MD5_G, a, b, c, d, x[ 1], 0xf61e2562,  5);
+    APRMD5_STEP(APRMD5_MD5_G, d, a, b, c, x[ 6], 0xc040b340,  9);
+    APRMD5_STEP(APRMD5_MD5_G, c, d, a, b, x[11], 0x265e5a51, 14);
+    APRMD5_STEP(APRMD5_MD5_G, b, c, d, a, x[ 0], 0xe9b6c7aa, 20);
+    APRMD5_STEP(APRMD5_MD5_G, a, b, c, d, x[ 5], 0xd62f105d,  5);
+    APRMD5_STEP(APRMD5_MD5_G, d, a, b, c, x[10], 0x02441453,  9);
+    APRMD5_STEP(APRMD5_MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14);
+    APRMD5_STEP(APRMD5_MD5_G, b, c, d, a, x[ 4], 0xe7d3fbc8, 20);
+    APRMD5_STEP(APRMD5_MD5_G, a, b, c, d, x[ 9], 0x21e1cde6,  5);
+    APRMD5_STEP(APRMD5_MD5_G, d, a, b, c, x[14], 0xc33707d6,  9);
+    APRMD5_STEP(APRMD5_MD5_G, c, d, a, b, x[ 3], 0xf4d50d87, 14);
+    APRMD5_STEP(APRMD5_MD5_G, b, c, d, a, x[ 8], 0x455a14ed, 20);
+    APRMD5_STEP(APRMD5_MD5_G, a, b, c, d, x[13], 0xa9e3e905,  5);
+    APRMD5_STEP(APRMD5_MD5_G, d, a, b, c, x[ 2], 0xfcefa3f8,  9);
+    APRMD5_STEP(APRMD5_MD5_G, c, d, a, b, x[ 7], 0x676f02d9, 14);
+    APRMD5_STEP(APRMD5_MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+
+    // Round 3
+    APRMD5_STEP(APRMD5_MD5_H, a, b, c, d, x[ 5], 0xfffa3942,  4);
+    APRMD5_STEP(APRMD5_MD5_H, d, a, b, c, x[ 8], 0x8771f681, 11);
+    APRMD5_STEP(APRMD5_MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16);
+    APRMD5_STEP(APRMD5_MD5_H, b, c, d, a, x[14], 0xfde5380c, 23);
+    APRMD5_STEP(APRMD5_MD5_H, a, b, c, d, x[ 1], 0xa4beea44,  4);
+    APRMD5_STEP(APRMD5_MD5_H, d, a, b, c, x[ 4], 0x4bdecfa9, 11);
+    APRMD5_STEP(APRMD5_MD5_H, c, d, a, b, x[ 7], 0xf6bb4b60, 16);
+    APRMD5_STEP(APRMD5_MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23);
+    APRMD5_STEP(APRMD5_MD5_H, a, b, c, d, x[13], 0x289b7ec6,  4);
+    APRMD5_STEP(APRMD5_MD5_H, d, a, b, c, x[ 0], 0xeaa127fa, 11);
+    APRMD5_STEP(APRMD5_MD5_H, c, d, a, b, x[ 3], 0xd4ef3085, 16);
+    APRMD5_STEP(APRMD5_MD5_H, b, c, d, a, x[ 6], 0x04881d05, 23);
+    APRMD5_STEP(APRMD5_MD5_H, a, b, c, d, x[ 9], 0xd9d4d039,  4);
+    APRMD5_STEP(APRMD5_MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11);
+    APRMD5_STEP(APRMD5_MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16);
+    APRMD5_STEP(APRMD5_MD5_H, b, c, d, a, x[ 2], 0xc4ac5665, 23);
+
+    // Round 4
+    APRMD5_STEP(APRMD5_MD5_I, a, b, c, d, x[ 0], 0xf4292244,  6);
+    APRMD5_STEP(APRMD5_MD5_I, d, a, b, c, x[ 7], 0x432aff97, 10);
+    APRMD5_STEP(APRMD5_MD5_I, c, d, a, b, x[14], 0xab9423a7, 15);
+    APRMD5_STEP(APRMD5_MD5_I, b, c, d, a, x[ 5], 0xfc93a039, 21);
+    APRMD5_STEP(APRMD5_MD5_I, a, b, c, d, x[12], 0x655b59c3,  6);
+    APRMD5_STEP(APRMD5_MD5_I, d, a, b, c, x[ 3], 0x8f0ccc92, 10);
+    APRMD5_STEP(APRMD5_MD5_I, c, d, a, b, x[10], 0xffeff47d, 15);
+    APRMD5_STEP(APRMD5_MD5_I, b, c, d, a, x[ 1], 0x85845dd1, 21);
+    APRMD5_STEP(APRMD5_MD5_I, a, b, c, d, x[ 8], 0x6fa87e4f,  6);
+    APRMD5_STEP(APRMD5_MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+    APRMD5_STEP(APRMD5_MD5_I, c, d, a, b, x[ 6], 0xa3014314, 15);
+    APRMD5_STEP(APRMD5_MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21);
+    APRMD5_STEP(APRMD5_MD5_I, a, b, c, d, x[ 4], 0xf7537e82,  6);
+    APRMD5_STEP(APRMD5_MD5_I, d, a, b, c, x[11], 0xbd3af235, 10);
+    APRMD5_STEP(APRMD5_MD5_I, c, d, a, b, x[ 2], 0x2ad7d2bb, 15);
+    APRMD5_STEP(APRMD5_MD5_I, b, c, d, a, x[ 9], 0xeb86d391, 21);
+
+    a += aa;
+    b += bb;
+    c += cc;
+    d += dd;
+    blocks += APRMD5_MD5_BLOCKSIZE;
+  }
+
+  state[0] = a;
+  state[1] = b;
+  state[2] = c;
+  state[3] = d;
+}
+
+
+// ---------------------------------------------------------------------------
+// The tuned compression functions, generated from aprmd5_md5block_fast.h
+// ---------------------------------------------------------------------------
+#ifdef APRMD5_MD5BLOCK_FAST
+
+#define APRMD5_MD5BLOCK_FAST_NAME   aprmd5_md5block_fast
+#define APRMD5_MD5BLOCK_FAST_TARGET
+#include "aprmd5_md5block_fast.h"
+#undef APRMD5_MD5BLOCK_FAST_NAME
+#undef APRMD5_MD5BLOCK_FAST_TARGET
+
+#endif  // #ifdef APRMD5_MD5BLOCK_FAST
+
+#ifdef APRMD5_MD5BLOCK_BMI
+
+#define APRMD5_MD5BLOCK_FAST_NAME   aprmd5_md5block_bmi
+#define APRMD5_MD5BLOCK_FAST_TARGET __attribute__((target("bmi,bmi2")))
+#include "aprmd5_md5block_fast.h"
+#undef APRMD5_MD5BLOCK_FAST_NAME
+#undef APRMD5_MD5BLOCK_FAST_TARGET
+
+#endif  // #ifdef APRMD5_MD5BLOCK_BMI
+
+
+// ---------------------------------------------------------------------------
+// Selection of the compression function
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  const char* name;
+  aprmd5_md5block_func func;
+} aprmd5_md5block_kernel;
+
+// The table of compression functions, best function first
+static const aprmd5_md5block_kernel aprmd5_md5block_kernels[] =
+{
+#ifdef APRMD5_MD5BLOCK_BMI
+  { "bmi",      aprmd5_md5block_bmi },
+#endif
+#ifdef APRMD5_MD5BLOCK_FAST
+  { "fast",     aprmd5_md5block_fast },
+#endif
+  { "portable", aprmd5_md5block_portable },
+  { NULL,       NULL }   // Sentinel
+};
+
+// The compression function that is used by the streaming functions below
+aprmd5_md5block_func aprmd5_md5block_selected = aprmd5_md5block_portable;
+const char* aprmd5_md5block_selected_name = "portable";
+
+static int
+aprmd5_md5block_kernel_is_supported(const aprmd5_md5block_kernel* kernel)
+{
+#ifdef APRMD5_MD5BLOCK_BMI
+  if (0 == strcmp(kernel->name, "bmi"))
+    return __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#endif
+  return 1;
+}
+
+
+// ---------------------------------------------------------------------------
+// Selects the compression function that is used by the md5 type. This must be
+// called once when the module is initialized.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_init(void)
+{
+#ifdef APRMD5_MD5BLOCK_BMI
+  __builtin_cpu_init();
+#endif
+  const char* forcedName = getenv("APRMD5_MD5BLOCK_KERNEL");
+  const aprmd5_md5block_kernel* kernel;
+  for (kernel = aprmd5_md5block_kernels; NULL != kernel->name; ++kernel)
+  {
+    if (NULL != forcedName && '\0' != forcedName[0] && 0 != strcmp(forcedName, kernel->name))
+      continue;
+    if (aprmd5_md5block_kernel_is_supported(kernel))
+      break;
+  }
+  // Fall back to the portable function if the forced function is unknown or
+  // not supported
+  if (NULL == kernel->name)
+    --kernel;
+  aprmd5_md5block_selected = kernel->func;
+  aprmd5_md5block_selected_name = kernel->name;
+}
+
+
+// ---------------------------------------------------------------------------
+// Initializes an MD5 context. This is the equivalent of apr_md5_init().
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_ctx_init(apr_md5_ctx_t* context)
+{
+  memset(context, 0, sizeof(*context));
+  context->state[0] = APRMD5_MD5_INIT_A;
+  context->state[1] = APRMD5_MD5_INIT_B;
+  context->state[2] = APRMD5_MD5_INIT_C;
+  context->state[3] = APRMD5_MD5_INIT_D;
+}
+
+
+// ---------------------------------------------------------------------------
+// Feeds input to an MD5 context. This is the equivalent of apr_md5_update(),
+// but it uses the given compression function. The context is kept in exactly
+// the same format as libaprutil keeps it.
+//
+// Parameters:
+// - func: The compression function, e.g. aprmd5_md5block_selected
+// - context: The MD5 context to update; must have been initialized by
+//   apr_md5_init()
+// - input: The input buffer
+// - inputLen: The length of the input buffer in bytes
+//
+// Return value:
+// - None
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_ctx_update_using(aprmd5_md5block_func func, apr_md5_ctx_t* context, const unsigned char* input, apr_size_t inputLen)
+{
+  // The number of bytes that are already in the buffer
+  apr_size_t bufferUsed = (context->count[0] >> 3) & (APRMD5_MD5_BLOCKSIZE - 1);
+
+  // Update the number of bits, modulo 2^64
+  apr_uint32_t lowBits = (apr_uint32_t)inputLen << 3;
+  context->count[0] += lowBits;
+  if (context->count[0] < lowBits)
+    ++context->count[1];
+  context->count[1] += (apr_uint32_t)((apr_uint64_t)inputLen >> 29);
+
+  // Complete a partially filled buffer first
+  if (bufferUsed > 0)
+  {
+    apr_size_t bufferFree = APRMD5_MD5_BLOCKSIZE - bufferUsed;
+    if (inputLen < bufferFree)
+    {
+      memcpy(context->buffer + bufferUsed, input, inputLen);
+      return;
+    }
+    memcpy(context->buffer + bufferUsed, input, bufferFree);
+    func(context->state, context->buffer, 1);
+    input += bufferFree;
+    inputLen -= bufferFree;
+  }
+
+  // Compress complete blocks directly from the input, without copying
+  apr_size_t blockCount = inputLen / APRMD5_MD5_BLOCKSIZE;
+  if (blockCount > 0)
+  {
+    func(context->state, input, blockCount);
+    input += blockCount * APRMD5_MD5_BLOCKSIZE;
+    inputLen -= blockCount * APRMD5_MD5_BLOCKSIZE;
+  }
+
+  // Keep the rest for later
+  memcpy(context->buffer, input, inputLen);
+}
+
+
+// ---------------------------------------------------------------------------
+// Feeds input to an MD5 context, using the selected compression function.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_ctx_update(apr_md5_ctx_t* context, const unsigned char* input, apr_size_t inputLen)
+{
+  aprmd5_md5block_ctx_update_using(aprmd5_md5block_selected, context, input, inputLen);
+}
+
+
+// ---------------------------------------------------------------------------
+// Finishes an MD5 context and writes the digest. This is the equivalent of
+// apr_md5_final(), i.e. the context is zeroed afterwards, but it uses the
+// given compression function.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_ctx_final_using(aprmd5_md5block_func func, unsigned char digest[APRMD5_MD5_DIGESTSIZE], apr_md5_ctx_t* context)
+{
+  apr_uint64_t bitCount = ((apr_uint64_t)context->count[1] << 32) | context->count[0];
+  apr_size_t bufferUsed = (context->count[0] >> 3) & (APRMD5_MD5_BLOCKSIZE - 1);
+  unsigned char paddedBlocks[2 * APRMD5_MD5_BLOCKSIZE];
+  apr_size_t blockCount = aprmd5_md5block_pad(context->buffer, bufferUsed, bitCount >> 3, paddedBlocks);
+  func(context->state, paddedBlocks, blockCount);
+  aprmd5_md5block_state_to_digest(context->state, digest);
+  memset(context, 0, sizeof(*context));
+}
+
+
+// ---------------------------------------------------------------------------
+// Finishes an MD5 context and writes the digest, using the selected
+// compression function.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_ctx_final(unsigned char digest[APRMD5_MD5_DIGESTSIZE], apr_md5_ctx_t* context)
+{
+  aprmd5_md5block_ctx_final_using(aprmd5_md5block_selected, digest, context);
+}
+
+
+// ---------------------------------------------------------------------------
+// Builds the final block(s) of a message, i.e. the bytes of the message that
+// do not fill a complete block, followed by the MD5 padding and the message
+// length.
+//
+// Parameters:
+// - tail: The trailing bytes of the message that do not fill a complete block
+// - tailLen: The number of trailing bytes; must be less than the block size
+// - messageLen: The length of the entire message in bytes
+// - paddedBlocks: A pre-allocated buffer of two blocks whose content is
+//   overwritten by this function
+//
+// Return value:
+// - The number of padded blocks (1 or 2)
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+apr_size_t aprmd5_md5block_pad(const unsigned char* tail, apr_size_t tailLen, apr_uint64_t messageLen, unsigned char paddedBlocks[2 * APRMD5_MD5_BLOCKSIZE])
+{
+  // The length is appended as a 64-bit little-endian number of bits. If it
+  // does not fit behind the 0x80 byte, an additional block is needed.
+  apr_size_t blockCount = (tailLen < APRMD5_MD5_BLOCKSIZE - 8) ? 1 : 2;
+  apr_size_t paddedLen = blockCount * APRMD5_MD5_BLOCKSIZE;
+
+  memcpy(paddedBlocks, tail, tailLen);
+  paddedBlocks[tailLen] = 0x80;
+  memset(paddedBlocks + tailLen + 1, 0, paddedLen - tailLen - 1 - 8);
+  apr_uint64_t bitCount = messageLen << 3;
+  int i;
+  for (i = 0; i < 8; ++i)
+    paddedBlocks[paddedLen - 8 + i] = (unsigned char)(bitCount >> (8 * i));
+  return blockCount;
+}
+
+
+// ---------------------------------------------------------------------------
+// Appends the MD5 padding and the message length to a message that is stored
+// in a buffer, so that the buffer can be compressed as it is.
+//
+// Parameters:
+// - message: The buffer that holds the message. The buffer must be large
+//   enough to hold the padding, i.e. it must be at least messageLen + 72 bytes
+//   long, rounded up to a multiple of the block size.
+// - messageLen: The length of the message in bytes
+//
+// Return value:
+// - The number of blocks in the padded message
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+apr_size_t aprmd5_md5block_pad_in_place(unsigned char* message, apr_size_t messageLen)
+{
+  apr_size_t blockCount = (messageLen + 8) / APRMD5_MD5_BLOCKSIZE + 1;
+  apr_size_t paddedLen = blockCount * APRMD5_MD5_BLOCKSIZE;
+  message[messageLen] = 0x80;
+  memset(message + messageLen + 1, 0, paddedLen - messageLen - 1 - 8);
+  apr_uint64_t bitCount = (apr_uint64_t)messageLen << 3;
+  int i;
+  for (i = 0; i < 8; ++i)
+    message[paddedLen - 8 + i] = (unsigned char)(bitCount >> (8 * i));
+  return blockCount;
+}
+
+
+// ---------------------------------------------------------------------------
+// Converts an MD5 state into the binary digest, i.e. writes the state words
+// in little-endian byte order.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_md5block_state_to_digest(const apr_uint32_t state[4], unsigned char digest[APRMD5_MD5_DIGESTSIZE])
+{
+  int i;
+  for (i = 0; i < 4; ++i)
+  {
+    digest[4 * i]     = (unsigned char)(state[i]);
+    digest[4 * i + 1] = (unsigned char)(state[i] >> 8);
+    digest[4 * i + 2] = (unsigned char)(state[i] >> 16);
+    digest[4 * i + 3] = (unsigned char)(state[i] >> 24);
+  }
+}
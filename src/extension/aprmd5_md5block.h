@@ -0,0 +1,93 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the module's own implementation of the MD5 compression
+// function. libaprutil does not expose its compression function, but some of
+// the module's engines need to compress blocks directly, and the md5 type
+// uses a compression function that is tuned for the CPU.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_MD5BLOCK_H
+#define APRMD5_MD5BLOCK_H
+
+// The initial MD5 state as defined by RFC 1321
+#define APRMD5_MD5_INIT_A 0x67452301
+#define APRMD5_MD5_INIT_B 0xefcdab89
+#define APRMD5_MD5_INIT_C 0x98badcfe
+#define APRMD5_MD5_INIT_D 0x10325476
+
+// Signature of a function that compresses blockCount consecutive 64-byte
+// blocks into an MD5 state
+typedef void (*aprmd5_md5block_func)(apr_uint32_t state[4],
+                                     const unsigned char* blocks,
+                                     apr_size_t blockCount);
+
+extern aprmd5_md5block_func aprmd5_md5block_selected;
+extern const char* aprmd5_md5block_selected_name;
+
+extern void
+aprmd5_md5block_init(void);
+
+extern void
+aprmd5_md5block_ctx_init(apr_md5_ctx_t* context);
+
+extern void
+aprmd5_md5block_ctx_update(apr_md5_ctx_t* context,
+                           const unsigned char* input,
+                           apr_size_t inputLen);
+
+extern void
+aprmd5_md5block_ctx_final(unsigned char digest[APRMD5_MD5_DIGESTSIZE],
+                          apr_md5_ctx_t* context);
+
+extern void
+aprmd5_md5block_ctx_update_using(aprmd5_md5block_func func,
+                                 apr_md5_ctx_t* context,
+                                 const unsigned char* input,
+                                 apr_size_t inputLen);
+
+extern void
+aprmd5_md5block_ctx_final_using(aprmd5_md5block_func func,
+                                unsigned char digest[APRMD5_MD5_DIGESTSIZE],
+                                apr_md5_ctx_t* context);
+
+extern void
+aprmd5_md5block_portable(apr_uint32_t state[4],
+                         const unsigned char* blocks,
+                         apr_size_t blockCount);
+
+extern apr_size_t
+aprmd5_md5block_pad(const unsigned char* tail,
+                    apr_size_t tailLen,
+                    apr_uint64_t messageLen,
+                    unsigned char paddedBlocks[2 * APRMD5_MD5_BLOCKSIZE]);
+
+extern apr_size_t
+aprmd5_md5block_pad_in_place(unsigned char* message,
+                             apr_size_t messageLen);
+
+extern void
+aprmd5_md5block_state_to_digest(const apr_uint32_t state[4],
+                                unsigned char digest[APRMD5_MD5_DIGESTSIZE]);
+
+
+#endif // #ifndef APRMD5_MD5BLOCK_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file is a template for the tuned single-stream MD5 compression
+// functions. It is included by aprmd5_md5block.c once per variant, each time
+// with the following macros defined:
+//
+// - APRMD5_MD5BLOCK_FAST_NAME: The name of the function to generate
+// - APRMD5_MD5BLOCK_FAST_TARGET: A function attribute that enables additional
+//   instructions, or nothing
+//
+// Compared to the portable function, the generated function
+// - is only compiled for little-endian hosts that can load unaligned words
+//   cheaply (x86-64 and AArch64), so the message words are loaded with plain
+//   32-bit loads instead of being assembled byte by byte
+// - computes the G and I functions in a form that maps to ANDN/BIC and ORN
+//   instructions, and adds the two disjoint halves of G separately so that
+//   they do not depend on each other
+// - adds the message word and the round constant to a before the auxiliary
+//   function is computed, so that this addition does not sit on the critical
+//   path through b, c and d
+//
+// Note: There is deliberately no include guard.
+// ---------------------------------------------------------------------------
+
+
+// F(b, c, d) = d ^ (b & (c ^ d))
+#define APRMD5_FAST_STEP_F(a, b, c, d, k, t, s)        \
+  (a) += x[k] + (apr_uint32_t)(t);                     \
+  (a) += (d) ^ ((b) & ((c) ^ (d)));                    \
+  (a) = APRMD5_ROTL((a), (s)) + (b);
+
+// G(b, c, d) = (b & d) | (c & ~d); the two terms never have a bit in common,
+// so they can be added instead of or-ed
+#define APRMD5_FAST_STEP_G(a, b, c, d, k, t, s)        \
+  (a) += x[k] + (apr_uint32_t)(t);                     \
+  (a) += (c) & ~(d);                                   \
+  (a) += (b) & (d);                                    \
+  (a) = APRMD5_ROTL((a), (s)) + (b);
+
+// H(b, c, d) = b ^ c ^ d
+#define APRMD5_FAST_STEP_H(a, b, c, d, k, t, s)        \
+  (a) += x[k] + (apr_uint32_t)(t);                     \
+  (a) += (b) ^ (c) ^ (d);                              \
+  (a) = APRMD5_ROTL((a), (s)) + (b);
+
+// I(b, c, d) = c ^ (b | ~d)
+#define APRMD5_FAST_STEP_I(a, b, c, d, k, t, s)        \
+  (a) += x[k] + (apr_uint32_t)(t);                     \
+  (a) += (c) ^ ((b) | ~(d));                           \
+  (a) = APRMD5_ROTL((a), (s)) + (b);
+
+APRMD5_MD5BLOCK_FAST_TARGET static void
+APRMD5_MD5BLOCK_FAST_NAME(apr_uint32_t state[4], const unsigned char* blocks, apr_size_t blockCount)
+{
+  apr_uint32_t a = state[0];
+  apr_uint32_t b = state[1];
+  apr_uint32_t c = state[2];
+  apr_uint32_t d = state[3];
+
+  while (blockCount-- > 0)
+  {
+    // The host is little-endian, so the block can be copied verbatim. The
+    // compiler turns this into wide loads.
+    apr_uint32_t x[16];
+    memcpy(x, blocks, APRMD5_MD5_BLOCKSIZE);
+
+    apr_uint32_t aa = a;
+    apr_uint32_t bb = b;
+    apr_uint32_t cc = c;
+    apr_uint32_t dd = d;
+
+    // Round 1
+    APRMD5_FAST_STEP_F(a, b, c, d,  0, 0xd76aa478,  7);
+    APRMD5_FAST_STEP_F(d, a, b, c,  1, 0xe8c7b756, 12);
+    APRMD5_FAST_STEP_F(c, d, a, b,  2, 0x242070db, 17);
+    APRMD5_FAST_STEP_F(b, c, d, a,  3, 0xc1bdceee, 22);
+    APRMD5_FAST_STEP_F(a, b, c, d,  4, 0xf57c0faf,  7);
+    APRMD5_FAST_STEP_F(d, a, b, c,  5, 0x4787c62a, 12);
+    APRMD5_FAST_STEP_F(c, d, a, b,  6, 0xa8304613, 17);
+    APRMD5_FAST_STEP_F(b, c, d, a,  7, 0xfd469501, 22);
+    APRMD5_FAST_STEP_F(a, b, c, d,  8, 0x698098d8,  7);
+    APRMD5_FAST_STEP_F(d, a, b, c,  9, 0x8b44f7af, 12);
+    APRMD5_FAST_STEP_F(c, d, a, b, 10, 0xffff5bb1, 17);
+    APRMD5_FAST_STEP_F(b, c, d, a, 11, 0x895cd7be, 22);
+    APRMD5_FAST_STEP_F(a, b, c, d, 12, 0x6b901122,  7);
+    APRMD5_FAST_STEP_F(d, a, b, c, 13, 0xfd987193, 12);
+    APRMD5_FAST_STEP_F(c, d, a, b, 14, 0xa679438e, 17);
+    APRMD5_FAST_STEP_F(b, c, d, a, 15, 0x49b40821, 22);
+
+    // Round 2
+    APRMD5_FAST_STEP_G(a, b, c, d,  1, 0xf61e2562,  5);
+    APRMD5_FAST_STEP_G(d, a, b, c,  6, 0xc040b340,  9);
+    APRMD5_FAST_STEP_G(c, d, a, b, 11, 0x265e5a51, 14);
+    APRMD5_FAST_STEP_G(b, c, d, a,  0, 0xe9b6c7aa, 20);
+    APRMD5_FAST_STEP_G(a, b, c, d,  5, 0xd62f105d,  5);
+    APRMD5_FAST_STEP_G(d, a, b, c, 10, 0x02441453,  9);
+    APRMD5_FAST_STEP_G(c, d, a, b, 15, 0xd8a1e681, 14);
+    APRMD5_FAST_STEP_G(b, c, d, a,  4, 0xe7d3fbc8, 20);
+    APRMD5_FAST_STEP_G(a, b, c, d,  9, 0x21e1cde6,  5);
+    APRMD5_FAST_STEP_G(d, a, b, c, 14, 0xc33707d6,  9);
+    APRMD5_FAST_STEP_G(c, d, a, b,  3, 0xf4d50d87, 14);
+    APRMD5_FAST_STEP_G(b, c, d, a,  8, 0x455a14ed, 20);
+    APRMD5_FAST_STEP_G(a, b, c, d, 13, 0xa9e3e905,  5);
+    APRMD5_FAST_STEP_G(d, a, b, c,  2, 0xfcefa3f8,  9);
+    APRMD5_FAST_STEP_G(c, d, a, b,  7, 0x676f02d9, 14);
+    APRMD5_FAST_STEP_G(b, c, d, a, 12, 0x8d2a4c8a, 20);
+
+    // Round 3
+    APRMD5_FAST_STEP_H(a, b, c, d,  5, 0xfffa3942,  4);
+    APRMD5_FAST_STEP_H(d, a, b, c,  8, 0x8771f681, 11);
+    APRMD5_FAST_STEP_H(c, d, a, b, 11, 0x6d9d6122, 16);
+    APRMD5_FAST_STEP_H(b, c, d, a, 14, 0xfde5380c, 23);
+    APRMD5_FAST_STEP_H(a, b, c, d,  1, 0xa4beea44,  4);
+    APRMD5_FAST_STEP_H(d, a, b, c,  4, 0x4bdecfa9, 11);
+    APRMD5_FAST_STEP_H(c, d, a, b,  7, 0xf6bb4b60, 16);
+    APRMD5_FAST_STEP_H(b, c, d, a, 10, 0xbebfbc70, 23);
+    APRMD5_FAST_STEP_H(a, b, c, d, 13, 0x289b7ec6,  4);
+    APRMD5_FAST_STEP_H(d, a, b, c,  0, 0xeaa127fa, 11);
+    APRMD5_FAST_STEP_H(c, d, a, b,  3, 0xd4ef3085, 16);
+    APRMD5_FAST_STEP_H(b, c, d, a,  6, 0x04881d05, 23);
+    APRMD5_FAST_STEP_H(a, b, c, d,  9, 0xd9d4d039,  4);
+    APRMD5_FAST_STEP_H(d, a, b, c, 12, 0xe6db99e5, 11);
+    APRMD5_FAST_STEP_H(c, d, a, b, 15, 0x1fa27cf8, 16);
+    APRMD5_FAST_STEP_H(b, c, d, a,  2, 0xc4ac5665, 23);
+
+    // Round 4
+    APRMD5_FAST_STEP_I(a, b, c, d,  0, 0xf4292244,  6);
+    APRMD5_FAST_STEP_I(d, a, b, c,  7, 0x432aff97, 10);
+    APRMD5_FAST_STEP_I(c, d, a, b, 14, 0xab9423a7, 15);
+    APRMD5_FAST_STEP_I(b, c, d, a,  5, 0xfc93a039, 21);
+    APRMD5_FAST_STEP_I(a, b, c, d, 12, 0x655b59c3,  6);
+    APRMD5_FAST_STEP_I(d, a, b, c,  3, 0x8f0ccc92, 10);
+    APRMD5_FAST_STEP_I(c, d, a, b, 10, 0xffeff47d, 15);
+    APRMD5_FAST_STEP_I(b, c, d, a,  1, 0x85845dd1, 21);
+    APRMD5_FAST_STEP_I(a, b, c, d,  8, 0x6fa87e4f,  6);
+    APRMD5_FAST_STEP_I(d, a, b, c, 15, 0xfe2ce6e0, 10);
+    APRMD5_FAST_STEP_I(c, d, a, b,  6, 0xa3014314, 15);
+    APRMD5_FAST_STEP_I(b, c, d, a, 13, 0x4e0811a1, 21);
+    APRMD5_FAST_STEP_I(a, b, c, d,  4, 0xf7537e82,  6);
+    APRMD5_FAST_STEP_I(d, a, b, c, 11, 0xbd3af235, 10);
+    APRMD5_FAST_STEP_I(c, d, a, b,  2, 0x2ad7d2bb, 15);
+    APRMD5_FAST_STEP_I(b, c, d, a,  9, 0xeb86d391, 21);
+
+    a += aa;
+    b += bb;
+    c += cc;
+    d += dd;
+    blocks += APRMD5_MD5_BLOCKSIZE;
+  }
+
+  state[0] = a;
+  state[1] = b;
+  state[2] = c;
+  state[3] = d;
+}
+
+#undef APRMD5_FAST_STEP_F
+#undef APRMD5_FAST_STEP_G
+#undef APRMD5_FAST_STEP_H
+#undef APRMD5_FAST_STEP_I
@@ -26,12 +26,21 @@
 // Project includes
 #include "aprmd5.h"
 #include "aprmd5_md5type.h"
+#include "aprmd5_backend.h"
 #include "aprmd5_helpers.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_async.h"
+#include "aprmd5_stats.h"
+#include "aprmd5_state.h"
 
 // Defines PyMemberDef and PyMethodDef. Weird - why is this not in Python.h?
 // See http://bugs.python.org/issue2897.
 #include <structmember.h>
 
+// Defines PyThread_type_lock. Python 3 includes this from Python.h, but Python
+// 2.x does not.
+#include <pythread.h>
+
 
 // ---------------------------------------------------------------------------
 // Various strings that are exposed to Python and visible to the user
@@ -40,6 +49,28 @@
 const char* aprmd5_md5_type_name = "md5";
 static char* aprmd5_md5_init_kwlist[] = {"input", NULL};
 
+#if PY_MAJOR_VERSION >= 3
+// Input must be an object that supports the buffer protocol (e.g. bytes(),
+// bytearray(), memoryview() or mmap). The buffer is not copied.
+#define APRMD5_MD5_INPUTFORMAT "y*"
+#else
+// Input must be a str() object, or an object that supports the buffer
+// protocol. The string may contain null bytes.
+#define APRMD5_MD5_INPUTFORMAT "s*"
+#endif
+
+// Gets the buffer of an input object, like PyArg_Parse() with
+// APRMD5_MD5_INPUTFORMAT does. Returns 1 on success, or 0 with a Python
+// exception set. On Python 3 the buffer is requested directly, which is
+// noticeably cheaper for short inputs than going through PyArg_Parse().
+#if PY_MAJOR_VERSION >= 3
+#define APRMD5_MD5_GET_INPUT(object, input, functionName) \
+  (0 == PyObject_GetBuffer((object), (input), PyBUF_SIMPLE))
+#else
+#define APRMD5_MD5_GET_INPUT(object, input, functionName) \
+  PyArg_Parse((object), APRMD5_MD5_INPUTFORMAT ":" functionName, (input))
+#endif
+
 
 // ---------------------------------------------------------------------------
 // Definition of the C type that is used to create md5 objects
@@ -51,8 +82,57 @@ typedef struct {
   // Type-specific fields go here
   apr_md5_ctx_t context;  // keeps state between calls to init(), update()
                           // and final()
+  PyThread_type_lock lock;  // protects context while the GIL is released;
+                            // NULL until the first time that the object is
+                            // updated with a large input buffer. Always
+                            // present in the free-threaded build.
+  int asyncUpdatePending;   // 1 while an update_async() job is in flight;
+                            // accessed only with the GIL held, or in a
+                            // critical section in the free-threaded build
+  unsigned char finalDigest[APRMD5_MD5_DIGESTSIZE];  // the digest of context;
+  int finalDigestValid;     // valid only if this is 1. Both are protected
+                            // like context, and every update resets the flag.
 } aprmd5_md5_object;
 
+// Deallocated md5 objects are kept for reuse on the freelist in the module
+// state. Programs that hash many short inputs create and destroy md5 objects
+// at a high rate; reusing the memory saves a trip through the allocator. The
+// freelist is accessed only with the GIL held.
+
+
+// ---------------------------------------------------------------------------
+// Locking of md5 objects
+//
+// While an md5 object hashes a large input buffer, the GIL is released so that
+// other threads can run. One of these other threads might use the same md5
+// object, so from that moment on all access to the object's context must be
+// serialized with the object's own lock. The lock is created lazily, objects
+// that never see a large input buffer never pay for it.
+//
+// The free-threaded build has no GIL that serializes the access of several
+// threads, so there every md5 object gets its lock when it is created.
+// ---------------------------------------------------------------------------
+
+// Acquires the object lock, if it exists. The GIL is released only if the lock
+// is contended.
+#define APRMD5_MD5_OBJECT_ENTER(obj)                        \
+  if ((obj)->lock)                                          \
+  {                                                         \
+    if (! PyThread_acquire_lock((obj)->lock, 0))            \
+    {                                                       \
+      Py_BEGIN_ALLOW_THREADS                                \
+      PyThread_acquire_lock((obj)->lock, 1);                \
+      Py_END_ALLOW_THREADS                                  \
+    }                                                       \
+  }
+
+// Releases the object lock, if it exists.
+#define APRMD5_MD5_OBJECT_LEAVE(obj)                        \
+  if ((obj)->lock)                                          \
+  {                                                         \
+    PyThread_release_lock((obj)->lock);                     \
+  }
+
 
 // ---------------------------------------------------------------------------
 // Allocation/initialization/deallocation of md5 objects
@@ -62,19 +142,98 @@ typedef struct {
 // initialized by obj.__init__(). It is exposed in Python as
 // class.__new__() method. __new__() is guaranteed to be called, even when the
 // object is unpickled.
+//
+// The md5 type cannot be subclassed, so type is always the md5 type of the
+// module state.
+static aprmd5_md5_object*
+aprmd5_md5_object_alloc(PyTypeObject* type)
+{
+  aprmd5_md5_object* self;
+  aprmd5_module_state* state = aprmd5_state_from_type(type);
+  if (state->md5FreelistCount > 0)
+  {
+    self = (aprmd5_md5_object*)state->md5Freelist[--state->md5FreelistCount];
+    PyObject_Init((PyObject*)self, type);
+  }
+  else
+  {
+    self = (aprmd5_md5_object*)type->tp_alloc(type, 0);
+    if (NULL == self)
+      return NULL;
+  }
+#if defined(Py_GIL_DISABLED)
+  self->lock = PyThread_allocate_lock();
+  if (NULL == self->lock)
+  {
+    Py_DECREF(self);
+    PyErr_NoMemory();
+    return NULL;
+  }
+#else
+  self->lock = NULL;
+#endif
+  self->asyncUpdatePending = 0;
+  self->finalDigestValid = 0;
+  return self;
+}
+
 static PyObject*
 aprmd5_md5_object_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
 {
-  aprmd5_md5_object* self = (aprmd5_md5_object*)type->tp_alloc(type, 0);
+  aprmd5_md5_object* self = aprmd5_md5_object_alloc(type);
   if (NULL == self)
     return NULL;
-  apr_status_t status = apr_md5_init(&self->context);
-  if (APR_SUCCESS != status)
+  aprmd5_md5block_ctx_init(&self->context);
+  return (PyObject*)self;
+}
+
+// Feeds inputLen bytes to the MD5 algorithm. Large inputs are hashed with the
+// GIL released. Returns the status code of the MD5 update; does not set a
+// Python exception and does not record statistics.
+static apr_status_t
+aprmd5_md5_object_hash(aprmd5_md5_object* self, const void* input, Py_ssize_t inputLen)
+{
+  apr_status_t status;
+
+  // Small inputs are hashed while holding the GIL, but if another thread is
+  // currently hashing a large input we must still wait for the object lock
+  if (self->lock == NULL && inputLen >= APRMD5_GIL_MINSIZE)
+    self->lock = PyThread_allocate_lock();   // failure is not fatal, we just
+                                             // keep holding the GIL
+
+  if (self->lock != NULL && inputLen >= APRMD5_GIL_MINSIZE)
   {
-    Py_DECREF(self);
-    return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, 1);
+    self->finalDigestValid = 0;
+    status = aprmd5_helper_md5_update(&self->context, input, inputLen);
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
   }
-  return (PyObject*)self;
+  else
+  {
+    APRMD5_MD5_OBJECT_ENTER(self);
+    self->finalDigestValid = 0;
+    status = aprmd5_helper_md5_update(&self->context, input, inputLen);
+    APRMD5_MD5_OBJECT_LEAVE(self);
+  }
+  return status;
+}
+
+// Feeds the content of a buffer to the MD5 algorithm. Large buffers are hashed
+// with the GIL released. Returns APR_SUCCESS if the buffer could be fed to the
+// MD5 algorithm, otherwise sets a Python exception and returns the status code
+// of the failed libaprutil call.
+static apr_status_t
+aprmd5_md5_object_feed(aprmd5_md5_object* self, const Py_buffer* buffer)
+{
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_status_t status = aprmd5_md5_object_hash(self, buffer->buf, buffer->len);
+  aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, statsStart, (apr_uint64_t)buffer->len, APR_SUCCESS != status);
+
+  if (APR_SUCCESS != status)
+    PyErr_SetString(PyExc_RuntimeError, "MD5 update returned status code != 0");
+  return status;
 }
 
 // This function is responsible for initializing objects *after* they have been
@@ -86,27 +245,17 @@ static int
 aprmd5_md5_object_init(aprmd5_md5_object* self, PyObject* args, PyObject* kwds)
 {
   // Get optional keyword argument
-#if PY_MAJOR_VERSION >= 3
-  // Input must be a bytes() object from which we can get a char*
-  const char* format = "|y#";
-#else
-  // Input must be a str() object from which we can get a char*. The string may
-  // contain null bytes.
-  const char* format = "|s#";
-#endif
-  const char* input = NULL;
-  Py_ssize_t inputLen = 0;
-  if (! PyArg_ParseTupleAndKeywords(args, kwds, format, aprmd5_md5_init_kwlist, &input, &inputLen))
+  Py_buffer input;
+  input.buf = NULL;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "|" APRMD5_MD5_INPUTFORMAT, aprmd5_md5_init_kwlist, &input))
     return -1;
   // If there is input, feed it to the MD5 algorithm
-  if (input != NULL)
+  if (input.buf != NULL)
   {
-    apr_status_t status = apr_md5_update(&self->context, input, inputLen);
+    apr_status_t status = aprmd5_md5_object_feed(self, &input);
+    PyBuffer_Release(&input);
     if (APR_SUCCESS != status)
-    {
-      PyErr_SetString(PyExc_RuntimeError, "apr_md5_update() returned status code != 0");
       return -1;
-    }
   }
 
   return 0;
@@ -117,13 +266,20 @@ aprmd5_md5_object_init(aprmd5_md5_object* self, PyObject* args, PyObject* kwds)
 static void
 aprmd5_md5_object_dealloc(aprmd5_md5_object* self)
 {
-  // Free object memory; note that self might be a subclass instance (if we
-  // allow subclassing)
+  if (self->lock != NULL)
+    PyThread_free_lock(self->lock);
 #if PY_MAJOR_VERSION >= 3
-  Py_TYPE(self)->tp_free((PyObject*)self);
+  PyTypeObject* type = Py_TYPE(self);
 #else   // #if PY_MAJOR_VERSION >= 3
-  self->ob_type->tp_free((PyObject*)self);
+  PyTypeObject* type = self->ob_type;
 #endif  // #if PY_MAJOR_VERSION >= 3
+  // Keep the memory for reuse if there is room on the freelist
+  aprmd5_module_state* state = aprmd5_state_from_type(type);
+  if (state->md5FreelistCount < APRMD5_MD5_FREELISTSIZE)
+    state->md5Freelist[state->md5FreelistCount++] = (PyObject*)self;
+  else
+    type->tp_free((PyObject*)self);
+  APRMD5_TYPE_DECREF(type);
 }
 
 
@@ -132,99 +288,399 @@ aprmd5_md5_object_dealloc(aprmd5_md5_object* self)
 // ---------------------------------------------------------------------------
 
 static PyObject*
-aprmd5_md5_object_update(aprmd5_md5_object* self, PyObject* args)
+aprmd5_md5_object_update(aprmd5_md5_object* self, PyObject* arg)
 {
-  // TODO: We do this sizeof() check because later on, when we call
-  // apr_md5_update(), we are making an implicit type conversion from Py_ssize_t
-  // (inputLen) to apr_size_t (function argument type). Instead of aborting
-  // here, a better approach would probably be to iterate over the input buffer
-  // and call apr_md5_update() multiple times
-  assert(sizeof(apr_size_t) >= sizeof(Py_ssize_t));
-  if (sizeof(apr_size_t) < sizeof(Py_ssize_t))
-  {
-    PyErr_SetString(PyExc_RuntimeError, "Function aborted, sizeof(apr_size_t) < sizeof(Py_ssize_t)");
+  Py_buffer input;
+  if (! APRMD5_MD5_GET_INPUT(arg, &input, "update"))
+    return NULL;
+
+  // Feed the input to the MD5 algorithm. Input that is larger than what
+  // apr_md5_update() can handle in one call is fed in chunks.
+  apr_status_t status = aprmd5_md5_object_feed(self, &input);
+  PyBuffer_Release(&input);
+  if (APR_SUCCESS != status)
+    return NULL;
+
+  // Don't return NULL, as this would indicate an error
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+// Feeds every buffer of an iterable, in one call instead of one update() call
+// per buffer. The whole call counts as one update in the statistics.
+static PyObject*
+aprmd5_md5_object_update_many(aprmd5_md5_object* self, PyObject* arg)
+{
+  PyObject* iterator = PyObject_GetIter(arg);
+  if (NULL == iterator)
     return NULL;
+
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_uint64_t totalLen = 0;
+  apr_status_t status = APR_SUCCESS;
+  PyObject* item;
+  while (NULL != (item = PyIter_Next(iterator)))
+  {
+#if PY_MAJOR_VERSION >= 3
+    // bytes objects are immutable, so their content can be used without
+    // going through the buffer protocol
+    if (PyBytes_CheckExact(item))
+    {
+      status = aprmd5_md5_object_hash(self, PyBytes_AS_STRING(item), PyBytes_GET_SIZE(item));
+      totalLen += (apr_uint64_t)PyBytes_GET_SIZE(item);
+      Py_DECREF(item);
+    }
+    else
+#endif  // #if PY_MAJOR_VERSION >= 3
+    {
+      Py_buffer input;
+      int gotInput = APRMD5_MD5_GET_INPUT(item, &input, "update_many");
+      Py_DECREF(item);
+      if (! gotInput)
+        break;
+      status = aprmd5_md5_object_hash(self, input.buf, input.len);
+      totalLen += (apr_uint64_t)input.len;
+      PyBuffer_Release(&input);
+    }
+    if (APR_SUCCESS != status)
+    {
+      PyErr_SetString(PyExc_RuntimeError, "MD5 update returned status code != 0");
+      break;
+    }
   }
+  Py_DECREF(iterator);
+  aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, statsStart, totalLen, APR_SUCCESS != status);
+  if (PyErr_Occurred())
+    return NULL;
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
 #if PY_MAJOR_VERSION >= 3
-  // Input must be a bytes() object from which we can get a char*
-  const char* format = "y#";
-#else
-  // Input must be a str() object from which we can get a char*. The string may
-  // contain null bytes.
-  const char* format = "s#";
-#endif
-  const char* input;
-  Py_ssize_t inputLen;
-  if (! PyArg_ParseTuple(args, format, &input, &inputLen))
+
+// The default size of the buffer of update_from()
+#define APRMD5_MD5_READBUFFERSIZE (64 * 1024)
+
+static char* aprmd5_md5_update_from_kwlist[] = {"fileobj", "bufsize", NULL};
+
+// Reads a binary file object until EOF with its readinto() method and feeds
+// the data. All reads go to one native buffer that lives for the duration of
+// the call; large reads are hashed with the GIL released. Returns the number
+// of bytes fed.
+static PyObject*
+aprmd5_md5_object_update_from(aprmd5_md5_object* self, PyObject* args, PyObject* kwds)
+{
+  PyObject* fileObject;
+  Py_ssize_t bufferSize = APRMD5_MD5_READBUFFERSIZE;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O|n:update_from", aprmd5_md5_update_from_kwlist,
+                                    &fileObject, &bufferSize))
+    return NULL;
+  if (bufferSize <= 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "bufsize must be positive");
     return NULL;
+  }
 
-  // Feed the input to the MD5 algorithm
-  apr_status_t status = apr_md5_update(&self->context, input, inputLen);
-  if (APR_SUCCESS != status)
+  PyObject* readinto = PyObject_GetAttrString(fileObject, "readinto");
+  if (NULL == readinto)
+    return NULL;
+  char* buffer = (char*)PyMem_Malloc((size_t)bufferSize);
+  if (NULL == buffer)
   {
-    PyErr_SetString(PyExc_RuntimeError, "apr_md5_update() returned status code != 0");
+    Py_DECREF(readinto);
+    return PyErr_NoMemory();
+  }
+  PyObject* view = PyMemoryView_FromMemory(buffer, bufferSize, PyBUF_WRITE);
+  if (NULL == view)
+  {
+    PyMem_Free(buffer);
+    Py_DECREF(readinto);
     return NULL;
   }
 
-  // Don't return NULL, as this would indicate an error
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_uint64_t totalLen = 0;
+  apr_status_t status = APR_SUCCESS;
+  for (;;)
+  {
+    PyObject* result = PyObject_CallFunctionObjArgs(readinto, view, NULL);
+    if (NULL == result)
+      break;
+    if (Py_None == result)
+    {
+      Py_DECREF(result);
+      PyErr_SetString(PyExc_BlockingIOError, "readinto() returned None, non-blocking files are not supported");
+      break;
+    }
+    Py_ssize_t readLen = PyNumber_AsSsize_t(result, PyExc_OverflowError);
+    Py_DECREF(result);
+    if (readLen < 0 || readLen > bufferSize)
+    {
+      if (! PyErr_Occurred())
+        PyErr_Format(PyExc_ValueError, "readinto() returned %zd outside the range [0, %zd]", readLen, bufferSize);
+      break;
+    }
+    if (0 == readLen)
+      break;
+    status = aprmd5_md5_object_hash(self, buffer, readLen);
+    totalLen += (apr_uint64_t)readLen;
+    if (APR_SUCCESS != status)
+    {
+      PyErr_SetString(PyExc_RuntimeError, "MD5 update returned status code != 0");
+      break;
+    }
+  }
+  aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, statsStart, totalLen, APR_SUCCESS != status);
+  Py_DECREF(readinto);
+
+  // The file object might have kept a reference to the view. Releasing the
+  // view makes such a reference unusable, so that the buffer can be freed.
+  // If the view cannot be released because the file object still exports
+  // its buffer, the buffer is leaked rather than freed under its feet.
+  PyObject* error = NULL;
+  PyObject* errorValue = NULL;
+  PyObject* errorTraceback = NULL;
+  PyErr_Fetch(&error, &errorValue, &errorTraceback);
+  PyObject* released = PyObject_CallMethod(view, "release", NULL);
+  Py_DECREF(view);
+  if (NULL != released)
+  {
+    Py_DECREF(released);
+    PyMem_Free(buffer);
+  }
+  else if (NULL != error)
+  {
+    PyErr_Clear();
+  }
+  if (NULL != error)
+    PyErr_Restore(error, errorValue, errorTraceback);
+  if (PyErr_Occurred())
+    return NULL;
+
+  return PyLong_FromUnsignedLongLong((unsigned long long)totalLen);
+}
+
+// The job behind update_async()
+typedef struct
+{
+  aprmd5_async_job base;
+  aprmd5_md5_object* object;
+  Py_buffer input;
+  apr_status_t status;
+} aprmd5_md5_update_job;
+
+static void
+aprmd5_md5_update_job_run(aprmd5_async_job* job)
+{
+  aprmd5_md5_update_job* updateJob = (aprmd5_md5_update_job*)job;
+  aprmd5_md5_object* self = updateJob->object;
+  apr_int64_t statsStart = aprmd5_stats_start();
+  PyThread_acquire_lock(self->lock, 1);
+  self->finalDigestValid = 0;
+  updateJob->status = aprmd5_helper_md5_update(&self->context, updateJob->input.buf, updateJob->input.len);
+  PyThread_release_lock(self->lock);
+  aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, statsStart, (apr_uint64_t)updateJob->input.len,
+                      APR_SUCCESS != updateJob->status);
+}
+
+static PyObject*
+aprmd5_md5_update_job_complete(aprmd5_async_job* job)
+{
+  aprmd5_md5_update_job* updateJob = (aprmd5_md5_update_job*)job;
+  if (APR_SUCCESS != updateJob->status)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "MD5 update returned status code != 0");
+    return NULL;
+  }
   Py_INCREF(Py_None);
   return Py_None;
 }
 
+static void
+aprmd5_md5_update_job_release(aprmd5_async_job* job)
+{
+  aprmd5_md5_update_job* updateJob = (aprmd5_md5_update_job*)job;
+  APRMD5_BEGIN_CRITICAL_SECTION(updateJob->object);
+  updateJob->object->asyncUpdatePending = 0;
+  APRMD5_END_CRITICAL_SECTION();
+  PyBuffer_Release(&updateJob->input);
+  Py_DECREF(updateJob->object);
+}
+
+// The awaitable version of update(). Large buffers are hashed on a native
+// worker thread; the buffer stays acquired until the future is resolved.
+// Small buffers are hashed right away.
 static PyObject*
-aprmd5_md5_object_digest(aprmd5_md5_object* self, PyObject* args)
+aprmd5_md5_object_update_async(aprmd5_md5_object* self, PyObject* args)
 {
-  // Make a local copy of the context that we can operate on; apr_md5_final()
-  // will zero that copy, but the original state in self remains untouched
-  apr_md5_ctx_t contextCopy = self->context;
+  if (self->asyncUpdatePending)
+  {
+    PyErr_SetString(PyExc_RuntimeError, "another update_async() is still in progress");
+    return NULL;
+  }
 
-  // Generate the hash
-  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
-  apr_status_t status = apr_md5_final(digest, &contextCopy);
-  if (APR_SUCCESS != status)
+  aprmd5_md5_update_job* job = (aprmd5_md5_update_job*)PyMem_Malloc(sizeof(aprmd5_md5_update_job));
+  if (NULL == job)
+    return PyErr_NoMemory();
+  if (! PyArg_ParseTuple(args, "y*:update_async", &job->input))
+  {
+    PyMem_Free(job);
+    return NULL;
+  }
+
+  if (job->input.len < APRMD5_GIL_MINSIZE)
+  {
+    apr_status_t status = aprmd5_md5_object_feed(self, &job->input);
+    PyBuffer_Release(&job->input);
+    PyMem_Free(job);
+    if (APR_SUCCESS != status)
+      return NULL;
+    return aprmd5_async_resolved(aprmd5_state_from_type(Py_TYPE(self)), Py_None);
+  }
+
+  // The worker thread always needs the lock
+  if (self->lock == NULL)
+    self->lock = PyThread_allocate_lock();
+  if (self->lock == NULL)
+  {
+    PyBuffer_Release(&job->input);
+    PyMem_Free(job);
+    return PyErr_NoMemory();
+  }
+
+  // Check again, another thread may have started an update_async() in the
+  // meantime in the free-threaded build
+  int pending;
+  APRMD5_BEGIN_CRITICAL_SECTION(self);
+  pending = self->asyncUpdatePending;
+  self->asyncUpdatePending = 1;
+  APRMD5_END_CRITICAL_SECTION();
+  if (pending)
   {
-    PyErr_SetString(PyExc_RuntimeError, "apr_md5_final() returned status code != 0");
+    PyBuffer_Release(&job->input);
+    PyMem_Free(job);
+    PyErr_SetString(PyExc_RuntimeError, "another update_async() is still in progress");
     return NULL;
   }
 
+  Py_INCREF(self);
+  job->object = self;
+  job->status = APR_SUCCESS;
+  job->base.run = aprmd5_md5_update_job_run;
+  job->base.complete = aprmd5_md5_update_job_complete;
+  job->base.release = aprmd5_md5_update_job_release;
+  job->base.apr1 = NULL;
+  return aprmd5_async_submit(aprmd5_state_from_type(Py_TYPE(self)), &job->base);
+}
+
+#endif  // #if PY_MAJOR_VERSION >= 3
+
+// Stores the digest of the data fed to the object so far in digest. The
+// digest is computed only once and then cached until the next update.
+static void
+aprmd5_md5_object_final(aprmd5_md5_object* self, unsigned char* digest)
+{
+  APRMD5_MD5_OBJECT_ENTER(self);
+  if (! self->finalDigestValid)
+  {
+    // Finalize a local copy of the context; finalizing will zero that copy,
+    // but the original state in self remains untouched so that the user can
+    // continue calling update()
+    apr_md5_ctx_t contextCopy = self->context;
+    aprmd5_backend_selected->final(self->finalDigest, &contextCopy);
+    self->finalDigestValid = 1;
+  }
+  memcpy(digest, self->finalDigest, APRMD5_MD5_DIGESTSIZE);
+  APRMD5_MD5_OBJECT_LEAVE(self);
+}
+
+// Builds a string object with the hexadecimal digits of a digest
+static PyObject*
+aprmd5_md5_hexdigest_object(const unsigned char* digest)
+{
+  // Construct the hex digest right in the memory of the new string object
+  Py_ssize_t hexDigestLen = APRMD5_MD5_DIGESTSIZE * 2;
 #if PY_MAJOR_VERSION >= 3
-  // Output must be a bytes() object
-  const char* format = "y#";
+  PyObject* result = PyUnicode_New(hexDigestLen, 127);
+  if (NULL == result)
+    return NULL;
+  aprmd5_helper_bindigest_to_hexdigest(APRMD5_MD5_DIGESTSIZE, digest, (char*)PyUnicode_1BYTE_DATA(result));
 #else
-  // Output must be a str() object. The string may contain null bytes.
-  const char* format = "s#";
+  PyObject* result = PyString_FromStringAndSize(NULL, hexDigestLen);
+  if (NULL == result)
+    return NULL;
+  aprmd5_helper_bindigest_to_hexdigest(APRMD5_MD5_DIGESTSIZE, digest, PyString_AS_STRING(result));
 #endif
-  // Return the result; the Python system becomes responsible for the object
-  // returned by Py_BuildValue().
-  return Py_BuildValue(format, digest, APRMD5_MD5_DIGESTSIZE);
+  return result;
 }
 
+// Builds a bytes object (Python 3.x) or a str object (Python 2.x) with a
+// digest
 static PyObject*
-aprmd5_md5_object_hexdigest(aprmd5_md5_object* self, PyObject* args)
+aprmd5_md5_digest_object(const unsigned char* digest)
 {
-  // Make a local copy of the context that we can operate on; apr_md5_final()
-  // will zero that copy, but the original state in self remains untouched so
-  // that the user can continue calling update()
-  apr_md5_ctx_t contextCopy = self->context;
+#if PY_MAJOR_VERSION >= 3
+  return PyBytes_FromStringAndSize((const char*)digest, APRMD5_MD5_DIGESTSIZE);
+#else
+  return PyString_FromStringAndSize((const char*)digest, APRMD5_MD5_DIGESTSIZE);
+#endif
+}
 
-  // Generate the hash
-  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
-  apr_status_t status = apr_md5_final(digest, &contextCopy);
-  if (APR_SUCCESS != status)
+// Gets a writable buffer that can hold at least size bytes. Returns 0 on
+// success, or -1 with a Python exception set.
+static int
+aprmd5_md5_object_get_output_buffer(PyObject* arg, const char* format, Py_ssize_t size, Py_buffer* output)
+{
+  if (! PyArg_Parse(arg, format, output))
+    return -1;
+  if (output->len < size)
   {
-    PyErr_SetString(PyExc_RuntimeError, "apr_md5_final() returned status code != 0");
-    return NULL;
+    PyErr_Format(PyExc_ValueError, "buffer is too small, at least %zd bytes are required", size);
+    PyBuffer_Release(output);
+    return -1;
   }
+  return 0;
+}
 
-  // Construct the hex digest from the binary digest
-  Py_ssize_t hexDigestLen = APRMD5_MD5_DIGESTSIZE * 2;
-  char hexDigest[hexDigestLen];
-  aprmd5_helper_bindigest_to_hexdigest(APRMD5_MD5_DIGESTSIZE, digest, hexDigest);
+static PyObject*
+aprmd5_md5_object_digest(aprmd5_md5_object* self, PyObject* args)
+{
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_md5_object_final(self, digest);
+  return aprmd5_md5_digest_object(digest);
+}
 
-  // Return the result; the Python system becomes responsible for the object
-  // returned by Py_BuildValue().
-  return Py_BuildValue("s#", hexDigest, hexDigestLen);
+static PyObject*
+aprmd5_md5_object_hexdigest(aprmd5_md5_object* self, PyObject* args)
+{
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_md5_object_final(self, digest);
+  return aprmd5_md5_hexdigest_object(digest);
+}
+
+static PyObject*
+aprmd5_md5_object_digest_into(aprmd5_md5_object* self, PyObject* arg)
+{
+  Py_buffer output;
+  if (aprmd5_md5_object_get_output_buffer(arg, "w*:digest_into", APRMD5_MD5_DIGESTSIZE, &output) < 0)
+    return NULL;
+  aprmd5_md5_object_final(self, (unsigned char*)output.buf);
+  PyBuffer_Release(&output);
+  return PyLong_FromLong(APRMD5_MD5_DIGESTSIZE);
+}
+
+static PyObject*
+aprmd5_md5_object_hexdigest_into(aprmd5_md5_object* self, PyObject* arg)
+{
+  Py_buffer output;
+  if (aprmd5_md5_object_get_output_buffer(arg, "w*:hexdigest_into", APRMD5_MD5_DIGESTSIZE * 2, &output) < 0)
+    return NULL;
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  aprmd5_md5_object_final(self, digest);
+  aprmd5_helper_bindigest_to_hexdigest(APRMD5_MD5_DIGESTSIZE, digest, (char*)output.buf);
+  PyBuffer_Release(&output);
+  return PyLong_FromLong(APRMD5_MD5_DIGESTSIZE * 2);
 }
 
 static PyObject*
@@ -235,16 +691,178 @@ aprmd5_md5_object_copy(aprmd5_md5_object* self, PyObject* args)
 #else
   PyTypeObject* type = self->ob_type;
 #endif
-  if (type != &aprmd5_md5_type)
-    return NULL;
-  aprmd5_md5_object* newobj = (aprmd5_md5_object*)type->tp_alloc(type, 0);
+  aprmd5_md5_object* newobj = aprmd5_md5_object_alloc(type);
   if (NULL == newobj)
     return NULL;
+  APRMD5_MD5_OBJECT_ENTER(self);
   newobj->context = self->context;
+  newobj->finalDigestValid = self->finalDigestValid;
+  memcpy(newobj->finalDigest, self->finalDigest, APRMD5_MD5_DIGESTSIZE);
+  APRMD5_MD5_OBJECT_LEAVE(self);
   return (PyObject*)newobj;
 }
 
 
+// ---------------------------------------------------------------------------
+// Serialization of md5 objects
+//
+// The exported state has a fixed byte order, so it can be restored on any
+// platform, by any later version of this module that still reads the
+// format version.
+// ---------------------------------------------------------------------------
+
+
+// ---------------------------------------------------------------------------
+// Serializes an MD5 context into the format of export_state().
+//
+// Parameters:
+// - context: The MD5 context to serialize
+// - state: A buffer of at least APRMD5_MD5_STATEMAXSIZE bytes that receives
+//   the serialized context
+//
+// Return value:
+// - The number of bytes written to state
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+Py_ssize_t aprmd5_md5_state_export(const apr_md5_ctx_t* context, unsigned char* state)
+{
+  memcpy(state, APRMD5_MD5_STATEMAGIC, 4);
+  state[4] = APRMD5_MD5_STATEVERSION;
+  int index;
+  for (index = 0; index < 4; ++index)
+    aprmd5_helper_put_uint32(state + 5 + 4 * index, context->state[index]);
+  aprmd5_helper_put_uint32(state + 21, context->count[0]);
+  aprmd5_helper_put_uint32(state + 25, context->count[1]);
+  apr_size_t pendingLen = (context->count[0] >> 3) & (APRMD5_MD5_BLOCKSIZE - 1);
+  memcpy(state + APRMD5_MD5_STATEHEADERSIZE, context->buffer, pendingLen);
+  return (Py_ssize_t)(APRMD5_MD5_STATEHEADERSIZE + pendingLen);
+}
+
+
+// ---------------------------------------------------------------------------
+// Restores an MD5 context from the format of export_state().
+//
+// Parameters:
+// - context: The MD5 context that receives the restored state. The context
+//   is only changed if the function succeeds.
+// - state: The serialized context
+// - stateLen: The length of state in bytes
+//
+// Return value:
+// - APRMD5_MD5_STATE_OK on success
+// - APRMD5_MD5_STATE_NOTSTATE if state is not an exported md5 state
+// - APRMD5_MD5_STATE_VERSION if the format version is not supported
+// - APRMD5_MD5_STATE_CORRUPT if the state is inconsistent
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_md5_state_import(apr_md5_ctx_t* context, const unsigned char* state, Py_ssize_t stateLen)
+{
+  if (stateLen < APRMD5_MD5_STATEHEADERSIZE || 0 != memcmp(state, APRMD5_MD5_STATEMAGIC, 4))
+    return APRMD5_MD5_STATE_NOTSTATE;
+  if (APRMD5_MD5_STATEVERSION != state[4])
+    return APRMD5_MD5_STATE_VERSION;
+  apr_md5_ctx_t restored;
+  aprmd5_md5block_ctx_init(&restored);
+  int index;
+  for (index = 0; index < 4; ++index)
+    restored.state[index] = aprmd5_helper_get_uint32(state + 5 + 4 * index);
+  restored.count[0] = aprmd5_helper_get_uint32(state + 21);
+  restored.count[1] = aprmd5_helper_get_uint32(state + 25);
+  apr_size_t pendingLen = (restored.count[0] >> 3) & (APRMD5_MD5_BLOCKSIZE - 1);
+  // Only whole bytes can be fed to an md5 object
+  if (0 != (restored.count[0] & 7) || (Py_ssize_t)(APRMD5_MD5_STATEHEADERSIZE + pendingLen) != stateLen)
+    return APRMD5_MD5_STATE_CORRUPT;
+  memcpy(restored.buffer, state + APRMD5_MD5_STATEHEADERSIZE, pendingLen);
+  *context = restored;
+  return APRMD5_MD5_STATE_OK;
+}
+
+
+static PyObject*
+aprmd5_md5_object_export_state(aprmd5_md5_object* self, PyObject* args)
+{
+  unsigned char state[APRMD5_MD5_STATEMAXSIZE];
+  APRMD5_MD5_OBJECT_ENTER(self);
+  Py_ssize_t stateLen = aprmd5_md5_state_export(&self->context, state);
+  APRMD5_MD5_OBJECT_LEAVE(self);
+
+#if PY_MAJOR_VERSION >= 3
+  return PyBytes_FromStringAndSize((const char*)state, stateLen);
+#else
+  return PyString_FromStringAndSize((const char*)state, stateLen);
+#endif
+}
+
+// Restores the context of an md5 object from an exported state. Returns 0 on
+// success, or -1 with a Python exception set.
+static int
+aprmd5_md5_object_import_state(aprmd5_md5_object* self, PyObject* stateObject)
+{
+  Py_buffer buffer;
+  if (! PyArg_Parse(stateObject, APRMD5_MD5_INPUTFORMAT ":__setstate__", &buffer))
+    return -1;
+  apr_md5_ctx_t context;
+  int status = aprmd5_md5_state_import(&context, (const unsigned char*)buffer.buf, buffer.len);
+  if (APRMD5_MD5_STATE_VERSION == status)
+    PyErr_Format(PyExc_ValueError, "unsupported md5 state version %d", (int)((const unsigned char*)buffer.buf)[4]);
+  PyBuffer_Release(&buffer);
+  if (APRMD5_MD5_STATE_NOTSTATE == status)
+    PyErr_SetString(PyExc_ValueError, "not an exported md5 state");
+  else if (APRMD5_MD5_STATE_CORRUPT == status)
+    PyErr_SetString(PyExc_ValueError, "md5 state is corrupt");
+  if (APRMD5_MD5_STATE_OK != status)
+    return -1;
+
+  APRMD5_MD5_OBJECT_ENTER(self);
+  self->context = context;
+  self->finalDigestValid = 0;
+  APRMD5_MD5_OBJECT_LEAVE(self);
+  return 0;
+}
+
+static PyObject*
+aprmd5_md5_object_setstate(aprmd5_md5_object* self, PyObject* stateObject)
+{
+  if (aprmd5_md5_object_import_state(self, stateObject) < 0)
+    return NULL;
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+// Pickling recreates the object by calling md5() without arguments, and then
+// restores the state with __setstate__()
+static PyObject*
+aprmd5_md5_object_reduce(aprmd5_md5_object* self, PyObject* args)
+{
+  PyObject* state = aprmd5_md5_object_export_state(self, NULL);
+  if (NULL == state)
+    return NULL;
+  return Py_BuildValue("O()N", (PyObject*)Py_TYPE(self), state);
+}
+
+static PyObject*
+aprmd5_md5_object_from_state(PyObject* type, PyObject* stateObject)
+{
+  aprmd5_md5_object* self = aprmd5_md5_object_alloc((PyTypeObject*)type);
+  if (NULL == self)
+    return NULL;
+  if (aprmd5_md5_object_import_state(self, stateObject) < 0)
+  {
+    Py_DECREF(self);
+    return NULL;
+  }
+  return (PyObject*)self;
+}
+
+
 // ---------------------------------------------------------------------------
 // Implementation of md5 type attribute getters/setters
 // ---------------------------------------------------------------------------
@@ -308,9 +926,23 @@ static PyGetSetDef aprmd5_md5_object_getseters[] =
 static PyMethodDef aprmd5_md5_object_methods[] =
 {
   {
-    "update", (PyCFunction)aprmd5_md5_object_update, METH_VARARGS,
-    "Update the hash object with the object arg, which must be a bytes object (Python 3.x) or a string object (Python 2.6 and earlier). Repeated calls are equivalent to a single call with the concatenation of all the arguments: m.update(a); m.update(b) is equivalent to m.update(a+b)."
+    "update", (PyCFunction)aprmd5_md5_object_update, METH_O,
+    "Update the hash object with the object arg, which must be a bytes-like object such as bytes, bytearray, memoryview or mmap (Python 3.x) or a string or buffer object (Python 2.6 and earlier). The buffer is not copied, and large buffers are hashed with the GIL released. Repeated calls are equivalent to a single call with the concatenation of all the arguments: m.update(a); m.update(b) is equivalent to m.update(a+b)."
+  },
+  {
+    "update_many", (PyCFunction)aprmd5_md5_object_update_many, METH_O,
+    "Update the hash object with every bytes-like object of an iterable, in order. This is equivalent to calling update() for each object, but saves the overhead of one Python method call per object."
+  },
+#if PY_MAJOR_VERSION >= 3
+  {
+    "update_from", (PyCFunction)aprmd5_md5_object_update_from, METH_VARARGS | METH_KEYWORDS,
+    "Update the hash object with the content of a binary file object, from its current position until EOF. The data is read with the file object's readinto() method into a single buffer (keyword argument bufsize, default is 65536 bytes) that is reused for every read; large reads are hashed with the GIL released. Returns the number of bytes read. Non-blocking file objects are not supported."
+  },
+  {
+    "update_async", (PyCFunction)aprmd5_md5_object_update_async, METH_VARARGS,
+    "Like update(), but returns an awaitable. Large buffers are hashed on a native worker thread so that the asyncio event loop is not blocked; the buffer must not be modified until the awaitable is done. Only one update_async() may be in progress at a time; update() and the other methods wait for it to finish."
   },
+#endif  // #if PY_MAJOR_VERSION >= 3
   {
     "digest", (PyCFunction)aprmd5_md5_object_digest, METH_NOARGS,
     "Return the digest of the data passed to the update() method so far. This is a bytes array (Python 3.x) or a string object (Python 2.6 and earlier) of size digest_size which may contain bytes in the whole range from 0 to 255."
@@ -319,6 +951,30 @@ static PyMethodDef aprmd5_md5_object_methods[] =
     "hexdigest", (PyCFunction)aprmd5_md5_object_hexdigest, METH_NOARGS,
     "Like digest() except the digest is returned as a string object of double length, containing only hexadecimal digits. This may be used to exchange the value safely in email or other non-binary environments."
   },
+  {
+    "digest_into", (PyCFunction)aprmd5_md5_object_digest_into, METH_O,
+    "Like digest(), but writes the digest into the first digest_size bytes of a writable buffer (e.g. a bytearray or a memoryview) instead of creating a new object. Returns the number of bytes written."
+  },
+  {
+    "hexdigest_into", (PyCFunction)aprmd5_md5_object_hexdigest_into, METH_O,
+    "Like hexdigest(), but writes the hexadecimal digits as ASCII bytes into the first 2 * digest_size bytes of a writable buffer instead of creating a new object. Returns the number of bytes written."
+  },
+  {
+    "export_state", (PyCFunction)aprmd5_md5_object_export_state, METH_NOARGS,
+    "Return the internal state of the hash object as bytes. md5.from_state() turns the bytes into a hash object that continues where this one left off, also in another process or on another platform. The state contains a small part of the data passed to update() in clear text, so it should be protected like the data itself."
+  },
+  {
+    "from_state", (PyCFunction)aprmd5_md5_object_from_state, METH_O | METH_CLASS,
+    "Create a hash object from a state that was returned by export_state(). Raises ValueError if the state is not valid."
+  },
+  {
+    "__reduce__", (PyCFunction)aprmd5_md5_object_reduce, METH_NOARGS,
+    "Support for pickle and copy. The pickled form contains the state returned by export_state()."
+  },
+  {
+    "__setstate__", (PyCFunction)aprmd5_md5_object_setstate, METH_O,
+    "Restore a state that was returned by export_state(). Used by pickle."
+  },
   {
     "copy", (PyCFunction)aprmd5_md5_object_copy, METH_NOARGS,
     "Return a copy (“clone”) of the hash object. This can be used to efficiently compute the digests of data sharing a common initial substring."
@@ -332,55 +988,32 @@ static PyMethodDef aprmd5_md5_object_methods[] =
 
 #if PY_MAJOR_VERSION >= 3
 
-PyTypeObject aprmd5_md5_type =
+// Under Python 3 the type is a heap type, so that each interpreter has its own
+// md5 type. The module state is reachable from the type.
+static PyType_Slot aprmd5_md5_type_slots[] =
 {
-  PyObject_HEAD_INIT(NULL)
-  "aprmd5.md5",                  // tp_name
-  sizeof(aprmd5_md5_object),     // tp_basicsize
-  0,                             // tp_itemsize
-  (destructor)
-    aprmd5_md5_object_dealloc,   // tp_dealloc
-  0,                             // tp_print
-  0,                             // tp_getattr
-  0,                             // tp_setattr
-  0,                             // tp_reserved
-  0,                             // tp_repr
-  0,                             // tp_as_number
-  0,                             // tp_as_sequence
-  0,                             // tp_as_mapping
-  0,                             // tp_hash
-  0,                             // tp_call
-  0,                             // tp_str
-  0,                             // tp_getattro
-  0,                             // tp_setattro
-  0,                             // tp_as_buffer
-  Py_TPFLAGS_DEFAULT,            // tp_flags; Py_TPFLAGS_DEFAULT enables all
-                                 // members defined by the version of Python
-                                 // that this is compiled for
-  "Instances of this class are used to generate MD5 hashes", // tp_doc
-  0,                             // tp_traverse
-  0,                             // tp_clear
-  0,                             // tp_richcompare
-  0,                             // tp_weaklistoffset
-  0,                             // tp_iter
-  0,                             // tp_iternext
-  aprmd5_md5_object_methods,     // tp_methods
-  aprmd5_md5_object_members,     // tp_members
-  aprmd5_md5_object_getseters,   // tp_getset
-  0,                             // tp_base
-  0,                             // tp_dict
-  0,                             // tp_descr_get
-  0,                             // tp_descr_set
-  0,                             // tp_dictoffset
-  (initproc)
-    aprmd5_md5_object_init,      // tp_init
-  0,                             // tp_alloc
-  aprmd5_md5_object_new,         // tp_new
+  {Py_tp_dealloc, (void*)aprmd5_md5_object_dealloc},
+  {Py_tp_doc, "Instances of this class are used to generate MD5 hashes"},
+  {Py_tp_methods, aprmd5_md5_object_methods},
+  {Py_tp_members, aprmd5_md5_object_members},
+  {Py_tp_getset, aprmd5_md5_object_getseters},
+  {Py_tp_init, (void*)aprmd5_md5_object_init},
+  {Py_tp_new, (void*)aprmd5_md5_object_new},
+  {0, NULL}
+};
+
+static PyType_Spec aprmd5_md5_type_spec =
+{
+  "aprmd5.md5",
+  sizeof(aprmd5_md5_object),
+  0,
+  APRMD5_TPFLAGS_DEFAULT,
+  aprmd5_md5_type_slots
 };
 
 #else   // #if PY_MAJOR_VERSION >= 3
 
-PyTypeObject aprmd5_md5_type =
+static PyTypeObject aprmd5_md5_type =
 {
   PyObject_HEAD_INIT(NULL)
   0,                             // ob_size
@@ -428,3 +1061,157 @@ PyTypeObject aprmd5_md5_type =
 };
 
 #endif  // #if PY_MAJOR_VERSION >= 3
+
+
+// ---------------------------------------------------------------------------
+// Fast construction of md5 objects
+//
+// Since Python 3.9 a type can be called through the vectorcall protocol,
+// which skips creating an argument tuple and the separate calls of tp_new
+// and tp_init. md5() and md5(data) take this path; anything else, e.g. the
+// keyword argument, falls back to the regular type call.
+// ---------------------------------------------------------------------------
+
+#if PY_VERSION_HEX >= 0x03090000
+
+static PyObject*
+aprmd5_md5_type_vectorcall(PyObject* type, PyObject* const* args, size_t nargsf, PyObject* kwnames)
+{
+  Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+  if (nargs > 1 || (NULL != kwnames && PyTuple_GET_SIZE(kwnames) > 0))
+  {
+    // Let the regular type call do the argument checking
+    PyObject* argsTuple = PyTuple_New(nargs);
+    if (NULL == argsTuple)
+      return NULL;
+    Py_ssize_t index;
+    for (index = 0; index < nargs; ++index)
+    {
+      Py_INCREF(args[index]);
+      PyTuple_SET_ITEM(argsTuple, index, args[index]);
+    }
+    PyObject* kwargs = NULL;
+    if (NULL != kwnames)
+    {
+      kwargs = PyDict_New();
+      for (index = 0; NULL != kwargs && index < PyTuple_GET_SIZE(kwnames); ++index)
+      {
+        if (PyDict_SetItem(kwargs, PyTuple_GET_ITEM(kwnames, index), args[nargs + index]) < 0)
+          Py_CLEAR(kwargs);
+      }
+      if (NULL == kwargs)
+      {
+        Py_DECREF(argsTuple);
+        return NULL;
+      }
+    }
+    PyObject* result = PyType_Type.tp_call(type, argsTuple, kwargs);
+    Py_DECREF(argsTuple);
+    Py_XDECREF(kwargs);
+    return result;
+  }
+
+  aprmd5_md5_object* self = aprmd5_md5_object_alloc((PyTypeObject*)type);
+  if (NULL == self)
+    return NULL;
+  aprmd5_md5block_ctx_init(&self->context);
+  if (1 == nargs)
+  {
+    Py_buffer input;
+    if (! APRMD5_MD5_GET_INPUT(args[0], &input, "md5"))
+    {
+      Py_DECREF(self);
+      return NULL;
+    }
+    apr_status_t status = aprmd5_md5_object_feed(self, &input);
+    PyBuffer_Release(&input);
+    if (APR_SUCCESS != status)
+    {
+      Py_DECREF(self);
+      return NULL;
+    }
+  }
+  return (PyObject*)self;
+}
+
+#endif  // #if PY_VERSION_HEX >= 0x03090000
+
+// Creates the md5 type of a module. Returns a new reference, or NULL with a
+// Python exception set.
+PyObject*
+aprmd5_md5_type_create(PyObject* module)
+{
+#if PY_MAJOR_VERSION >= 3
+  PyObject* type = aprmd5_helper_type_from_spec(module, &aprmd5_md5_type_spec);
+  if (NULL == type)
+    return NULL;
+#if PY_VERSION_HEX >= 0x03090000
+  ((PyTypeObject*)type)->tp_vectorcall = aprmd5_md5_type_vectorcall;
+#endif
+  return type;
+#else   // #if PY_MAJOR_VERSION >= 3
+  if (PyType_Ready(&aprmd5_md5_type) < 0)
+    return NULL;
+  Py_INCREF(&aprmd5_md5_type);
+  return (PyObject*)&aprmd5_md5_type;
+#endif  // #if PY_MAJOR_VERSION >= 3
+}
+
+
+// ---------------------------------------------------------------------------
+// One-shot digests
+//
+// These module functions hash a single buffer without creating an md5
+// object. From within Python, they are available as
+//
+//   aprmd5.md5_digest()
+//   aprmd5.md5_hexdigest()
+// ---------------------------------------------------------------------------
+
+// Computes the digest of a buffer object. Returns 0 on success, or -1 with a
+// Python exception set.
+static int
+aprmd5_md5_oneshot(PyObject* data, unsigned char* digest)
+{
+  Py_buffer input;
+  if (! APRMD5_MD5_GET_INPUT(data, &input, "md5_digest"))
+    return -1;
+
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_md5_ctx_t context;
+  aprmd5_md5block_ctx_init(&context);
+  if (input.len >= APRMD5_GIL_MINSIZE)
+  {
+    Py_BEGIN_ALLOW_THREADS
+    aprmd5_helper_md5_update(&context, input.buf, input.len);
+    aprmd5_backend_selected->final(digest, &context);
+    Py_END_ALLOW_THREADS
+  }
+  else
+  {
+    aprmd5_helper_md5_update(&context, input.buf, input.len);
+    aprmd5_backend_selected->final(digest, &context);
+  }
+  aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, statsStart, (apr_uint64_t)input.len, 0);
+
+  PyBuffer_Release(&input);
+  return 0;
+}
+
+PyObject*
+aprmd5_md5_digest(PyObject* self, PyObject* data)
+{
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  if (aprmd5_md5_oneshot(data, digest) < 0)
+    return NULL;
+  return aprmd5_md5_digest_object(digest);
+}
+
+PyObject*
+aprmd5_md5_hexdigest(PyObject* self, PyObject* data)
+{
+  unsigned char digest[APRMD5_MD5_DIGESTSIZE];
+  if (aprmd5_md5_oneshot(data, digest) < 0)
+    return NULL;
+  return aprmd5_md5_hexdigest_object(digest);
+}
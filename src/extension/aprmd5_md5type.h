@@ -26,12 +26,45 @@
 #ifndef APRMD5_MD5TYPE_H
 #define APRMD5_MD5TYPE_H
 
+// The exported state of an md5 object (see export_state()) has this layout;
+// all integers are little endian:
+//   4 bytes   magic "AMD5"
+//   1 byte    format version
+//   16 bytes  the state words A, B, C and D, 4 bytes each
+//   8 bytes   the number of bits fed to the object so far, modulo 2^64
+//   n bytes   the pending input that does not fill a block yet; n is the
+//             number of bytes fed so far, modulo the block size
+#define APRMD5_MD5_STATEMAGIC "AMD5"
+#define APRMD5_MD5_STATEVERSION 1
+#define APRMD5_MD5_STATEHEADERSIZE (4 + 1 + 16 + 8)
+#define APRMD5_MD5_STATEMAXSIZE (APRMD5_MD5_STATEHEADERSIZE + APRMD5_MD5_BLOCKSIZE)
+
+// The results of aprmd5_md5_state_import()
+#define APRMD5_MD5_STATE_OK        0
+#define APRMD5_MD5_STATE_NOTSTATE  -1
+#define APRMD5_MD5_STATE_VERSION   -2
+#define APRMD5_MD5_STATE_CORRUPT   -3
 
 // Type name that is exposed to Python
 extern const char* aprmd5_md5_type_name;
 
-// Type object
-extern PyTypeObject aprmd5_md5_type;
+extern PyObject*
+aprmd5_md5_type_create(PyObject* module);
+
+extern PyObject*
+aprmd5_md5_digest(PyObject* self, PyObject* data);
+
+extern PyObject*
+aprmd5_md5_hexdigest(PyObject* self, PyObject* data);
+
+extern Py_ssize_t
+aprmd5_md5_state_export(const apr_md5_ctx_t* context,
+                        unsigned char* state);
+
+extern int
+aprmd5_md5_state_import(apr_md5_ctx_t* context,
+                        const unsigned char* state,
+                        Py_ssize_t stateLen);
 
 
 #endif // #ifndef APRMD5_MD5TYPE_H
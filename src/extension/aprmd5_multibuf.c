@@ -0,0 +1,475 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the multi-buffer MD5 engine and the module function
+// md5_many() that exposes it to Python.
+//
+// MD5 is inherently serial within one message, but independent messages can
+// be hashed in parallel: Each SIMD lane holds the state of a different
+// message. The engine keeps all lanes busy by assigning the next message to a
+// lane as soon as the lane's previous message is finished.
+//
+// Kernels exist for SSE2 (4 lanes), AVX2 (8 lanes) and AVX-512 (16 lanes).
+// The best kernel that the CPU supports is selected at module initialization.
+// A scalar kernel (1 lane) that uses the selected single-stream compression
+// function is used on all other CPUs. The environment variable
+// APRMD5_MULTIBUF_KERNEL can be set to "scalar", "sse2", "avx2" or "avx512" to
+// force a specific kernel, which is useful for verification. A kernel that the
+// CPU does not support is never selected.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_multibuf.h"
+#include "aprmd5_md5block.h"
+#include "aprmd5_threadpool.h"
+
+// System includes
+#include <stdlib.h>   // for getenv()
+#include <string.h>   // for memcpy(), strcmp()
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define APRMD5_MULTIBUF_X86 1
+#include <immintrin.h>
+#endif
+
+
+// The number of messages that a worker thread of md5_many() processes in one
+// go. Small messages take only a fraction of a microsecond, so the ranges must
+// be large to outweigh the cost of starting threads.
+#define APRMD5_MULTIBUF_GRAINSIZE 4096
+
+// Fed to lanes that have no work
+static const unsigned char aprmd5_multibuf_zero_block[APRMD5_MD5_BLOCKSIZE] = { 0 };
+
+
+// ---------------------------------------------------------------------------
+// The scalar kernel
+// ---------------------------------------------------------------------------
+static void
+aprmd5_multibuf_kernel_scalar(apr_uint32_t* state, const unsigned char* const* blocks)
+{
+  // With only one lane, the "structure of arrays" layout of the state is the
+  // same as the layout expected by the single-stream compression functions
+  if (NULL != blocks[0])
+    aprmd5_md5block_selected(state, blocks[0], 1);
+}
+
+
+// ---------------------------------------------------------------------------
+// The SIMD kernels, generated from aprmd5_multibuf_kernel.h
+// ---------------------------------------------------------------------------
+#ifdef APRMD5_MULTIBUF_X86
+
+// SSE2
+#define APRMD5_MB_NAME          aprmd5_multibuf_kernel_sse2
+#define APRMD5_MB_TARGET        __attribute__((target("sse2")))
+#define APRMD5_MB_LANES         4
+#define APRMD5_MB_VEC           __m128i
+#define APRMD5_MB_LOAD(p)       _mm_loadu_si128((const __m128i*)(p))
+#define APRMD5_MB_STORE(p, v)   _mm_storeu_si128((__m128i*)(p), (v))
+#define APRMD5_MB_SET1(x)       _mm_set1_epi32((int)(x))
+#define APRMD5_MB_ADD(a, b)     _mm_add_epi32((a), (b))
+#define APRMD5_MB_AND(a, b)     _mm_and_si128((a), (b))
+#define APRMD5_MB_ROTL(v, n)    _mm_or_si128(_mm_slli_epi32((v), (n)), _mm_srli_epi32((v), 32 - (n)))
+#define APRMD5_MB_F(x, y, z)    _mm_xor_si128((z), _mm_and_si128((x), _mm_xor_si128((y), (z))))
+#define APRMD5_MB_G(x, y, z)    _mm_xor_si128((y), _mm_and_si128((z), _mm_xor_si128((x), (y))))
+#define APRMD5_MB_H(x, y, z)    _mm_xor_si128(_mm_xor_si128((x), (y)), (z))
+#define APRMD5_MB_I(x, y, z)    _mm_xor_si128((y), _mm_or_si128((x), _mm_xor_si128((z), _mm_set1_epi32(-1))))
+#include "aprmd5_multibuf_kernel.h"
+#undef APRMD5_MB_NAME
+#undef APRMD5_MB_TARGET
+#undef APRMD5_MB_LANES
+#undef APRMD5_MB_VEC
+#undef APRMD5_MB_LOAD
+#undef APRMD5_MB_STORE
+#undef APRMD5_MB_SET1
+#undef APRMD5_MB_ADD
+#undef APRMD5_MB_AND
+#undef APRMD5_MB_ROTL
+#undef APRMD5_MB_F
+#undef APRMD5_MB_G
+#undef APRMD5_MB_H
+#undef APRMD5_MB_I
+
+// AVX2
+#define APRMD5_MB_NAME          aprmd5_multibuf_kernel_avx2
+#define APRMD5_MB_TARGET        __attribute__((target("avx2")))
+#define APRMD5_MB_LANES         8
+#define APRMD5_MB_VEC           __m256i
+#define APRMD5_MB_LOAD(p)       _mm256_loadu_si256((const __m256i*)(p))
+#define APRMD5_MB_STORE(p, v)   _mm256_storeu_si256((__m256i*)(p), (v))
+#define APRMD5_MB_SET1(x)       _mm256_set1_epi32((int)(x))
+#define APRMD5_MB_ADD(a, b)     _mm256_add_epi32((a), (b))
+#define APRMD5_MB_AND(a, b)     _mm256_and_si256((a), (b))
+#define APRMD5_MB_ROTL(v, n)    _mm256_or_si256(_mm256_slli_epi32((v), (n)), _mm256_srli_epi32((v), 32 - (n)))
+#define APRMD5_MB_F(x, y, z)    _mm256_xor_si256((z), _mm256_and_si256((x), _mm256_xor_si256((y), (z))))
+#define APRMD5_MB_G(x, y, z)    _mm256_xor_si256((y), _mm256_and_si256((z), _mm256_xor_si256((x), (y))))
+#define APRMD5_MB_H(x, y, z)    _mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+#define APRMD5_MB_I(x, y, z)    _mm256_xor_si256((y), _mm256_or_si256((x), _mm256_xor_si256((z), _mm256_set1_epi32(-1))))
+#include "aprmd5_multibuf_kernel.h"
+#undef APRMD5_MB_NAME
+#undef APRMD5_MB_TARGET
+#undef APRMD5_MB_LANES
+#undef APRMD5_MB_VEC
+#undef APRMD5_MB_LOAD
+#undef APRMD5_MB_STORE
+#undef APRMD5_MB_SET1
+#undef APRMD5_MB_ADD
+#undef APRMD5_MB_AND
+#undef APRMD5_MB_ROTL
+#undef APRMD5_MB_F
+#undef APRMD5_MB_G
+#undef APRMD5_MB_H
+#undef APRMD5_MB_I
+
+// AVX-512. The rotation is a native instruction, and each auxiliary function
+// is a single ternary logic instruction. The immediate operand is the truth
+// table of the function for the inputs x = 0xf0, y = 0xcc and z = 0xaa.
+#define APRMD5_MB_NAME          aprmd5_multibuf_kernel_avx512
+#define APRMD5_MB_TARGET        __attribute__((target("avx512f")))
+#define APRMD5_MB_LANES         16
+#define APRMD5_MB_VEC           __m512i
+#define APRMD5_MB_LOAD(p)       _mm512_loadu_si512((const void*)(p))
+#define APRMD5_MB_STORE(p, v)   _mm512_storeu_si512((void*)(p), (v))
+#define APRMD5_MB_SET1(x)       _mm512_set1_epi32((int)(x))
+#define APRMD5_MB_ADD(a, b)     _mm512_add_epi32((a), (b))
+#define APRMD5_MB_AND(a, b)     _mm512_and_si512((a), (b))
+#define APRMD5_MB_ROTL(v, n)    _mm512_rol_epi32((v), (n))
+#define APRMD5_MB_F(x, y, z)    _mm512_ternarylogic_epi32((x), (y), (z), 0xca)
+#define APRMD5_MB_G(x, y, z)    _mm512_ternarylogic_epi32((x), (y), (z), 0xe4)
+#define APRMD5_MB_H(x, y, z)    _mm512_ternarylogic_epi32((x), (y), (z), 0x96)
+#define APRMD5_MB_I(x, y, z)    _mm512_ternarylogic_epi32((x), (y), (z), 0x39)
+#include "aprmd5_multibuf_kernel.h"
+#undef APRMD5_MB_NAME
+#undef APRMD5_MB_TARGET
+#undef APRMD5_MB_LANES
+#undef APRMD5_MB_VEC
+#undef APRMD5_MB_LOAD
+#undef APRMD5_MB_STORE
+#undef APRMD5_MB_SET1
+#undef APRMD5_MB_ADD
+#undef APRMD5_MB_AND
+#undef APRMD5_MB_ROTL
+#undef APRMD5_MB_F
+#undef APRMD5_MB_G
+#undef APRMD5_MB_H
+#undef APRMD5_MB_I
+
+#endif  // #ifdef APRMD5_MULTIBUF_X86
+
+
+// ---------------------------------------------------------------------------
+// The table of kernels, best kernel first. Kernels for which the CPU check
+// fails at runtime are skipped.
+// ---------------------------------------------------------------------------
+static const aprmd5_multibuf_kernel aprmd5_multibuf_kernels[] =
+{
+#ifdef APRMD5_MULTIBUF_X86
+  { "avx512", 16, aprmd5_multibuf_kernel_avx512 },
+  { "avx2",    8, aprmd5_multibuf_kernel_avx2 },
+  { "sse2",    4, aprmd5_multibuf_kernel_sse2 },
+#endif
+  { "scalar",  1, aprmd5_multibuf_kernel_scalar },
+  { NULL,      0, NULL }   // Sentinel
+};
+
+// The kernel that is used by md5_many() and the other multi-lane engines
+const aprmd5_multibuf_kernel* aprmd5_multibuf_selected_kernel = NULL;
+
+// The scalar kernel, for engines that work on a single message
+const aprmd5_multibuf_kernel aprmd5_multibuf_scalar_kernel = { "scalar", 1, aprmd5_multibuf_kernel_scalar };
+
+static int
+aprmd5_multibuf_kernel_is_supported(const aprmd5_multibuf_kernel* kernel)
+{
+#ifdef APRMD5_MULTIBUF_X86
+  if (0 == strcmp(kernel->name, "avx512"))
+    return __builtin_cpu_supports("avx512f");
+  if (0 == strcmp(kernel->name, "avx2"))
+    return __builtin_cpu_supports("avx2");
+  if (0 == strcmp(kernel->name, "sse2"))
+    return __builtin_cpu_supports("sse2");
+#endif
+  return 1;
+}
+
+
+// ---------------------------------------------------------------------------
+// Selects the kernel that is used by the multi-buffer MD5 engine. This must be
+// called once when the module is initialized.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_multibuf_init(void)
+{
+#ifdef APRMD5_MULTIBUF_X86
+  __builtin_cpu_init();
+#endif
+  const char* forcedName = getenv("APRMD5_MULTIBUF_KERNEL");
+  const aprmd5_multibuf_kernel* kernel;
+  for (kernel = aprmd5_multibuf_kernels; NULL != kernel->name; ++kernel)
+  {
+    if (NULL != forcedName && '\0' != forcedName[0] && 0 != strcmp(forcedName, kernel->name))
+      continue;
+    if (aprmd5_multibuf_kernel_is_supported(kernel))
+      break;
+  }
+  // Fall back to the scalar kernel if the forced kernel is unknown or not
+  // supported
+  if (NULL == kernel->name)
+    --kernel;
+  aprmd5_multibuf_selected_kernel = kernel;
+}
+
+
+// ---------------------------------------------------------------------------
+// The per-lane bookkeeping of aprmd5_multibuf_md5()
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  aprmd5_multibuf_job* job;          // NULL if the lane is idle
+  const unsigned char* nextBlock;    // next block of the message data
+  apr_size_t dataBlocksLeft;         // number of complete data blocks left
+  apr_size_t tailBlocksLeft;         // number of padded tail blocks left
+  apr_size_t tailBlockCount;
+  unsigned char tail[2 * APRMD5_MD5_BLOCKSIZE];
+} aprmd5_multibuf_lane;
+
+// Assigns a job to a lane and resets the lane's state
+static void
+aprmd5_multibuf_lane_start(aprmd5_multibuf_lane* lane, aprmd5_multibuf_job* job,
+                           apr_uint32_t* state, int laneIndex, int laneCount)
+{
+  apr_size_t fullLen = (apr_size_t)job->len & ~(apr_size_t)(APRMD5_MD5_BLOCKSIZE - 1);
+  lane->job = job;
+  lane->nextBlock = job->data;
+  lane->dataBlocksLeft = fullLen / APRMD5_MD5_BLOCKSIZE;
+  lane->tailBlockCount = aprmd5_md5block_pad(job->data + fullLen,
+                                             (apr_size_t)job->len - fullLen,
+                                             (apr_uint64_t)job->len,
+                                             lane->tail);
+  lane->tailBlocksLeft = lane->tailBlockCount;
+  state[0 * laneCount + laneIndex] = APRMD5_MD5_INIT_A;
+  state[1 * laneCount + laneIndex] = APRMD5_MD5_INIT_B;
+  state[2 * laneCount + laneIndex] = APRMD5_MD5_INIT_C;
+  state[3 * laneCount + laneIndex] = APRMD5_MD5_INIT_D;
+}
+
+
+// ---------------------------------------------------------------------------
+// Computes the MD5 hashes of a number of independent messages.
+//
+// Parameters:
+// - kernel: The kernel to use, usually aprmd5_multibuf_selected_kernel
+// - jobs: The messages to hash; the digest of each message is written to the
+//   location specified by the job
+// - jobCount: The number of jobs
+//
+// Return value:
+// - None
+//
+// Note: This function does not touch any Python objects, it can therefore be
+// called while the GIL is released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_multibuf_md5(const aprmd5_multibuf_kernel* kernel, aprmd5_multibuf_job* jobs, Py_ssize_t jobCount)
+{
+  int laneCount = kernel->lanes;
+  apr_uint32_t state[4 * APRMD5_MULTIBUF_MAXLANES];
+  const unsigned char* blocks[APRMD5_MULTIBUF_MAXLANES];
+  aprmd5_multibuf_lane lanes[APRMD5_MULTIBUF_MAXLANES];
+  Py_ssize_t nextJob = 0;
+  int activeLaneCount = 0;
+  int laneIndex;
+
+  for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+  {
+    if (nextJob < jobCount)
+    {
+      aprmd5_multibuf_lane_start(&lanes[laneIndex], &jobs[nextJob++], state, laneIndex, laneCount);
+      ++activeLaneCount;
+    }
+    else
+    {
+      lanes[laneIndex].job = NULL;
+    }
+  }
+
+  while (activeLaneCount > 0)
+  {
+    for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+    {
+      aprmd5_multibuf_lane* lane = &lanes[laneIndex];
+      if (NULL == lane->job)
+        blocks[laneIndex] = NULL;
+      else if (lane->dataBlocksLeft > 0)
+        blocks[laneIndex] = lane->nextBlock;
+      else
+        blocks[laneIndex] = lane->tail + (lane->tailBlockCount - lane->tailBlocksLeft) * APRMD5_MD5_BLOCKSIZE;
+    }
+
+    kernel->func(state, blocks);
+
+    for (laneIndex = 0; laneIndex < laneCount; ++laneIndex)
+    {
+      aprmd5_multibuf_lane* lane = &lanes[laneIndex];
+      if (NULL == lane->job)
+        continue;
+      if (lane->dataBlocksLeft > 0)
+      {
+        --lane->dataBlocksLeft;
+        lane->nextBlock += APRMD5_MD5_BLOCKSIZE;
+        continue;
+      }
+      if (--lane->tailBlocksLeft > 0)
+        continue;
+
+      // The message is complete
+      apr_uint32_t laneState[4];
+      int word;
+      for (word = 0; word < 4; ++word)
+        laneState[word] = state[word * laneCount + laneIndex];
+      aprmd5_md5block_state_to_digest(laneState, lane->job->digest);
+
+      if (nextJob < jobCount)
+      {
+        aprmd5_multibuf_lane_start(lane, &jobs[nextJob++], state, laneIndex, laneCount);
+      }
+      else
+      {
+        lane->job = NULL;
+        --activeLaneCount;
+      }
+    }
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// Thread pool glue for md5_many()
+// ---------------------------------------------------------------------------
+static void
+aprmd5_multibuf_md5_range(void* context, Py_ssize_t begin, Py_ssize_t end)
+{
+  aprmd5_multibuf_job* jobs = (aprmd5_multibuf_job*)context;
+  aprmd5_multibuf_md5(aprmd5_multibuf_selected_kernel, jobs + begin, end - begin);
+}
+
+// Computes the hashes of a batch of messages with the selected kernel on the
+// native thread pool. Must be called with the GIL released.
+void
+aprmd5_multibuf_md5_parallel(int threadCount, aprmd5_multibuf_job* jobs, Py_ssize_t jobCount)
+{
+  aprmd5_threadpool_run(threadCount, jobCount, APRMD5_MULTIBUF_GRAINSIZE, aprmd5_multibuf_md5_range, jobs);
+}
+
+
+// ---------------------------------------------------------------------------
+// From within Python, this function will be available as
+//
+//   aprmd5.md5_many()
+//
+// Computes the MD5 hashes of many independent messages with the multi-buffer
+// MD5 engine. The result is the same as if an md5 object were created for
+// each message and its digest() method were called.
+//
+// Parameters of the Python function:
+// - buffers: an iterable of bytes-like objects (Python 3.x) or of string or
+//   buffer objects (Python 2.x)
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core. Small
+//   batches are always processed by a single thread.
+//
+// Return value of the Python function:
+// - A list of binary digests, in the same order as the input
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_many(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  static char* kwlist[] = {"buffers", "threads", NULL};
+  PyObject* iterable;
+  int threadCount = 0;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, "O|i:md5_many", kwlist, &iterable, &threadCount))
+    return NULL;
+  if (threadCount < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+    return NULL;
+  }
+
+  PyObject* items = PySequence_Tuple(iterable);
+  if (NULL == items)
+    return NULL;
+  Py_ssize_t count = PyTuple_GET_SIZE(items);
+
+  PyObject* resultList = NULL;
+  Py_ssize_t acquiredCount = 0;
+  Py_buffer* views = PyMem_New(Py_buffer, count + 1);
+  aprmd5_multibuf_job* jobs = PyMem_New(aprmd5_multibuf_job, count + 1);
+  unsigned char* digests = PyMem_New(unsigned char, count * APRMD5_MD5_DIGESTSIZE + 1);
+  if (NULL == views || NULL == jobs || NULL == digests)
+  {
+    PyErr_NoMemory();
+    goto done;
+  }
+
+  // The buffers are not copied. They stay acquired, and therefore unchanged,
+  // until all hashes have been computed.
+  for (acquiredCount = 0; acquiredCount < count; ++acquiredCount)
+  {
+    Py_buffer* view = &views[acquiredCount];
+    if (PyObject_GetBuffer(PyTuple_GET_ITEM(items, acquiredCount), view, PyBUF_SIMPLE) < 0)
+      goto done;
+    jobs[acquiredCount].data = (const unsigned char*)view->buf;
+    jobs[acquiredCount].len = view->len;
+    jobs[acquiredCount].digest = digests + acquiredCount * APRMD5_MD5_DIGESTSIZE;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  aprmd5_multibuf_md5_parallel(threadCount, jobs, count);
+  Py_END_ALLOW_THREADS
+
+  resultList = PyList_New(count);
+  Py_ssize_t index;
+  for (index = 0; NULL != resultList && index < count; ++index)
+  {
+    PyObject* digest = PyBytes_FromStringAndSize((const char*)(digests + index * APRMD5_MD5_DIGESTSIZE),
+                                                 APRMD5_MD5_DIGESTSIZE);
+    if (NULL == digest)
+    {
+      Py_CLEAR(resultList);
+      break;
+    }
+    PyList_SET_ITEM(resultList, index, digest);
+  }
+
+done:
+  while (acquiredCount > 0)
+    PyBuffer_Release(&views[--acquiredCount]);
+  PyMem_Free(views);
+  PyMem_Free(jobs);
+  PyMem_Free(digests);
+  Py_DECREF(items);
+  return resultList;
+}
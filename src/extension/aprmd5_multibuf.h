@@ -0,0 +1,77 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the multi-buffer MD5 engine. The engine computes the MD5
+// hashes of several independent messages at once, one message per SIMD lane.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_MULTIBUF_H
+#define APRMD5_MULTIBUF_H
+
+// The maximum number of lanes of any kernel (AVX-512: 16 x 32 bits)
+#define APRMD5_MULTIBUF_MAXLANES 16
+
+// Signature of a kernel function. A kernel compresses one 64-byte block per
+// lane.
+// - state: The MD5 states of all lanes, in "structure of arrays" layout, i.e.
+//   word w of lane l is stored at state[w * lanes + l]
+// - blocks: One block pointer per lane; a NULL pointer marks an inactive lane
+//   whose state is left untouched
+typedef void (*aprmd5_multibuf_kernel_func)(apr_uint32_t* state,
+                                            const unsigned char* const* blocks);
+
+typedef struct
+{
+  const char* name;                 // e.g. "avx2"
+  int lanes;                        // number of messages per kernel call
+  aprmd5_multibuf_kernel_func func;
+} aprmd5_multibuf_kernel;
+
+// A message whose MD5 hash is computed by aprmd5_multibuf_md5()
+typedef struct
+{
+  const unsigned char* data;
+  Py_ssize_t len;
+  unsigned char* digest;            // receives APRMD5_MD5_DIGESTSIZE bytes
+} aprmd5_multibuf_job;
+
+extern const aprmd5_multibuf_kernel* aprmd5_multibuf_selected_kernel;
+extern const aprmd5_multibuf_kernel aprmd5_multibuf_scalar_kernel;
+
+extern void
+aprmd5_multibuf_init(void);
+
+extern void
+aprmd5_multibuf_md5(const aprmd5_multibuf_kernel* kernel,
+                    aprmd5_multibuf_job* jobs,
+                    Py_ssize_t jobCount);
+
+extern void
+aprmd5_multibuf_md5_parallel(int threadCount,
+                             aprmd5_multibuf_job* jobs,
+                             Py_ssize_t jobCount);
+
+extern PyObject*
+aprmd5_md5_many(PyObject* self, PyObject* args, PyObject* kwds);
+
+
+#endif // #ifndef APRMD5_MULTIBUF_H
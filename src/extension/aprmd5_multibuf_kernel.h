@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file is a template for the SIMD kernels of the multi-buffer MD5 engine.
+// It is included by aprmd5_multibuf.c once per instruction set, each time with
+// a different set of the following macros defined:
+//
+// - APRMD5_MB_NAME: The name of the kernel function to generate
+// - APRMD5_MB_TARGET: The function attribute that enables the instruction set
+// - APRMD5_MB_LANES: The number of 32-bit lanes in a vector
+// - APRMD5_MB_VEC: The vector type
+// - APRMD5_MB_LOAD(p), APRMD5_MB_STORE(p, v): Unaligned load/store
+// - APRMD5_MB_SET1(x): Broadcast a 32-bit value into all lanes
+// - APRMD5_MB_ADD(a, b), APRMD5_MB_AND(a, b): Lane-wise operations
+// - APRMD5_MB_ROTL(v, n): Rotate all lanes left by a constant
+// - APRMD5_MB_F/G/H/I(x, y, z): The auxiliary functions of RFC 1321
+//
+// The generated kernel compresses one 64-byte block per lane. It has the
+// signature of aprmd5_multibuf_kernel_func, see aprmd5_multibuf.h for the
+// layout of its parameters.
+//
+// Note: There is deliberately no include guard.
+// ---------------------------------------------------------------------------
+
+
+#define APRMD5_MB_STEP(f, a, b, c, d, k, t, s)                                          \
+  (a) = APRMD5_MB_ADD((a), APRMD5_MB_ADD(f((b), (c), (d)),                              \
+                                         APRMD5_MB_ADD(x[k], APRMD5_MB_SET1(t))));      \
+  (a) = APRMD5_MB_ADD(APRMD5_MB_ROTL((a), (s)), (b));
+
+APRMD5_MB_TARGET static void
+APRMD5_MB_NAME(apr_uint32_t* state, const unsigned char* const* blocks)
+{
+  // Transpose the message words so that word k of all lanes can be loaded
+  // into one vector. Inactive lanes get a block of zero bytes.
+  apr_uint32_t words[16][APRMD5_MB_LANES];
+  apr_uint32_t activeMask[APRMD5_MB_LANES];
+  int lane;
+  int k;
+  for (lane = 0; lane < APRMD5_MB_LANES; ++lane)
+  {
+    const unsigned char* block = blocks[lane];
+    if (NULL == block)
+    {
+      block = aprmd5_multibuf_zero_block;
+      activeMask[lane] = 0;
+    }
+    else
+    {
+      activeMask[lane] = 0xffffffff;
+    }
+    // x86 is little-endian, so the words can be copied verbatim
+    for (k = 0; k < 16; ++k)
+      memcpy(&words[k][lane], block + 4 * k, 4);
+  }
+  APRMD5_MB_VEC x[16];
+  for (k = 0; k < 16; ++k)
+    x[k] = APRMD5_MB_LOAD(words[k]);
+
+  APRMD5_MB_VEC aa = APRMD5_MB_LOAD(state + 0 * APRMD5_MB_LANES);
+  APRMD5_MB_VEC bb = APRMD5_MB_LOAD(state + 1 * APRMD5_MB_LANES);
+  APRMD5_MB_VEC cc = APRMD5_MB_LOAD(state + 2 * APRMD5_MB_LANES);
+  APRMD5_MB_VEC dd = APRMD5_MB_LOAD(state + 3 * APRMD5_MB_LANES);
+  APRMD5_MB_VEC a = aa;
+  APRMD5_MB_VEC b = bb;
+  APRMD5_MB_VEC c = cc;
+  APRMD5_MB_VEC d = dd;
+
+  // Round 1
+  APRMD5_MB_STEP(APRMD5_MB_F, a, b, c, d,  0, 0xd76aa478,  7);
+  APRMD5_MB_STEP(APRMD5_MB_F, d, a, b, c,  1, 0xe8c7b756, 12);
+  APRMD5_MB_STEP(APRMD5_MB_F, c, d, a, b,  2, 0x242070db, 17);
+  APRMD5_MB_STEP(APRMD5_MB_F, b, c, d, a,  3, 0xc1bdceee, 22);
+  APRMD5_MB_STEP(APRMD5_MB_F, a, b, c, d,  4, 0xf57c0faf,  7);
+  APRMD5_MB_STEP(APRMD5_MB_F, d, a, b, c,  5, 0x4787c62a, 12);
+  APRMD5_MB_STEP(APRMD5_MB_F, c, d, a, b,  6, 0xa8304613, 17);
+  APRMD5_MB_STEP(APRMD5_MB_F, b, c, d, a,  7, 0xfd469501, 22);
+  APRMD5_MB_STEP(APRMD5_MB_F, a, b, c, d,  8, 0x698098d8,  7);
+  APRMD5_MB_STEP(APRMD5_MB_F, d, a, b, c,  9, 0x8b44f7af, 12);
+  APRMD5_MB_STEP(APRMD5_MB_F, c, d, a, b, 10, 0xffff5bb1, 17);
+  APRMD5_MB_STEP(APRMD5_MB_F, b, c, d, a, 11, 0x895cd7be, 22);
+  APRMD5_MB_STEP(APRMD5_MB_F, a, b, c, d, 12, 0x6b901122,  7);
+  APRMD5_MB_STEP(APRMD5_MB_F, d, a, b, c, 13, 0xfd987193, 12);
+  APRMD5_MB_STEP(APRMD5_MB_F, c, d, a, b, 14, 0xa679438e, 17);
+  APRMD5_MB_STEP(APRMD5_MB_F, b, c, d, a, 15, 0x49b40821, 22);
+
+  // Round 2
+  APRMD5_MB_STEP(APRMD5_MB_G, a, b, c, d,  1, 0xf61e2562,  5);
+  APRMD5_MB_STEP(APRMD5_MB_G, d, a, b, c,  6, 0xc040b340,  9);
+  APRMD5_MB_STEP(APRMD5_MB_G, c, d, a, b, 11, 0x265e5a51, 14);
+  APRMD5_MB_STEP(APRMD5_MB_G, b, c, d, a,  0, 0xe9b6c7aa, 20);
+  APRMD5_MB_STEP(APRMD5_MB_G, a, b, c, d,  5, 0xd62f105d,  5);
+  APRMD5_MB_STEP(APRMD5_MB_G, d, a, b, c, 10, 0x02441453,  9);
+  APRMD5_MB_STEP(APRMD5_MB_G, c, d, a, b, 15, 0xd8a1e681, 14);
+  APRMD5_MB_STEP(APRMD5_MB_G, b, c, d, a,  4, 0xe7d3fbc8, 20);
+  APRMD5_MB_STEP(APRMD5_MB_G, a, b, c, d,  9, 0x21e1cde6,  5);
+  APRMD5_MB_STEP(APRMD5_MB_G, d, a, b, c, 14, 0xc33707d6,  9);
+  APRMD5_MB_STEP(APRMD5_MB_G, c, d, a, b,  3, 0xf4d50d87, 14);
+  APRMD5_MB_STEP(APRMD5_MB_G, b, c, d, a,  8, 0x455a14ed, 20);
+  APRMD5_MB_STEP(APRMD5_MB_G, a, b, c, d, 13, 0xa9e3e905,  5);
+  APRMD5_MB_STEP(APRMD5_MB_G, d, a, b, c,  2, 0xfcefa3f8,  9);
+  APRMD5_MB_STEP(APRMD5_MB_G, c, d, a, b,  7, 0x676f02d9, 14);
+  APRMD5_MB_STEP(APRMD5_MB_G, b, c, d, a, 12, 0x8d2a4c8a, 20);
+
+  // Round 3
+  APRMD5_MB_STEP(APRMD5_MB_H, a, b, c, d,  5, 0xfffa3942,  4);
+  APRMD5_MB_STEP(APRMD5_MB_H, d, a, b, c,  8, 0x8771f681, 11);
+  APRMD5_MB_STEP(APRMD5_MB_H, c, d, a, b, 11, 0x6d9d6122, 16);
+  APRMD5_MB_STEP(APRMD5_MB_H, b, c, d, a, 14, 0xfde5380c, 23);
+  APRMD5_MB_STEP(APRMD5_MB_H, a, b, c, d,  1, 0xa4beea44,  4);
+  APRMD5_MB_STEP(APRMD5_MB_H, d, a, b, c,  4, 0x4bdecfa9, 11);
+  APRMD5_MB_STEP(APRMD5_MB_H, c, d, a, b,  7, 0xf6bb4b60, 16);
+  APRMD5_MB_STEP(APRMD5_MB_H, b, c, d, a, 10, 0xbebfbc70, 23);
+  APRMD5_MB_STEP(APRMD5_MB_H, a, b, c, d, 13, 0x289b7ec6,  4);
+  APRMD5_MB_STEP(APRMD5_MB_H, d, a, b, c,  0, 0xeaa127fa, 11);
+  APRMD5_MB_STEP(APRMD5_MB_H, c, d, a, b,  3, 0xd4ef3085, 16);
+  APRMD5_MB_STEP(APRMD5_MB_H, b, c, d, a,  6, 0x04881d05, 23);
+  APRMD5_MB_STEP(APRMD5_MB_H, a, b, c, d,  9, 0xd9d4d039,  4);
+  APRMD5_MB_STEP(APRMD5_MB_H, d, a, b, c, 12, 0xe6db99e5, 11);
+  APRMD5_MB_STEP(APRMD5_MB_H, c, d, a, b, 15, 0x1fa27cf8, 16);
+  APRMD5_MB_STEP(APRMD5_MB_H, b, c, d, a,  2, 0xc4ac5665, 23);
+
+  // Round 4
+  APRMD5_MB_STEP(APRMD5_MB_I, a, b, c, d,  0, 0xf4292244,  6);
+  APRMD5_MB_STEP(APRMD5_MB_I, d, a, b, c,  7, 0x432aff97, 10);
+  APRMD5_MB_STEP(APRMD5_MB_I, c, d, a, b, 14, 0xab9423a7, 15);
+  APRMD5_MB_STEP(APRMD5_MB_I, b, c, d, a,  5, 0xfc93a039, 21);
+  APRMD5_MB_STEP(APRMD5_MB_I, a, b, c, d, 12, 0x655b59c3,  6);
+  APRMD5_MB_STEP(APRMD5_MB_I, d, a, b, c,  3, 0x8f0ccc92, 10);
+  APRMD5_MB_STEP(APRMD5_MB_I, c, d, a, b, 10, 0xffeff47d, 15);
+  APRMD5_MB_STEP(APRMD5_MB_I, b, c, d, a,  1, 0x85845dd1, 21);
+  APRMD5_MB_STEP(APRMD5_MB_I, a, b, c, d,  8, 0x6fa87e4f,  6);
+  APRMD5_MB_STEP(APRMD5_MB_I, d, a, b, c, 15, 0xfe2ce6e0, 10);
+  APRMD5_MB_STEP(APRMD5_MB_I, c, d, a, b,  6, 0xa3014314, 15);
+  APRMD5_MB_STEP(APRMD5_MB_I, b, c, d, a, 13, 0x4e0811a1, 21);
+  APRMD5_MB_STEP(APRMD5_MB_I, a, b, c, d,  4, 0xf7537e82,  6);
+  APRMD5_MB_STEP(APRMD5_MB_I, d, a, b, c, 11, 0xbd3af235, 10);
+  APRMD5_MB_STEP(APRMD5_MB_I, c, d, a, b,  2, 0x2ad7d2bb, 15);
+  APRMD5_MB_STEP(APRMD5_MB_I, b, c, d, a,  9, 0xeb86d391, 21);
+
+  // Feed forward, but only in lanes that are active
+  APRMD5_MB_VEC mask = APRMD5_MB_LOAD(activeMask);
+  APRMD5_MB_STORE(state + 0 * APRMD5_MB_LANES, APRMD5_MB_ADD(aa, APRMD5_MB_AND(a, mask)));
+  APRMD5_MB_STORE(state + 1 * APRMD5_MB_LANES, APRMD5_MB_ADD(bb, APRMD5_MB_AND(b, mask)));
+  APRMD5_MB_STORE(state + 2 * APRMD5_MB_LANES, APRMD5_MB_ADD(cc, APRMD5_MB_AND(c, mask)));
+  APRMD5_MB_STORE(state + 3 * APRMD5_MB_LANES, APRMD5_MB_ADD(dd, APRMD5_MB_AND(d, mask)));
+}
+
+#undef APRMD5_MB_STEP
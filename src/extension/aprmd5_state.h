@@ -0,0 +1,87 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the state of the module, i.e. the Python objects and
+// caches that belong to one module object. With multi-phase initialization
+// every interpreter that imports the module has its own state; otherwise
+// there is a single, global state.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_STATE_H
+#define APRMD5_STATE_H
+
+
+// The maximum number of deallocated md5 objects that are kept for reuse. The
+// free-threaded build has no freelist, because the freelist would need a lock
+// that costs more than it saves.
+#if defined(Py_GIL_DISABLED)
+#define APRMD5_MD5_FREELISTSIZE 0
+#else
+#define APRMD5_MD5_FREELISTSIZE 64
+#endif
+
+typedef struct
+{
+  // The types exposed to Python
+  PyObject* md5Type;
+  PyObject* cacheType;
+  PyObject* htpasswdType;
+  // Used by the awaitable functions, see aprmd5_async.c
+  PyObject* asyncPortType;
+  PyObject* asyncPorts;           // loop -> port
+  PyObject* asyncGetRunningLoop;  // imported lazily
+  // Deallocated md5 objects, kept for reuse; see aprmd5_md5type.c. The
+  // memory belongs to the interpreter of the module.
+  PyObject* md5Freelist[APRMD5_MD5_FREELISTSIZE + 1];
+  int md5FreelistCount;
+} aprmd5_module_state;
+
+#if ! APRMD5_HAVE_MODULE_STATE
+extern aprmd5_module_state aprmd5_global_state;
+#endif
+
+// Returns the state of the module object that was created by the module's
+// initialization function
+static inline aprmd5_module_state*
+aprmd5_state_from_module(PyObject* module)
+{
+#if APRMD5_HAVE_MODULE_STATE
+  return (aprmd5_module_state*)PyModule_GetState(module);
+#else
+  return &aprmd5_global_state;
+#endif
+}
+
+// Returns the state of the module that defines a type. The type must be one
+// of the types in the state, not a subclass.
+static inline aprmd5_module_state*
+aprmd5_state_from_type(PyTypeObject* type)
+{
+#if APRMD5_HAVE_MODULE_STATE
+  return (aprmd5_module_state*)PyType_GetModuleState(type);
+#else
+  return &aprmd5_global_state;
+#endif
+}
+
+
+#endif // #ifndef APRMD5_STATE_H
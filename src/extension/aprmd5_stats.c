@@ -0,0 +1,371 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the runtime statistics, and the module functions
+// stats(), reset_stats() and set_stats_enabled().
+//
+// Each thread that records an operation gets its own shard of counters, so
+// that recording needs neither a lock nor an atomic read-modify-write: a
+// shard is only ever written by its owner thread, and other threads only read
+// it. stats() adds up the shards of all threads.
+//
+// Shards are never freed. When a thread exits, its shard keeps its counts
+// and is handed to the next new thread, so the number of shards is bounded
+// by the largest number of threads that were alive at the same time.
+//
+// reset_stats() cannot zero the shards of other threads without racing with
+// them. Instead it remembers the current totals, and stats() subtracts them.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_stats.h"
+
+// System includes
+#include <pthread.h>
+#include <stdlib.h>   // for calloc()
+#include <string.h>   // for memcpy(), memset()
+#include <time.h>     // for clock_gettime()
+
+
+// The number of latency histogram buckets. Bucket i counts the operations
+// that took at least 2^i and less than 2^(i+1) nanoseconds (bucket 0 also
+// counts operations that took 0 ns); the last bucket counts everything that
+// took longer.
+#define APRMD5_STATS_BUCKETCOUNT 40
+
+// Adds a value to a counter that only the calling thread writes. Readers may
+// see the old or the new value, but never a torn one.
+#define APRMD5_STATS_ADD(counter, value) \
+  __atomic_store_n(&(counter), __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (value), __ATOMIC_RELAXED)
+
+
+// ---------------------------------------------------------------------------
+// Data structures
+// ---------------------------------------------------------------------------
+
+typedef struct
+{
+  apr_uint64_t calls;
+  apr_uint64_t failures;
+  apr_uint64_t bytes;
+  apr_uint64_t totalNs;
+  apr_uint64_t histogram[APRMD5_STATS_BUCKETCOUNT];
+} aprmd5_stats_counters;
+
+typedef struct aprmd5_stats_shard
+{
+  struct aprmd5_stats_shard* next;
+  int inUse;                    // 0 if the owner thread has exited
+  aprmd5_stats_counters operations[APRMD5_STATS_OPERATIONCOUNT];
+} aprmd5_stats_shard;
+
+int aprmd5_stats_enabled = 0;
+
+// Protects the list of shards and the baseline
+static pthread_mutex_t aprmd5_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static aprmd5_stats_shard* aprmd5_stats_shards = NULL;
+// The totals at the time of the last reset_stats()
+static aprmd5_stats_counters aprmd5_stats_baseline[APRMD5_STATS_OPERATIONCOUNT];
+// Notifies us when a thread with a shard exits
+static pthread_key_t aprmd5_stats_key;
+static int aprmd5_stats_initialized = 0;
+
+static __thread aprmd5_stats_shard* aprmd5_stats_thread_shard = NULL;
+
+// The names under which stats() reports the operations
+static const char* aprmd5_stats_operation_names[APRMD5_STATS_OPERATIONCOUNT] =
+{
+  "md5_update",
+  "md5_encode",
+  "password_validate",
+};
+
+
+// ---------------------------------------------------------------------------
+// Recording
+// ---------------------------------------------------------------------------
+
+apr_int64_t
+aprmd5_stats_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (apr_int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void
+aprmd5_stats_thread_exit(void* value)
+{
+  aprmd5_stats_shard* shard = (aprmd5_stats_shard*)value;
+  pthread_mutex_lock(&aprmd5_stats_mutex);
+  shard->inUse = 0;
+  pthread_mutex_unlock(&aprmd5_stats_mutex);
+}
+
+// Returns the shard of the calling thread, or NULL if there is none and no
+// memory for a new one
+static aprmd5_stats_shard*
+aprmd5_stats_get_shard(void)
+{
+  aprmd5_stats_shard* shard = aprmd5_stats_thread_shard;
+  if (NULL != shard)
+    return shard;
+
+  pthread_mutex_lock(&aprmd5_stats_mutex);
+  for (shard = aprmd5_stats_shards; NULL != shard; shard = shard->next)
+  {
+    if (! shard->inUse)
+      break;
+  }
+  if (NULL == shard)
+  {
+    // Not PyMem_Malloc(): the GIL may not be held
+    shard = (aprmd5_stats_shard*)calloc(1, sizeof(aprmd5_stats_shard));
+    if (NULL != shard)
+    {
+      shard->next = aprmd5_stats_shards;
+      aprmd5_stats_shards = shard;
+    }
+  }
+  if (NULL != shard)
+    shard->inUse = 1;
+  pthread_mutex_unlock(&aprmd5_stats_mutex);
+
+  if (NULL != shard)
+  {
+    pthread_setspecific(aprmd5_stats_key, shard);
+    aprmd5_stats_thread_shard = shard;
+  }
+  return shard;
+}
+
+void
+aprmd5_stats_record_slow(aprmd5_stats_operation operation,
+                         apr_int64_t start,
+                         apr_uint64_t bytes,
+                         int failed)
+{
+  apr_int64_t elapsed = aprmd5_stats_now() - start;
+  aprmd5_stats_shard* shard = aprmd5_stats_get_shard();
+  if (NULL == shard)
+    return;
+
+  int bucket = 0;
+  if (elapsed > 0)
+    bucket = 63 - __builtin_clzll((unsigned long long)elapsed);
+  else
+    elapsed = 0;
+  if (bucket >= APRMD5_STATS_BUCKETCOUNT)
+    bucket = APRMD5_STATS_BUCKETCOUNT - 1;
+
+  aprmd5_stats_counters* counters = &shard->operations[operation];
+  APRMD5_STATS_ADD(counters->calls, 1);
+  if (failed)
+    APRMD5_STATS_ADD(counters->failures, 1);
+  APRMD5_STATS_ADD(counters->bytes, bytes);
+  APRMD5_STATS_ADD(counters->totalNs, (apr_uint64_t)elapsed);
+  APRMD5_STATS_ADD(counters->histogram[bucket], 1);
+}
+
+
+// ---------------------------------------------------------------------------
+// Merging
+// ---------------------------------------------------------------------------
+
+// Adds up the counters of all shards. Must be called with the mutex held.
+static void
+aprmd5_stats_merge(aprmd5_stats_counters* totals)
+{
+  memset(totals, 0, sizeof(aprmd5_stats_counters) * APRMD5_STATS_OPERATIONCOUNT);
+  aprmd5_stats_shard* shard;
+  for (shard = aprmd5_stats_shards; NULL != shard; shard = shard->next)
+  {
+    int operation;
+    for (operation = 0; operation < APRMD5_STATS_OPERATIONCOUNT; ++operation)
+    {
+      aprmd5_stats_counters* source = &shard->operations[operation];
+      aprmd5_stats_counters* target = &totals[operation];
+      target->calls += __atomic_load_n(&source->calls, __ATOMIC_RELAXED);
+      target->failures += __atomic_load_n(&source->failures, __ATOMIC_RELAXED);
+      target->bytes += __atomic_load_n(&source->bytes, __ATOMIC_RELAXED);
+      target->totalNs += __atomic_load_n(&source->totalNs, __ATOMIC_RELAXED);
+      int bucket;
+      for (bucket = 0; bucket < APRMD5_STATS_BUCKETCOUNT; ++bucket)
+        target->histogram[bucket] += __atomic_load_n(&source->histogram[bucket], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Builds the dictionary that stats() returns for one operation
+static PyObject*
+aprmd5_stats_counters_to_dict(const aprmd5_stats_counters* totals,
+                              const aprmd5_stats_counters* baseline)
+{
+  // The counters of a thread may be read while it is in the middle of
+  // recording an operation, so that e.g. the histogram already contains an
+  // operation that calls does not. This evens out on the next call.
+  PyObject* histogram = PyList_New(APRMD5_STATS_BUCKETCOUNT);
+  if (NULL == histogram)
+    return NULL;
+  int bucket;
+  for (bucket = 0; bucket < APRMD5_STATS_BUCKETCOUNT; ++bucket)
+  {
+    PyObject* count = PyLong_FromUnsignedLongLong(totals->histogram[bucket] - baseline->histogram[bucket]);
+    if (NULL == count)
+    {
+      Py_DECREF(histogram);
+      return NULL;
+    }
+    PyList_SET_ITEM(histogram, bucket, count);
+  }
+  return Py_BuildValue("{s:K,s:K,s:K,s:K,s:N}",
+                       "calls", (unsigned long long)(totals->calls - baseline->calls),
+                       "failures", (unsigned long long)(totals->failures - baseline->failures),
+                       "bytes", (unsigned long long)(totals->bytes - baseline->bytes),
+                       "total_ns", (unsigned long long)(totals->totalNs - baseline->totalNs),
+                       "histogram", histogram);
+}
+
+
+// ---------------------------------------------------------------------------
+// Module initialization
+// ---------------------------------------------------------------------------
+
+// The child of a fork() has only the forking thread. The mutex may have been
+// held by another thread at the time of the fork.
+static void
+aprmd5_stats_atfork_child(void)
+{
+  pthread_mutex_init(&aprmd5_stats_mutex, NULL);
+  aprmd5_stats_shard* shard;
+  for (shard = aprmd5_stats_shards; NULL != shard; shard = shard->next)
+    shard->inUse = (shard == aprmd5_stats_thread_shard);
+}
+
+int
+aprmd5_stats_init(void)
+{
+  // Every interpreter that imports the module calls this
+  int result = 0;
+  pthread_mutex_lock(&aprmd5_stats_mutex);
+  if (! aprmd5_stats_initialized)
+  {
+    if (0 == pthread_key_create(&aprmd5_stats_key, aprmd5_stats_thread_exit)
+        && 0 == pthread_atfork(NULL, NULL, aprmd5_stats_atfork_child))
+      aprmd5_stats_initialized = 1;
+    else
+      result = -1;
+  }
+  pthread_mutex_unlock(&aprmd5_stats_mutex);
+  if (result < 0)
+    PyErr_SetString(PyExc_RuntimeError, "failed to initialize the statistics");
+  return result;
+}
+
+
+// ---------------------------------------------------------------------------
+// Module functions
+// ---------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// From within Python, this function is available as
+//
+//   aprmd5.stats()
+//
+// Return value of the Python function:
+// - A dictionary. The key "enabled" tells whether statistics are currently
+//   collected. The keys "md5_update", "md5_encode" and "password_validate"
+//   refer to dictionaries with the counters of the operation: "calls",
+//   "failures", "bytes" (the input size; only for md5_update), "total_ns"
+//   and "histogram", a list of latency bucket counts.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_stats(PyObject* self, PyObject* args)
+{
+  aprmd5_stats_counters totals[APRMD5_STATS_OPERATIONCOUNT];
+  aprmd5_stats_counters baseline[APRMD5_STATS_OPERATIONCOUNT];
+  pthread_mutex_lock(&aprmd5_stats_mutex);
+  aprmd5_stats_merge(totals);
+  memcpy(baseline, aprmd5_stats_baseline, sizeof(baseline));
+  pthread_mutex_unlock(&aprmd5_stats_mutex);
+
+  PyObject* result = Py_BuildValue("{s:O}", "enabled",
+                                   aprmd5_stats_enabled ? Py_True : Py_False);
+  if (NULL == result)
+    return NULL;
+  int operation;
+  for (operation = 0; operation < APRMD5_STATS_OPERATIONCOUNT; ++operation)
+  {
+    PyObject* counters = aprmd5_stats_counters_to_dict(&totals[operation], &baseline[operation]);
+    if (NULL == counters
+        || PyDict_SetItemString(result, aprmd5_stats_operation_names[operation], counters) < 0)
+    {
+      Py_XDECREF(counters);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(counters);
+  }
+  return result;
+}
+
+// ---------------------------------------------------------------------------
+// From within Python, this function is available as
+//
+//   aprmd5.reset_stats()
+//
+// Sets all counters to zero.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_reset_stats(PyObject* self, PyObject* args)
+{
+  pthread_mutex_lock(&aprmd5_stats_mutex);
+  aprmd5_stats_merge(aprmd5_stats_baseline);
+  pthread_mutex_unlock(&aprmd5_stats_mutex);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+// ---------------------------------------------------------------------------
+// From within Python, this function is available as
+//
+//   aprmd5.set_stats_enabled()
+//
+// Parameters of the Python function:
+// - enabled: True to collect statistics from now on, False to stop
+//
+// Return value of the Python function:
+// - True if statistics were enabled before the call, otherwise False
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_set_stats_enabled(PyObject* self, PyObject* args)
+{
+  PyObject* enabledObject;
+  if (! PyArg_ParseTuple(args, "O:set_stats_enabled", &enabledObject))
+    return NULL;
+  int enabled = PyObject_IsTrue(enabledObject);
+  if (enabled < 0)
+    return NULL;
+  int wasEnabled = __atomic_exchange_n(&aprmd5_stats_enabled, enabled, __ATOMIC_RELAXED);
+  return PyBool_FromLong(wasEnabled);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the runtime statistics that the module collects about
+// its operations.
+//
+// An operation is measured like this:
+//
+//   apr_int64_t start = aprmd5_stats_start();
+//   ... do the work ...
+//   aprmd5_stats_record(APRMD5_STATS_MD5_UPDATE, start, bytes, failed);
+//
+// While statistics are disabled, aprmd5_stats_start() returns 0 without
+// reading the clock, and aprmd5_stats_record() returns right away. Both
+// functions may be called with the GIL released.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_STATS_H
+#define APRMD5_STATS_H
+
+// The operations that are measured
+typedef enum
+{
+  APRMD5_STATS_MD5_UPDATE = 0,
+  APRMD5_STATS_MD5_ENCODE,
+  APRMD5_STATS_PASSWORD_VALIDATE,
+  APRMD5_STATS_OPERATIONCOUNT
+} aprmd5_stats_operation;
+
+// 1 if statistics are collected, otherwise 0
+extern int aprmd5_stats_enabled;
+
+extern apr_int64_t
+aprmd5_stats_now(void);
+
+static inline apr_int64_t
+aprmd5_stats_start(void)
+{
+  if (! __atomic_load_n(&aprmd5_stats_enabled, __ATOMIC_RELAXED))
+    return 0;
+  return aprmd5_stats_now();
+}
+
+extern void
+aprmd5_stats_record_slow(aprmd5_stats_operation operation,
+                         apr_int64_t start,
+                         apr_uint64_t bytes,
+                         int failed);
+
+// Records an operation that began at start. Does nothing if start is 0, i.e.
+// if statistics were disabled when the operation began.
+static inline void
+aprmd5_stats_record(aprmd5_stats_operation operation,
+                    apr_int64_t start,
+                    apr_uint64_t bytes,
+                    int failed)
+{
+  if (0 != start)
+    aprmd5_stats_record_slow(operation, start, bytes, failed);
+}
+
+extern int
+aprmd5_stats_init(void);
+
+extern PyObject*
+aprmd5_stats(PyObject* self, PyObject* args);
+
+extern PyObject*
+aprmd5_reset_stats(PyObject* self, PyObject* args);
+
+extern PyObject*
+aprmd5_set_stats_enabled(PyObject* self, PyObject* args);
+
+
+#endif // #ifndef APRMD5_STATS_H
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file implements the native thread pool that the module's batch
+// functions use to distribute work across CPU cores.
+//
+// The pool is a simple fork/join construct: aprmd5_threadpool_run() starts a
+// number of native threads, each thread repeatedly grabs the next range of
+// unprocessed items, and when all items have been processed the threads are
+// joined. The calling thread participates in the work, so a batch is always
+// completed even if no additional thread could be started.
+// ---------------------------------------------------------------------------
+
+
+// Project includes
+#include "aprmd5.h"
+#include "aprmd5_threadpool.h"
+
+// System includes
+#include <pthread.h>
+#include <unistd.h>   // for sysconf()
+
+
+// The maximum number of threads that aprmd5_threadpool_run() starts
+#define APRMD5_THREADPOOL_MAXTHREADS 256
+
+
+// ---------------------------------------------------------------------------
+// Shared state of one aprmd5_threadpool_run() invocation
+// ---------------------------------------------------------------------------
+typedef struct
+{
+  pthread_mutex_t mutex;       // protects nextItem
+  Py_ssize_t nextItem;         // first item that has not been handed out yet
+  Py_ssize_t itemCount;
+  Py_ssize_t grainSize;
+  aprmd5_threadpool_work_func func;
+  void* context;
+} aprmd5_threadpool_batch;
+
+
+// ---------------------------------------------------------------------------
+// Thread main function. Processes ranges of items until the batch is
+// exhausted.
+// ---------------------------------------------------------------------------
+static void*
+aprmd5_threadpool_worker(void* arg)
+{
+  aprmd5_threadpool_batch* batch = (aprmd5_threadpool_batch*)arg;
+  for (;;)
+  {
+    pthread_mutex_lock(&batch->mutex);
+    Py_ssize_t begin = batch->nextItem;
+    Py_ssize_t end = begin + batch->grainSize;
+    if (end > batch->itemCount)
+      end = batch->itemCount;
+    batch->nextItem = end;
+    pthread_mutex_unlock(&batch->mutex);
+
+    if (begin >= end)
+      return NULL;
+    batch->func(batch->context, begin, end);
+  }
+}
+
+
+// ---------------------------------------------------------------------------
+// Returns the number of threads that batch functions use if the user does not
+// specify a thread count. This is the number of CPU cores that are online.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+int aprmd5_threadpool_default_thread_count(void)
+{
+  long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpuCount < 1)
+    return 1;
+  if (cpuCount > APRMD5_THREADPOOL_MAXTHREADS)
+    return APRMD5_THREADPOOL_MAXTHREADS;
+  return (int)cpuCount;
+}
+
+
+// ---------------------------------------------------------------------------
+// Processes a batch of items on several native threads. The function returns
+// when all items have been processed.
+//
+// Parameters:
+// - threadCount: The maximum number of threads to use, including the calling
+//   thread. If this is less than 1, the default thread count is used. No more
+//   threads are started than there are ranges of items to process.
+// - itemCount: The number of items in the batch
+// - grainSize: The number of items that a thread processes before it grabs the
+//   next range of items; must be at least 1
+// - func: The function that processes a range of items
+// - context: Passed unchanged to func
+//
+// Return value:
+// - None
+//
+// Note: This function must be called with the GIL released.
+//
+// Note: This is an internal helper function only, it is not exposed to Python.
+// ---------------------------------------------------------------------------
+void aprmd5_threadpool_run(int threadCount, Py_ssize_t itemCount, Py_ssize_t grainSize, aprmd5_threadpool_work_func func, void* context)
+{
+  if (itemCount <= 0)
+    return;
+  if (threadCount < 1)
+    threadCount = aprmd5_threadpool_default_thread_count();
+  if (threadCount > APRMD5_THREADPOOL_MAXTHREADS)
+    threadCount = APRMD5_THREADPOOL_MAXTHREADS;
+  Py_ssize_t rangeCount = (itemCount + grainSize - 1) / grainSize;
+  if (threadCount > rangeCount)
+    threadCount = (int)rangeCount;
+
+  // Fast path: No synchronization required if we are on our own
+  if (threadCount <= 1)
+  {
+    func(context, 0, itemCount);
+    return;
+  }
+
+  aprmd5_threadpool_batch batch;
+  pthread_mutex_init(&batch.mutex, NULL);
+  batch.nextItem = 0;
+  batch.itemCount = itemCount;
+  batch.grainSize = grainSize;
+  batch.func = func;
+  batch.context = context;
+
+  // Start the additional threads. If a thread cannot be started we simply
+  // continue with fewer threads.
+  pthread_t threads[APRMD5_THREADPOOL_MAXTHREADS];
+  int startedCount = 0;
+  while (startedCount < threadCount - 1)
+  {
+    if (0 != pthread_create(&threads[startedCount], NULL, aprmd5_threadpool_worker, &batch))
+      break;
+    ++startedCount;
+  }
+
+  // The calling thread works, too
+  aprmd5_threadpool_worker(&batch);
+
+  while (startedCount > 0)
+    pthread_join(threads[--startedCount], NULL);
+  pthread_mutex_destroy(&batch.mutex);
+}
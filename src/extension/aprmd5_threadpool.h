@@ -0,0 +1,48 @@
+/*
+ * Copyright 2026 Patrick Näf
+ *
+ * This file is part of python-aprmd5
+ *
+ * python-aprmd5 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * python-aprmd5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// ---------------------------------------------------------------------------
+// This file declares the native thread pool that the module's batch functions
+// use to distribute work across CPU cores.
+// ---------------------------------------------------------------------------
+
+
+#ifndef APRMD5_THREADPOOL_H
+#define APRMD5_THREADPOOL_H
+
+// Signature of a function that processes the items [begin, end) of a batch.
+// The function is invoked concurrently on several native threads, with the GIL
+// released; it must therefore not touch any Python objects.
+typedef void (*aprmd5_threadpool_work_func)(void* context,
+                                            Py_ssize_t begin,
+                                            Py_ssize_t end);
+
+extern int
+aprmd5_threadpool_default_thread_count(void);
+
+extern void
+aprmd5_threadpool_run(int threadCount,
+                      Py_ssize_t itemCount,
+                      Py_ssize_t grainSize,
+                      aprmd5_threadpool_work_func func,
+                      void* context);
+
+
+#endif // #ifndef APRMD5_THREADPOOL_H
@@ -31,7 +31,22 @@
 // Project includes
 #include "aprmd5.h"
 #include "aprmd5_wrappers.h"
+#include "aprmd5_backend.h"
 #include "aprmd5_helpers.h"
+#include "aprmd5_threadpool.h"
+#include "aprmd5_multibuf.h"
+#include "aprmd5_apr1.h"
+#include "aprmd5_passwd.h"
+#include "aprmd5_fileio.h"
+#include "aprmd5_checkpoint.h"
+#include "aprmd5_htpasswd.h"
+#include "aprmd5_dedup.h"
+#include "aprmd5_async.h"
+#include "aprmd5_stats.h"
+#include "aprmd5_md5type.h"
+
+// System includes
+#include <string.h>   // for strncmp()
 
 
 // ---------------------------------------------------------------------------
@@ -61,15 +76,23 @@
 //   hash that is, for instance, implemented by the glibc function crypt(3)).
 // ---------------------------------------------------------------------------
 PyObject*
-aprmd5_md5_encode(PyObject* self, PyObject* args)
+aprmd5_md5_encode(PyObject* self, APRMD5_FASTCALL_PARAMETERS)
 {
   // Both the input and the salt must be str() objects, from which we can get
   // NULL-terminated char*.
   // Note: This is true for both Python 2.6 and Python 3
   const char* input;
   const char* salt;
+#if APRMD5_HAVE_FASTCALL
+  const char* strings[2];
+  if (aprmd5_helper_fastcall_strings(args, nargs, "md5_encode", 2, strings) < 0)
+    return NULL;
+  input = strings[0];
+  salt = strings[1];
+#else
   if (! PyArg_ParseTuple(args, "ss", &input, &salt))
     return NULL;
+#endif
 
   // Generate the hash
   apr_size_t resultLen = 6 + strlen(salt) + 1 + 22 + 1;  // 6 = $apr1$
@@ -79,7 +102,9 @@ aprmd5_md5_encode(PyObject* self, PyObject* args)
   char result[resultLen];
   // +1 to resultLen because, for some unknown reason, apr_md5_encode() wants
   // an additional byte
-  apr_status_t status = apr_md5_encode(input, salt, result, resultLen + 1);
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_status_t status = aprmd5_backend_selected->apr1_encode(input, salt, result, resultLen + 1);
+  aprmd5_stats_record(APRMD5_STATS_MD5_ENCODE, statsStart, 0, APR_SUCCESS != status);
   if (APR_SUCCESS != status)
   {
     PyErr_SetString(PyExc_RuntimeError, "apr_md5_encode() returned status code != 0");
@@ -87,8 +112,11 @@ aprmd5_md5_encode(PyObject* self, PyObject* args)
   }
 
   // Return the result; the Python system becomes responsible for the object
-  // returned by Py_BuildValue().
-  return Py_BuildValue("s", result);
+#if PY_MAJOR_VERSION >= 3
+  return PyUnicode_FromString(result);
+#else
+  return PyString_FromString(result);
+#endif
 }
 
 
@@ -112,28 +140,317 @@ aprmd5_md5_encode(PyObject* self, PyObject* args)
 // - False: If the validation failed
 // ---------------------------------------------------------------------------
 PyObject*
-aprmd5_password_validate(PyObject* self, PyObject* args)
+aprmd5_password_validate(PyObject* self, APRMD5_FASTCALL_PARAMETERS)
 {
   // Both the password and the hash must be str() objects, from which we can get
   // NULL-terminated char*.
   // Note: This is true for both Python 2.6 and Python 3
   const char* password;
   const char* hash;
+#if APRMD5_HAVE_FASTCALL
+  const char* strings[2];
+  if (aprmd5_helper_fastcall_strings(args, nargs, "password_validate", 2, strings) < 0)
+    return NULL;
+  password = strings[0];
+  hash = strings[1];
+#else
   if (! PyArg_ParseTuple(args, "ss", &password, &hash))
     return NULL;
+#endif
 
   // Validate the password against the given hash. A zero return status means
   // that the password is valid
-  // Note: There are two pre-fabricated objects to represent the boolean values
-  // True and False. Because of this, and because Py_BuildValue does not have a
-  // special format string to refer to boolean values, we simply use the format
-  // string "O" and pass in one of the pre-fabricated values. Py_BuildValue will
-  // increase the refcount for us.
-  apr_status_t status = apr_password_validate(password, hash);
-  if (APR_SUCCESS != status)
-    return Py_BuildValue("O", Py_False);
-  else
-    return Py_BuildValue("O", Py_True);
+  apr_int64_t statsStart = aprmd5_stats_start();
+  apr_status_t status = aprmd5_passwd_validate(password, hash);
+  aprmd5_stats_record(APRMD5_STATS_PASSWORD_VALIDATE, statsStart, 0, APR_SUCCESS != status);
+  return PyBool_FromLong(APR_SUCCESS == status);
+}
+
+
+// ---------------------------------------------------------------------------
+// Work items of the batch functions md5_encode_many() and
+// password_validate_many(). A worker thread processes a range of items with
+// the GIL released and stores the results in arrays that are indexed in the
+// same order as the input pairs.
+// ---------------------------------------------------------------------------
+
+// The number of items that a worker thread processes in one go. Each item
+// requires 1000 rounds of MD5, so even small ranges outweigh the cost of
+// handing them out.
+#define APRMD5_BATCH_GRAINSIZE 16
+
+typedef struct
+{
+  aprmd5_helper_string_pairs pairs;
+  char* results;               // APRMD5_APR1_HASHSIZE bytes per item
+  apr_status_t* statuses;      // one status per item
+} aprmd5_batch;
+
+// Encodes a range of items with the multi-lane apr1 engine, one lane group
+// at a time. If the engine fails for lack of memory, the affected lane group
+// is encoded by libaprutil instead.
+static void
+aprmd5_md5_encode_range(void* context, Py_ssize_t begin, Py_ssize_t end)
+{
+  aprmd5_batch* batch = (aprmd5_batch*)context;
+  aprmd5_apr1_job jobs[APRMD5_MULTIBUF_MAXLANES];
+  Py_ssize_t groupBegin;
+  for (groupBegin = begin; groupBegin < end; groupBegin += APRMD5_MULTIBUF_MAXLANES)
+  {
+    Py_ssize_t groupEnd = groupBegin + APRMD5_MULTIBUF_MAXLANES;
+    if (groupEnd > end)
+      groupEnd = end;
+    Py_ssize_t index;
+    for (index = groupBegin; index < groupEnd; ++index)
+    {
+      aprmd5_apr1_job* job = &jobs[index - groupBegin];
+      job->password = batch->pairs.first[index];
+      job->salt = batch->pairs.second[index];
+      job->result = batch->results + index * APRMD5_APR1_HASHSIZE;
+      batch->statuses[index] = APR_SUCCESS;
+    }
+    if (0 == aprmd5_apr1_encode_many(aprmd5_multibuf_selected_kernel, jobs, groupEnd - groupBegin))
+      continue;
+    for (index = groupBegin; index < groupEnd; ++index)
+    {
+      // +1 to the result size for the same reason as in aprmd5_md5_encode()
+      batch->statuses[index] = aprmd5_backend_selected->apr1_encode(batch->pairs.first[index],
+                                                                    batch->pairs.second[index],
+                                                                    batch->results + index * APRMD5_APR1_HASHSIZE,
+                                                                    APRMD5_APR1_HASHSIZE + 1);
+    }
+  }
+}
+
+// Validates the apr1 hashes collected by aprmd5_password_validate_range().
+// The results are compared the same way apr_password_validate() does. If the
+// multi-lane apr1 engine fails for lack of memory, the hashes are validated
+// one at a time instead.
+static void
+aprmd5_password_validate_apr1(aprmd5_batch* batch, aprmd5_apr1_job* jobs,
+                              const Py_ssize_t* itemIndexes, int jobCount)
+{
+  int failed = aprmd5_apr1_encode_many(aprmd5_multibuf_selected_kernel, jobs, jobCount);
+  int jobIndex;
+  for (jobIndex = 0; jobIndex < jobCount; ++jobIndex)
+  {
+    apr_status_t* status = &batch->statuses[itemIndexes[jobIndex]];
+    if (failed)
+      *status = aprmd5_passwd_validate(jobs[jobIndex].password, jobs[jobIndex].salt);
+    else if (aprmd5_apr1_equal(jobs[jobIndex].result, jobs[jobIndex].salt))
+      *status = APR_SUCCESS;
+    else
+      *status = APR_EMISMATCH;
+  }
+}
+
+// Validates a range of items. apr1 hashes are re-generated with the
+// multi-lane apr1 engine (the hash serves as the salt, just like in
+// apr_password_validate()); all other hashes are validated by
+// aprmd5_passwd_validate().
+static void
+aprmd5_password_validate_range(void* context, Py_ssize_t begin, Py_ssize_t end)
+{
+  aprmd5_batch* batch = (aprmd5_batch*)context;
+  aprmd5_apr1_job jobs[APRMD5_MULTIBUF_MAXLANES];
+  Py_ssize_t itemIndexes[APRMD5_MULTIBUF_MAXLANES];
+  char results[APRMD5_MULTIBUF_MAXLANES][APRMD5_APR1_HASHSIZE];
+  int jobCount = 0;
+  Py_ssize_t index;
+  for (index = begin; index < end; ++index)
+  {
+    const char* hash = batch->pairs.second[index];
+    if (0 != strncmp(hash, APRMD5_APR1_ID, APRMD5_APR1_IDLEN))
+    {
+      batch->statuses[index] = aprmd5_passwd_validate(batch->pairs.first[index], hash);
+      continue;
+    }
+
+    jobs[jobCount].password = batch->pairs.first[index];
+    jobs[jobCount].salt = hash;
+    jobs[jobCount].result = results[jobCount];
+    itemIndexes[jobCount] = index;
+    if (APRMD5_MULTIBUF_MAXLANES == ++jobCount)
+    {
+      aprmd5_password_validate_apr1(batch, jobs, itemIndexes, jobCount);
+      jobCount = 0;
+    }
+  }
+  if (jobCount > 0)
+    aprmd5_password_validate_apr1(batch, jobs, itemIndexes, jobCount);
+}
+
+// Encodes a batch of password/salt pairs on the native thread pool. This is
+// the work of md5_encode_many(), without the Python objects; the C API
+// exposes it to other extensions. Must be called with the GIL released.
+// - results: receives APRMD5_APR1_HASHSIZE bytes per pair
+// - statuses: receives the status of each pair
+void
+aprmd5_md5_encode_batch(int threadCount, const char** passwords, const char** salts,
+                        Py_ssize_t count, char* results, apr_status_t* statuses)
+{
+  aprmd5_batch batch;
+  batch.pairs.count = count;
+  batch.pairs.first = passwords;
+  batch.pairs.second = salts;
+  batch.pairs.storage = NULL;
+  batch.results = results;
+  batch.statuses = statuses;
+  aprmd5_threadpool_run(threadCount, count, APRMD5_BATCH_GRAINSIZE, aprmd5_md5_encode_range, &batch);
+}
+
+// Validates a batch of password/hash pairs on the native thread pool; the
+// counterpart of aprmd5_md5_encode_batch() for password_validate_many().
+void
+aprmd5_password_validate_batch(int threadCount, const char** passwords, const char** hashes,
+                               Py_ssize_t count, apr_status_t* statuses)
+{
+  aprmd5_batch batch;
+  batch.pairs.count = count;
+  batch.pairs.first = passwords;
+  batch.pairs.second = hashes;
+  batch.pairs.storage = NULL;
+  batch.results = NULL;
+  batch.statuses = statuses;
+  aprmd5_threadpool_run(threadCount, count, APRMD5_BATCH_GRAINSIZE, aprmd5_password_validate_range, &batch);
+}
+
+// Parses the arguments of a batch function and runs the batch on the native
+// thread pool. Returns 0 on success, or -1 if a Python exception has been set.
+// On success, the caller must free the batch with aprmd5_batch_free().
+static int
+aprmd5_batch_run(PyObject* args, PyObject* kwds, const char* format, const char* pairFormat,
+                 int withResults, aprmd5_threadpool_work_func func, aprmd5_batch* batch)
+{
+  static char* kwlist[] = {"pairs", "threads", NULL};
+  PyObject* iterable;
+  int threadCount = 0;
+  if (! PyArg_ParseTupleAndKeywords(args, kwds, format, kwlist, &iterable, &threadCount))
+    return -1;
+  if (threadCount < 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+    return -1;
+  }
+
+  if (aprmd5_helper_string_pairs_create(iterable, pairFormat, &batch->pairs) < 0)
+    return -1;
+  Py_ssize_t count = batch->pairs.count;
+  batch->results = withResults ? PyMem_New(char, count * APRMD5_APR1_HASHSIZE + 1) : NULL;
+  batch->statuses = PyMem_New(apr_status_t, count + 1);
+  if ((withResults && NULL == batch->results) || NULL == batch->statuses)
+  {
+    PyMem_Free(batch->results);
+    PyMem_Free(batch->statuses);
+    aprmd5_helper_string_pairs_free(&batch->pairs);
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  aprmd5_threadpool_run(threadCount, count, APRMD5_BATCH_GRAINSIZE, func, batch);
+  Py_END_ALLOW_THREADS
+
+  return 0;
+}
+
+static void
+aprmd5_batch_free(aprmd5_batch* batch)
+{
+  PyMem_Free(batch->results);
+  PyMem_Free(batch->statuses);
+  aprmd5_helper_string_pairs_free(&batch->pairs);
+}
+
+
+// ---------------------------------------------------------------------------
+// This is the batch version of md5_encode(). From within Python, this function
+// will be available as
+//
+//   aprmd5.md5_encode_many()
+//
+// The passwords are encoded on a pool of native threads with the GIL released.
+//
+// Parameters of the Python function:
+// - pairs: an iterable of (password, salt) pairs; password and salt have the
+//   same meaning as the parameters of md5_encode()
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core
+//
+// Return value of the Python function:
+// - A list of string objects, each of which contains the encrypted password
+//   of the corresponding input pair. The list has the same order as the input.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_md5_encode_many(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  aprmd5_batch batch;
+  if (aprmd5_batch_run(args, kwds, "O|i:md5_encode_many", "ss:md5_encode_many",
+                       1, aprmd5_md5_encode_range, &batch) < 0)
+    return NULL;
+
+  PyObject* resultList = PyList_New(batch.pairs.count);
+  Py_ssize_t index;
+  for (index = 0; NULL != resultList && index < batch.pairs.count; ++index)
+  {
+    if (APR_SUCCESS != batch.statuses[index])
+    {
+      PyErr_SetString(PyExc_RuntimeError, "apr_md5_encode() returned status code != 0");
+      Py_CLEAR(resultList);
+      break;
+    }
+    PyObject* result = Py_BuildValue("s", batch.results + index * APRMD5_APR1_HASHSIZE);
+    if (NULL == result)
+    {
+      Py_CLEAR(resultList);
+      break;
+    }
+    PyList_SET_ITEM(resultList, index, result);
+  }
+
+  aprmd5_batch_free(&batch);
+  return resultList;
+}
+
+
+// ---------------------------------------------------------------------------
+// This is the batch version of password_validate(). From within Python, this
+// function will be available as
+//
+//   aprmd5.password_validate_many()
+//
+// The passwords are validated on a pool of native threads with the GIL
+// released.
+//
+// Parameters of the Python function:
+// - pairs: an iterable of (password, hash) pairs; password and hash have the
+//   same meaning as the parameters of password_validate()
+// - threads: optional keyword argument that specifies the maximum number of
+//   threads to use; the default (0) is to use one thread per CPU core
+//
+// Return value of the Python function:
+// - A list of boolean values, each of which is the validation result of the
+//   corresponding input pair. The list has the same order as the input.
+// ---------------------------------------------------------------------------
+PyObject*
+aprmd5_password_validate_many(PyObject* self, PyObject* args, PyObject* kwds)
+{
+  aprmd5_batch batch;
+  if (aprmd5_batch_run(args, kwds, "O|i:password_validate_many", "ss:password_validate_many",
+                       0, aprmd5_password_validate_range, &batch) < 0)
+    return NULL;
+
+  PyObject* resultList = PyList_New(batch.pairs.count);
+  Py_ssize_t index;
+  for (index = 0; NULL != resultList && index < batch.pairs.count; ++index)
+  {
+    PyObject* result = (APR_SUCCESS == batch.statuses[index]) ? Py_True : Py_False;
+    Py_INCREF(result);
+    PyList_SET_ITEM(resultList, index, result);
+  }
+
+  aprmd5_batch_free(&batch);
+  return resultList;
 }
 
 
@@ -143,13 +460,77 @@ aprmd5_password_validate(PyObject* self, PyObject* args)
 PyMethodDef aprmd5_methods[] =
 {
   {
-    "md5_encode", aprmd5_md5_encode, METH_VARARGS,
+    "md5_encode", (PyCFunction)aprmd5_md5_encode, APRMD5_METH_FASTCALL,
     "Encode a password using an MD5 algorithm modified for the APR project."
   },
   {
-    "password_validate", aprmd5_password_validate, METH_VARARGS,
+    "password_validate", (PyCFunction)aprmd5_password_validate, APRMD5_METH_FASTCALL,
     "Validate any password encrypted with any algorithm that APR understands."
   },
+  {
+    "md5_encode_many", (PyCFunction)aprmd5_md5_encode_many, METH_VARARGS | METH_KEYWORDS,
+    "Encode an iterable of (password, salt) pairs like md5_encode() does. The work is distributed across native threads (keyword argument threads, default is one per CPU core) with the GIL released. Returns a list of hashes in input order."
+  },
+  {
+    "password_validate_many", (PyCFunction)aprmd5_password_validate_many, METH_VARARGS | METH_KEYWORDS,
+    "Validate an iterable of (password, hash) pairs like password_validate() does. The work is distributed across native threads (keyword argument threads, default is one per CPU core) with the GIL released. Returns a list of booleans in input order."
+  },
+  {
+    "write_htpasswd", (PyCFunction)aprmd5_write_htpasswd, METH_VARARGS | METH_KEYWORDS,
+    "Write an htpasswd file with one line \"user:hash\" for each (user, password) pair of an iterable, in input order. Each password is encoded like md5_encode() does, with a random 8 character salt that is generated natively. The pairs are consumed in chunks and encoded on native threads (keyword argument threads, default is one per CPU core) with the GIL released. The file is replaced only when all lines have been written. Returns the number of users written."
+  },
+  {
+    "md5_digest", aprmd5_md5_digest, METH_O,
+    "Return the MD5 digest of a bytes-like object. This is the same as md5(data).digest(), but no md5 object is created."
+  },
+  {
+    "md5_hexdigest", aprmd5_md5_hexdigest, METH_O,
+    "Return the MD5 digest of a bytes-like object as a string of hexadecimal digits. This is the same as md5(data).hexdigest(), but no md5 object is created."
+  },
+  {
+    "md5_many", (PyCFunction)aprmd5_md5_many, METH_VARARGS | METH_KEYWORDS,
+    "Compute the MD5 digests of an iterable of bytes-like objects. Several messages are hashed at once in the lanes of the CPU's SIMD registers (see multibuf_kernel). Returns a list of digests in input order; each digest is the same as md5(buffer).digest()."
+  },
+  {
+    "md5_file", (PyCFunction)aprmd5_md5_file, METH_VARARGS | METH_KEYWORDS,
+    "Compute the MD5 digest of the content of a file. The file is read and hashed in native code with the GIL released. The keyword arguments offset and length select a range of the file (default is the whole file). A pipe, such as a FIFO, is read sequentially and only supports offset 0. Returns the same digest as md5(content).digest()."
+  },
+#if PY_MAJOR_VERSION >= 3
+  {
+    "md5_parts", (PyCFunction)aprmd5_md5_parts, METH_VARARGS | METH_KEYWORDS,
+    "Compute the MD5 digests of the fixed-size parts of a buffer or of a regular file, given by its path, like S3 does for an object that was uploaded in multiple parts (part_size bytes each, the last part may be shorter). The parts are hashed on native threads (keyword argument threads, default is one per CPU core) with the GIL released. Returns a tuple (digests, etag): the list of the digests of the parts, and the multipart ETag \"<md5>-<n>\", i.e. the hexadecimal MD5 digest of the concatenated part digests and the number of parts. Raises ValueError if the path is not a regular file, or if the file has more content than its size says (e.g. a file in /proc)."
+  },
+#endif  // #if PY_MAJOR_VERSION >= 3
+  {
+    "md5_rehash", (PyCFunction)aprmd5_md5_rehash, METH_VARARGS | METH_KEYWORDS,
+    "Compute the MD5 digest of a file that is only ever appended to, like md5_file(), but resume from the checkpoints that an earlier call stored in an index file. A checkpoint is the MD5 state after every interval bytes (keyword argument interval, a multiple of 64; default is the interval of the index, or 64 MiB); it is used if the file still reaches it and the bytes just before it are unchanged. Only the bytes after the last valid checkpoint are hashed, with the GIL released, and the index is updated."
+  },
+  {
+    "find_duplicates", (PyCFunction)aprmd5_find_duplicates, METH_VARARGS | METH_KEYWORDS,
+    "Find files with identical content in an iterable of directory trees. Files are grouped by size, then by an MD5 digest of their head and tail, and only the remaining candidates are hashed completely on native threads (keyword argument threads, default is one per CPU core). Files smaller than the keyword argument min_size (default 1) are ignored. Returns a list of groups of paths."
+  },
+#if PY_MAJOR_VERSION >= 3
+  {
+    "md5_encode_async", aprmd5_md5_encode_async, METH_VARARGS,
+    "Like md5_encode(), but returns an awaitable. The password is encoded on a native worker thread, so the asyncio event loop is not blocked. Must be called while an event loop is running."
+  },
+  {
+    "password_validate_async", aprmd5_password_validate_async, METH_VARARGS,
+    "Like password_validate(), but returns an awaitable. The password is validated on a native worker thread, so the asyncio event loop is not blocked. Must be called while an event loop is running."
+  },
+#endif  // #if PY_MAJOR_VERSION >= 3
+  {
+    "stats", aprmd5_stats, METH_NOARGS,
+    "Return a dictionary with runtime statistics of md5 hashing (md5 objects, md5_digest() and md5_hexdigest(); reported as md5_update), md5_encode() and password_validate(): for each, the number of calls and failures, the bytes hashed, the total time in nanoseconds, and a latency histogram whose bucket i counts calls that took 2**i to 2**(i+1) nanoseconds. Statistics are only collected while they are enabled (see set_stats_enabled())."
+  },
+  {
+    "reset_stats", aprmd5_reset_stats, METH_NOARGS,
+    "Set all statistics counters to zero."
+  },
+  {
+    "set_stats_enabled", aprmd5_set_stats_enabled, METH_VARARGS,
+    "Start (True) or stop (False) collecting statistics. Statistics are disabled by default; while disabled, they cost a single check per operation. Returns whether statistics were enabled before the call."
+  },
   {NULL, NULL, 0, NULL}   // Sentinel
 };
 
@@ -30,10 +30,31 @@
 extern PyMethodDef aprmd5_methods[];
 
 extern PyObject*
-aprmd5_md5_encode(PyObject* self, PyObject* args);
+aprmd5_md5_encode(PyObject* self, APRMD5_FASTCALL_PARAMETERS);
 
 extern PyObject*
-aprmd5_password_validate(PyObject* self, PyObject* args);
+aprmd5_password_validate(PyObject* self, APRMD5_FASTCALL_PARAMETERS);
+
+extern PyObject*
+aprmd5_md5_encode_many(PyObject* self, PyObject* args, PyObject* kwds);
+
+extern PyObject*
+aprmd5_password_validate_many(PyObject* self, PyObject* args, PyObject* kwds);
+
+extern void
+aprmd5_md5_encode_batch(int threadCount,
+                        const char** passwords,
+                        const char** salts,
+                        Py_ssize_t count,
+                        char* results,
+                        apr_status_t* statuses);
+
+extern void
+aprmd5_password_validate_batch(int threadCount,
+                               const char** passwords,
+                               const char** hashes,
+                               Py_ssize_t count,
+                               apr_status_t* statuses);
 
 
 #endif // #ifndef APRMD5_WRAPPERS_H
@@ -0,0 +1,153 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Benchmarks for the hot paths of aprmd5.
+
+Each benchmark module exports a function run(runner) that measures a group of
+operations and records them with runner.record(). Where hashlib offers the
+same operation, the benchmark measures it too, so that results can be read
+relative to the MD5 implementation that ships with Python.
+"""
+
+
+# PSL
+import json
+import platform
+import sys
+import time
+
+# python-aprmd5
+import aprmd5
+from benchmarks import bench_md5
+from benchmarks import bench_apr1
+
+
+# The version of the result format. Increment this when the meaning of an
+# existing field changes.
+RESULT_FORMAT_VERSION = 1
+
+# The benchmark modules, in the order in which they are run
+modules = [bench_md5, bench_apr1]
+
+if hasattr(time, "perf_counter"):
+    clock = time.perf_counter
+else:
+    clock = time.time
+
+
+class Runner(object):
+    """Times operations and collects the results of a benchmark run."""
+
+    def __init__(self, duration = 0.2, repeat = 3, maxSize = 1 << 30, verbose = True):
+        # Each operation is called for at least duration seconds per
+        # measurement, and the best of repeat measurements is kept
+        self.duration = duration
+        self.repeat = repeat
+        # The largest buffer size that throughput benchmarks use
+        self.maxSize = maxSize
+        self.verbose = verbose
+        self.results = []
+
+    def measure(self, function):
+        """Return the best time in seconds that one call of function takes."""
+        # Find a number of calls that takes at least duration seconds
+        calls = 1
+        while True:
+            elapsed = self._timeCalls(function, calls)
+            if elapsed >= self.duration or calls >= (1 << 30):
+                break
+            if elapsed <= 0:
+                calls *= 10
+            else:
+                calls = max(calls + 1, int(calls * self.duration * 1.2 / elapsed))
+        best = elapsed / calls
+        for i in range(self.repeat - 1):
+            best = min(best, self._timeCalls(function, calls) / calls)
+        return best
+
+    def _timeCalls(self, function, calls):
+        calls = range(calls)
+        start = clock()
+        for i in calls:
+            function()
+        return clock() - start
+
+    def record(self, group, name, implementation, seconds, size = None):
+        """Record the time that one operation takes.
+
+        size is the number of bytes that the operation processes, if any;
+        results that have a size also report a throughput.
+        """
+        result = {
+            "group": group,
+            "name": name,
+            "implementation": implementation,
+            "ns_per_op": seconds * 1e9,
+            "ops_per_sec": 1.0 / seconds if seconds > 0 else None,
+        }
+        if size is not None:
+            result["size"] = size
+            result["bytes_per_sec"] = size / seconds if seconds > 0 else None
+        self.results.append(result)
+        if self.verbose:
+            if size is not None:
+                name = "%s %d B" % (name, size)
+            line = "%-6s %-28s %-8s %14.1f ns/op %14.1f ops/s" % (
+                group, name, implementation, result["ns_per_op"], result["ops_per_sec"] or 0)
+            if size is not None:
+                line += " %10.1f MiB/s" % ((result["bytes_per_sec"] or 0) / (1 << 20))
+            print(line)
+            sys.stdout.flush()
+
+    def report(self):
+        """Return the results together with information about the environment
+        as a JSON-serializable dictionary."""
+        return {
+            "format_version": RESULT_FORMAT_VERSION,
+            "timestamp": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "environment": {
+                "python": platform.python_version(),
+                "python_implementation": platform.python_implementation(),
+                "platform": platform.platform(),
+                "machine": platform.machine(),
+                "backend": getattr(aprmd5, "backend", None),
+                "md5block_kernel": getattr(aprmd5, "md5block_kernel", None),
+                "multibuf_kernel": getattr(aprmd5, "multibuf_kernel", None),
+            },
+            "settings": {
+                "duration": self.duration,
+                "repeat": self.repeat,
+                "max_size": self.maxSize,
+            },
+            "results": self.results,
+        }
+
+
+def runAll(runner, output = None):
+    """Run all benchmarks. If output is not None, write the report as JSON to
+    the file with that name. Returns the report."""
+    for module in modules:
+        module.run(runner)
+    report = runner.report()
+    if output is not None:
+        with open(output, "w") as outputFile:
+            json.dump(report, outputFile, indent = 2, sort_keys = True)
+            outputFile.write("\n")
+    return report
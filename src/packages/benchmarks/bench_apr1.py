@@ -0,0 +1,42 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Benchmarks for md5_encode() and password_validate()
+
+hashlib has no equivalent of the apr1 algorithm, so these benchmarks only
+measure aprmd5.
+"""
+
+# python-aprmd5
+from aprmd5 import md5_encode, password_validate
+
+
+PASSWORD = "foo"
+SALT = "mYJd83wW"
+HASH = "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"
+
+
+def run(runner):
+    runner.record("apr1", "md5_encode", "aprmd5",
+                  runner.measure(lambda: md5_encode(PASSWORD, SALT)))
+    runner.record("apr1", "password_validate", "aprmd5",
+                  runner.measure(lambda: password_validate(PASSWORD, HASH)))
+    runner.record("apr1", "password_validate(wrong)", "aprmd5",
+                  runner.measure(lambda: password_validate("bar", HASH)))
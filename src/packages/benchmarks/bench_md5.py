@@ -0,0 +1,116 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Benchmarks for aprmd5.md5, compared against hashlib.md5"""
+
+# PSL
+try:
+    import hashlib
+    hashlib.md5()
+except (ImportError, ValueError):
+    # hashlib is missing, or MD5 is disabled (e.g. in FIPS mode)
+    hashlib = None
+
+# python-aprmd5
+from aprmd5 import md5, md5_hexdigest
+
+
+# The smallest buffer size of the throughput benchmarks. Each further size is
+# four times the previous one, up to the runner's maximum size.
+MIN_SIZE = 16
+
+# The input of the latency benchmarks
+LATENCY_INPUT = b"The quick brown fox jumps over the lazy dog"
+
+
+def implementations():
+    """Return a list of (name, constructor) tuples of the implementations to
+    measure."""
+    result = [("aprmd5", md5)]
+    if hashlib is not None:
+        result.append(("hashlib", hashlib.md5))
+    return result
+
+
+def sizes(maxSize):
+    result = []
+    size = MIN_SIZE
+    while size <= maxSize:
+        result.append(size)
+        size *= 4
+    return result
+
+
+def runUpdate(runner):
+    """Measure update() throughput across buffer sizes"""
+    bufferSizes = sizes(runner.maxSize)
+    if not bufferSizes:
+        return
+    # A single buffer is allocated, and slices of it are hashed, so that the
+    # memory for the largest size is only needed once
+    buffer = memoryview(bytearray(b"\xa5") * bufferSizes[-1])
+    for size in bufferSizes:
+        data = buffer[:size]
+        for name, constructor in implementations():
+            hashObject = constructor()
+            seconds = runner.measure(lambda: hashObject.update(data))
+            runner.record("md5", "update", name, seconds, size)
+
+
+def runFragments(runner):
+    """Measure the ingestion of many small fragments, one update() call per
+    fragment versus a single update_many() call"""
+    fragments = [LATENCY_INPUT] * 1000
+    size = len(LATENCY_INPUT) * len(fragments)
+    for name, constructor in implementations():
+        hashObject = constructor()
+        def updateEach():
+            update = hashObject.update
+            for fragment in fragments:
+                update(fragment)
+        runner.record("md5", "update fragments", name, runner.measure(updateEach), size)
+    hashObject = md5()
+    runner.record("md5", "update fragments", "aprmd5 update_many",
+                  runner.measure(lambda: hashObject.update_many(fragments)), size)
+
+
+def runLatency(runner):
+    """Measure the per-call latency of the small md5 operations"""
+    for name, constructor in implementations():
+        hashObject = constructor(LATENCY_INPUT)
+        runner.record("md5", "new", name, runner.measure(constructor))
+        runner.record("md5", "new(data)", name,
+                      runner.measure(lambda: constructor(LATENCY_INPUT)))
+        runner.record("md5", "digest", name, runner.measure(hashObject.digest))
+        runner.record("md5", "hexdigest", name, runner.measure(hashObject.hexdigest))
+        runner.record("md5", "copy", name, runner.measure(hashObject.copy))
+
+    # One-shot hashing of a short input; hashlib needs an object for this
+    runner.record("md5", "one-shot hexdigest", "aprmd5",
+                  runner.measure(lambda: md5_hexdigest(LATENCY_INPUT)))
+    if hashlib is not None:
+        runner.record("md5", "one-shot hexdigest", "hashlib",
+                      runner.measure(lambda: hashlib.md5(LATENCY_INPUT).hexdigest()))
+
+
+def run(runner):
+    runLatency(runner)
+    runUpdate(runner)
+    runFragments(runner)
@@ -0,0 +1,262 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Memory soak tests for aprmd5.
+
+Each soak module exports a function scenarios() that returns a list of
+(name, operation) tuples. The runner calls each operation over and over and
+measures how much memory the calls leave behind:
+
+- blocks_per_op: The number of pymalloc blocks that are still allocated after
+  the loop, per call (sys.getallocatedblocks())
+- bytes_per_op: The number of bytes that tracemalloc still sees allocated
+  after the loop, per call. This includes the memory that the extension
+  allocates with PyMem_Malloc() and PyMem_RawMalloc().
+- peak_bytes_per_op: The largest amount of memory that tracemalloc sees
+  allocated at once during a single call, i.e. the transient allocations of
+  one call
+- rss_growth_kb: The growth of the resident set size during a second,
+  longer loop without tracemalloc, read from /proc/self/statm. This also
+  covers memory that native code allocates with malloc(), which the other
+  measurements do not see, and it covers the native worker threads.
+
+The measurements are compared with the limits in baseline.json. A scenario
+that exceeds one of its limits is a regression. Measurements that the
+interpreter cannot take (tracemalloc needs Python 3.4, the peak needs Python
+3.9) are reported as None and are not compared.
+"""
+
+
+# PSL
+import gc
+import json
+import os
+import platform
+import sys
+import time
+
+try:
+    import tracemalloc
+except ImportError:
+    tracemalloc = None
+
+# python-aprmd5
+import aprmd5
+from soak import soak_md5
+from soak import soak_apr1
+from soak import soak_batch
+
+
+# The version of the result and baseline formats. Increment this when the
+# meaning of an existing field changes.
+RESULT_FORMAT_VERSION = 1
+
+# The soak modules, in the order in which they are run
+modules = [soak_md5, soak_apr1, soak_batch]
+
+# The baseline that ships with the sources
+BASELINE_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "baseline.json")
+
+# The measurements that are compared with the baseline
+METRICS = ["blocks_per_op", "bytes_per_op", "peak_bytes_per_op", "rss_growth_kb"]
+
+# When a baseline is written, each limit is the measurement times this factor,
+# but at least the floor of the metric. The floors are well below what a leak
+# of a single object per call would cost, and well above the noise of the
+# interpreter's free lists and of the page granularity of the RSS.
+BASELINE_HEADROOM = 2.0
+BASELINE_FLOORS = {
+    "blocks_per_op": 0.25,
+    "bytes_per_op": 16.0,
+    "peak_bytes_per_op": 4096.0,
+    "rss_growth_kb": 2048.0,
+}
+
+if hasattr(time, "perf_counter"):
+    clock = time.perf_counter
+else:
+    clock = time.time
+
+
+def rss():
+    """Return the resident set size of the process in KB, or None if it
+    cannot be determined."""
+    try:
+        with open("/proc/self/statm") as statm:
+            return int(statm.read().split()[1]) * os.sysconf("SC_PAGE_SIZE") // 1024
+    except (IOError, OSError, ValueError):
+        return None
+
+
+class Runner(object):
+    """Runs the soak loops and collects their measurements."""
+
+    def __init__(self, duration = 5.0, minCalls = 1000, measureRss = True, verbose = True):
+        # The allocation loop of a scenario runs for duration / 2 seconds, the
+        # RSS loop for duration seconds. Both loops make at least minCalls
+        # calls, so that the measurements per call are not dominated by noise.
+        self.duration = duration
+        self.minCalls = minCalls
+        self.measureRss = measureRss
+        self.verbose = verbose
+        self.results = []
+
+    def _call(self, function, seconds):
+        """Call function for at least seconds and at least minCalls times.
+        Returns the number of calls."""
+        calls = 0
+        batch = 1
+        start = clock()
+        while calls < self.minCalls or clock() - start < seconds:
+            for i in range(batch):
+                function()
+            calls += batch
+            batch = min(batch * 2, 1024)
+        return calls
+
+    def _measureAllocations(self, function, result):
+        if tracemalloc is None or not hasattr(sys, "getallocatedblocks"):
+            return
+        gc.collect()
+        tracemalloc.start()
+        try:
+            blocks = sys.getallocatedblocks()
+            traced = tracemalloc.get_traced_memory()[0]
+            calls = self._call(function, self.duration / 2)
+            gc.collect()
+            result["blocks_per_op"] = float(sys.getallocatedblocks() - blocks) / calls
+            result["bytes_per_op"] = float(tracemalloc.get_traced_memory()[0] - traced) / calls
+            result["calls"] = calls
+            if hasattr(tracemalloc, "reset_peak"):
+                peak = 0
+                for i in range(min(calls, 100)):
+                    traced = tracemalloc.get_traced_memory()[0]
+                    tracemalloc.reset_peak()
+                    function()
+                    peak = max(peak, tracemalloc.get_traced_memory()[1] - traced)
+                result["peak_bytes_per_op"] = float(peak)
+        finally:
+            tracemalloc.stop()
+
+    def _measureRss(self, function, result):
+        if not self.measureRss or rss() is None:
+            return
+        gc.collect()
+        start = rss()
+        self._call(function, self.duration)
+        gc.collect()
+        result["rss_growth_kb"] = float(rss() - start)
+
+    def soak(self, name, function):
+        """Soak one operation and record its measurements."""
+        result = {"name": name}
+        for metric in METRICS:
+            result[metric] = None
+        # Warm up caches, free lists and lazily initialized state, which would
+        # otherwise count as memory that the first calls leave behind
+        self._call(function, min(self.duration / 10, 0.5))
+        self._measureAllocations(function, result)
+        self._measureRss(function, result)
+        self.results.append(result)
+        if self.verbose:
+            values = []
+            for metric in METRICS:
+                value = result[metric]
+                values.append("%12s" % ("-" if value is None else "%.3f" % value))
+            print("%-36s %s" % (name, " ".join(values)))
+            sys.stdout.flush()
+        return result
+
+    def report(self):
+        """Return the results together with information about the environment
+        as a JSON-serializable dictionary."""
+        return {
+            "format_version": RESULT_FORMAT_VERSION,
+            "timestamp": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "environment": {
+                "python": platform.python_version(),
+                "python_implementation": platform.python_implementation(),
+                "platform": platform.platform(),
+                "machine": platform.machine(),
+                "backend": getattr(aprmd5, "backend", None),
+            },
+            "settings": {
+                "duration": self.duration,
+                "min_calls": self.minCalls,
+            },
+            "results": self.results,
+        }
+
+
+def loadBaseline(path = BASELINE_PATH):
+    with open(path) as baselineFile:
+        baseline = json.load(baselineFile)
+    if baseline.get("format_version") != RESULT_FORMAT_VERSION:
+        raise ValueError("%s: unsupported baseline format version %r" % (path, baseline.get("format_version")))
+    return baseline
+
+
+def makeBaseline(results):
+    """Return a baseline whose limits leave some headroom above results."""
+    limits = {"default": dict(BASELINE_FLOORS)}
+    for result in results:
+        scenarioLimits = {}
+        for metric in METRICS:
+            if result[metric] is not None:
+                scenarioLimits[metric] = round(max(result[metric] * BASELINE_HEADROOM, BASELINE_FLOORS[metric]), 3)
+        limits[result["name"]] = scenarioLimits
+    return {"format_version": RESULT_FORMAT_VERSION, "limits": limits}
+
+
+def compare(results, baseline):
+    """Return a list of messages, one for each measurement that exceeds its
+    limit. A scenario without limits of its own uses the default limits."""
+    regressions = []
+    for result in results:
+        scenarioLimits = baseline["limits"].get(result["name"], baseline["limits"].get("default", {}))
+        for metric in METRICS:
+            limit = scenarioLimits.get(metric)
+            if result[metric] is not None and limit is not None and result[metric] > limit:
+                regressions.append("%s: %s is %.3f, the limit is %.3f"
+                                   % (result["name"], metric, result[metric], limit))
+    return regressions
+
+
+def scenarios():
+    """Return the (name, operation) tuples of all soak modules."""
+    result = []
+    for module in modules:
+        result.extend(module.scenarios())
+    return result
+
+
+def runAll(runner, output = None):
+    """Soak all scenarios. If output is not None, write the report as JSON to
+    the file with that name. Returns the report."""
+    if runner.verbose:
+        print("%-36s %s" % ("scenario", " ".join("%12s" % metric[:12] for metric in METRICS)))
+    for name, function in scenarios():
+        runner.soak(name, function)
+    report = runner.report()
+    if output is not None:
+        with open(output, "w") as outputFile:
+            json.dump(report, outputFile, indent = 2, sort_keys = True)
+            outputFile.write("\n")
+    return report
@@ -0,0 +1,44 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Soak scenarios for md5_encode(), password_validate() and the password
+validation cache"""
+
+# python-aprmd5
+from aprmd5 import md5_encode, password_validate, ValidationCache
+
+
+PASSWORD = "foo"
+SALT = "mYJd83wW"
+APR1_HASH = "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"
+MD5CRYPT_HASH = "$1$mYJd83wW$fIuQNGxb1BPSvQy5DP8sV."
+SHA1_HASH = "{SHA}C+7Hteo/D9vJXQ3UfzxbwnXaijM="
+
+
+def scenarios():
+    cache = ValidationCache()
+    return [
+        ("md5_encode", lambda: md5_encode(PASSWORD, SALT)),
+        ("password_validate(apr1)", lambda: password_validate(PASSWORD, APR1_HASH)),
+        ("password_validate(apr1, wrong)", lambda: password_validate("bar", APR1_HASH)),
+        ("password_validate(md5crypt)", lambda: password_validate(PASSWORD, MD5CRYPT_HASH)),
+        ("password_validate(sha1)", lambda: password_validate(PASSWORD, SHA1_HASH)),
+        ("ValidationCache.validate", lambda: cache.validate(PASSWORD, APR1_HASH)),
+    ]
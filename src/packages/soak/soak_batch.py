@@ -0,0 +1,95 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Soak scenarios for the batch functions and the other code paths that run
+on native threads"""
+
+# PSL
+import atexit
+import os
+import shutil
+import sys
+import tempfile
+import threading
+
+# python-aprmd5
+import aprmd5
+from aprmd5 import md5, md5_many, md5_encode_many, password_validate_many, md5_file, find_duplicates
+
+
+# The batches are small, so that a loop makes enough calls within its
+# duration; the threads still get work of their own
+BATCH_SIZE = 16
+THREADS = 2
+
+BUFFERS = [bytes(bytearray([i])) * 1024 for i in range(BATCH_SIZE)]
+ENCODE_PAIRS = [("password%d" % i, "salt%04d" % i) for i in range(BATCH_SIZE)]
+VALIDATE_PAIRS = [("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")] * BATCH_SIZE
+
+# The number of Python threads, and the number of calls per thread, of the
+# concurrent scenario
+CONCURRENT_THREADS = 4
+CONCURRENT_CALLS = 50
+
+
+def makeDirectory():
+    """Create a directory with a few files for the file scenarios. The
+    directory is removed when the interpreter exits."""
+    directory = tempfile.mkdtemp()
+    atexit.register(shutil.rmtree, directory, True)
+    for index in range(4):
+        with open(os.path.join(directory, "file%d" % index), "wb") as f:
+            # Two pairs of identical files
+            f.write(BUFFERS[index // 2] * 64)
+    return directory
+
+
+def concurrent(shared):
+    """Hammer a shared md5 object and the password functions from several
+    Python threads at once."""
+    def work():
+        for i in range(CONCURRENT_CALLS):
+            shared.update(BUFFERS[i % BATCH_SIZE])
+            shared.copy().hexdigest()
+        aprmd5.password_validate("foo", VALIDATE_PAIRS[0][1])
+    threads = [threading.Thread(target = work) for i in range(CONCURRENT_THREADS)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+
+def scenarios():
+    directory = makeDirectory()
+    path = os.path.join(directory, "file0")
+    shared = md5()
+    result = [
+        ("md5_many", lambda: md5_many(BUFFERS, threads = THREADS)),
+        ("md5_encode_many", lambda: md5_encode_many(ENCODE_PAIRS, threads = THREADS)),
+        ("password_validate_many", lambda: password_validate_many(VALIDATE_PAIRS, threads = THREADS)),
+        ("md5_file", lambda: md5_file(path)),
+        ("find_duplicates", lambda: find_duplicates([directory], threads = THREADS)),
+        ("concurrent threads", lambda: concurrent(shared)),
+    ]
+    if sys.version_info >= (3, 0):
+        from aprmd5 import md5_parts
+        data = b"".join(BUFFERS) * 4
+        result.insert(4, ("md5_parts", lambda: md5_parts(data, 16 * 1024, threads = THREADS)))
+    return result
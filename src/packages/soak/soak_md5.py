@@ -0,0 +1,54 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Soak scenarios for aprmd5.md5 and the one-shot digest functions"""
+
+# PSL
+import pickle
+
+# python-aprmd5
+from aprmd5 import md5, md5_digest, md5_hexdigest
+
+
+# The input of most scenarios; longer than one block
+DATA = b"The quick brown fox jumps over the lazy dog" * 4
+
+# Large enough that md5.update() releases the GIL
+LARGE_DATA = b"x" * (256 * 1024)
+
+
+def scenarios():
+    # Objects that live across calls, so that the scenarios measure the
+    # methods and not only the construction of md5 objects
+    updated = md5()
+    copied = md5(DATA)
+    return [
+        ("md5()", lambda: md5()),
+        ("md5(data)", lambda: md5(DATA)),
+        ("md5.update", lambda: updated.update(DATA)),
+        ("md5.update(large)", lambda: updated.update(LARGE_DATA)),
+        ("md5.digest", lambda: md5(DATA).digest()),
+        ("md5.hexdigest", lambda: md5(DATA).hexdigest()),
+        ("md5.copy", lambda: copied.copy()),
+        ("md5.update_many", lambda: md5().update_many([DATA, DATA, DATA])),
+        ("md5 pickle", lambda: pickle.loads(pickle.dumps(copied))),
+        ("md5_digest", lambda: md5_digest(DATA)),
+        ("md5_hexdigest", lambda: md5_hexdigest(DATA)),
+    ]
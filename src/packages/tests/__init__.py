@@ -24,10 +24,24 @@ import sys
 import os
 
 # python-aprmd5
+if sys.version_info >= (3, 7):
+    from tests import test_async
+from tests import test_batch
+from tests import test_cache
+from tests import test_find_duplicates
+from tests import test_htpasswd
 from tests import test_leak
 from tests import test_md5_encode
 from tests import test_md5
+from tests import test_md5_file
+from tests import test_md5_many
+from tests import test_md5_rehash
 from tests import test_password_validate
+from tests import test_stats
+from tests import test_write_htpasswd
+if sys.version_info >= (3, 0):
+    from tests import test_capi
+    from tests import test_md5_parts
 
 
 # Set python2 to True or False, depending on which version of the
@@ -49,4 +63,18 @@ def allTests():
     suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5_encode))
     suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5))
     suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_password_validate))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_batch))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5_many))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5_file))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5_rehash))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_find_duplicates))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_cache))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_htpasswd))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_write_htpasswd))
+    suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_stats))
+    if sys.version_info >= (3, 0):
+        suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_capi))
+        suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_md5_parts))
+    if sys.version_info >= (3, 7):
+        suite.addTests(unittest.defaultTestLoader.loadTestsFromModule(test_async))
     return suite
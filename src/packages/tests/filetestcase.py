@@ -0,0 +1,74 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+"""Fixture shared by the tests that hash files"""
+
+# PSL
+import unittest
+import os
+import shutil
+import tempfile
+import threading
+
+
+class FileTestCase(unittest.TestCase):
+    """Base class for tests that need a temporary directory with files in it.
+
+    The directory is created before and removed after each test.
+    """
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def makeFile(self, content):
+        """Write content to a new file in the directory and return its path"""
+        path = os.path.join(self.directory, "file%d" % len(os.listdir(self.directory)))
+        f = open(path, "wb")
+        f.write(content)
+        f.close()
+        return path
+
+    def makeFifo(self, content):
+        """Create a FIFO in the directory and start a thread that writes
+        content to it once a reader opens it. Returns the path and the thread;
+        the caller must join() the thread."""
+        path = os.path.join(self.directory, "fifo%d" % len(os.listdir(self.directory)))
+        os.mkfifo(path)
+        def writer():
+            try:
+                f = open(path, "wb")
+                try:
+                    f.write(content)
+                finally:
+                    f.close()
+            except (IOError, OSError):
+                # The reader stopped reading early
+                pass
+        thread = threading.Thread(target = writer)
+        thread.daemon = True
+        thread.start()
+        return (path, thread)
+
+    def makeContent(self, length, seed = 7):
+        """Return length bytes that are not all the same; different seeds
+        give different content"""
+        return bytes(bytearray((i * 31 + seed) % 256 for i in range(length)))
@@ -0,0 +1,168 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for the awaitable functions md5_encode_async(),
+password_validate_async() and md5.update_async()"""
+
+# PSL
+import unittest
+import hashlib
+import os
+# asyncio is imported by setUpModule(). Importing it when the test suite is
+# collected changes the memory footprint of the interpreter in a way that
+# upsets the RSS measurements in test_leak.
+asyncio = None
+
+# python-aprmd5
+import aprmd5
+from aprmd5 import md5, md5_encode, md5_encode_async, password_validate_async
+
+
+def setUpModule():
+    global asyncio
+    import asyncio
+
+
+def run(coroutine):
+    return asyncio.run(coroutine)
+
+
+class MD5EncodeAsyncTest(unittest.TestCase):
+    """Exercise aprmd5.md5_encode_async()"""
+
+    def testNormal(self):
+        async def encode():
+            return await md5_encode_async("foo", "mYJd83wW")
+        result = run(encode())
+        self.assertEqual(result, "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")
+
+    def testMatchesMd5Encode(self):
+        pairs = [("password%d" % i * (i % 7), "salt%d" % i) for i in range(300)]
+        async def encodeAll():
+            return await asyncio.gather(*[md5_encode_async(password, salt) for (password, salt) in pairs])
+        self.assertEqual(run(encodeAll()), [md5_encode(password, salt) for (password, salt) in pairs])
+
+    def testNoRunningLoop(self):
+        self.assertRaises(RuntimeError, md5_encode_async, "foo", "bar")
+
+    def testPasswordIsNone(self):
+        async def encode():
+            return md5_encode_async(None, "bar")
+        self.assertRaises(TypeError, run, encode())
+
+
+class PasswordValidateAsyncTest(unittest.TestCase):
+    """Exercise aprmd5.password_validate_async()"""
+
+    def testNormal(self):
+        async def validate():
+            return [await password_validate_async("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"),
+                    await password_validate_async("bar", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"),
+                    await password_validate_async("foo", "$apr1$mYJd83wW$xxxxxxxxxxxxxxxxxxxxxx")]
+        self.assertEqual(run(validate()), [True, False, False])
+
+    def testManyConcurrentValidations(self):
+        hashes = [md5_encode("password%d" % i, "salt%d" % i) for i in range(200)]
+        async def validateAll():
+            return await asyncio.gather(*[password_validate_async("password%d" % (i + i % 2), hashes[i])
+                                          for i in range(200)])
+        self.assertEqual(run(validateAll()), [(i % 2) == 0 for i in range(200)])
+
+    def testLoopIsNotBlocked(self):
+        hashes = [md5_encode("password%d" % i, "salt") for i in range(100)]
+        async def validateWhileTicking():
+            ticks = []
+            done = asyncio.Event()
+            async def ticker():
+                while not done.is_set():
+                    ticks.append(1)
+                    await asyncio.sleep(0)
+            tickerTask = asyncio.ensure_future(ticker())
+            for i in range(100):
+                self.assertTrue(await password_validate_async("password%d" % i, hashes[i]))
+            done.set()
+            await tickerTask
+            return len(ticks)
+        # The ticker runs at least once while each validation is in progress
+        self.assertTrue(run(validateWhileTicking()) >= 100)
+
+    def testSeveralLoops(self):
+        async def validate():
+            return await password_validate_async("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")
+        for i in range(3):
+            self.assertTrue(run(validate()))
+
+    def testCancelledFuture(self):
+        async def cancelThenValidate():
+            future = password_validate_async("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")
+            future.cancel()
+            return await password_validate_async("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")
+        self.assertTrue(run(cancelThenValidate()))
+
+    def testNoRunningLoop(self):
+        self.assertRaises(RuntimeError, password_validate_async, "foo", "bar")
+
+
+class MD5UpdateAsyncTest(unittest.TestCase):
+    """Exercise md5.update_async()"""
+
+    def testSmallBuffer(self):
+        async def update():
+            m = md5(b"foo")
+            await m.update_async(b"bar")
+            return m.digest()
+        self.assertEqual(run(update()), hashlib.md5(b"foobar").digest())
+
+    def testLargeBuffers(self):
+        buffers = [os.urandom(100000), bytearray(os.urandom(3000)), memoryview(os.urandom(70000))]
+        async def update():
+            m = md5()
+            for buffer in buffers:
+                await m.update_async(buffer)
+            m.update(b"tail")
+            return m.hexdigest()
+        expected = hashlib.md5(b"".join(bytes(buffer) for buffer in buffers) + b"tail").hexdigest()
+        self.assertEqual(run(update()), expected)
+
+    def testConcurrentUpdatesOfSameObject(self):
+        async def update():
+            m = md5()
+            future = m.update_async(b"x" * 100000)
+            try:
+                self.assertRaises(RuntimeError, m.update_async, b"y" * 100000)
+            finally:
+                await future
+            # The object is usable again once the first update has finished
+            await m.update_async(b"y" * 100000)
+            return m.digest()
+        self.assertEqual(run(update()), hashlib.md5(b"x" * 100000 + b"y" * 100000).digest())
+
+    def testNoRunningLoop(self):
+        m = md5()
+        self.assertRaises(RuntimeError, m.update_async, b"x" * 100000)
+        # A failed call does not leave the object in a pending state
+        self.assertRaises(RuntimeError, m.update_async, b"x" * 100000)
+        m.update(b"foo")
+        self.assertEqual(m.digest(), hashlib.md5(b"foo").digest())
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,156 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.md5_encode_many() and aprmd5.password_validate_many()"""
+
+# PSL
+import unittest
+import os
+import subprocess
+import sys
+
+# python-aprmd5
+from aprmd5 import md5_encode, md5_encode_many
+from aprmd5 import password_validate_many
+
+
+def makePairs():
+    """Return a list of (password, salt) pairs whose password lengths cover
+    round messages of one, two and more blocks, and whose salts cover all the
+    ways in which md5_encode() interprets a salt."""
+    salts = ["", "a", "mYJd83wW", "mYJd83wW9876543210", "$apr1$mYJd83wW",
+             "$apr1$mYJd$83wW", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"]
+    pairs = []
+    for length in list(range(0, 70)) + [100, 127, 128, 129, 300]:
+        password = "".join(chr(ord("!") + (i * 13 + length) % 90) for i in range(length))
+        pairs.append((password, salts[length % len(salts)]))
+    return pairs
+
+
+class MD5EncodeManyTest(unittest.TestCase):
+    """Exercise aprmd5.md5_encode_many()"""
+
+    def testNormal(self):
+        pairs = [("foo", "mYJd83wW"), ("", "7n4Iu7Bq"), ("foo", "")]
+        expectedResult = ["$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50",
+                          "$apr1$7n4Iu7Bq$jsH1cRc.tyRPvJpZjxUjV.",
+                          "$apr1$$vGRl2mLvDG8pptkZ9Cyum."]
+        result = md5_encode_many(pairs)
+        self.assertEqual(result, expectedResult)
+
+    def testEmpty(self):
+        self.assertEqual(md5_encode_many([]), [])
+
+    def testSaltIsLongerThan8Characters(self):
+        result = md5_encode_many([("foo", "mYJd83wW9876543210")])
+        self.assertEqual(result, ["$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"])
+
+    def testMatchesMd5Encode(self):
+        # Enough pairs to keep several threads busy; the result order must
+        # match the input order
+        pairs = [("password%d" % i, "salt%04d" % i) for i in range(200)]
+        expectedResult = [md5_encode(password, salt) for (password, salt) in pairs]
+        for threads in (0, 1, 3):
+            result = md5_encode_many(pairs, threads = threads)
+            self.assertEqual(result, expectedResult)
+
+    def testPasswordAndSaltLengths(self):
+        pairs = makePairs()
+        expectedResult = [md5_encode(password, salt) for (password, salt) in pairs]
+        self.assertEqual(md5_encode_many(pairs), expectedResult)
+
+    def testAllKernels(self):
+        """Forces each multi-buffer kernel in turn in a child process. Kernels
+        that the CPU does not support fall back to the scalar kernel."""
+        script = ("import aprmd5\n"
+                  "from tests.test_batch import makePairs\n"
+                  "pairs = makePairs()\n"
+                  "hashes = [aprmd5.md5_encode(p, s) for (p, s) in pairs]\n"
+                  "assert aprmd5.md5_encode_many(pairs, threads=1) == hashes\n"
+                  "assert all(aprmd5.password_validate_many([(p, h) for ((p, s), h) in zip(pairs, hashes)]))\n")
+        for kernel in ("scalar", "sse2", "avx2", "avx512"):
+            environment = dict(os.environ)
+            environment["APRMD5_MULTIBUF_KERNEL"] = kernel
+            environment["PYTHONPATH"] = os.pathsep.join(sys.path)
+            exitCode = subprocess.call([sys.executable, "-c", script], env = environment)
+            self.assertEqual(exitCode, 0, "kernel %s" % kernel)
+
+    def testIterable(self):
+        pairs = (("foo", "mYJd83wW") for i in range(3))
+        result = md5_encode_many(pairs)
+        self.assertEqual(result, ["$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"] * 3)
+
+    def testPairIsNotAPair(self):
+        self.assertRaises(TypeError, md5_encode_many, [("foo",)])
+        self.assertRaises(TypeError, md5_encode_many, ["foo"])
+
+    def testPairIsAString(self):
+        # A two character string must not be taken for a password and a salt
+        self.assertRaises(TypeError, md5_encode_many, ["ab"])
+        self.assertRaises(TypeError, md5_encode_many, [b"ab"])
+        self.assertRaises(TypeError, password_validate_many, ["ab"])
+
+    def testPairIsAList(self):
+        self.assertEqual(md5_encode_many([["foo", "mYJd83wW"]]), ["$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"])
+
+    def testPasswordIsNone(self):
+        self.assertRaises(TypeError, md5_encode_many, [(None, "7n4Iu7Bq")])
+
+    def testThreadsIsNegative(self):
+        self.assertRaises(ValueError, md5_encode_many, [("foo", "bar")], threads = -1)
+
+
+class PasswordValidateManyTest(unittest.TestCase):
+    """Exercise aprmd5.password_validate_many()"""
+
+    def testNormal(self):
+        pairs = [("foo", "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"),
+                 ("foo", "$apr1$mYJd83wW$xxxxxxxxxxxxxxxxxxxxxx"),
+                 ("", "$apr1$7n4Iu7Bq$jsH1cRc.tyRPvJpZjxUjV."),
+                 ("foo", "$apr1$vGRl2mLvDG8pptkZ9Cyum.")]
+        expectedResult = [True, False, True, False]
+        result = password_validate_many(pairs)
+        self.assertEqual(result, expectedResult)
+
+    def testManyPairs(self):
+        hashes = md5_encode_many([("password%d" % i, "salt%04d" % i) for i in range(100)])
+        # Every other pair uses the wrong password
+        pairs = [("password%d" % (i + (i % 2)), hashes[i]) for i in range(100)]
+        expectedResult = [(i % 2) == 0 for i in range(100)]
+        for threads in (0, 1, 5):
+            result = password_validate_many(pairs, threads = threads)
+            self.assertEqual(result, expectedResult)
+
+    def testPasswordAndSaltLengths(self):
+        pairs = makePairs()
+        hashes = md5_encode_many(pairs)
+        result = password_validate_many([(password, hash) for ((password, salt), hash) in zip(pairs, hashes)])
+        self.assertEqual(result, [True] * len(pairs))
+        # Validation must fail if the password is off by one character
+        result = password_validate_many([(password + "x", hash) for ((password, salt), hash) in zip(pairs, hashes)])
+        self.assertEqual(result, [False] * len(pairs))
+
+    def testHashIsNone(self):
+        self.assertRaises(TypeError, password_validate_many, [("foo", None)])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,170 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.ValidationCache"""
+
+# PSL
+import unittest
+import threading
+import time
+
+# python-aprmd5
+from aprmd5 import ValidationCache, md5_encode
+
+
+class ValidationCacheTest(unittest.TestCase):
+    """Exercise aprmd5.ValidationCache"""
+
+    hash = "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"
+
+    def testValidate(self):
+        cache = ValidationCache()
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertFalse(cache.validate("bar", self.hash))
+        self.assertFalse(cache.validate("foo", "$apr1$mYJd83wW$xxxxxxxxxxxxxxxxxxxxxx"))
+        stats = cache.stats()
+        self.assertEqual(stats["hits"], 1)
+        self.assertEqual(stats["misses"], 3)
+        self.assertEqual(stats["entries"], 1)
+
+    def testFailedValidationsAreNotCached(self):
+        cache = ValidationCache()
+        for i in range(3):
+            self.assertFalse(cache.validate("bar", self.hash))
+        self.assertEqual(cache.stats()["hits"], 0)
+        self.assertEqual(cache.stats()["entries"], 0)
+
+    def testBoundaryBetweenHashAndPasswordIsUnambiguous(self):
+        # A password that happens to continue the hash must not hit the entry
+        # of a different pair
+        cache = ValidationCache()
+        hash = md5_encode("x", "salt")
+        self.assertTrue(cache.validate("x", hash))
+        self.assertFalse(cache.validate("", hash + "x"))
+
+    def testEviction(self):
+        cache = ValidationCache(max_entries = 16)
+        hashes = [md5_encode("password%d" % i, "salt") for i in range(100)]
+        for i in range(100):
+            self.assertTrue(cache.validate("password%d" % i, hashes[i]))
+        stats = cache.stats()
+        self.assertTrue(stats["entries"] <= 16)
+        self.assertEqual(stats["evictions"], 100 - stats["entries"])
+        # The most recently validated pair is still cached
+        self.assertTrue(cache.validate("password99", hashes[99]))
+        self.assertEqual(cache.stats()["hits"], 1)
+
+    def testMaxEntriesIsABound(self):
+        # The stripes must not hold more than max_entries together, also if
+        # max_entries is not a multiple of the number of stripes
+        hashes = [md5_encode("password%d" % i, "salt") for i in range(40)]
+        for maxEntries in (1, 2, 3, 5, 15, 17, 33):
+            cache = ValidationCache(maxEntries, None)
+            for i in range(40):
+                self.assertTrue(cache.validate("password%d" % i, hashes[i]))
+            stats = cache.stats()
+            self.assertTrue(stats["entries"] <= maxEntries, (maxEntries, stats))
+            self.assertEqual(stats["evictions"], 40 - stats["entries"])
+        cache = ValidationCache(1, None)
+        for i in range(40):
+            cache.validate("password%d" % i, hashes[i])
+        self.assertEqual(cache.stats()["entries"], 1)
+
+    def testLeastRecentlyUsedIsEvicted(self):
+        # With max_entries = 32, each of the 16 stripes holds two entries. A
+        # pair that is used before each new pair is always the most recently
+        # used entry of its stripe, so it is never evicted.
+        cache = ValidationCache(max_entries = 32)
+        hashes = [md5_encode("password%d" % i, "salt") for i in range(200)]
+        for i in range(200):
+            self.assertTrue(cache.validate("password0", hashes[0]))
+            self.assertTrue(cache.validate("password%d" % i, hashes[i]))
+        stats = cache.stats()
+        self.assertTrue(stats["evictions"] > 0)
+        self.assertEqual(stats["hits"], 200)
+
+    def testTtl(self):
+        cache = ValidationCache(ttl = 0.05)
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertTrue(cache.validate("foo", self.hash))
+        time.sleep(0.1)
+        self.assertTrue(cache.validate("foo", self.hash))
+        stats = cache.stats()
+        self.assertEqual(stats["hits"], 1)
+        self.assertEqual(stats["expirations"], 1)
+
+    def testTtlNone(self):
+        cache = ValidationCache(ttl = None)
+        self.assertEqual(cache.ttl, None)
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertEqual(cache.stats()["hits"], 1)
+
+    def testAttributes(self):
+        cache = ValidationCache(123, 4.5)
+        self.assertEqual(cache.max_entries, 123)
+        self.assertEqual(cache.ttl, 4.5)
+        self.assertEqual(cache.stats()["max_entries"], 123)
+
+    def testClear(self):
+        cache = ValidationCache()
+        cache.validate("foo", self.hash)
+        cache.clear()
+        self.assertEqual(cache.stats()["entries"], 0)
+        self.assertTrue(cache.validate("foo", self.hash))
+        self.assertEqual(cache.stats()["hits"], 0)
+
+    def testConcurrentThreads(self):
+        cache = ValidationCache(max_entries = 64)
+        hashes = [md5_encode("password%d" % i, "salt") for i in range(100)]
+        failures = []
+        def worker(offset):
+            for i in range(300):
+                index = (i * 7 + offset) % 100
+                if not cache.validate("password%d" % index, hashes[index]):
+                    failures.append(index)
+                if cache.validate("wrong", hashes[index]):
+                    failures.append(index)
+        threads = [threading.Thread(target = worker, args = (offset,)) for offset in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(failures, [])
+        stats = cache.stats()
+        self.assertEqual(stats["hits"] + stats["misses"], 4 * 300 * 2)
+        self.assertTrue(stats["entries"] <= 64)
+
+    def testInvalidArguments(self):
+        self.assertRaises(ValueError, ValidationCache, 0)
+        self.assertRaises(ValueError, ValidationCache, 10, 0)
+        self.assertRaises(ValueError, ValidationCache, 10, -1)
+        self.assertRaises(TypeError, ValidationCache, 10, "foo")
+        self.assertRaises(TypeError, ValidationCache().validate, None, self.hash)
+
+    def testReinitialization(self):
+        cache = ValidationCache()
+        self.assertRaises(RuntimeError, cache.__init__)
+
+
+if __name__ == "__main__":
+    unittest.main()
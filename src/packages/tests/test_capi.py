@@ -0,0 +1,160 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for the C API that is exported through aprmd5._C_API
+
+The tests call the function table through ctypes, the same way a native
+extension would call it after including aprmd5_capi.h.
+"""
+
+# PSL
+import unittest
+import hashlib
+
+# python-aprmd5
+import aprmd5
+from tests.test_md5_many import makeInputs
+
+
+DIGESTSIZE = 16
+APR1_HASHSIZE = 38
+
+
+def getCAPI():
+    """Return the function table behind aprmd5._C_API
+
+    ctypes is imported here rather than at import time, so that merely
+    importing this module does not change the memory footprint that test_leak
+    measures.
+    """
+    import ctypes
+    c_char_p_p = ctypes.POINTER(ctypes.c_char_p)
+
+    class CAPI(ctypes.Structure):
+        """Mirrors the struct aprmd5_capi in aprmd5_capi.h"""
+        _fields_ = [
+            ("version", ctypes.c_int),
+            ("md5_init", ctypes.CFUNCTYPE(None, ctypes.c_void_p)),
+            ("md5_update", ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t)),
+            ("md5_final", ctypes.CFUNCTYPE(None, ctypes.c_char_p, ctypes.c_void_p)),
+            ("md5", ctypes.CFUNCTYPE(None, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t)),
+            ("apr1_encode", ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p)),
+            ("password_validate", ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_char_p, ctypes.c_char_p)),
+            ("md5_many", ctypes.CFUNCTYPE(ctypes.c_int, c_char_p_p, ctypes.POINTER(ctypes.c_size_t),
+                                          ctypes.c_size_t, ctypes.c_char_p, ctypes.c_int)),
+            ("apr1_encode_many", ctypes.CFUNCTYPE(ctypes.c_int, c_char_p_p, c_char_p_p,
+                                                  ctypes.c_size_t, ctypes.c_char_p, ctypes.c_int)),
+            ("password_validate_many", ctypes.CFUNCTYPE(ctypes.c_int, c_char_p_p, c_char_p_p,
+                                                        ctypes.c_size_t, ctypes.c_char_p, ctypes.c_int)),
+        ]
+
+    getPointer = ctypes.pythonapi.PyCapsule_GetPointer
+    getPointer.restype = ctypes.c_void_p
+    getPointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+    address = getPointer(aprmd5._C_API, b"aprmd5._C_API")
+    return CAPI.from_address(address)
+
+def stringArray(strings):
+    import ctypes
+    return (ctypes.c_char_p * len(strings))(*[s.encode("utf-8") for s in strings])
+
+
+class CAPITest(unittest.TestCase):
+    """Exercise the C API"""
+
+    def setUp(self):
+        import ctypes
+        self.ctypes = ctypes
+        self.api = getCAPI()
+        self.pairs = [("pw%d" % i, "salt%d" % i) for i in range(37)]
+
+    def testVersion(self):
+        self.assertTrue(self.api.version >= 1)
+
+    def testIncremental(self):
+        context = self.ctypes.create_string_buffer(128)
+        self.api.md5_init(context)
+        self.api.md5_update(context, b"foo", 3)
+        self.api.md5_update(context, b"bar" * 100, 300)
+        digest = self.ctypes.create_string_buffer(DIGESTSIZE)
+        self.api.md5_final(digest, context)
+        self.assertEqual(digest.raw, hashlib.md5(b"foo" + b"bar" * 100).digest())
+
+    def testContextCanBeCopied(self):
+        context = self.ctypes.create_string_buffer(128)
+        self.api.md5_init(context)
+        self.api.md5_update(context, b"prefix", 6)
+        fork = self.ctypes.create_string_buffer(context.raw, 128)
+        self.api.md5_update(fork, b"suffix", 6)
+        digest = self.ctypes.create_string_buffer(DIGESTSIZE)
+        self.api.md5_final(digest, context)
+        self.assertEqual(digest.raw, hashlib.md5(b"prefix").digest())
+        self.api.md5_final(digest, fork)
+        self.assertEqual(digest.raw, hashlib.md5(b"prefixsuffix").digest())
+
+    def testOneShot(self):
+        digest = self.ctypes.create_string_buffer(DIGESTSIZE)
+        for input in makeInputs():
+            self.api.md5(digest, input, len(input))
+            self.assertEqual(digest.raw, hashlib.md5(input).digest())
+
+    def testApr1Encode(self):
+        result = self.ctypes.create_string_buffer(APR1_HASHSIZE)
+        self.assertEqual(self.api.apr1_encode(b"foo", b"mYJd83wW", result), 0)
+        self.assertEqual(result.value, b"$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50")
+
+    def testPasswordValidate(self):
+        hash = b"$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"
+        self.assertEqual(self.api.password_validate(b"foo", hash), 1)
+        self.assertEqual(self.api.password_validate(b"bar", hash), 0)
+
+    def testMd5Many(self):
+        inputs = makeInputs()
+        inputArray = (self.ctypes.c_char_p * len(inputs))(*inputs)
+        lenArray = (self.ctypes.c_size_t * len(inputs))(*[len(input) for input in inputs])
+        digests = self.ctypes.create_string_buffer(DIGESTSIZE * len(inputs))
+        for threads in (0, 1, 2):
+            self.assertEqual(self.api.md5_many(inputArray, lenArray, len(inputs), digests, threads), 0)
+            self.assertEqual(digests.raw, b"".join(aprmd5.md5_many(inputs)))
+
+    def testApr1EncodeMany(self):
+        results = self.ctypes.create_string_buffer(APR1_HASHSIZE * len(self.pairs))
+        status = self.api.apr1_encode_many(stringArray([p for p, s in self.pairs]),
+                                           stringArray([s for p, s in self.pairs]),
+                                           len(self.pairs), results, 0)
+        self.assertEqual(status, 0)
+        expected = aprmd5.md5_encode_many(self.pairs)
+        for index in range(len(self.pairs)):
+            result = results.raw[index * APR1_HASHSIZE:(index + 1) * APR1_HASHSIZE]
+            self.assertEqual(result.split(b"\0")[0].decode("utf-8"), expected[index])
+
+    def testPasswordValidateMany(self):
+        hashes = aprmd5.md5_encode_many(self.pairs)
+        passwords = [p if i % 3 else "wrong" for i, (p, s) in enumerate(self.pairs)]
+        valid = self.ctypes.create_string_buffer(len(hashes))
+        status = self.api.password_validate_many(stringArray(passwords), stringArray(hashes),
+                                                 len(hashes), valid, 2)
+        self.assertEqual(status, 0)
+        self.assertEqual(list(bytearray(valid.raw)), [1 if i % 3 else 0 for i in range(len(hashes))])
+
+
+if __name__ == "__main__":
+    unittest.main()
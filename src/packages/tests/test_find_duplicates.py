@@ -0,0 +1,142 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.find_duplicates()"""
+
+# PSL
+import unittest
+import os
+
+# python-aprmd5
+from aprmd5 import find_duplicates
+from tests import filetestcase
+
+
+class FindDuplicatesTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.find_duplicates()"""
+
+    def makeFile(self, relativePath, content):
+        path = os.path.join(self.directory, relativePath)
+        parent = os.path.dirname(path)
+        if not os.path.isdir(parent):
+            os.makedirs(parent)
+        f = open(path, "wb")
+        f.write(content)
+        f.close()
+        return path
+
+    def normalize(self, groups):
+        return sorted(sorted(group) for group in groups)
+
+    def testNoFiles(self):
+        self.assertEqual(find_duplicates([self.directory]), [])
+
+    def testNoRoots(self):
+        self.assertEqual(find_duplicates([]), [])
+
+    def testSmallFiles(self):
+        a = self.makeFile("a", b"foo")
+        b = self.makeFile("sub/b", b"foo")
+        c = self.makeFile("sub/deeper/c", b"foo")
+        self.makeFile("d", b"bar")
+        self.makeFile("e", b"fooo")
+        self.assertEqual(self.normalize(find_duplicates([self.directory])), [sorted([a, b, c])])
+
+    def testLargeFiles(self):
+        content = bytes(bytearray(i % 251 for i in range(100000)))
+        a = self.makeFile("a", content)
+        b = self.makeFile("b", content)
+        # Same size, same head and tail, different middle: survives the
+        # prefilter but not the full hash
+        middle = bytearray(content)
+        middle[50000] ^= 1
+        self.makeFile("c", bytes(middle))
+        # Same size, different head: eliminated by the prefilter
+        head = bytearray(content)
+        head[0] ^= 1
+        self.makeFile("d", bytes(head))
+        self.assertEqual(self.normalize(find_duplicates([self.directory])), [sorted([a, b])])
+
+    def testGroupOrder(self):
+        small = [self.makeFile("small%d" % i, b"x") for i in range(2)]
+        large = [self.makeFile("large%d" % i, b"y" * 20000) for i in range(2)]
+        result = find_duplicates([self.directory], threads = 1)
+        self.assertEqual([sorted(group) for group in result], [sorted(large), sorted(small)])
+
+    def testManyFiles(self):
+        expectedGroups = []
+        for i in range(50):
+            group = [self.makeFile("dir%d/file%d" % (j, i), b"content %d" % i * (i * 100 + 1)) for j in range(3)]
+            expectedGroups.append(sorted(group))
+        self.makeFile("unique", b"unique")
+        for threads in (0, 1, 4):
+            result = find_duplicates([self.directory], threads = threads)
+            self.assertEqual(self.normalize(result), sorted(expectedGroups))
+
+    def testEmptyFiles(self):
+        a = self.makeFile("a", b"")
+        b = self.makeFile("b", b"")
+        self.assertEqual(find_duplicates([self.directory]), [])
+        self.assertEqual(self.normalize(find_duplicates([self.directory], min_size = 0)), [sorted([a, b])])
+
+    def testMinSize(self):
+        self.makeFile("a", b"foo")
+        self.makeFile("b", b"foo")
+        self.assertEqual(find_duplicates([self.directory], min_size = 4), [])
+
+    def testHardLinksAndOverlappingRoots(self):
+        a = self.makeFile("a", b"foo")
+        os.link(a, os.path.join(self.directory, "hardlink"))
+        self.assertEqual(find_duplicates([self.directory]), [])
+        b = self.makeFile("sub/b", b"foo")
+        result = find_duplicates([self.directory, os.path.join(self.directory, "sub"), a])
+        self.assertEqual(len(result), 1)
+        self.assertEqual(len(result[0]), 2)
+        self.assertTrue(b in result[0])
+
+    def testSymbolicLinksAreNotFollowed(self):
+        self.makeFile("a", b"foo")
+        os.symlink(os.path.join(self.directory, "a"), os.path.join(self.directory, "symlink"))
+        self.assertEqual(find_duplicates([self.directory]), [])
+
+    def testFileRoots(self):
+        a = self.makeFile("a", b"foo")
+        b = self.makeFile("b", b"foo")
+        self.assertEqual(self.normalize(find_duplicates([a, b])), [sorted([a, b])])
+
+    def testRootWithTrailingSlash(self):
+        a = self.makeFile("a", b"foo")
+        b = self.makeFile("b", b"foo")
+        result = find_duplicates([self.directory + os.sep])
+        self.assertEqual(self.normalize(result), [sorted([a, b])])
+
+    def testRootDoesNotExist(self):
+        self.assertRaises(OSError, find_duplicates, [os.path.join(self.directory, "doesnotexist")])
+
+    def testInvalidArguments(self):
+        self.assertRaises(TypeError, find_duplicates, None)
+        self.assertRaises(TypeError, find_duplicates, [None])
+        self.assertRaises(ValueError, find_duplicates, [], threads = -1)
+        self.assertRaises(ValueError, find_duplicates, [], min_size = -1)
+
+
+if __name__ == "__main__":
+    unittest.main()
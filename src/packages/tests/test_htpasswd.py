@@ -0,0 +1,167 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.HtpasswdFile"""
+
+# PSL
+import unittest
+import os
+
+# python-aprmd5
+from aprmd5 import HtpasswdFile, md5_encode
+from tests import filetestcase
+
+
+class HtpasswdFileTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.HtpasswdFile"""
+
+    def setUp(self):
+        filetestcase.FileTestCase.setUp(self)
+        self.path = os.path.join(self.directory, "htpasswd")
+
+    def write(self, content, mode = "wb"):
+        with open(self.path, mode) as f:
+            f.write(content.encode("utf-8"))
+
+    def line(self, user, password):
+        return "%s:%s\n" % (user, md5_encode(password, "salt" + user))
+
+    def testValidate(self):
+        self.write(self.line("alice", "foo") + self.line("bob", "bar"))
+        htpasswd = HtpasswdFile(self.path)
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+        self.assertTrue(htpasswd.validate("bob", "bar"))
+        self.assertFalse(htpasswd.validate("alice", "bar"))
+        self.assertFalse(htpasswd.validate("carol", "foo"))
+        self.assertFalse(htpasswd.validate("", "foo"))
+        self.assertEqual(len(htpasswd), 2)
+        self.assertTrue("alice" in htpasswd)
+        self.assertFalse("carol" in htpasswd)
+        self.assertEqual(htpasswd.path, self.path)
+
+    def testFileFormat(self):
+        self.write("# comment:x\n"
+                   "\n"
+                   "nocolon\n"
+                   ":nouser\n"
+                   + self.line("alice", "foo").replace("\n", "\r\n")
+                   + self.line("alice", "second")
+                   + self.line("bob", "bar").rstrip("\n"))
+        htpasswd = HtpasswdFile(self.path)
+        self.assertEqual(len(htpasswd), 2)
+        self.assertFalse("# comment" in htpasswd)
+        # The first line of a user wins
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+        self.assertFalse(htpasswd.validate("alice", "second"))
+        # The last line needs no line break
+        self.assertTrue(htpasswd.validate("bob", "bar"))
+
+    def testManyUsers(self):
+        lines = ["user%d:{SHA}hash%d\n" % (i, i) for i in range(5000)]
+        self.write("".join(lines) + self.line("last", "foo"))
+        htpasswd = HtpasswdFile(self.path)
+        self.assertEqual(len(htpasswd), 5001)
+        for i in range(0, 5000, 97):
+            self.assertTrue("user%d" % i in htpasswd)
+        self.assertFalse("user5000" in htpasswd)
+        self.assertTrue(htpasswd.validate("last", "foo"))
+
+    def testIncrementalReload(self):
+        self.write(self.line("alice", "foo"))
+        htpasswd = HtpasswdFile(self.path, check_interval = 0)
+        self.write(self.line("bob", "bar"), "ab")
+        self.assertTrue(htpasswd.validate("bob", "bar"))
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+        stats = htpasswd.stats()
+        self.assertEqual(stats["users"], 2)
+        self.assertEqual(stats["full_reloads"], 1)
+        self.assertEqual(stats["incremental_reloads"], 1)
+
+    def testEditInPlaceAndAppend(self):
+        # The htpasswd utility rewrites the file in place. A hash that changes
+        # to one of the same length far away from the end of the file must not
+        # be missed when the file has also grown.
+        lines = [self.line("alice", "foo")] + [self.line("user%d" % i, "pw") for i in range(200)]
+        self.write("".join(lines))
+        htpasswd = HtpasswdFile(self.path, check_interval = 0)
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+        newLine = self.line("alice", "new")
+        self.assertEqual(len(newLine), len(lines[0]))
+        with open(self.path, "r+b") as f:
+            f.write(newLine.encode("utf-8"))
+            f.seek(0, os.SEEK_END)
+            f.write(self.line("bob", "bar").encode("utf-8"))
+        self.assertFalse(htpasswd.validate("alice", "foo"))
+        self.assertTrue(htpasswd.validate("alice", "new"))
+        self.assertTrue(htpasswd.validate("bob", "bar"))
+        stats = htpasswd.stats()
+        self.assertEqual(stats["full_reloads"], 2)
+        self.assertEqual(stats["incremental_reloads"], 0)
+
+    def testFullReload(self):
+        self.write(self.line("alice", "foo") + self.line("bob", "bar"))
+        htpasswd = HtpasswdFile(self.path, check_interval = 0)
+        # Replace the file with a new inode, as tools do that write a new file
+        # and rename it over the old one
+        replacement = self.path + ".tmp"
+        with open(replacement, "wb") as f:
+            f.write(self.line("bob", "baz").encode("utf-8"))
+        os.rename(replacement, self.path)
+        self.assertFalse(htpasswd.validate("alice", "foo"))
+        self.assertTrue(htpasswd.validate("bob", "baz"))
+        self.assertFalse(htpasswd.validate("bob", "bar"))
+        self.assertEqual(len(htpasswd), 1)
+        self.assertEqual(htpasswd.stats()["full_reloads"], 2)
+
+    def testCheckIntervalNone(self):
+        self.write(self.line("alice", "foo"))
+        htpasswd = HtpasswdFile(self.path, check_interval = None)
+        self.write(self.line("bob", "bar"), "ab")
+        self.assertFalse(htpasswd.validate("bob", "bar"))
+        htpasswd.reload()
+        self.assertTrue(htpasswd.validate("bob", "bar"))
+
+    def testMissingFile(self):
+        self.assertRaises(OSError, HtpasswdFile, os.path.join(self.directory, "missing"))
+
+    def testFileRemovedAfterLoading(self):
+        self.write(self.line("alice", "foo"))
+        htpasswd = HtpasswdFile(self.path, check_interval = 0)
+        os.remove(self.path)
+        # The loaded content stays in use
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+        self.assertRaises(OSError, htpasswd.reload)
+        self.assertTrue(htpasswd.validate("alice", "foo"))
+
+    def testInvalidArguments(self):
+        self.write(self.line("alice", "foo"))
+        self.assertRaises(ValueError, HtpasswdFile, self.path, -1)
+        self.assertRaises(TypeError, HtpasswdFile, self.path, "foo")
+        self.assertRaises(TypeError, HtpasswdFile(self.path).validate, None, "foo")
+
+    def testReinitialization(self):
+        self.write(self.line("alice", "foo"))
+        htpasswd = HtpasswdFile(self.path)
+        self.assertRaises(RuntimeError, htpasswd.__init__, self.path)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -23,6 +23,11 @@
 This unit test module only works on systems that have a couple of basic command
 line utilities such as ps and tail. __init__.py only includes this unit test
 module if os.name == "posix".
+
+SoakTest runs a short version of the memory soak tests ("setup.py soak") and
+fails if a scenario leaves more allocations behind per call than the stored
+baseline allows. The RSS is only checked by the full soak run, because short
+loops are too noisy for it.
 """
 
 
@@ -32,6 +37,7 @@ import os
 
 # python-aprmd5
 from aprmd5 import md5
+import soak
 import tests   # import stuff from __init__.py (e.g. tests.python2)
 
 
@@ -44,7 +50,11 @@ def mem():
     for this is that this method uses the ps command line utility, and that
     utility may see only increases of one memory page (e.g. 4 KB on Mac OS X).
     """
-    return int(os.popen('ps -p %d -o rss | tail -1' % os.getpid()).read())
+    pipe = os.popen('ps -p %d -o rss | tail -1' % os.getpid())
+    try:
+        return int(pipe.read())
+    finally:
+        pipe.close()
 
 
 class MemoryLeakTest(unittest.TestCase):
@@ -114,5 +124,17 @@ class MemoryLeakTest(unittest.TestCase):
         self.assertEqual(memory, mem())
 
 
+class SoakTest(unittest.TestCase):
+
+    def testAllocationsPerCall(self):
+        """Tests if any soak scenario leaves allocations behind"""
+        if soak.tracemalloc is None:
+            self.skipTest("tracemalloc is not available")
+        runner = soak.Runner(duration = 0.05, minCalls = 100, measureRss = False, verbose = False)
+        report = soak.runAll(runner)
+        regressions = soak.compare(report["results"], soak.loadBaseline())
+        self.assertEqual(regressions, [])
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -22,12 +22,37 @@
 
 # PSL
 import unittest
+import hashlib
+import copy
+import mmap
+import os
+import pickle
+import subprocess
+import sys
+import tempfile
+import threading
 
 # python-aprmd5
-from aprmd5 import md5
+import aprmd5
+from aprmd5 import md5, md5_digest, md5_hexdigest
 import tests   # import stuff from __init__.py (e.g. tests.python2)
 
 
+def hashInFragments():
+    """Hash inputs of various lengths, fed in fragments that straddle block
+    boundaries, and compare the result with hashlib. Returns True if all
+    digests match. This is also run in child processes by
+    MD5Test.testAllBlockKernels() and MD5Test.testAllBackends()."""
+    for length in (0, 1, 55, 56, 63, 64, 65, 127, 128, 129, 1000, 70000):
+        input = bytes(bytearray((i * 13 + length) % 256 for i in range(length)))
+        m = md5()
+        for start in range(0, length, 37):
+            m.update(input[start:start + 37])
+        if m.digest() != hashlib.md5(input).digest():
+            return False
+    return True
+
+
 class MD5Test(unittest.TestCase):
     """Exercise aprmd5.md5"""
 
@@ -108,6 +133,224 @@ class MD5Test(unittest.TestCase):
         hexdigest = m.hexdigest()
         self.assertEqual(hexdigest, self.expectedHexdigestInputTwice)
 
+    def testUpdateInputIsBytearray(self):
+        m = md5()
+        m.update(bytearray(self.inputNormal))
+        hexdigest = m.hexdigest()
+        self.assertEqual(hexdigest, self.expectedHexdigestInputNormal)
+
+    def testUpdateInputIsMemoryview(self):
+        m = md5()
+        # Slicing the memoryview must not copy the underlying buffer, and only
+        # the slice must be hashed
+        view = memoryview(self.inputNormal + self.inputNormal)
+        m.update(view[:len(self.inputNormal)])
+        hexdigest = m.hexdigest()
+        self.assertEqual(hexdigest, self.expectedHexdigestInputNormal)
+
+    def testUpdateInputIsMmap(self):
+        m = md5()
+        tmpFile = tempfile.TemporaryFile()
+        try:
+            tmpFile.write(self.inputNormal)
+            tmpFile.flush()
+            mapped = mmap.mmap(tmpFile.fileno(), 0, access = mmap.ACCESS_READ)
+            try:
+                m.update(mapped)
+            finally:
+                mapped.close()
+        finally:
+            tmpFile.close()
+        hexdigest = m.hexdigest()
+        self.assertEqual(hexdigest, self.expectedHexdigestInputNormal)
+
+    def testCreateInitInputIsBytearray(self):
+        m = md5(bytearray(self.inputNormal))
+        hexdigest = m.hexdigest()
+        self.assertEqual(hexdigest, self.expectedHexdigestInputNormal)
+
+    def testUpdateLargeInput(self):
+        # Large enough that the GIL is released while hashing, and not a
+        # multiple of the block size
+        input = bytearray(range(256)) * 4099
+        m = md5()
+        m.update(input)
+        m.update(self.inputNormal)
+        expected = hashlib.md5(bytes(input) + self.inputNormal).hexdigest()
+        self.assertEqual(m.hexdigest(), expected)
+
+    def testUpdateLargeInputFromThreads(self):
+        # Several threads update the same object concurrently. The order of
+        # the updates is undefined, but since all inputs are equal the result
+        # is not.
+        input = bytes(bytearray(range(256)) * 1024)
+        threadCount = 4
+        updatesPerThread = 8
+        m = md5()
+        def worker():
+            for i in range(updatesPerThread):
+                m.update(input)
+        threads = [threading.Thread(target = worker) for i in range(threadCount)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        expected = hashlib.md5(input * threadCount * updatesPerThread).hexdigest()
+        self.assertEqual(m.hexdigest(), expected)
+
+    def testUpdateMixedInputFromThreads(self):
+        # Small updates are hashed without releasing the GIL, large ones with
+        # the GIL released; both must be serialized on the same object. All
+        # inputs consist of the same byte, so the order does not matter.
+        smallInput = ("a" * 64).encode("utf-8")
+        largeInput = smallInput * 64
+        threadCount = 4
+        updatesPerThread = 64
+        m = md5()
+        def worker(input):
+            for i in range(updatesPerThread):
+                m.update(input)
+        threads = [threading.Thread(target = worker, args = (input,))
+                   for i in range(threadCount) for input in (smallInput, largeInput)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        totalInput = (smallInput + largeInput) * threadCount * updatesPerThread
+        self.assertEqual(m.hexdigest(), hashlib.md5(totalInput).hexdigest())
+
+    def testUpdateMany(self):
+        m = md5()
+        m.update_many([self.inputNormal, bytearray(self.inputNormal)])
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputTwice)
+        # Any iterable works, including one with large buffers
+        input = bytes(bytearray(range(256)) * 64)
+        m = md5()
+        m.update_many(input[start:start + 3000] for start in range(0, len(input), 3000))
+        self.assertEqual(m.hexdigest(), hashlib.md5(input).hexdigest())
+
+    def testUpdateManyIsEmpty(self):
+        m = md5()
+        m.update_many([])
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputEmpty)
+
+    def testUpdateManyInputIsInvalid(self):
+        m = md5()
+        self.assertRaises(TypeError, m.update_many, None)
+        # The items before the invalid item have been fed
+        self.assertRaises(TypeError, m.update_many, [self.inputNormal, None])
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputNormal)
+
+    def testUpdateFrom(self):
+        if tests.python2:
+            return
+        import io
+        input = bytes(bytearray(range(256)) * 1000)
+        m = md5()
+        m.update(self.inputNormal)
+        # A buffer size that is not a multiple of the block size
+        self.assertEqual(m.update_from(io.BytesIO(input), bufsize = 1000), len(input))
+        self.assertEqual(m.hexdigest(), hashlib.md5(self.inputNormal + input).hexdigest())
+        tmpFile = tempfile.TemporaryFile()
+        try:
+            tmpFile.write(input)
+            tmpFile.seek(100)
+            m = md5()
+            self.assertEqual(m.update_from(tmpFile), len(input) - 100)
+        finally:
+            tmpFile.close()
+        self.assertEqual(m.hexdigest(), hashlib.md5(input[100:]).hexdigest())
+
+    def testUpdateFromInvalidArguments(self):
+        if tests.python2:
+            return
+        import io
+        m = md5()
+        self.assertRaises(AttributeError, m.update_from, self.inputNormal)
+        self.assertRaises(ValueError, m.update_from, io.BytesIO(self.inputNormal), 0)
+        class BadFile(object):
+            def readinto(self, buffer):
+                return len(buffer) + 1
+        self.assertRaises(ValueError, m.update_from, BadFile())
+        class KeepingFile(object):
+            def readinto(self, buffer):
+                self.buffer = buffer
+                return 0
+        keepingFile = KeepingFile()
+        m.update_from(keepingFile)
+        # The buffer is gone after the call
+        self.assertRaises(ValueError, len, keepingFile.buffer)
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputEmpty)
+
+    def testTypeIsImmutable(self):
+        if sys.version_info < (3, 10):
+            self.skipTest("heap types are immutable only since Python 3.10")
+        self.assertRaises(TypeError, setattr, md5, "update", None)
+
+    def testSubinterpreter(self):
+        """Each interpreter gets its own module object and its own types."""
+        if sys.version_info < (3, 9):
+            self.skipTest("module state requires Python 3.9")
+        try:
+            import _testcapi
+        except ImportError:
+            self.skipTest("_testcapi is not available")
+        expected = hashlib.md5(self.inputNormal).hexdigest()
+        script = ("import aprmd5\n"
+                  "assert aprmd5.md5(%r).hexdigest() == %r\n"
+                  "assert aprmd5.md5_hexdigest(%r) == %r\n"
+                  % (self.inputNormal, expected, self.inputNormal, expected))
+        self.assertEqual(_testcapi.run_in_subinterp(script), 0)
+        # The module in the main interpreter is not affected
+        self.assertEqual(md5(self.inputNormal).hexdigest(), self.expectedHexdigestInputNormal)
+
+    def testUpdateInFragments(self):
+        self.assertTrue(hashInFragments())
+
+    def testBlockKernelName(self):
+        self.assertTrue(aprmd5.md5block_kernel in ("portable", "fast", "bmi"))
+
+    def testAllBlockKernels(self):
+        """Forces each compression function in turn in a child process.
+        Functions that the CPU does not support fall back to the portable
+        function, which is tested as well."""
+        script = ("import sys\n"
+                  "from tests.test_md5 import hashInFragments\n"
+                  "sys.exit(0 if hashInFragments() else 1)\n")
+        for kernel in ("portable", "fast", "bmi"):
+            environment = dict(os.environ)
+            environment["APRMD5_BACKEND"] = "builtin"
+            environment["APRMD5_MD5BLOCK_KERNEL"] = kernel
+            environment["PYTHONPATH"] = os.pathsep.join(sys.path)
+            exitCode = subprocess.call([sys.executable, "-c", script], env = environment)
+            self.assertEqual(exitCode, 0, "kernel %s" % kernel)
+
+    def testBackendName(self):
+        self.assertTrue(aprmd5.backend in ("builtin", "openssl", "apr"))
+
+    def testAllBackends(self):
+        """Forces each backend in turn in a child process. A backend that is
+        not available falls back to the builtin backend, which is tested as
+        well. Besides md5, the child process checks md5_encode() and a state
+        exported by this process, which all backends must understand."""
+        m = md5(self.inputNormal * 30)
+        expected = hashlib.md5(self.inputNormal * 31).hexdigest()
+        script = ("import sys, aprmd5\n"
+                  "from tests.test_md5 import hashInFragments\n"
+                  "m = aprmd5.md5.from_state(%r)\n"
+                  "m.update(%r)\n"
+                  "ok = (hashInFragments()\n"
+                  "      and m.hexdigest() == %r\n"
+                  "      and aprmd5.md5_encode('foo', 'mYJd83wW') == '$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50')\n"
+                  "sys.exit(0 if ok else 1)\n"
+                  % (m.export_state(), self.inputNormal, expected))
+        for backend in ("builtin", "openssl", "apr"):
+            environment = dict(os.environ)
+            environment["APRMD5_BACKEND"] = backend
+            environment["PYTHONPATH"] = os.pathsep.join(sys.path)
+            exitCode = subprocess.call([sys.executable, "-c", script], env = environment)
+            self.assertEqual(exitCode, 0, "backend %s" % backend)
+
     def testDigest(self):
         m = md5()
         m.update(self.inputNormal)
@@ -182,6 +425,118 @@ class MD5Test(unittest.TestCase):
         m = md5()
         self.assertEqual(m.name, "md5")
 
+    def testDigestInto(self):
+        m = md5(self.inputNormal)
+        buffer = bytearray(20)
+        self.assertEqual(m.digest_into(buffer), 16)
+        self.assertEqual(bytes(buffer[:16]), m.digest())
+        self.assertEqual(bytes(buffer[16:]), bytes(bytearray(4)))
+        # A slice of a larger buffer works, too
+        buffer = bytearray(32)
+        m.digest_into(memoryview(buffer)[8:24])
+        self.assertEqual(bytes(buffer[8:24]), m.digest())
+
+    def testHexdigestInto(self):
+        m = md5(self.inputNormal)
+        buffer = bytearray(32)
+        self.assertEqual(m.hexdigest_into(buffer), 32)
+        self.assertEqual(buffer.decode("ascii"), self.expectedHexdigestInputNormal)
+
+    def testDigestIntoInvalidBuffer(self):
+        m = md5()
+        self.assertRaises(ValueError, m.digest_into, bytearray(15))
+        self.assertRaises(ValueError, m.hexdigest_into, bytearray(31))
+        if not tests.python2:
+            self.assertRaises(TypeError, m.digest_into, bytes(16))
+
+    def testCreateWithTooManyArguments(self):
+        self.assertRaises(TypeError, md5, self.inputNormal, self.inputNormal)
+        self.assertRaises(TypeError, md5, foo = self.inputNormal)
+        if not tests.python2:
+            self.assertRaises(TypeError, md5, "foo")
+
+    def testReusedObjectsStartFresh(self):
+        # Deallocated objects are kept on a freelist and reused; a reused
+        # object must not carry over any state
+        for i in range(200):
+            m = md5(self.inputNormal)
+            m.hexdigest()
+            del m
+            self.assertEqual(md5().hexdigest(), self.expectedHexdigestInputEmpty)
+            self.assertEqual(md5(self.inputNormal).copy().hexdigest(), self.expectedHexdigestInputNormal)
+
+    def testOneShotDigest(self):
+        self.assertEqual(md5_digest(self.inputNormal), self.expectedDigestInputNormal)
+        self.assertEqual(md5_hexdigest(self.inputNormal), self.expectedHexdigestInputNormal)
+        self.assertEqual(md5_hexdigest(self.inputEmpty), self.expectedHexdigestInputEmpty)
+        largeInput = self.inputNormal * 10000
+        self.assertEqual(md5_digest(bytearray(largeInput)), hashlib.md5(largeInput).digest())
+        self.assertEqual(md5_hexdigest(memoryview(largeInput)), hashlib.md5(largeInput).hexdigest())
+        self.assertRaises(TypeError, md5_digest, None)
+        if not tests.python2:
+            self.assertRaises(TypeError, md5_hexdigest, "foo")
+
+    def testExportState(self):
+        # Cover an empty pending buffer, a partial block, and several blocks
+        for length in (0, 1, 63, 64, 65, 1000):
+            input = self.inputNormal * length
+            m = md5(input)
+            state = m.export_state()
+            self.assertEqual(len(state), 29 + (len(input) % 64))
+            restored = md5.from_state(state)
+            self.assertEqual(restored.hexdigest(), m.hexdigest())
+            restored.update(self.inputNormal)
+            self.assertEqual(restored.hexdigest(), hashlib.md5(input + self.inputNormal).hexdigest())
+
+    def testExportStateFormat(self):
+        # The format is little endian regardless of the platform
+        state = md5(self.inputNormal).export_state()
+        self.assertEqual(state[:5], "AMD5\x01".encode("latin-1"))
+        self.assertEqual(state[21:29], "\x18\0\0\0\0\0\0\0".encode("latin-1"))
+        self.assertEqual(state[29:], self.inputNormal)
+        emptyState = md5().export_state()
+        self.assertEqual(emptyState[5:21], "\x01\x23\x45\x67\x89\xab\xcd\xef\xfe\xdc\xba\x98\x76\x54\x32\x10".encode("latin-1"))
+
+    def testFromStateInvalid(self):
+        state = md5(self.inputNormal).export_state()
+        self.assertRaises(ValueError, md5.from_state, state[:28])
+        self.assertRaises(ValueError, md5.from_state, state + self.inputNormal)
+        self.assertRaises(ValueError, md5.from_state, "XMD5".encode("latin-1") + state[4:])
+        self.assertRaises(ValueError, md5.from_state, state[:4] + "\x02".encode("latin-1") + state[5:])
+        self.assertRaises(TypeError, md5.from_state, None)
+
+    def testPickle(self):
+        m = md5(self.inputNormal * 30)
+        for protocol in range(pickle.HIGHEST_PROTOCOL + 1):
+            restored = pickle.loads(pickle.dumps(m, protocol))
+            self.assertEqual(restored.hexdigest(), m.hexdigest())
+            restored.update(self.inputNormal)
+            self.assertEqual(restored.hexdigest(), hashlib.md5(self.inputNormal * 31).hexdigest())
+
+    def testCopyModule(self):
+        m = md5(self.inputNormal)
+        for c in (copy.copy(m), copy.deepcopy(m)):
+            self.assertEqual(c.hexdigest(), self.expectedHexdigestInputNormal)
+            c.update(self.inputNormal)
+            self.assertEqual(m.hexdigest(), self.expectedHexdigestInputNormal)
+
+    def testSetStateReplacesState(self):
+        m = md5(self.inputNormal)
+        m.hexdigest()
+        m.__setstate__(md5().export_state())
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputEmpty)
+
+    def testCachedDigestIsInvalidatedByUpdate(self):
+        m = md5(self.inputNormal)
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputNormal)
+        self.assertEqual(m.hexdigest(), self.expectedHexdigestInputNormal)
+        c = m.copy()
+        m.update(self.inputNormal)
+        self.assertEqual(m.hexdigest(), hashlib.md5(self.inputNormal * 2).hexdigest())
+        self.assertEqual(c.hexdigest(), self.expectedHexdigestInputNormal)
+        c.update(self.inputNormal * 2000)
+        self.assertEqual(c.digest(), hashlib.md5(self.inputNormal * 2001).digest())
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -24,7 +24,7 @@
 import unittest
 
 # python-aprmd5
-from aprmd5 import md5_encode
+from aprmd5 import md5_encode, md5_encode_many
 
 
 class MD5EncodeTest(unittest.TestCase):
@@ -66,11 +66,27 @@ class MD5EncodeTest(unittest.TestCase):
         result = md5_encode(password, salt)
         self.assertEqual(result, expectedResult)
 
+    def testAllPasswordLengths(self):
+        """md5_encode() uses the single-password engine, md5_encode_many() the
+        multi-lane engine. Long passwords make the round messages span
+        several blocks, and the blocks before the digest are precomputed."""
+        pairs = [("%d" % (length % 10) * length, "s%d" % length) for length in range(150)]
+        expected = md5_encode_many(pairs)
+        for index, (password, salt) in enumerate(pairs):
+            self.assertEqual(md5_encode(password, salt), expected[index])
+
     def testSaltIsNone(self):
         password = "foo"
         salt = None
         self.assertRaises(TypeError, md5_encode, password, salt)
 
+    def testWrongNumberOfArguments(self):
+        self.assertRaises(TypeError, md5_encode, "foo")
+        self.assertRaises(TypeError, md5_encode, "foo", "salt", "bar")
+
+    def testEmbeddedNullCharacter(self):
+        self.assertRaises(ValueError, md5_encode, "fo\0o", "salt")
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,138 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.md5_file()"""
+
+# PSL
+import unittest
+import errno
+import hashlib
+import os
+import threading
+
+# python-aprmd5
+from aprmd5 import md5_file
+from tests import filetestcase
+import tests   # import stuff from __init__.py (e.g. tests.python2)
+
+
+class MD5FileTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.md5_file()"""
+
+    def testEmptyFile(self):
+        path = self.makeFile(b"")
+        self.assertEqual(md5_file(path), hashlib.md5(b"").digest())
+
+    def testSmallFile(self):
+        path = self.makeFile(b"foo")
+        self.assertEqual(md5_file(path), hashlib.md5(b"foo").digest())
+
+    def testLargeFile(self):
+        # Larger than the native read buffer, and not a multiple of the block
+        # size
+        content = self.makeContent(3 * 1024 * 1024 + 13)
+        path = self.makeFile(content)
+        self.assertEqual(md5_file(path), hashlib.md5(content).digest())
+
+    def testOffsetAndLength(self):
+        content = self.makeContent(100000)
+        path = self.makeFile(content)
+        for (offset, length) in ((0, 0), (1, 63), (4095, 4097), (99999, 1), (100000, 5), (50000, None)):
+            if length is None:
+                expectedContent = content[offset:]
+            else:
+                expectedContent = content[offset:offset + length]
+            self.assertEqual(md5_file(path, offset = offset, length = length),
+                             hashlib.md5(expectedContent).digest())
+
+    def testLengthBeyondEndOfFile(self):
+        content = self.makeContent(1000)
+        path = self.makeFile(content)
+        self.assertEqual(md5_file(path, length = 5000), hashlib.md5(content).digest())
+        self.assertEqual(md5_file(path, offset = 5000), hashlib.md5(b"").digest())
+
+    def testBytesPath(self):
+        path = self.makeFile(b"foo")
+        self.assertEqual(md5_file(path.encode()), hashlib.md5(b"foo").digest())
+
+    def testPathLikeObject(self):
+        if tests.python2:
+            return
+        import pathlib
+        path = self.makeFile(b"foo")
+        self.assertEqual(md5_file(pathlib.Path(path)), hashlib.md5(b"foo").digest())
+
+    def testConcurrentThreads(self):
+        content = self.makeContent(2 * 1024 * 1024)
+        path = self.makeFile(content)
+        results = []
+        def worker():
+            results.append(md5_file(path))
+        threads = [threading.Thread(target = worker) for i in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(results, [hashlib.md5(content).digest()] * 4)
+
+    @unittest.skipUnless(hasattr(os, "mkfifo"), "requires os.mkfifo()")
+    def testFifo(self):
+        content = self.makeContent(3 * 1024 * 1024 + 5)
+        path, thread = self.makeFifo(content)
+        self.assertEqual(md5_file(path), hashlib.md5(content).digest())
+        thread.join()
+        path, thread = self.makeFifo(content)
+        self.assertEqual(md5_file(path, length = 1000), hashlib.md5(content[:1000]).digest())
+        thread.join()
+
+    @unittest.skipUnless(hasattr(os, "mkfifo"), "requires os.mkfifo()")
+    def testFifoWithOffset(self):
+        path, thread = self.makeFifo(b"foo")
+        try:
+            md5_file(path, offset = 1)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ESPIPE)
+        thread.join()
+
+    def testFileDoesNotExist(self):
+        path = os.path.join(self.directory, "doesnotexist")
+        try:
+            md5_file(path)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ENOENT)
+            self.assertEqual(e.filename, path)
+
+    def testPathIsADirectory(self):
+        self.assertRaises(OSError, md5_file, self.directory)
+
+    def testNegativeOffsetOrLength(self):
+        path = self.makeFile(b"foo")
+        self.assertRaises(ValueError, md5_file, path, offset = -1)
+        self.assertRaises(ValueError, md5_file, path, length = -1)
+
+    def testPathIsNone(self):
+        self.assertRaises(TypeError, md5_file, None)
+
+
+if __name__ == "__main__":
+    unittest.main()
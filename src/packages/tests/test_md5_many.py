@@ -0,0 +1,102 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.md5_many()"""
+
+# PSL
+import unittest
+import os
+import subprocess
+import sys
+
+# python-aprmd5
+import aprmd5
+from aprmd5 import md5, md5_many
+
+
+def makeInputs():
+    """Return a list of byte strings whose lengths cover all the interesting
+    cases of MD5 padding: empty input, tails that do and do not leave room for
+    the length field, and inputs that span several blocks."""
+    lengths = [0, 1, 3, 55, 56, 57, 63, 64, 65, 119, 120, 127, 128, 129, 1000, 4099]
+    inputs = []
+    for length in lengths:
+        inputs.append(bytes(bytearray((i * 7 + length) % 256 for i in range(length))))
+    # Many more inputs than lanes, in an order that makes lanes finish at
+    # different times
+    inputs = inputs * 5 + list(reversed(inputs))
+    return inputs
+
+
+class MD5ManyTest(unittest.TestCase):
+    """Exercise aprmd5.md5_many()"""
+
+    def testMatchesMd5Type(self):
+        inputs = makeInputs()
+        expectedResult = [md5(input).digest() for input in inputs]
+        for threads in (0, 1, 2):
+            result = md5_many(inputs, threads = threads)
+            self.assertEqual(result, expectedResult)
+
+    def testEmpty(self):
+        self.assertEqual(md5_many([]), [])
+
+    def testSingle(self):
+        self.assertEqual(md5_many(["foo".encode("utf-8")]), [md5("foo".encode("utf-8")).digest()])
+
+    def testBufferTypes(self):
+        input = "foo".encode("utf-8")
+        expected = md5(input).digest()
+        result = md5_many([bytearray(input), memoryview(input), input])
+        self.assertEqual(result, [expected] * 3)
+
+    def testIterable(self):
+        inputs = makeInputs()
+        result = md5_many(iter(inputs))
+        self.assertEqual(result, [md5(input).digest() for input in inputs])
+
+    def testInputIsNone(self):
+        self.assertRaises(TypeError, md5_many, [None])
+
+    def testThreadsIsNegative(self):
+        self.assertRaises(ValueError, md5_many, [], threads = -1)
+
+    def testKernelName(self):
+        self.assertTrue(aprmd5.multibuf_kernel in ("scalar", "sse2", "avx2", "avx512"))
+
+    def testAllKernels(self):
+        """Forces each kernel in turn in a child process. Kernels that the CPU
+        does not support fall back to the scalar kernel, which is tested as
+        well."""
+        script = ("import aprmd5, hashlib\n"
+                  "from tests.test_md5_many import makeInputs\n"
+                  "inputs = makeInputs()\n"
+                  "assert aprmd5.md5_many(inputs, threads=1) == [hashlib.md5(i).digest() for i in inputs]\n")
+        for kernel in ("scalar", "sse2", "avx2", "avx512"):
+            environment = dict(os.environ)
+            environment["APRMD5_MULTIBUF_KERNEL"] = kernel
+            environment["PYTHONPATH"] = os.pathsep.join(sys.path)
+            exitCode = subprocess.call([sys.executable, "-c", script], env = environment)
+            self.assertEqual(exitCode, 0, "kernel %s" % kernel)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,123 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.md5_parts()"""
+
+# PSL
+import unittest
+import errno
+import hashlib
+import os
+
+# python-aprmd5
+from aprmd5 import md5_parts
+from tests import filetestcase
+
+
+def expectedParts(content, partSize):
+    """Return what md5_parts() should return for content, computed with
+    hashlib"""
+    digests = [hashlib.md5(content[start:start + partSize]).digest()
+               for start in range(0, max(len(content), 1), partSize)]
+    etag = "%s-%d" % (hashlib.md5(b"".join(digests)).hexdigest(), len(digests))
+    return (digests, etag)
+
+
+class MD5PartsTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.md5_parts()"""
+
+    def testBuffer(self):
+        content = self.makeContent(100000)
+        for partSize in (1, 64, 1000, 4097, 100000, 200000):
+            self.assertEqual(md5_parts(content, partSize), expectedParts(content, partSize))
+        self.assertEqual(md5_parts(bytearray(content), 4097), expectedParts(content, 4097))
+        self.assertEqual(md5_parts(memoryview(content)[10:], 4097), expectedParts(content[10:], 4097))
+
+    def testFile(self):
+        # Parts larger than the native read buffer, and a short last part
+        content = self.makeContent(3 * 1024 * 1024 + 13)
+        path = self.makeFile(content)
+        for partSize in (1024 * 1024, 1536 * 1024 + 1):
+            self.assertEqual(md5_parts(path, partSize), expectedParts(content, partSize))
+
+    def testKnownETag(self):
+        # Two parts of 5 MiB and 1 byte, as uploaded by an S3 client
+        content = b"a" * (5 * 1024 * 1024 + 1)
+        digests, etag = md5_parts(content, 5 * 1024 * 1024)
+        self.assertEqual(len(digests), 2)
+        self.assertEqual(etag, expectedParts(content, 5 * 1024 * 1024)[1])
+        self.assertTrue(etag.endswith("-2"))
+
+    def testThreads(self):
+        content = self.makeContent(50000)
+        path = self.makeFile(content)
+        expected = expectedParts(content, 1000)
+        for threads in (0, 1, 3, 64):
+            self.assertEqual(md5_parts(path, 1000, threads = threads), expected)
+
+    def testEmptyContent(self):
+        # Empty content counts as one empty part
+        expected = ([hashlib.md5(b"").digest()], "%s-1" % hashlib.md5(hashlib.md5(b"").digest()).hexdigest())
+        self.assertEqual(md5_parts(b"", 10), expected)
+        self.assertEqual(md5_parts(self.makeFile(b""), 10), expected)
+
+    def testPathLikeObject(self):
+        import pathlib
+        content = self.makeContent(5000)
+        path = self.makeFile(content)
+        self.assertEqual(md5_parts(pathlib.Path(path), 1000), expectedParts(content, 1000))
+
+    def testFileDoesNotExist(self):
+        path = os.path.join(self.directory, "doesnotexist")
+        try:
+            md5_parts(path, 1000)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ENOENT)
+            self.assertEqual(e.filename, path)
+
+    def testPathIsADirectory(self):
+        try:
+            md5_parts(self.directory, 1000)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.EISDIR)
+
+    @unittest.skipUnless(hasattr(os, "mkfifo"), "requires os.mkfifo()")
+    def testPathIsAFifo(self):
+        # The size of a FIFO is 0; it must not be hashed as an empty file
+        path, thread = self.makeFifo(b"foo")
+        self.assertRaises(ValueError, md5_parts, path, 1024)
+        thread.join()
+
+    @unittest.skipUnless(os.path.exists("/proc/self/status"), "requires /proc")
+    def testPathIsAProcFile(self):
+        self.assertRaises(ValueError, md5_parts, "/proc/self/status", 1024)
+
+    def testInvalidArguments(self):
+        self.assertRaises(ValueError, md5_parts, b"foo", 0)
+        self.assertRaises(ValueError, md5_parts, b"foo", 10, threads = -1)
+        self.assertRaises(TypeError, md5_parts, None, 10)
+        self.assertRaises(TypeError, md5_parts, b"foo", 10, 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
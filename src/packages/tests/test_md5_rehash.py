@@ -0,0 +1,181 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+"""Unit tests for aprmd5.md5_rehash()"""
+
+# PSL
+import unittest
+import errno
+import hashlib
+import os
+
+# python-aprmd5
+from aprmd5 import md5_rehash
+from tests import filetestcase
+
+
+# The sizes of the header, of one checkpoint and of the trailer of an index
+HEADERSIZE = 24
+CHECKPOINTSIZE = 45
+TRAILERSIZE = 16
+
+
+class MD5RehashTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.md5_rehash()"""
+
+    def setUp(self):
+        filetestcase.FileTestCase.setUp(self)
+        self.path = os.path.join(self.directory, "log")
+        self.index = os.path.join(self.directory, "log.md5idx")
+
+    def writeFile(self, content, mode = "wb"):
+        f = open(self.path, mode)
+        f.write(content)
+        f.close()
+
+    def patchFile(self, path, offset, content):
+        f = open(path, "r+b")
+        f.seek(offset)
+        f.write(content)
+        f.close()
+
+    def checkpointCount(self):
+        return (os.path.getsize(self.index) - HEADERSIZE - TRAILERSIZE) // CHECKPOINTSIZE
+
+    def testNewIndex(self):
+        content = self.makeContent(10000)
+        self.writeFile(content)
+        self.assertEqual(md5_rehash(self.path, self.index, interval = 1024), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 9)
+        self.assertEqual(sorted(os.listdir(self.directory)), ["log", "log.md5idx"])
+
+    def testAppend(self):
+        content = b""
+        for length in (0, 1, 63, 1024, 1000, 5000, 3, 20000):
+            appended = self.makeContent(length, len(content))
+            self.writeFile(appended, "ab")
+            content += appended
+            self.assertEqual(md5_rehash(self.path, self.index, interval = 1024), hashlib.md5(content).digest())
+            self.assertEqual(self.checkpointCount(), len(content) // 1024)
+
+    def testResumesFromCheckpoint(self):
+        # A change before the probe of the last checkpoint goes unnoticed,
+        # which proves that the beginning of the file is not hashed again
+        content = self.makeContent(4 * 8192 + 100)
+        self.writeFile(content)
+        digest = md5_rehash(self.path, self.index, interval = 8192)
+        self.patchFile(self.path, 0, b"x")
+        self.assertEqual(md5_rehash(self.path, self.index), digest)
+        self.writeFile(b"tail", "ab")
+        self.assertEqual(md5_rehash(self.path, self.index), hashlib.md5(content + b"tail").digest())
+
+    def testChangedProbe(self):
+        # A change just before the last checkpoint invalidates it, so hashing
+        # resumes from the checkpoint before
+        content = self.makeContent(4 * 8192 + 100)
+        self.writeFile(content)
+        md5_rehash(self.path, self.index, interval = 8192)
+        self.patchFile(self.path, 4 * 8192 - 1, b"x")
+        content = content[:4 * 8192 - 1] + b"x" + content[4 * 8192:]
+        self.assertEqual(md5_rehash(self.path, self.index), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 4)
+
+    def testTruncatedFile(self):
+        content = self.makeContent(10000)
+        self.writeFile(content)
+        md5_rehash(self.path, self.index, interval = 1024)
+        self.writeFile(content[:3000])
+        self.assertEqual(md5_rehash(self.path, self.index), hashlib.md5(content[:3000]).digest())
+        self.assertEqual(self.checkpointCount(), 2)
+        self.writeFile(b"")
+        self.assertEqual(md5_rehash(self.path, self.index), hashlib.md5(b"").digest())
+        self.assertEqual(self.checkpointCount(), 0)
+
+    def testCorruptIndex(self):
+        content = self.makeContent(10000)
+        self.writeFile(content)
+        md5_rehash(self.path, self.index, interval = 1024)
+        self.patchFile(self.index, HEADERSIZE + 3, b"\xff")
+        self.patchFile(self.path, 0, b"x")
+        content = b"x" + content[1:]
+        self.assertEqual(md5_rehash(self.path, self.index, interval = 1024), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 9)
+        f = open(self.index, "wb")
+        f.write(b"garbage")
+        f.close()
+        self.assertEqual(md5_rehash(self.path, self.index, interval = 1024), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 9)
+
+    def testIntervalChange(self):
+        content = self.makeContent(10000)
+        self.writeFile(content)
+        md5_rehash(self.path, self.index, interval = 1024)
+        self.assertEqual(md5_rehash(self.path, self.index, interval = 2048), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 4)
+        # Without an interval, the interval of the index is kept
+        self.writeFile(self.makeContent(10000), "ab")
+        md5_rehash(self.path, self.index)
+        self.assertEqual(self.checkpointCount(), 9)
+
+    def testFileDoesNotExist(self):
+        try:
+            md5_rehash(self.path, self.index)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ENOENT)
+            self.assertEqual(e.filename, self.path)
+        self.assertFalse(os.path.exists(self.index))
+
+    def testIgnoresPlantedTemporaryFile(self):
+        target = os.path.join(self.directory, "target")
+        f = open(target, "wb")
+        f.write(b"target")
+        f.close()
+        os.symlink(target, self.index + ".tmp")
+        content = self.makeContent(10000)
+        self.writeFile(content)
+        self.assertEqual(md5_rehash(self.path, self.index, interval = 1024), hashlib.md5(content).digest())
+        self.assertEqual(self.checkpointCount(), 9)
+        f = open(target, "rb")
+        self.assertEqual(f.read(), b"target")
+        f.close()
+
+    def testIndexCannotBeWritten(self):
+        self.writeFile(b"foo")
+        index = os.path.join(self.directory, "doesnotexist", "log.md5idx")
+        try:
+            md5_rehash(self.path, index)
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ENOENT)
+            self.assertEqual(e.filename, index)
+
+    def testInvalidArguments(self):
+        self.writeFile(b"foo")
+        for interval in (0, -64, 100):
+            self.assertRaises(ValueError, md5_rehash, self.path, self.index, interval = interval)
+        self.assertRaises(TypeError, md5_rehash, self.path)
+        self.assertRaises(TypeError, md5_rehash, self.path, self.index, interval = "64")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -24,7 +24,7 @@
 import unittest
 
 # python-aprmd5
-from aprmd5 import password_validate
+from aprmd5 import password_validate, md5_encode
 
 
 class PasswordValidateTest(unittest.TestCase):
@@ -44,6 +44,55 @@ class PasswordValidateTest(unittest.TestCase):
         result = password_validate(password, hash)
         self.assertEqual(result, expectedResult)
 
+    def testValidationFailsForTruncatedHash(self):
+        password = "foo"
+        hash = "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX5"
+        self.assertEqual(password_validate(password, hash), False)
+        self.assertEqual(password_validate(password, hash + "00"), False)
+
+    def testLongPasswords(self):
+        for length in (47, 48, 64, 100, 300):
+            password = "x" * length
+            hash = md5_encode(password, "mYJd83wW")
+            self.assertEqual(password_validate(password, hash), True)
+            self.assertEqual(password_validate(password[:-1] + "y", hash), False)
+
+    def testSha1Hash(self):
+        hash = "{SHA}C+7Hteo/D9vJXQ3UfzxbwnXaijM="
+        self.assertEqual(password_validate("foo", hash), True)
+        self.assertEqual(password_validate("fox", hash), False)
+        self.assertEqual(password_validate("foo", hash[:-1]), False)
+
+    def testMd5CryptHash(self):
+        hash = "$1$mYJd83wW$fIuQNGxb1BPSvQy5DP8sV."
+        self.assertEqual(password_validate("foo", hash), True)
+        self.assertEqual(password_validate("fox", hash), False)
+        # Same salt, but the hash of the apr1 scheme
+        self.assertEqual(password_validate("foo", "$1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"), False)
+
+    def testBcryptHash(self):
+        hash = "$2y$04$abcdefghijklmnopqrstuusPAkIApvNSrrxdx0BTXtj7R2NfqZq36"
+        self.assertEqual(password_validate("foo", hash), True)
+        self.assertEqual(password_validate("fox", hash), False)
+        self.assertEqual(password_validate("foo", "$2b$" + hash[4:]), True)
+        self.assertEqual(password_validate("U*U", "$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW"), True)
+        # bcrypt ignores everything after the first 72 characters
+        hash = "$2a$05$abcdefghijklmnopqrstuu5s2v8.iXieOjg/.AySBTTZIIVFJeBui"
+        password = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+        self.assertEqual(password_validate(password + "chars after 72 are ignored", hash), True)
+        self.assertEqual(password_validate(password, hash), True)
+        self.assertEqual(password_validate(password[:-1], hash), False)
+
+    def testBcryptHashIsMalformed(self):
+        hash = "$2y$04$abcdefghijklmnopqrstuusPAkIApvNSrrxdx0BTXtj7R2NfqZq36"
+        self.assertEqual(password_validate("foo", hash[:-1]), False)
+        self.assertEqual(password_validate("foo", "$2y$03$" + hash[7:]), False)
+        self.assertEqual(password_validate("foo", "$2y$04$abcdefghijklmnopqrstu"), False)
+
+    def testPlaintextIsNotAccepted(self):
+        # Like libaprutil on all platforms except Windows, NetWare and BeOS
+        self.assertEqual(password_validate("secret", "secret"), False)
+
     def testPasswordIsEmptyString(self):
         password = ""
         hash = "$apr1$7n4Iu7Bq$jsH1cRc.tyRPvJpZjxUjV."
@@ -0,0 +1,103 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Unit tests for aprmd5.stats(), aprmd5.reset_stats() and
+aprmd5.set_stats_enabled()"""
+
+# PSL
+import unittest
+import threading
+
+# python-aprmd5
+from aprmd5 import md5, md5_encode, password_validate, stats, reset_stats, set_stats_enabled
+
+
+class StatsTest(unittest.TestCase):
+    """Exercise the runtime statistics"""
+
+    hash = "$apr1$mYJd83wW$IO.6aK3G0d4mHxcImhPX50"
+
+    def setUp(self):
+        self.wasEnabled = set_stats_enabled(True)
+        reset_stats()
+
+    def tearDown(self):
+        set_stats_enabled(self.wasEnabled)
+
+    def testUpdate(self):
+        m = md5(b"foo")
+        m.update(b"x" * 5000)
+        result = stats()
+        self.assertTrue(result["enabled"])
+        update = result["md5_update"]
+        self.assertEqual(update["calls"], 2)
+        self.assertEqual(update["bytes"], 5003)
+        self.assertEqual(update["failures"], 0)
+        self.assertEqual(sum(update["histogram"]), 2)
+        self.assertEqual(len(update["histogram"]), 40)
+
+    def testEncodeAndValidate(self):
+        md5_encode("foo", "salt")
+        self.assertTrue(password_validate("foo", self.hash))
+        self.assertFalse(password_validate("bar", self.hash))
+        result = stats()
+        self.assertEqual(result["md5_encode"]["calls"], 1)
+        self.assertEqual(result["password_validate"]["calls"], 2)
+        self.assertEqual(result["password_validate"]["failures"], 1)
+        self.assertTrue(result["md5_encode"]["total_ns"] > 0)
+
+    def testReset(self):
+        md5_encode("foo", "salt")
+        reset_stats()
+        result = stats()
+        self.assertEqual(result["md5_encode"]["calls"], 0)
+        self.assertEqual(sum(result["md5_encode"]["histogram"]), 0)
+        md5_encode("foo", "salt")
+        self.assertEqual(stats()["md5_encode"]["calls"], 1)
+
+    def testDisabled(self):
+        self.assertTrue(set_stats_enabled(False))
+        self.assertFalse(set_stats_enabled(False))
+        md5_encode("foo", "salt")
+        md5(b"foo")
+        result = stats()
+        self.assertFalse(result["enabled"])
+        self.assertEqual(result["md5_encode"]["calls"], 0)
+        self.assertEqual(result["md5_update"]["calls"], 0)
+
+    def testThreads(self):
+        # Each thread records into its own shard; stats() adds them up
+        def worker():
+            for i in range(100):
+                md5(b"x" * 4096)
+        for round in range(3):
+            threads = [threading.Thread(target = worker) for i in range(4)]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+        update = stats()["md5_update"]
+        self.assertEqual(update["calls"], 3 * 4 * 100)
+        self.assertEqual(update["bytes"], 3 * 4 * 100 * 4096)
+
+
+if __name__ == "__main__":
+    unittest.main()
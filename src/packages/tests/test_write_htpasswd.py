@@ -0,0 +1,155 @@
+# encoding=utf-8
+
+# Copyright 2026 Patrick Näf
+# 
+# This file is part of python-aprmd5
+#
+# python-aprmd5 is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# python-aprmd5 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with python-aprmd5. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+"""Unit tests for aprmd5.write_htpasswd()"""
+
+# PSL
+import unittest
+import errno
+import os
+import re
+
+# python-aprmd5
+from aprmd5 import write_htpasswd, password_validate, HtpasswdFile
+from tests import filetestcase
+
+
+class WriteHtpasswdTest(filetestcase.FileTestCase):
+    """Exercise aprmd5.write_htpasswd()"""
+
+    def setUp(self):
+        filetestcase.FileTestCase.setUp(self)
+        self.path = os.path.join(self.directory, "htpasswd")
+
+    def readLines(self):
+        f = open(self.path, "r")
+        lines = f.read().splitlines()
+        f.close()
+        return lines
+
+    def testWrite(self):
+        pairs = [("alice", "secret"), ("bob", ""), ("carol", "pässword"), ("dave", "x" * 200)]
+        self.assertEqual(write_htpasswd(self.path, pairs), len(pairs))
+        lines = self.readLines()
+        self.assertEqual(len(lines), len(pairs))
+        for (user, password), line in zip(pairs, lines):
+            lineUser, hash = line.split(":", 1)
+            self.assertEqual(lineUser, user)
+            self.assertTrue(re.match(r"^\$apr1\$[./0-9A-Za-z]{8}\$[./0-9A-Za-z]{22}$", hash), hash)
+            self.assertTrue(password_validate(password, hash))
+        htpasswdFile = HtpasswdFile(self.path)
+        self.assertTrue(htpasswdFile.validate("alice", "secret"))
+        self.assertFalse(htpasswdFile.validate("alice", "wrong"))
+
+    def testManyUsers(self):
+        # More users than fit into one chunk, from a generator
+        count = 5000
+        pairs = (("user%d" % i, "password%d" % i) for i in range(count))
+        self.assertEqual(write_htpasswd(self.path, pairs, threads = 3), count)
+        lines = self.readLines()
+        self.assertEqual([line.split(":", 1)[0] for line in lines], ["user%d" % i for i in range(count)])
+        for i in (0, 1, 4095, 4096, 4999):
+            self.assertTrue(password_validate("password%d" % i, lines[i].split(":", 1)[1]))
+
+    def testSaltsAreRandom(self):
+        write_htpasswd(self.path, [("user%d" % i, "password") for i in range(100)])
+        salts = set(line.split("$")[2] for line in self.readLines())
+        self.assertEqual(len(salts), 100)
+
+    def testNoUsers(self):
+        self.assertEqual(write_htpasswd(self.path, []), 0)
+        self.assertEqual(os.path.getsize(self.path), 0)
+
+    def testReplacesFile(self):
+        f = open(self.path, "w")
+        f.write("old:line\n" * 1000)
+        f.close()
+        write_htpasswd(self.path, [("new", "password")])
+        self.assertEqual(len(self.readLines()), 1)
+        self.assertEqual(os.listdir(self.directory), ["htpasswd"])
+
+    def testErrorLeavesFileUnchanged(self):
+        f = open(self.path, "w")
+        f.write("old:line\n")
+        f.close()
+        for user in ("", "a:b", "a\nb", "a\rb"):
+            self.assertRaises(ValueError, write_htpasswd, self.path, [("good", "password"), (user, "password")])
+        self.assertRaises(TypeError, write_htpasswd, self.path, [("good", "password"), ("bad",)])
+        def failingGenerator():
+            yield ("good", "password")
+            raise KeyError("foo")
+        self.assertRaises(KeyError, write_htpasswd, self.path, failingGenerator())
+        self.assertEqual(self.readLines(), ["old:line"])
+        self.assertEqual(os.listdir(self.directory), ["htpasswd"])
+
+    def testPermissionsOfNewFile(self):
+        # A new file gets the permission bits that the htpasswd utility gives
+        # it, so that e.g. a web server that runs as another user can read it
+        for umask, expected in ((0o022, 0o644), (0o027, 0o640), (0o077, 0o600)):
+            oldUmask = os.umask(umask)
+            try:
+                path = os.path.join(self.directory, "new%o" % umask)
+                write_htpasswd(path, [("user", "password")])
+            finally:
+                os.umask(oldUmask)
+            self.assertEqual(os.stat(path).st_mode & 0o777, expected)
+            os.remove(path)
+        self.assertEqual(os.listdir(self.directory), [])
+
+    def testKeepsPermissions(self):
+        write_htpasswd(self.path, [("user", "password")])
+        os.chmod(self.path, 0o640)
+        write_htpasswd(self.path, [("user", "password")])
+        self.assertEqual(os.stat(self.path).st_mode & 0o777, 0o640)
+
+    def testIgnoresPlantedTemporaryFile(self):
+        # A symbolic link where a predictable temporary file would be must
+        # neither be followed nor be removed
+        target = os.path.join(self.directory, "target")
+        f = open(target, "w")
+        f.write("target\n")
+        f.close()
+        os.symlink(target, self.path + ".tmp")
+        write_htpasswd(self.path, [("user", "password")])
+        self.assertEqual(len(self.readLines()), 1)
+        f = open(target, "r")
+        self.assertEqual(f.read(), "target\n")
+        f.close()
+        self.assertEqual(sorted(os.listdir(self.directory)), ["htpasswd", "htpasswd.tmp", "target"])
+
+    def testDirectoryDoesNotExist(self):
+        path = os.path.join(self.directory, "doesnotexist", "htpasswd")
+        try:
+            write_htpasswd(path, [("user", "password")])
+            self.fail("OSError not raised")
+        except OSError as e:
+            self.assertEqual(e.errno, errno.ENOENT)
+
+    def testInvalidArguments(self):
+        self.assertRaises(TypeError, write_htpasswd, self.path, None)
+        self.assertRaises(TypeError, write_htpasswd, self.path, [("user", None)])
+        self.assertRaises(ValueError, write_htpasswd, self.path, [], threads = -1)
+        self.assertRaises(TypeError, write_htpasswd, self.path)
+
+
+if __name__ == "__main__":
+    unittest.main()